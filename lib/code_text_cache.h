@@ -0,0 +1,118 @@
+#pragma once
+
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+#include "include/core/SkFont.h"
+#include "include/core/SkTextBlob.h"
+
+#include "common.h"
+#include "sv_colorizer.h"
+
+namespace graphics {
+
+/**
+ * @brief All spans of one color on a line, shaped into a single text blob positioned relative to the
+ * start of the line's baseline
+ */
+struct CodeLineRun {
+    Color             color;
+    sk_sp<SkTextBlob> blob;
+};
+
+/**
+ * @brief A pre-shaped window of a line of code. The window is wider than the panel, so scrolling
+ * sideways within it only moves the blobs
+ * @var runs      One blob per distinct color on the line
+ * @var first_col Column the shaped text starts at, everything left of it is clipped away
+ * @var col_x     X of the columns the window can be scrolled to, only for proportional fonts
+ * @var width     Advance width of the shaped text in pixels
+ */
+struct CodeLine {
+    std::vector<CodeLineRun> runs;
+    size_t             first_col = 0;
+    std::vector<float> col_x;
+    float              width     = 0.f;
+    size_t             bytes     = 0; // estimated size of the blobs
+};
+
+/**
+ * @brief Cache of shaped text blobs for the lines of a colorized document. Lines are shaped lazily
+ * the first time they are drawn, and only the columns that fit inside the panel are shaped. Only the
+ * lines around the most recently drawn ones are kept, so the cache size does not depend on the
+ * length of the document. Everything is thrown away when the document or the font changes.
+ */
+class CodeTextCache {
+public:
+    // Lines kept around before the ones furthest from the view are evicted
+    static constexpr size_t kMaxCachedLines = 2048;
+    // Columns a shaped line can be scrolled by before it is shaped again
+    static constexpr size_t kScrollColumns = 32;
+
+    /**
+     * @brief Make sure the cache belongs to doc and font, throwing everything away if not. A document
+     * is identified by the source its spans point into, so a new document moved into the same object
+     * is still noticed
+     * @param max_width Width of the visible text area, text further right than the scroll window is
+     * never shaped
+     */
+    void sync(const sv::ColorizedDoc& doc, const SkFont& font, float max_width);
+
+    /**
+     * @brief Drop all cached lines and everything measured from the document, for when it was
+     * modified or replaced in place. The next sync() starts over
+     */
+    void invalidate();
+
+    /**
+     * @brief Get a shaped line that covers the view starting at column first_col, shaping it now if
+     * the cached window does not. Lines not shaped yet come back empty once the source was written
+     * in place, its spans could fault
+     */
+    const CodeLine& line(size_t idx, size_t first_col = 0);
+
+    /**
+     * @brief X of column col relative to the start of the shaped line, col must be one it was fetched for
+     */
+    float columnX(const CodeLine& line, size_t col) const;
+
+    bool   isMonospace() const { return monospace; }
+    float  charAdvance() const { return advance; }
+    size_t maxColumns()  const { return max_columns; }
+
+    /**
+     * @brief Estimated bytes of every cached line
+     */
+    size_t memoryBytes() const { return bytes + lines.size() * sizeof(std::pair<const size_t, CodeLine>); }
+
+private:
+    void buildLine(const sv::LineSpans& spans, CodeLine& out);
+    void evictAround(size_t idx);
+    void clearLines();
+
+    const sv::ColorizedDoc*               doc         = nullptr;
+    std::shared_ptr<const SV::MappedFile> source;           // held so its address is not reused by another file
+    size_t                                doc_size    = 0;
+    size_t                                max_columns = 0; // length of the longest line
+    bool                                  intact      = true; // source unchanged on disk as of the last sync
+
+    SkFont      font;
+    SkTypeface* typeface  = nullptr;
+    float       font_size = 0.f;
+    float       max_width   = 0.f;
+    float       shape_width = 0.f; // the visible width plus the columns the window can scroll by
+    bool        monospace   = false;
+    float       advance     = 0.f; // width of one column, exact for monospaced fonts
+    float       space_w     = 0.f; // width of ' ', whitespace is advanced over, not drawn
+
+    std::unordered_map<size_t, CodeLine> lines;
+    size_t                               bytes = 0; // sum of CodeLine::bytes
+
+    // Scratch buffers reused between lines
+    std::vector<SkGlyphID> glyphs;
+    std::vector<SkScalar>  positions;
+    std::vector<SkScalar>  widths;
+};
+
+}
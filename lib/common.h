@@ -5,8 +5,10 @@
 #include <iostream>
 #include <sstream>
 #include <string>
+#include <string_view>
 #include <vector>
 #include <filesystem>
+#include <optional>
 
 #include <nlohmann/json.hpp>
 using json = nlohmann::json;
@@ -81,7 +83,48 @@ std::ostream& operator<<(std::ostream& os, const Color& c);
 std::string ResolveUserPath(const char* arg);
 
 // File stuff
-std::string ReadAll(FILE* f);
+
+/**
+ * @brief Growable byte buffer for reading into. Grows with realloc, which for big buffers remaps
+ * pages instead of copying them, and never zero fills what is about to be read over.
+ */
+class IoBuffer {
+public:
+    IoBuffer() = default;
+    ~IoBuffer() { std::free(bytes); }
+
+    IoBuffer(IoBuffer&& o) noexcept : bytes(o.bytes), len(o.len), cap(o.cap) { o.bytes = nullptr; o.len = o.cap = 0; }
+    IoBuffer& operator=(IoBuffer&& o) noexcept {
+        std::swap(bytes, o.bytes);
+        std::swap(len, o.len);
+        std::swap(cap, o.cap);
+        return *this;
+    }
+    IoBuffer(const IoBuffer&)            = delete;
+    IoBuffer& operator=(const IoBuffer&) = delete;
+
+    const char*      data() const { return bytes; }
+    size_t           size() const { return len; }
+    bool             empty() const { return len == 0; }
+    std::string_view view() const { return std::string_view(bytes, len); }
+
+    /**
+     * @brief Room for at least n more bytes after size(), to be filled and then committed
+     */
+    char* reserveTail(size_t n);
+    void  commit(size_t n) { len += n; }
+
+private:
+    char*  bytes = nullptr;
+    size_t len   = 0;
+    size_t cap   = 0;
+};
+
+/**
+ * @brief Everything until end of file, e.g. the output of a subprocess, read with large read() calls
+ * straight into the buffer it is returned in
+ */
+IoBuffer ReadAll(FILE* f);
 
 // Json stuff
 inline bool is_object(const json& n) { return n.is_object(); }
@@ -123,6 +166,37 @@ inline const json* find_first(const json& node, std::string_view wanted_tag) {
     return nullptr;
 }
 
+// first and last token below a node, tokens are the nodes that carry byte offsets
+inline const json* first_token(const json& node) {
+    if (!is_object(node)) return nullptr;
+    if (node.contains("start")) return &node;
+    if (auto a = get_child_array(node)) {
+        for (const auto& c : *a) if (!c.is_null()) {
+            if (auto* r = first_token(c)) return r;
+        }
+    }
+    return nullptr;
+}
+
+inline const json* last_token(const json& node) {
+    if (!is_object(node)) return nullptr;
+    if (node.contains("end")) return &node;
+    if (auto a = get_child_array(node)) {
+        for (auto it = a->rbegin(); it != a->rend(); ++it) if (!it->is_null()) {
+            if (auto* r = last_token(*it)) return r;
+        }
+    }
+    return nullptr;
+}
+
+// byte range of the source covered by a node
+inline std::optional<Range> node_range(const json& node) {
+    const json* first = first_token(node);
+    const json* last  = last_token(node);
+    if (!first || !last) return std::nullopt;
+    return Range(first->at("start").get<int>(), last->at("end").get<int>());
+}
+
 // collect all descendants with a given tag
 inline void collect_all(const json& node, std::string_view wanted_tag, std::vector<const json*>& out) {
     if (!is_object(node)) return;
@@ -131,3 +205,27 @@ inline void collect_all(const json& node, std::string_view wanted_tag, std::vect
         for (const auto& c : *a) if (!c.is_null()) collect_all(c, wanted_tag, out);
     }
 }
+
+// source text of a node, rebuilt from its tokens. Tokens without text are keywords and operators,
+// their tag is the text. Tokens that were apart in the source get one space between them
+inline void append_node_text(const json& node, std::string& out, int& prev_end) {
+    if (!is_object(node)) return;
+    if (node.contains("start")) {
+        const int start = node.at("start").get<int>();
+        if (!out.empty() && start > prev_end) out += ' ';
+        auto it = node.find("text");
+        out     += (it != node.end() && it->is_string()) ? it->get<std::string>() : tag_of(node);
+        prev_end = node.at("end").get<int>();
+        return;
+    }
+    if (auto a = get_child_array(node)) {
+        for (const auto& c : *a) if (!c.is_null()) append_node_text(c, out, prev_end);
+    }
+}
+
+inline std::string node_text(const json& node) {
+    std::string out;
+    int         prev_end = 0;
+    append_node_text(node, out, prev_end);
+    return out;
+}
@@ -1,6 +1,8 @@
 #pragma once
 #include "common.h"
 #include "sv.h"
+#include "symbol_table.h"
+#include "design_db.h"
 
 namespace cst {
 
@@ -69,6 +71,24 @@ json ParseFiles(size_t num_files, char** file_paths, bazel::tools::cpp::runfiles
 SV::Module* ParseCST(const json& cst_json);
 
 
+/**
+ * @brief Rebuild the modules and their instantiations from a design database instead of from a CST,
+ * replacing the symbol table just like ParseCST does
+ * @return The top module, nullptr if the database has none
+ */
+SV::Module* ParseDesignDB(const db::DesignDB& design);
+
+/**
+ * @brief Like ParseDesignDB, but into a table of the caller's, e.g. for a second revision of the
+ * design that must not replace the one on screen
+ */
+SV::Module* ReadDesignDB(const db::DesignDB& design, SymTable::ModuleSymbolTable* table);
+
+/**
+ * @brief Symbol table with every module found by the last call to ParseCST or ParseDesignDB
+ */
+SymTable::ModuleSymbolTable* GetModuleSymbolTable();
+
 /**
  * @brief Pretty print the node structure
  */
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <vector>
+
+#include "include/core/SkRect.h"
+
+namespace graphics {
+
+/**
+ * @brief Tracks which regions of the framebuffer changed since the last presented frame, so that
+ * only those regions are re-rastered and uploaded to the window texture.
+ * @var rects  Damaged screen rectangles, in pixels. Only valid after finalize()
+ * @var bounds Bounds of the framebuffer, every damage rect is clipped against this
+ * @var full   True if the whole framebuffer has to be redrawn
+ */
+struct DamageTracker {
+    std::vector<SkIRect> rects;
+    SkIRect bounds = SkIRect::MakeWH(0, 0);
+    bool    full   = true;
+
+    // If the damaged area covers more than this fraction of the screen, just redraw all of it
+    static constexpr float kFullScreenFraction = 0.6f;
+    // Upper bound on separate uploads per frame, more than this and the rects get merged
+    static constexpr size_t kMaxRects = 8;
+
+    /**
+     * @brief Set the framebuffer size, and mark everything as damaged
+     */
+    void reset(int width, int height);
+
+    /**
+     * @brief Mark a region of the screen as damaged
+     */
+    void add(const SkIRect& rect);
+    void add(const SkRect& rect);
+
+    /**
+     * @brief Mark the whole screen as damaged
+     */
+    void addFull();
+
+    /**
+     * @brief Add all damage of another tracker
+     */
+    void merge(const DamageTracker& other);
+
+    /**
+     * @brief Merge overlapping rects and collapse to a full redraw when that is cheaper.
+     * Must be called before iterating over rects.
+     */
+    void finalize();
+
+    /**
+     * @brief Forget all damage, called after the frame has been presented
+     */
+    void clear();
+
+    bool empty() const { return !full && rects.empty(); }
+};
+
+}
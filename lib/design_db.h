@@ -0,0 +1,241 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "common.h"
+#include "sv.h"
+#include "symbol_table.h"
+
+namespace db {
+
+/*
+ * On disk layout. Everything is little endian, fixed size and refers to other records by index or
+ * by offset into the string table, never by pointer, so the file can be mapped and used as is.
+ *
+ *   Header
+ *   FileRecord[num_files]
+ *   ModuleRecord[num_modules]
+ *   InstanceRecord[num_instances]   grouped by the module they are written in
+ *   ParamRecord[num_params]         parameters of modules and overrides of instances, grouped by owner
+ *   RangeRecord[num_ranges]         index ranges of instance arrays and generate loops
+ *   PortRecord[num_ports]           ports of modules and connections of instances, grouped by owner
+ *   uint32_t[num_references]        for every module, the modules instantiating it
+ *   uint32_t[num_buckets]           open addressing hash table, module name -> module index
+ *   char[strings_size]              every name and path, not null terminated
+ */
+
+constexpr char     kMagic[8] = {'S', 'V', 'D', 'E', 'S', 'I', 'G', 'N'};
+constexpr uint32_t kVersion  = 4;
+constexpr uint32_t kNone     = UINT32_MAX;
+
+struct StringRef {
+    uint32_t offset;
+    uint32_t length;
+};
+
+struct Header {
+    char     magic[8];
+    uint32_t version;
+    uint32_t top_module;
+
+    uint32_t num_files;
+    uint32_t num_modules;
+    uint32_t num_instances;
+    uint32_t num_references;
+    uint32_t num_buckets;
+    uint32_t num_params;
+    uint32_t num_ranges;
+    uint32_t num_ports;
+
+    uint64_t files_offset;
+    uint64_t modules_offset;
+    uint64_t instances_offset;
+    uint64_t params_offset;
+    uint64_t ranges_offset;
+    uint64_t ports_offset;
+    uint64_t references_offset;
+    uint64_t buckets_offset;
+    uint64_t strings_offset;
+    uint64_t strings_size;
+    uint64_t total_size;
+};
+
+/**
+ * @brief A parsed source file, size and mtime tell whether the database is still up to date
+ */
+struct FileRecord {
+    StringRef path;
+    uint64_t  size;
+    int64_t   mtime_ns;
+};
+
+/**
+ * @var first_instance Instances written in this module are instances[first_instance, +num_instances)
+ * @var first_param    Parameters of this module are params[first_param, +num_params), in declaration order
+ * @var first_port     Ports of this module are ports[first_port, +num_ports), in declaration order
+ * @var line           Zero based line of the declaration
+ */
+struct ModuleRecord {
+    StringRef name;
+    uint32_t  file;
+    uint32_t  line;
+    int32_t   span_start;
+    int32_t   span_end;
+    uint32_t  first_instance;
+    uint32_t  num_instances;
+    uint32_t  first_reference;
+    uint32_t  num_references;
+    uint32_t  first_param;
+    uint32_t  num_params;
+    uint32_t  first_port;
+    uint32_t  num_ports;
+};
+
+/**
+ * @var module Module that is instantiated
+ * @var parent Module the instantiation is written in
+ * @var line   Zero based line of the instantiation, in the file of parent
+ * @var first_param Parameter overrides are params[first_param, +num_params), in the order written
+ * @var range       Index into the ranges for an instance array or generate loop, kNone for a single instance
+ * @var first_port  Port connections are ports[first_port, +num_ports), in the order written
+ */
+struct InstanceRecord {
+    StringRef name;
+    uint32_t  module;
+    uint32_t  parent;
+    uint32_t  line;
+    int32_t   span_start;
+    int32_t   span_end;
+    uint32_t  first_param;
+    uint32_t  num_params;
+    uint32_t  range;
+    uint32_t  first_port;
+    uint32_t  num_ports;
+};
+
+/**
+ * @brief A parameter of a module, or a parameter override of an instance
+ * @var name  Empty for a positional override
+ * @var value Expression text, the default value of a parameter or the value of an override
+ * @var local Non zero for a parameter that can not be overridden
+ */
+struct ParamRecord {
+    StringRef name;
+    StringRef value;
+    uint32_t  local;
+};
+
+/**
+ * @brief A port of a module, or a port connection of an instance
+ * @var name   Port name, empty for a positional connection to a port the module does not have
+ * @var signal Expression connected to the port, empty for a port of a module
+ * @var type   SV::PortType of a port, SV::PortInstanceType of a connection
+ */
+struct PortRecord {
+    StringRef name;
+    StringRef signal;
+    uint32_t  type;
+};
+
+/**
+ * @brief Index range of an instance array or generate loop, the fields are those of SV::InstanceRange
+ */
+struct RangeRecord {
+    StringRef first_expr;
+    StringRef last_expr;
+    StringRef scope;
+    int32_t   step;
+    int32_t   first;
+    int32_t   last;
+    uint32_t  resolved;
+};
+
+/**
+ * @brief Write every module in table and how they instantiate each other into a database file.
+ * Written to a temporary file and renamed, so readers never see half a database.
+ * @param files Every file the modules were parsed from, resolved
+ * @return false if the file could not be written
+ */
+bool WriteDesignDB(const std::string& path, const std::vector<std::string>& files,
+                   const SymTable::ModuleSymbolTable* table, const SV::Module* top);
+
+/**
+ * @brief Read only view of a database file, mapped into memory. Opening does not parse or copy
+ * anything, it only checks that every record points inside the file, so it takes about as long
+ * as the mapping itself.
+ */
+class DesignDB {
+public:
+    /**
+     * @return nullptr if the file does not exist or is not a valid database
+     */
+    static std::unique_ptr<DesignDB> Open(const std::string& path);
+    ~DesignDB();
+
+    DesignDB(const DesignDB&)            = delete;
+    DesignDB& operator=(const DesignDB&) = delete;
+
+    uint32_t NumFiles()     const { return header->num_files; }
+    uint32_t NumModules()   const { return header->num_modules; }
+    uint32_t NumInstances() const { return header->num_instances; }
+    uint32_t NumParams()    const { return header->num_params; }
+    uint32_t NumRanges()    const { return header->num_ranges; }
+    uint32_t NumPorts()     const { return header->num_ports; }
+    uint32_t Top()          const { return header->top_module; }
+
+    const FileRecord&     File(uint32_t i)     const { return files[i]; }
+    const ModuleRecord&   Module(uint32_t i)   const { return modules[i]; }
+    const InstanceRecord& Instance(uint32_t i) const { return instances[i]; }
+    const ParamRecord&    Param(uint32_t i)    const { return params[i]; }
+    const RangeRecord&    Range(uint32_t i)    const { return ranges[i]; }
+    const PortRecord&     Port(uint32_t i)     const { return ports[i]; }
+
+    /**
+     * @brief Modules that instantiate module i, may repeat a module that instantiates it more than once
+     */
+    const uint32_t* ReferencesBegin(uint32_t i) const { return references + modules[i].first_reference; }
+    const uint32_t* ReferencesEnd(uint32_t i)   const { return ReferencesBegin(i) + modules[i].num_references; }
+
+    std::string_view String(const StringRef& ref) const { return std::string_view(strings + ref.offset, ref.length); }
+
+    /**
+     * @brief Module index by name, O(1)
+     * @return kNone if there is no such module
+     */
+    uint32_t FindModule(std::string_view name) const;
+
+    /**
+     * @brief True if every file the database was built from still has the same size and mtime, and
+     * the database was built from exactly these files
+     */
+    bool UpToDate(const std::vector<std::string>& resolved_paths) const;
+
+private:
+    DesignDB() = default;
+
+    void*  mapping      = nullptr;
+    size_t mapping_size = 0;
+
+    const Header*         header     = nullptr;
+    const FileRecord*     files      = nullptr;
+    const ModuleRecord*   modules    = nullptr;
+    const InstanceRecord* instances  = nullptr;
+    const ParamRecord*    params     = nullptr;
+    const RangeRecord*    ranges     = nullptr;
+    const PortRecord*     ports      = nullptr;
+    const uint32_t*       references = nullptr;
+    const uint32_t*       buckets    = nullptr;
+    const char*           strings    = nullptr;
+};
+
+/**
+ * @brief Size and modification time of a file, as stored in FileRecord
+ * @return false if the file does not exist
+ */
+bool StatFile(const std::string& path, uint64_t& size, int64_t& mtime_ns);
+
+}
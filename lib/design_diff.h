@@ -0,0 +1,133 @@
+#pragma once
+
+#include <cstdint>
+#include <deque>
+#include <map>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "common.h"
+#include "sv.h"
+#include "symbol_table.h"
+
+namespace diff {
+
+enum Status : uint8_t {
+    DIFF_SAME,
+    DIFF_ADDED,
+    DIFF_REMOVED,
+    DIFF_MODIFIED,
+};
+
+const char* StatusName(Status status);
+
+/**
+ * @brief Merkle hashes of a module
+ * @var local Name, ports, parameters and every instantiation written in the module: instance name,
+ *            range, parameter overrides and the name of the instantiated module
+ * @var tree  Local hash and the tree hash of every instantiated module, so it changes whenever
+ *            anything below the module changes
+ */
+struct ModuleHash {
+    uint64_t local = 0;
+    uint64_t tree  = 0;
+};
+
+/**
+ * @brief Merkle hashes of every module of one model. Each module is hashed once, bottom up, no
+ * matter how often it is instantiated.
+ */
+class MerkleHashes {
+public:
+    void Build(const SymTable::ModuleSymbolTable* table);
+
+    /**
+     * @return Zero hashes for a module that is not in the table
+     */
+    ModuleHash Get(const SV::Module* module) const;
+
+    size_t MemoryBytes() const;
+
+private:
+    std::unordered_map<const SV::Module*, ModuleHash> hashes;
+};
+
+struct ModuleDiff;
+
+/**
+ * @brief One instantiation compared between the revisions
+ * @var old_dep Index into old_module->dependencies, -1 if the instance was added
+ * @var new_dep Index into new_module->dependencies, -1 if the instance was removed
+ * @var diff    What changed below it, only set when status is DIFF_MODIFIED
+ */
+struct ChildDiff {
+    Status            status  = DIFF_SAME;
+    int32_t           old_dep = -1;
+    int32_t           new_dep = -1;
+    const ModuleDiff* diff    = nullptr;
+};
+
+/**
+ * @brief A module of the old revision compared with the module of the new revision at the same place
+ * in the hierarchy. Shared by every place the same pair of modules shows up.
+ * @var module_changed The local hashes differ, so the module itself changed and not just something below it
+ * @var children       children[i] is new_module->dependencies[i], the removed instances come after them
+ */
+struct ModuleDiff {
+    Status            status;
+    const SV::Module* old_module;
+    const SV::Module* new_module;
+    bool              module_changed = false;
+
+    std::vector<ChildDiff> children;
+};
+
+/**
+ * @var status DIFF_MODIFIED if the local hash changed, modules only changed below are the same here
+ */
+struct ModuleChange {
+    std::string name;
+    Status      status;
+};
+
+/**
+ * @brief Structural difference between two revisions of a design. Subtrees with the same Merkle tree
+ * hash are never entered, and every pair of modules is compared only once, so the cost follows what
+ * changed and not the size of the design. Read only once built.
+ */
+class HierarchyDiff {
+public:
+    void Build(const SV::Module* old_top, const SymTable::ModuleSymbolTable* old_table,
+               const SV::Module* new_top, const SymTable::ModuleSymbolTable* new_table);
+
+    /**
+     * @brief Difference between the two tops, nullptr if either revision has no top
+     */
+    const ModuleDiff* Top() const { return top; }
+
+    /**
+     * @brief Every module that was added, removed or changed, by name
+     */
+    const std::vector<ModuleChange>& Modules() const { return modules; }
+
+    /**
+     * @brief Pairs of modules that had to be compared, the rest was pruned by equal hashes
+     */
+    size_t NumCompared() const { return diffs.size(); }
+
+    size_t MemoryBytes() const;
+
+private:
+    const ModuleDiff* compare(const SV::Module* old_module, const SV::Module* new_module);
+
+    MerkleHashes old_hashes;
+    MerkleHashes new_hashes;
+
+    std::deque<ModuleDiff>                                                        diffs; // stable addresses
+    std::map<std::pair<const SV::Module*, const SV::Module*>, const ModuleDiff*> memo;
+    const ModuleDiff*                                                             top = nullptr;
+    std::vector<ModuleChange>                                                     modules;
+};
+
+}
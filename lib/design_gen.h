@@ -0,0 +1,56 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace gen {
+
+/**
+ * @brief Shape of a synthetic design. Modules are spread over depth + 1 levels, the top module is
+ * alone on level 0, and every module above the last level instantiates fanout modules of the next.
+ * @var modules          Distinct modules in the design, at least one per level
+ * @var fanout           Instantiations written in every module that is not on the last level
+ * @var depth            Levels of instantiation below the top module
+ * @var reuse            Chance that an instantiation picks the shared module of the next level
+ *                       instead of the next one in turn, 0 spreads instances over every module
+ * @var filler_lines     Extra declarations per module, to make files bigger without more instances
+ * @var modules_per_file Modules written into the same file
+ * @var seed             Same options and seed give the same design
+ */
+struct GenOpts {
+    size_t   modules          = 100;
+    size_t   fanout           = 4;
+    size_t   depth            = 4;
+    double   reuse            = 0.25;
+    size_t   filler_lines     = 0;
+    size_t   modules_per_file = 10;
+    uint64_t seed             = 1;
+};
+
+/**
+ * @var files     Written files, absolute
+ * @var top       Name of the top module
+ * @var instances Instances in the elaborated hierarchy, the top module included
+ * @var bytes     Size of all files together
+ */
+struct GeneratedDesign {
+    std::vector<std::string> files;
+    std::string              top;
+    size_t                   modules   = 0;
+    uint64_t                 instances = 0;
+    uint64_t                 bytes     = 0;
+};
+
+/**
+ * @brief Options for a design whose elaborated hierarchy has about the given number of instances
+ */
+GenOpts OptsForInstances(uint64_t instances);
+
+/**
+ * @brief Write a synthetic design into a directory, creating it if needed. Files already in the
+ * directory with the same names are overwritten.
+ */
+GeneratedDesign GenerateDesign(const GenOpts& opts, const std::string& out_dir);
+
+}
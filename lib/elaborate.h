@@ -0,0 +1,129 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "common.h"
+#include "sv.h"
+
+namespace elab {
+
+constexpr uint32_t kNoSpec = UINT32_MAX;
+
+/**
+ * @brief Looks up the value of a parameter while evaluating, nullopt if it is unknown or not an integer
+ */
+using ParamLookup = std::function<std::optional<int64_t>(std::string_view name)>;
+
+/**
+ * @brief Evaluate a constant integer expression as written in the source, e.g. "WIDTH*2-1" or
+ * "$clog2(DEPTH)". Handles sized and based literals and the usual operators, all in 64 bits.
+ * @return nullopt if the expression is not a constant integer, like a string, a real, or a literal
+ * with x or z bits
+ */
+std::optional<int64_t> EvalConstExpr(std::string_view expr, const ParamLookup& lookup);
+
+/**
+ * @brief Lookup over the parameters of a module, values has one entry per parameter and has to
+ * outlive the lookup
+ */
+ParamLookup ModuleScope(const SV::Module* module, const std::vector<std::string>& values);
+
+/**
+ * @brief Default value of every parameter of a module, later ones may use earlier ones
+ */
+std::vector<std::string> DefaultValues(const SV::Module* module);
+
+/**
+ * @brief Evaluate both ends of an instance array or generate loop range
+ * @return false if either end is not a constant integer
+ */
+bool ResolveRange(const SV::InstanceRange& range, const ParamLookup& lookup, int& first, int& last);
+
+/**
+ * @brief A module together with one resolved set of parameter values. Every instance with the same
+ * module and values shares one specialization, so each one is elaborated only once.
+ * @var values    Resolved value per module->parameters, in the same order. The decimal value if it
+ *                evaluates to an integer, otherwise the expression text
+ * @var children  Specialization of each module->dependencies, kNoSpec where elaboration stopped
+ * @var elements  Elements of each module->dependencies with these values, 1 unless it is ranged
+ * @var instances How often it appears in the hierarchy under the top, saturates at UINT64_MAX
+ */
+struct Specialization {
+    SV::Module*              module;
+    std::vector<std::string> values;
+    std::vector<uint32_t>    children;
+    std::vector<uint32_t>    elements;
+    uint64_t                 hash      = 0;
+    uint64_t                 instances = 0;
+};
+
+/**
+ * @brief Parameter aware view of the hierarchy. Overrides are evaluated per instantiation in the
+ * scope of the specialization it is written in, and every distinct (module, values) pair is interned
+ * by its hash, so a design with 100k instances of 50 configurations is elaborated 50 times.
+ * Instance arrays and generate loops stay one child with an element count, resolved per specialization.
+ * Generate if and case blocks are not elaborated, every branch counts.
+ * Read only once built.
+ */
+class Elaboration {
+public:
+    /**
+     * @brief Elaborate everything under top, with the default parameter values of top
+     * @param max_specializations Stop interning after this many, recursive modules never stop on their own
+     */
+    void Build(SV::Module* top, size_t max_specializations = 1 << 16);
+
+    uint32_t Top() const { return top; }
+    size_t   NumSpecializations() const { return specs.size(); }
+
+    const Specialization& Get(uint32_t spec) const { return specs[spec]; }
+
+    /**
+     * @brief Every specialization of one module, in the order they were found
+     */
+    std::vector<uint32_t> SpecializationsOf(const SV::Module* module) const;
+
+    /**
+     * @brief Resolved value of a parameter, nullptr if the module has no such parameter
+     */
+    const std::string* Value(uint32_t spec, std::string_view name) const;
+
+    /**
+     * @brief Instances in the hierarchy under the top, counted per specialization, saturates at UINT64_MAX
+     */
+    uint64_t NumInstances() const { return num_instances; }
+
+    /**
+     * @brief True if the specialization cap was hit or the hierarchy instantiates itself, the
+     * instance counts are then only a lower bound
+     */
+    bool Truncated() const { return truncated; }
+
+    /**
+     * @brief Module name with its non-local parameters, e.g. "fifo #(WIDTH=8, DEPTH=16)"
+     */
+    std::string Describe(uint32_t spec) const;
+
+    size_t MemoryBytes() const;
+
+private:
+    uint32_t Intern(SV::Module* module, std::vector<std::string>&& values);
+    void     ResolveChildren(uint32_t spec);
+    void     CountInstances();
+
+    std::vector<Specialization>                specs;
+    std::unordered_multimap<uint64_t, uint32_t> by_hash;
+
+    uint32_t top           = kNoSpec;
+    size_t   max_specs     = 0;
+    uint64_t num_instances = 0;
+    bool     truncated     = false;
+};
+
+}
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <future>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+#include "include/core/SkFont.h"
+#include "include/core/SkFontMgr.h"
+#include "include/core/SkTypeface.h"
+
+namespace graphics {
+
+/**
+ * @brief Process wide registry of fonts. The fontconfig database is scanned once, on a background
+ * thread, and every typeface and sized font handed out is cached, so asking for the same font again
+ * costs a hash lookup.
+ */
+class FontRegistry {
+public:
+    static FontRegistry& Get();
+
+    /**
+     * @brief Start scanning the fontconfig database in the background if that has not happened yet.
+     * Returns immediately, call this as early as possible.
+     */
+    void warmUp();
+
+    /**
+     * @brief The font manager, blocks until the scan is done
+     */
+    sk_sp<SkFontMgr> manager();
+
+    /**
+     * @brief Find a typeface, throws if nothing matches
+     */
+    sk_sp<SkTypeface> typeface(const std::string& family, const SkFontStyle& style = SkFontStyle());
+
+    /**
+     * @brief Get a font of the given family, size and style
+     */
+    SkFont font(const std::string& family, float size, const SkFontStyle& style = SkFontStyle());
+
+private:
+    FontRegistry() = default;
+
+    static std::string key(const std::string& family, const SkFontStyle& style);
+
+    std::once_flag                      scan_started;
+    std::shared_future<sk_sp<SkFontMgr>> scan;
+
+    std::mutex                                         mtx;
+    std::unordered_map<std::string, sk_sp<SkTypeface>> typefaces;
+    std::unordered_map<std::string, SkFont>            fonts;
+};
+
+}
@@ -0,0 +1,90 @@
+#pragma once
+
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <SDL2/SDL.h>
+#include "include/core/SkPicture.h"
+
+#include "damage_tracker.h"
+#include "tiled_renderer.h"
+
+namespace graphics {
+
+/**
+ * @brief Rasterizes recorded frames on a render thread into one of three pixel buffers, so that
+ * neither input handling nor the vsync wait in SDL_RenderPresent ever waits on a raster.
+ *
+ * The main thread records a frame and submits it, the render thread rasterizes the newest submitted
+ * frame into its back buffer and swaps it with the ready buffer, and the main thread uploads the ready
+ * buffer to the window texture when it presents. Frames the main thread did not get around to
+ * presenting are skipped, never queued. Every buffer remembers which of its regions are out of date,
+ * so only damaged regions are rastered and uploaded, just like when drawing synchronously.
+ */
+class FramePipeline {
+public:
+    static constexpr int kNumBuffers = 3;
+
+    FramePipeline(int width, int height, TiledRenderer* tiles);
+    ~FramePipeline();
+
+    FramePipeline(const FramePipeline&)            = delete;
+    FramePipeline& operator=(const FramePipeline&) = delete;
+
+    /**
+     * @brief Hand a recorded frame to the render thread, replacing any frame that was not started yet.
+     * Never blocks on rasterization.
+     * @param frame  Recorded frame, in screen coordinates
+     * @param damage What changed compared to the previously submitted frame
+     */
+    void submit(sk_sp<SkPicture> frame, const DamageTracker& damage);
+
+    /**
+     * @brief Upload the newest finished frame to the texture, only the parts that changed since
+     * the frame uploaded before it
+     * @return false if no new frame was finished since the last call
+     */
+    bool present(SDL_Texture* texture);
+
+    /**
+     * @brief Bytes of the pixel buffers
+     */
+    size_t memoryBytes() const { return kNumBuffers * row_bytes * size_t(height); }
+
+private:
+    /**
+     * @var pixels  BGRA8888 frame
+     * @var stale   Regions whose pixels are older than the last submitted frame
+     * @var changed Regions that differ from the last frame that was presented, valid once finished
+     */
+    struct Buffer {
+        std::vector<uint8_t> pixels;
+        DamageTracker        stale;
+        DamageTracker        changed;
+    };
+
+    void renderLoop();
+
+    int            width;
+    int            height;
+    size_t         row_bytes;
+    TiledRenderer* tiles;
+
+    // Every buffer is always in exactly one role, roles are swapped under mtx
+    Buffer buffers[kNumBuffers];
+    int    rendering   = 0;
+    int    ready       = 1;
+    int    presenting  = 2;
+    bool   ready_fresh = false; // ready holds a finished frame that was not presented yet
+
+    std::mutex              mtx;
+    std::condition_variable cv;
+    sk_sp<SkPicture>        pending;
+    DamageTracker           pending_damage;
+    bool                    stopping = false;
+    std::thread             render_thread;
+};
+
+}
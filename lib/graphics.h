@@ -2,6 +2,7 @@
 
 #include <vector>
 #include <cstdint>
+#include <functional>
 
 #include <SDL2/SDL.h>
 #include "include/core/SkCanvas.h"
@@ -14,6 +15,13 @@
 #include "include/core/SkFontMgr.h"
 #include "include/core/SkFont.h"
 #include "include/core/SkTypeface.h"
+#include "include/core/SkTextBlob.h"
+#include "include/core/SkFontMetrics.h"
+#include "include/core/SkPath.h"
+#include "include/core/SkPathBuilder.h"
+#include "include/core/SkPicture.h"
+#include "include/core/SkPictureRecorder.h"
+#include "include/core/SkBBHFactory.h"
 #include "include/core/SkFontMgr.h"
 #include "include/ports/SkFontMgr_fontconfig.h"
 #include "include/ports/SkFontMgr_empty.h"
@@ -24,6 +32,19 @@
 #include "common.h"
 #include "sv_colorizer.h"
 #include "sv.h"
+#include "damage_tracker.h"
+#include "tiled_renderer.h"
+#include "frame_pipeline.h"
+#include "code_text_cache.h"
+#include "spatial_index.h"
+#include "node_graph.h"
+#include "layout.h"
+#include "wire_router.h"
+#include "font_registry.h"
+#include "profiler.h"
+#include "mem_stats.h"
+#include "search_index.h"
+#include "line_index.h"
 
 namespace graphics {
 
@@ -52,14 +73,22 @@ struct WindowStructs {
     SDL_Renderer* renderer;
     SDL_Texture*  fb_texture;
 
-    size_t               rowBytes;
-    std::vector<uint8_t> pixels;
-
     Camera camera;
 
-    sk_sp<SkSurface> surface;
     SkFont           default_font;
     SkFont           dbg_font;
+    SkFont           mono_font;
+    SkFont           code_font; // monospaced, columns of the code panel line up
+    bool             fonts_ready = false;
+
+    // Only the damaged part of the framebuffer is redrawn and uploaded each frame
+    DamageTracker damage;
+
+    // Rasterizes the recorded frame on a pool of worker threads
+    std::unique_ptr<TiledRenderer> tiles;
+
+    // Runs the rasterization on a render thread, into triple buffered framebuffers
+    std::unique_ptr<FramePipeline> pipeline;
 
     ~WindowStructs() {
         SDL_DestroyTexture(fb_texture);
@@ -69,42 +98,71 @@ struct WindowStructs {
 };
 static std::shared_ptr<WindowStructs> default_window;
 
-typedef struct NodeGraph {
-    NodeGraph*              parent = nullptr;
-    std::vector<NodeGraph*> children;
-
-    Color color    = Color(1.0f, 1.0f, 1.0f);
-    vec2  rel_pos  = vec2(0, 0);
-    vec2  rec_size = vec2(0, 0);
-
-    ~NodeGraph() {
-        for (auto child : children) {
-            delete child;
-        }
-    }
+/**
+ * @brief Level of detail thresholds for drawing the node graph, all in screen pixels. Because they are
+ * in screen space, the number of things drawn is bounded by the size of the screen, not by how much of
+ * the design is in view.
+ * @var label_min_px Labels shorter than this are unreadable, and the graph switches to boxes only
+ * @var aggregate_px When zoomed out, a subtree smaller than this is drawn as one box in the color of its module
+ * @var summary_px   Subtrees smaller than this are merged with their neighbours into a single rect
+ * @var wire_min_px  Wires are left out once the channels they are routed in are narrower than this.
+ *                   While zoomed out, nets shorter than aggregate_px are left out as well.
+ */
+struct LodOpts {
+    float label_min_px = 6.f;
+    float aggregate_px = 24.f;
+    float summary_px   = 3.f;
+    float wire_min_px  = 4.f;
+};
 
-    AABB GetAABB() const {
-        AABB bb(vec2(0, 0), this->rec_size);
-        for (auto& child : children) {
-            AABB child_bb = child->GetAABB();
-            child_bb.ul += child->rel_pos;
-            child_bb.br += child->rel_pos;
+/**
+ * @brief The laid out node graph of the project
+ * @var module   Root module the graph was built from
+ * @var layout   Lays out the graph on a background thread
+ * @var snapshot Layout currently on screen
+ * @var selected Selected node, kNoNode if nothing is selected
+ * @var diff     Difference against a base revision the graph is colored by, nullptr if there is none
+ * @var router   Routes the wires of every new layout on the task pool
+ * @var wires    Latest routed wires, only drawn while they were routed for snapshot
+ */
+struct GraphView {
+    SV::Module*                                module = nullptr;
+    std::unique_ptr<LayoutEngine>              layout;
+    std::shared_ptr<const LayoutSnapshot>      snapshot;
+    std::unique_ptr<WireRouter>                router;
+    std::shared_ptr<const WireLayout>          wires;
+    NodeId                                     selected = kNoNode;
+    LodOpts                                    lod;
+    std::shared_ptr<const diff::HierarchyDiff> diff;
+    std::shared_ptr<const elab::Elaboration>   elaboration;
+};
 
-            bb.ul.x = std::min(bb.ul.x, child_bb.ul.x);
-            bb.ul.y = std::min(bb.ul.y, child_bb.ul.y);
-            bb.br.x = std::max(bb.br.x, child_bb.br.x);
-            bb.br.y = std::max(bb.br.y, child_bb.br.y);
-        }
+/**
+ * @brief Search box over modules and instance paths, opened with ctrl+F
+ * @var results      Matches for query, best first
+ * @var cursor       Highlighted result, enter jumps to it
+ * @var focus_path   Instance the camera moves to once the layout has made it visible
+ * @var focus_until  Give up on focus_path once the layout is past this generation without it
+ */
+struct SearchBox {
+    bool                                      open = false;
+    std::string                               query;
+    std::vector<search::Result>               results;
+    int                                       cursor = 0;
+    std::shared_ptr<const search::SearchIndex> index;
 
-        return bb;
-    }
-} NodeGraph;
+    bool                  focus_pending = false;
+    std::vector<uint32_t> focus_path;
+    uint64_t              focus_until   = 0;
+};
 
 struct CodePanel {
-    vec2  pos;
-    vec2  size;
-    float scrollY;
-    bool  visible;
+    vec2    pos;
+    vec2    size;
+    float   scrollY;
+    float   scrollX;
+    bool    visible;
+    int64_t highlightLine = -1; // line marked as the one navigated to, -1 for none
 };
 
 /**
@@ -118,7 +176,73 @@ void initWindow(int width, int height, bool debug_counters = false);
 bool updateWindow(SV::Module* root, sv::ColorizedDoc& g_doc);
 
 /**
- * @brief Create a new font
+ * @brief Show a loading overlay with a progress bar, or hide it
+ * @param fraction How far along the load is, from 0 to 1
+ */
+void setLoadStatus(bool visible, const std::string& text = "", float fraction = 0.f);
+
+/**
+ * @brief Redraw the whole window on the next frame, for when the model or document passed to
+ * updateWindow was swapped out
+ */
+void invalidateWindow();
+
+/**
+ * @brief Tell the code panel which file the document passed to updateWindow was colorized from
+ */
+void setCodePanelFile(const std::string& file);
+
+/**
+ * @brief Called with a file the code panel has to show but does not have. The handler should
+ * colorize it, pass it to updateWindow and call setCodePanelFile once it is ready.
+ */
+void setOpenFileHandler(std::function<void(const std::string&)> handler);
+
+/**
+ * @brief Scroll the code panel to the line holding a byte offset of a file, opening the file first if needed
+ */
+void showSource(const std::string& file, size_t offset);
+
+/**
+ * @brief Hand the search index of the loaded project to the search box
+ */
+void setSearchIndex(std::shared_ptr<const search::SearchIndex> index);
+
+/**
+ * @brief Color the node graph by how the loaded project differs from a base revision, nullptr to
+ * stop. Call it before the root it was built for is passed to updateWindow.
+ */
+void setHierarchyDiff(std::shared_ptr<const diff::HierarchyDiff> diff);
+
+/**
+ * @brief Label the node graph with the parameter values of every instance, nullptr for the defaults.
+ * Call it before the root it was built for is passed to updateWindow.
+ */
+void setElaboration(std::shared_ptr<const elab::Elaboration> elaboration);
+
+/**
+ * @brief Expand the graph down to an instance and move the camera onto it once it is laid out
+ * @param path Indices into dependencies, starting at the root module
+ */
+void focusInstance(const std::vector<uint32_t>& path);
+
+/**
+ * @brief Draw everything that is on screen. The canvas clip decides what actually gets rastered.
+ */
+void drawFrame(SkCanvas* canvas, SV::Module* root, const sv::ColorizedDoc& g_doc, const std::string& fps_string);
+
+/**
+ * @brief Draw the per phase timings and the frame time graph of the profiler
+ */
+void drawProfilerOverlay(SkCanvas* canvas, const SkRect& rect, SkFont& font);
+
+/**
+ * @brief Draw the memory used per subsystem and source, and the resident set size
+ */
+void drawMemoryOverlay(SkCanvas* canvas, const SkRect& rect, SkFont& font);
+
+/**
+ * @brief Get a font from the shared font registry
  */
 SkFont createNewFont(std::string font_name, int font_size);
 
@@ -133,9 +257,26 @@ void drawString(SkCanvas* canvas, const char* text, vec2& pos, SkFont& font, Col
 void drawBox(SkCanvas* canvas, vec2& pos, vec2& size, Color color);
 
 /**
- * @brief Draw a node graph
+ * @brief Start laying out the module hierarchy under root as a node graph, colored by view.diff if set
+ */
+void buildGraphView(GraphView& view, SV::Module* root, const SkFont& font);
+
+/**
+ * @brief Swap in the newest finished layout and wires
+ * @return true if either changed
+ */
+bool syncGraphView(GraphView& view);
+
+/**
+ * @brief Draw the nodes and wires of the graph that are inside the camera view
+ */
+void drawNodeGraph(SkCanvas* canvas, GraphView& view, const Camera& camera, SkFont& font);
+
+/**
+ * @brief Find the node under a point on the screen
+ * @return The node, or kNoNode if there is no node there
  */
-void drawNodeGraph(SkCanvas* canvas, SV::Module* root, std::string instance_name, vec2& root_position);
+NodeId pickNode(const GraphView& view, const Camera& camera, const vec2& screen_pos);
 
 /**
  * @brief Render some code
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "common.h"
+#include "sv.h"
+#include "graphics.h"
+
+namespace graphics {
+
+enum ExportFormat {
+    EXPORT_PNG,
+    EXPORT_SVG,
+    EXPORT_PDF,
+};
+
+/**
+ * @brief One picture to render without a window
+ * @var module      Root of the subtree to draw
+ * @var output_path File to write
+ * @var width       Size of the picture in pixels, 0 means sized to fit the whole subtree
+ * @var camera      View to draw, if not set the camera is fitted to the whole subtree
+ */
+struct ExportView {
+    SV::Module*           module = nullptr;
+    std::string           output_path;
+    ExportFormat          format = EXPORT_PNG;
+    int                   width  = 0;
+    int                   height = 0;
+    std::optional<Camera> camera;
+};
+
+struct HeadlessOpts {
+    std::string font_family      = "DejaVu Sans";
+    float       font_size        = 20.f;
+    float       margin           = 32.f;    // around the subtree when fitting the camera
+    int         max_size         = 16384;   // largest width/height of a fitted picture
+    int         threads          = 0;       // 0 means one per hardware thread
+    size_t      max_raster_bytes = size_t(2) << 30; // pixels of the PNG surfaces alive at once, over all threads
+    Color       background       = Color(0x1B1C1DFFu);
+};
+
+/**
+ * @brief Guess the format from the extension of a file name, PNG if it is not .svg or .pdf
+ */
+ExportFormat exportFormatFromPath(const std::string& path);
+
+/**
+ * @brief Lay out and draw a single view into an offscreen surface and write it to disk.
+ * Does not need initWindow, and is safe to call from several threads at once.
+ * @return true if the file was written
+ */
+bool renderView(const ExportView& view, const HeadlessOpts& opts = HeadlessOpts());
+
+/**
+ * @brief Render many views in parallel on a pool of threads. A fitted picture can be max_size squared,
+ * so raster surfaces wait for each other once max_raster_bytes are taken.
+ * @return Number of views that were written successfully
+ */
+size_t renderViews(const std::vector<ExportView>& views, const HeadlessOpts& opts = HeadlessOpts());
+
+}
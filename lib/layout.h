@@ -0,0 +1,205 @@
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "include/core/SkFont.h"
+#include "include/core/SkTextBlob.h"
+
+#include "elaborate.h"
+#include "node_graph.h"
+#include "spatial_index.h"
+
+namespace graphics {
+
+/**
+ * @brief Text of a node, shaped once when the node is created, so drawing it is a blob draw
+ */
+struct NodeLabel {
+    std::string       text;
+    sk_sp<SkTextBlob> blob;
+};
+
+/**
+ * @brief A node of the graph with its box in world space
+ * @var subtree     Bounds of the node and everything visible below it
+ * @var subtree_end Items are in depth first order, so the subtree is items [index, subtree_end)
+ * @var instance    Instantiation the node was created from, nullptr for the root
+ * @var is_range    The node stands for every element of an instance array or generate loop
+ */
+struct GraphItem {
+    NodeId             node;
+    AABB               box;
+    AABB               subtree;
+    uint32_t           subtree_end;
+    SV::Module*               module;
+    const SV::ModuleInstance* instance;
+    const NodeLabel*          label;
+    Color              color;
+    Color              type_color;
+    uint32_t           depth;
+    bool               expanded;
+    bool               has_children;
+    bool               is_range;
+};
+
+/**
+ * @brief Finished, immutable result of a layout pass. The render loop only ever reads these, while
+ * the layout thread works on the next one.
+ * @var items        Every visible node, in depth first order. Index is the id used by the spatial index
+ * @var item_of_node Index into items for every node id, UINT32_MAX if the node is not visible
+ * @var labels       Keeps the labels pointed to by items alive
+ * @var label_bytes  Heap bytes of the labels when the snapshot was taken, the layout thread goes on
+ *                   adding to labels after that
+ */
+struct LayoutSnapshot {
+    uint64_t               generation = 0;
+    std::vector<GraphItem> items;
+    std::vector<uint32_t>  item_of_node;
+    SpatialIndex           index;
+    AABB                   bounds;
+
+    std::shared_ptr<const std::deque<NodeLabel>> labels;
+    size_t                                       label_bytes = 0;
+
+    const GraphItem* find(NodeId id) const {
+        if (id >= item_of_node.size() || item_of_node[id] == UINT32_MAX) return nullptr;
+        return &items[item_of_node[id]];
+    }
+
+    /**
+     * @brief Heap bytes of the snapshot, the labels included
+     */
+    size_t memoryBytes() const;
+};
+
+struct LayoutOpts {
+    float    gap_x          = 40.f;           // between a node and its children
+    float    gap_y          = 4.f;            // between sibling subtrees
+    float    line_height    = 0.f;            // height of a node, 0 means from the font size
+    vec2     origin         = vec2(200, 200); // top left of the whole graph in world space
+    bool     background     = true;           // lay out on a worker thread, otherwise in the calling thread
+    uint32_t expand_depth   = 1;              // nodes above this depth start out expanded, the root is depth 0
+    size_t   nodes_per_pass = 4096;           // nodes created per published layout, 0 means no limit
+};
+
+/**
+ * @brief Turns the module hierarchy into positioned node boxes on a background thread.
+ *
+ * Layered tidy tree: every node is placed to the right of its parent, siblings are stacked
+ * vertically in bands that never overlap, and a parent is centered vertically on its children.
+ * Positions are relative to the parent, so a change in one subtree only re-lays out that subtree
+ * and re-stacks the children of its ancestors. Publishing is incremental too: subtrees that were not laid
+ * out again are copied from the last snapshot as a whole, and its spatial index is refit instead of rebuilt.
+ *
+ * Nodes are materialized lazily: children are created, named and shaped the first time their
+ * parent is expanded, at most nodes_per_pass per published layout. A bigger expansion fills in
+ * over the next few layouts, while the window keeps drawing the ones before. A collapsed node is
+ * one item however much is below it.
+ */
+class LayoutEngine {
+public:
+    explicit LayoutEngine(const SkFont& font, const LayoutOpts& options = LayoutOpts());
+    ~LayoutEngine();
+
+    LayoutEngine(const LayoutEngine&)            = delete;
+    LayoutEngine& operator=(const LayoutEngine&) = delete;
+
+    /**
+     * @brief Throw the current graph away and lay out the hierarchy under root
+     * @param diff        Difference of root against a base revision, colors every node by how it changed.
+     *                    Has to outlive the layout of this root, nullptr shows the hierarchy as it is.
+     * @param elaboration Parameters of the hierarchy under root. Labels show the parameter values of
+     *                    every instance and ranges get the element count of their own parent.
+     *                    nullptr uses the default parameters everywhere.
+     */
+    void setRoot(SV::Module* root, const diff::ModuleDiff* diff = nullptr,
+                 std::shared_ptr<const elab::Elaboration> elaboration = nullptr);
+
+    /**
+     * @brief Expand or collapse a node, only its subtree and the path to the root get laid out again
+     */
+    void setExpanded(NodeId id, bool expanded);
+    void toggleExpanded(NodeId id);
+
+    /**
+     * @brief Expand every node from the root down to an instance, so it becomes visible
+     * @param path Indices into dependencies, starting at the root module. Below an instance array
+     *             or generate loop the path goes on through its first element.
+     */
+    void reveal(const std::vector<uint32_t>& path);
+
+    /**
+     * @brief Latest finished layout, nullptr until the first pass is done
+     */
+    std::shared_ptr<const LayoutSnapshot> snapshot() const;
+
+    /**
+     * @brief Block until every queued request has been laid out
+     */
+    void waitIdle();
+
+private:
+    struct Request {
+        enum Type { SET_ROOT, SET_EXPANDED, TOGGLE, REVEAL, MATERIALIZE } type;
+        SV::Module* root     = nullptr;
+        NodeId      node     = kNoNode;
+        bool        expanded = true;
+
+        const diff::ModuleDiff*                  diff = nullptr;
+        std::shared_ptr<const elab::Elaboration> elaboration = nullptr;
+
+        std::vector<uint32_t> path = {};
+    };
+
+    void threadLoop();
+    void push(const Request& request);
+    void process(std::deque<Request>& batch);
+    void apply(const Request& request);
+
+    NodeId createNode(SV::Module* module, const std::string& instance_name, uint32_t spec = elab::kNoSpec);
+    void   initChild(NodeId parent, NodeId child);
+    void   buildChildren(NodeId id);
+    void   buildElements(NodeId id);
+    void   buildRemoved(NodeId id);
+    void   setDiffStatus(NodeId id, diff::Status status, const diff::ModuleDiff* diff);
+    bool   isRecursive(NodeId parent, const SV::Module* module) const;
+    size_t numElements(NodeId parent, const SV::ModuleInstance& instance) const;
+    void   expandNode(NodeId id);
+    void   markLayoutDirty(NodeId id);
+    void   layoutSubtree(NodeId id);
+    void   publish();
+
+    SkFont     font;
+    LayoutOpts options;
+    std::vector<Color> type_colors;
+    std::vector<Color> diff_colors; // per diff::Status
+
+    // Only touched by the layout thread
+    NodeGraphPool                          pool;
+    NodeId                                 root_node = kNoNode;
+    bool                                   diffing   = false;
+    std::shared_ptr<const elab::Elaboration> elaboration;
+    std::shared_ptr<std::deque<NodeLabel>> labels;
+    size_t                                 label_bytes = 0; // heap bytes of labels, kept as they are created
+    uint64_t                               generation = 0;
+    size_t                                 budget     = 0;  // nodes this pass may still create
+    std::vector<NodeId>                    unfinished;      // expanded, but out of budget before all children were created
+    size_t                                 last_items = 0;  // visible nodes in the last snapshot
+    std::shared_ptr<const LayoutSnapshot>  published;       // last snapshot, unchanged subtrees are copied from it
+
+    std::thread                           worker;
+    mutable std::mutex                    mtx;
+    std::condition_variable               cv;
+    std::condition_variable               cv_idle;
+    std::deque<Request>                   requests;
+    bool                                  working  = false;
+    bool                                  stopping = false;
+    std::shared_ptr<const LayoutSnapshot> latest;
+};
+
+}
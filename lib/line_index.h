@@ -0,0 +1,53 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace SV {
+
+/**
+ * @brief Zero based position in a source file. Column is in bytes.
+ */
+struct LineCol {
+    size_t line   = 0;
+    size_t column = 0;
+};
+
+/**
+ * @brief Start offset of every line in a file, so byte offsets from verible can be turned into
+ * lines and columns with a binary search.
+ */
+class LineIndex {
+public:
+    LineIndex() = default;
+    explicit LineIndex(std::string_view source) { Build(source); }
+
+    /**
+     * @brief Find every line start, scanning 16 bytes at a time where SSE2 is available
+     */
+    void Build(std::string_view source);
+
+    /**
+     * @brief Line and column of a byte offset, O(log lines). Offsets past the end land on the last line.
+     */
+    LineCol Locate(size_t offset) const;
+
+    size_t LineStart(size_t line) const { return line_starts[line]; }
+    size_t LineCount() const { return line_starts.size(); }
+    size_t MemoryBytes() const { return line_starts.capacity() * sizeof(size_t); }
+
+private:
+    std::vector<size_t> line_starts = {0};
+};
+
+/**
+ * @brief Line index of a file, read and built the first time it is asked for and cached after that.
+ * Safe to call from any thread.
+ * @return nullptr if the file could not be read
+ */
+std::shared_ptr<const LineIndex> GetFileLineIndex(const std::string& path);
+
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+
+namespace SV {
+
+/**
+ * @brief A file mapped read only into memory. Its text is read straight out of the page cache, so
+ * nothing is copied no matter how many views into it are handed out.
+ *
+ * Views into a mapping fault (SIGBUS) once the file is truncated under them, which a tool writing
+ * a file in place instead of renaming a new one over it does. Whoever reads views well after the
+ * file was handed out checks Intact() first.
+ */
+class MappedFile {
+public:
+    /**
+     * @return nullptr if the file cannot be opened or mapped
+     */
+    static std::shared_ptr<const MappedFile> Open(const std::string& path);
+    ~MappedFile();
+
+    MappedFile(const MappedFile&)            = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    std::string_view Text() const { return std::string_view(static_cast<const char*>(mapping), size); }
+    size_t           Size() const { return size; }
+
+    /**
+     * @brief False once the mapped file was written in place, its views may fault from then on. A file
+     * renamed over or removed leaves the mapping alone. Costs a stat.
+     */
+    bool Intact() const;
+
+    /**
+     * @brief Size and mtime the file had when it was mapped
+     */
+    bool SameAs(uint64_t size, int64_t mtime_ns) const { return this->size == size && this->mtime_ns == mtime_ns; }
+
+private:
+    MappedFile() = default;
+
+    std::string path;
+    void*       mapping  = nullptr;
+    size_t      size     = 0;
+    int64_t     mtime_ns = 0;
+    uint64_t    dev      = 0; // identify the file that was mapped, not whatever has its path now
+    uint64_t    ino      = 0;
+};
+
+/**
+ * @brief The mapping of a source file, shared by everything that reads it: the colorizer, line indexes
+ * and whatever comes after. Mapped the first time it is asked for, mapped again if the file changed
+ * on disk since. Safe to call from any thread.
+ * @return nullptr if the file cannot be read
+ */
+std::shared_ptr<const MappedFile> GetSourceFile(const std::string& path);
+
+}
@@ -0,0 +1,126 @@
+#pragma once
+
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "common.h"
+#include "symbol_table.h"
+
+namespace mem {
+
+/**
+ * @brief What the memory is used for. Every subsystem is made up of named sources, one per owner
+ * of the memory, so the report can tell which part of a subsystem is responsible.
+ */
+enum Subsystem {
+    MEM_CST,      // JSON DOM from verible
+    MEM_DESIGN,   // SV::Module model and what is built from it, like the search index
+    MEM_DOCS,     // colorized documents and line indexes
+    MEM_RENDER,   // frame buffers, layouts, shaped text
+    MEM_NUM_SUBSYSTEMS,
+};
+
+const char* SubsystemName(Subsystem subsystem);
+
+/**
+ * @brief Turn on the accounting that has to walk big data structures, like the JSON DOM. Counters
+ * that are cheap to keep are always kept.
+ */
+void SetEnabled(bool enabled);
+bool Enabled();
+
+/**
+ * @brief Set the bytes used by one source. Source must outlive the accounting, in practice a
+ * string literal.
+ */
+void Set(Subsystem subsystem, const char* source, int64_t bytes);
+
+/**
+ * @brief Add to (or, negative, take from) the bytes used by one source
+ */
+void Add(Subsystem subsystem, const char* source, int64_t delta);
+
+/**
+ * @var peak Most bytes used at once since the start
+ */
+struct SourceStats {
+    Subsystem   subsystem;
+    std::string name;
+    int64_t     current = 0;
+    int64_t     peak    = 0;
+};
+
+struct SubsystemStats {
+    Subsystem subsystem;
+    int64_t   current = 0;
+    int64_t   peak    = 0;
+};
+
+/**
+ * @brief Every source, grouped by subsystem and sorted by name
+ */
+std::vector<SourceStats> GetSourceStats();
+
+/**
+ * @brief Every subsystem, in the order of the enum
+ */
+std::vector<SubsystemStats> GetSubsystemStats();
+
+/**
+ * @brief Resident set size of the process in bytes, 0 where /proc is not available
+ */
+int64_t CurrentRSS();
+
+/**
+ * @brief Highest resident set size of the process so far
+ */
+int64_t PeakRSS();
+
+/**
+ * @brief Resident set size over one phase of the program, like one phase of a load
+ * @var rss_peak Highest resident set size while the phase ran
+ */
+struct PhaseMemory {
+    std::string name;
+    int64_t     rss_start = 0;
+    int64_t     rss_end   = 0;
+    int64_t     rss_peak  = 0;
+    double      seconds   = 0.0;
+};
+
+/**
+ * @brief End the current phase, if any, and start a new one
+ */
+void BeginPhase(const std::string& name);
+void EndPhase();
+
+/**
+ * @brief Every finished phase, in order
+ */
+std::vector<PhaseMemory> GetPhases();
+
+/**
+ * @brief Human readable summary of the subsystems, their sources and the phases
+ */
+void WriteReport(std::ostream& out);
+
+/**
+ * @brief Estimated heap bytes of a JSON DOM, walks every value
+ */
+int64_t JsonBytes(const json& j);
+
+/**
+ * @brief Estimated heap bytes of every module in a symbol table, and of the table itself
+ */
+int64_t ModuleBytes(const SymTable::ModuleSymbolTable* table);
+
+/**
+ * @brief Heap bytes of a string, 0 while it fits in the string itself (15 chars in libstdc++)
+ */
+inline int64_t StringBytes(const std::string& s) {
+    return s.capacity() > 15 ? int64_t(s.capacity() + 1) : 0;
+}
+
+}
@@ -0,0 +1,104 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "common.h"
+#include "design_diff.h"
+#include "sv.h"
+#include "vec.h"
+
+namespace graphics {
+
+using NodeId = uint32_t;
+constexpr NodeId kNoNode = UINT32_MAX;
+
+struct NodeLabel;
+
+/**
+ * @brief A box in the node graph. Nodes live in a NodeGraphPool and refer to each other by index, so
+ * the whole graph is a handful of allocations no matter how many nodes it has.
+ * @var rel_pos     Position of the top left corner, relative to the parent's
+ * @var rec_size    Size of the node's own box
+ * @var band_top    Top of the space taken by the laid out subtree, relative to the node's own box
+ * @var band_bottom Bottom of the same
+ */
+struct NodeGraph {
+    NodeId parent       = kNoNode;
+    NodeId first_child  = kNoNode;
+    NodeId last_child   = kNoNode;
+    NodeId next_sibling = kNoNode;
+    uint32_t num_children = 0;
+    uint32_t depth        = 0;
+
+    Color color      = Color(1.0f, 1.0f, 1.0f);
+    Color type_color = Color(1.0f, 1.0f, 1.0f); // same for every instance of a module
+    vec2  rel_pos    = vec2(0, 0);
+    vec2  rec_size   = vec2(0, 0);
+
+    // What the node shows
+    SV::Module*               module   = nullptr;
+    const SV::ModuleInstance* instance = nullptr; // nullptr for the root
+    const NodeLabel*          label    = nullptr;
+    uint32_t                  spec     = UINT32_MAX; // elab::Specialization the node is, UINT32_MAX if not elaborated
+
+    // An instance array or generate loop is one node until it is expanded, its children are the elements
+    bool    is_range = false;
+    int32_t element  = -1; // element of the instance's range this node is, -1 if it is not an element
+
+    // Compared against a base revision. A removed instance is a node of its own, after the real children,
+    // whose module and instance belong to the base revision.
+    diff::Status            diff_status = diff::DIFF_SAME;
+    const diff::ModuleDiff* diff        = nullptr; // what changed below, nullptr if nothing did
+
+    // Layout state. Children are only created once the node is expanded, a few at a time if there
+    // are many, materialized counts the ones created so far and children_built is set once all are.
+    bool     expanded       = false;
+    bool     children_built = false;
+    uint32_t materialized   = 0;
+    bool     layout_dirty   = true;
+    bool     publish_dirty  = true; // laid out again since the last snapshot, so its items there are stale
+    float    band_top       = 0.f;
+    float    band_bottom    = 0.f;
+
+    // Bounding box of the whole subtree, relative to this node. Only recomputed when something in
+    // the subtree changed. If a node is dirty, so are all of its ancestors.
+    mutable AABB cached_bb;
+    mutable bool bb_dirty = true;
+};
+
+/**
+ * @brief Index based storage for all nodes of a graph. Nodes are only ever added, a collapsed subtree
+ * keeps its nodes so ids stay valid and expanding it again costs nothing
+ */
+class NodeGraphPool {
+public:
+    NodeId Create();
+    void   Clear();
+
+    /**
+     * @brief Link child in as the last child of parent
+     */
+    void AddChild(NodeId parent, NodeId child);
+
+    NodeGraph&       operator[](NodeId id)       { return nodes[id]; }
+    const NodeGraph& operator[](NodeId id) const { return nodes[id]; }
+    size_t           size() const                { return nodes.size(); }
+
+    // Anything that changes a node's box has to go through these, so the cached bounding boxes of
+    // its ancestors get invalidated
+    void MarkDirty(NodeId id);
+    void SetRelPos(NodeId id, const vec2& pos);
+    void SetSize(NodeId id, const vec2& size);
+
+    /**
+     * @brief Bounding box of the subtree under id, relative to id
+     */
+    AABB GetAABB(NodeId id) const;
+
+private:
+    std::vector<NodeGraph> nodes;
+};
+
+}
@@ -0,0 +1,95 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace prof {
+
+/**
+ * @brief Turn profiling on or off. While off, a PROFILE_SCOPE costs one relaxed atomic load.
+ */
+void SetEnabled(bool enabled);
+bool Enabled();
+
+inline uint64_t NowNs() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+/**
+ * @brief Record one finished scope into a buffer of the calling thread. Name must outlive the
+ * profiler, in practice a string literal.
+ */
+void Record(const char* name, uint64_t start_ns, uint64_t dur_ns);
+
+/**
+ * @brief Times the scope it lives in, use through PROFILE_SCOPE
+ */
+class ScopedTimer {
+public:
+    explicit ScopedTimer(const char* name) : name(name), start(Enabled() ? NowNs() : 0) {}
+    ~ScopedTimer() {
+        if (start != 0) Record(name, start, NowNs() - start);
+    }
+
+    ScopedTimer(const ScopedTimer&)            = delete;
+    ScopedTimer& operator=(const ScopedTimer&) = delete;
+
+private:
+    const char* name;
+    uint64_t    start;
+};
+
+#define PROFILE_CONCAT_(a, b) a##b
+#define PROFILE_CONCAT(a, b)  PROFILE_CONCAT_(a, b)
+#define PROFILE_SCOPE(name)   prof::ScopedTimer PROFILE_CONCAT(prof_scope_, __LINE__)(name)
+
+/**
+ * @brief Count the scopes of the calling thread towards the frame, like the ones of a render thread.
+ * Scopes of other threads, like layout or parsing in the background, only go into the trace.
+ */
+void SetFrameThread();
+
+/**
+ * @brief Mark the end of a frame. Everything the frame threads recorded since the last mark is summed
+ * per phase and added to the per phase history used for the statistics. The calling thread becomes
+ * a frame thread.
+ */
+void FrameMark();
+
+/**
+ * @brief Timing statistics of one phase over the recent frames, in milliseconds
+ */
+struct PhaseStats {
+    std::string name;
+    double last = 0.0;
+    double p50  = 0.0;
+    double p95  = 0.0;
+    double p99  = 0.0;
+    double max  = 0.0;
+};
+
+/**
+ * @brief Statistics for every phase seen in the recent frames, sorted by name
+ */
+std::vector<PhaseStats> GetPhaseStats();
+
+/**
+ * @brief Durations of the recent frames in milliseconds, oldest first
+ */
+std::vector<float> GetFrameTimes();
+
+/**
+ * @brief Write every recorded event as Chrome trace event JSON (chrome://tracing, Perfetto)
+ * @return false if the file could not be written
+ */
+bool WriteChromeTrace(const std::string& path);
+
+/**
+ * @brief Forget all recorded events and history
+ */
+void Reset();
+
+}
@@ -0,0 +1,161 @@
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "common.h"
+#include "sv.h"
+#include "sv_colorizer.h"
+#include "search_index.h"
+#include "elaborate.h"
+#include "design_diff.h"
+#include "task_pool.h"
+
+namespace sv {
+
+enum LoadState {
+    LOAD_IDLE,
+    LOAD_RUNNING,
+    LOAD_DONE,
+    LOAD_FAILED,
+    LOAD_CANCELLED,
+};
+
+/**
+ * @brief Where a load is at
+ * @var phase       What is being done right now, for showing to the user
+ * @var files_done  Files run through the parser so far
+ * @var files_total Files in the project
+ * @var error       Why the load failed, only set when state is LOAD_FAILED
+ */
+struct LoadProgress {
+    LoadState   state = LOAD_IDLE;
+    std::string phase;
+    size_t      files_done  = 0;
+    size_t      files_total = 0;
+    std::string error;
+
+    float fraction() const { return files_total ? float(files_done) / float(files_total) : 0.f; }
+};
+
+/**
+ * @brief A colorized source file
+ * @var file Resolved path, the same as SV::Module::source_file
+ */
+struct LoadedDoc {
+    std::string  file;
+    ColorizedDoc doc;
+};
+
+/**
+ * @brief Loads a project on background threads, so the window stays responsive while it happens.
+ * The colorized source of the first file is handed over as soon as it is ready, the files are run
+ * through verible in parallel, and the module hierarchy is handed over, together with its search
+ * index and its elaboration, once every file is parsed.
+ * With a design database set, the hierarchy is read from it instead when no file changed since it
+ * was written, and it is rewritten after every full parse.
+ * With a base database set, the hierarchy is also compared against the revision stored in it.
+ * Nothing here ever blocks the caller except the destructor, which cancels and waits.
+ */
+class ProjectLoader {
+public:
+    ProjectLoader() = default;
+    ~ProjectLoader();
+
+    ProjectLoader(const ProjectLoader&)            = delete;
+    ProjectLoader& operator=(const ProjectLoader&) = delete;
+
+    /**
+     * @brief Start loading files in the background
+     * @param num_threads Files parsed at once, 0 means one per hardware thread
+     */
+    void start(std::vector<std::string> files, bazel::tools::cpp::runfiles::Runfiles* rf,
+               const ColorizerOpts& opt = {}, int num_threads = 0);
+
+    /**
+     * @brief Stop as soon as possible. A verible run that already started is finished first.
+     */
+    void cancel();
+
+    /**
+     * @brief Use a design database file for the next start, an empty path turns it off
+     */
+    void setDatabase(const std::string& path) { db_path = path; }
+
+    /**
+     * @brief Compare the next start against the design database of another revision, an empty path turns it off
+     */
+    void setBaseDatabase(const std::string& path) { base_path = path; }
+
+    LoadProgress progress() const;
+
+    /**
+     * @brief Colorize another file in the background, it comes out of takeDoc when it is done
+     */
+    void openFile(const std::string& path);
+
+    /**
+     * @brief The newest colorized file, once, as soon as it is ready. At first that is the first
+     * file of the project, later whatever openFile asked for.
+     */
+    std::optional<LoadedDoc> takeDoc();
+
+    /**
+     * @brief The root of the module hierarchy, once, when the whole project is parsed
+     */
+    std::optional<SV::Module*> takeRoot();
+
+    /**
+     * @brief Search index over the loaded hierarchy, nullptr until the root is ready
+     */
+    std::shared_ptr<const search::SearchIndex> searchIndex() const;
+
+    /**
+     * @brief Parameter specializations of the loaded hierarchy, nullptr until the root is ready
+     */
+    std::shared_ptr<const elab::Elaboration> elaboration() const;
+
+    /**
+     * @brief Difference against the base revision, nullptr until the root is ready or if there is no base.
+     * Keeps the modules of the base revision alive.
+     */
+    std::shared_ptr<const diff::HierarchyDiff> diff() const;
+
+    bool finished() const;
+
+private:
+    void run();
+    void parseFiles(std::vector<json>& per_file);
+    SV::Module* loadDatabase(const std::vector<std::string>& resolved);
+    std::shared_ptr<const diff::HierarchyDiff> compareToBase(const SV::Module* top);
+    void setPhase(const std::string& phase);
+    void finish(LoadState state, const std::string& error = "");
+
+    std::vector<std::string>                files;
+    bazel::tools::cpp::runfiles::Runfiles*  rf = nullptr;
+    ColorizerOpts                           opt;
+    int                                     num_threads = 0;
+    std::string                             db_path;
+    std::string                             base_path;
+
+    std::thread       worker;
+    std::atomic<bool> cancelled{false};
+
+    mutable std::mutex          mtx;
+    LoadProgress                status;
+    std::optional<LoadedDoc>    doc;
+    std::optional<SV::Module*>  root;
+
+    std::shared_ptr<const search::SearchIndex> search_index;
+    std::shared_ptr<const elab::Elaboration>   specializations;
+    std::shared_ptr<const diff::HierarchyDiff> hierarchy_diff;
+
+    std::vector<task::TaskHandle> open_jobs;
+};
+
+}
@@ -0,0 +1,120 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "common.h"
+#include "sv.h"
+#include "symbol_table.h"
+
+namespace search {
+
+constexpr uint32_t kNoEntry = UINT32_MAX;
+
+enum EntryKind {
+    ENTRY_MODULE,   // a module declaration, text is the module name
+    ENTRY_INSTANCE, // an instance in the hierarchy, text is the full path, e.g. top.u_core.u_alu.
+                    // An instance array is one entry for all its elements, e.g. top.u_bank[63:0]
+};
+
+/**
+ * @brief One searchable thing
+ * @var parent         Instance this instance lives in, kNoEntry for the top module
+ * @var dep_index      Index into parent->module->dependencies this instance was created from
+ * @var first_instance For modules, the first instance of it in the hierarchy, kNoEntry if there is none
+ */
+struct Entry {
+    EntryKind   kind;
+    SV::Module* module;
+    uint32_t    parent         = kNoEntry;
+    uint32_t    dep_index      = 0;
+    uint32_t    depth          = 0;
+    uint32_t    first_instance = kNoEntry;
+    uint32_t    text_offset    = 0;
+    uint32_t    text_len       = 0;
+    uint32_t    segment_offset = 0; // start of the last path segment within the text
+};
+
+struct Result {
+    uint32_t entry;
+    int      score;
+};
+
+/**
+ * @brief Search over module names and hierarchical instance paths.
+ *
+ * Built once after parsing. Every entry is indexed by the trigrams of its lower cased text, a query
+ * only scores the entries sharing the most discriminating trigrams with it, so a keystroke stays
+ * cheap on designs with hundreds of thousands of instances.
+ * Exact instance paths are looked up in a hash map. Read only once built, so it can be queried from
+ * any number of threads.
+ */
+class SearchIndex {
+public:
+    /**
+     * @brief Index every module in table and every instance in the hierarchy under root
+     * @param max_instances Stop adding instances after this many
+     */
+    void Build(SV::Module* root, const SymTable::ModuleSymbolTable* table, size_t max_instances = 1 << 22);
+
+    /**
+     * @brief Fuzzy search, best match first
+     */
+    std::vector<Result> Query(std::string_view query, size_t max_results = 50) const;
+
+    /**
+     * @brief Exact instance path lookup, e.g. "top.u_core.u_alu". An element of an instance array,
+     * e.g. "top.u_bank[3]", gives the entry of the whole array
+     * @return The instance entry, or kNoEntry if there is no such path
+     */
+    uint32_t FindPath(std::string_view path) const;
+
+    /**
+     * @brief Indices into dependencies leading from the top module down to an instance
+     */
+    std::vector<uint32_t> InstancePath(uint32_t entry) const;
+
+    std::string_view Text(uint32_t entry) const {
+        return std::string_view(text).substr(entries[entry].text_offset, entries[entry].text_len);
+    }
+
+    const Entry& operator[](uint32_t entry) const { return entries[entry]; }
+    size_t size() const { return entries.size(); }
+    bool   truncated() const { return was_truncated; }
+
+    /**
+     * @brief Heap bytes held by the index
+     */
+    size_t MemoryBytes() const;
+
+private:
+    // Above this share of all entries a trigram says nothing about a match, and its list is skipped
+    static constexpr float  kCommonTrigramFraction = 0.05f;
+    // Most entries given to the fuzzy scorer per query
+    static constexpr size_t kMaxCandidates = 2000;
+
+    void addText(Entry& entry, std::string_view s);
+    void buildTrigrams();
+    int  score(uint32_t entry, std::string_view query) const;
+    std::vector<uint32_t> shortQueryCandidates(std::string_view query) const;
+
+    std::vector<Entry> entries;
+    std::string        text;  // all entry texts back to back
+    std::string        lower; // same, lower cased
+    bool               was_truncated = false;
+
+    // Trigram postings in CSR form: the entries with trigrams[i] are postings[offsets[i] .. offsets[i+1])
+    std::vector<uint32_t> trigrams;
+    std::vector<uint32_t> offsets;
+    std::vector<uint32_t> postings;
+
+    // Entries sorted by their lower cased last segment, for queries too short to have a trigram
+    std::vector<uint32_t> by_segment;
+
+    std::unordered_map<std::string_view, uint32_t> path_lookup;
+};
+
+}
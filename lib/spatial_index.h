@@ -0,0 +1,99 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "vec.h"
+#include "vec_batch.h"
+
+namespace graphics {
+
+/**
+ * @brief Bounding volume hierarchy over a set of boxes in world space. Used to cull everything outside
+ * of the camera view, and to find what is under the mouse, in logarithmic time.
+ * Boxes are kept as structure of arrays in tree order, so a whole leaf is culled with one batch kernel.
+ */
+class SpatialIndex {
+public:
+    /**
+     * @brief A box to be indexed, id is handed back by the queries
+     */
+    struct Item {
+        AABB     box;
+        uint32_t id;
+    };
+
+    static constexpr uint32_t kLeafSize = 8; // one AVX2 register of boxes
+
+    /**
+     * @brief Build the hierarchy from scratch over items
+     */
+    void build(std::vector<Item> items);
+
+    /**
+     * @brief Recompute the bounds of every BVH node after items moved, without changing the tree.
+     * Cheaper than a rebuild, but the tree gets worse the further items move.
+     * @param moved New box of every item, indexed by id
+     */
+    void refit(const std::vector<AABB>& moved);
+
+    /**
+     * @brief Carry the index over to a new set of items, refitting instead of rebuilding. Slots of items
+     * that are gone are emptied, and items that are new go into a subtree of their own next to the old
+     * tree. Rebuilds anyway once the tree got too loose: too many empty slots or grafted subtrees, or
+     * leaves stretched to twice the area they were built with.
+     * @param remap New id of every old id, UINT32_MAX if the item is gone
+     * @param boxes Box of every new id, a new id nothing in remap maps to is an added item
+     */
+    void update(const std::vector<uint32_t>& remap, const std::vector<AABB>& boxes);
+
+    /**
+     * @brief Append the ids of every item that intersects rect to out
+     */
+    void queryRect(const AABB& rect, std::vector<uint32_t>& out) const;
+
+    /**
+     * @brief Find the smallest item containing p
+     * @return id of the item, or -1 if there is none
+     */
+    int64_t pick(const vec2& p) const;
+
+    void   clear();
+    size_t size()  const { return ids.size() - dead; }
+    bool   empty() const { return size() == 0; }
+    size_t memoryBytes() const { return nodes.capacity() * sizeof(Node) + ids.capacity() * sizeof(uint32_t) + boxes.memoryBytes(); }
+
+    /**
+     * @brief Bounds of everything in the index
+     */
+    AABB bounds() const { return nodes.empty() ? AABB() : nodes[0].box; }
+
+private:
+    // Internal nodes have count == 0, their left child is the next node and right is stored.
+    // Leaves point to [first, first + count) in ids and boxes.
+    struct Node {
+        AABB     box;
+        uint32_t first = 0;
+        uint32_t count = 0;
+        uint32_t right = 0;
+    };
+
+    static constexpr uint32_t kDead     = UINT32_MAX; // id of an emptied slot, its box is inverted so nothing hits it
+    static constexpr uint32_t kMaxGrafts = 8;          // every graft makes the tree one level deeper
+
+    uint32_t buildRecursive(std::vector<Item>& items, uint32_t first, uint32_t count);
+    AABB     refitRecursive(uint32_t node_idx, const std::vector<AABB>& moved);
+    void     graft(std::vector<Item> added);
+    float    leafArea() const;
+
+    std::vector<Node>     nodes;
+    std::vector<uint32_t> ids;   // item id per slot, in tree order
+    simd::BoxBuffer       boxes; // item box per slot, in tree order
+
+    // How loose the tree got since it was built
+    size_t   dead       = 0;
+    uint32_t grafts     = 0;
+    float    built_area = 0.f; // summed area of the leaves when they were built
+};
+
+}
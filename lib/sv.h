@@ -1,5 +1,8 @@
 #pragma once
 
+#include <cctype>
+#include <optional>
+
 #include "common.h"
 
 namespace SV {
@@ -36,8 +39,8 @@ enum PortInstanceType {
 struct Port {
     std::string name;
 
-    SV::PortType port_type;
-    SV::DataType data_type;
+    SV::PortType port_type = SV::INPUT;
+    SV::DataType data_type = SV::LOGIC; // not parsed yet
 
     bool has_packed_dims   = false;
     bool has_unpacked_dims = false;
@@ -45,40 +48,158 @@ struct Port {
     Range inpacked_dim = Range();
 };
 
+// Connection of one port of an instance, ".d(w_0)" or just "w_0" in port order
 struct InstancePort {
-    SV::PortInstanceType port_type;
-    SV::Port* module_port;
-    std::string signal_name; // TODO: Figure out if I should make a signal struct to fix this? 
-                             // Not important for now
+    SV::PortInstanceType port_type = SV::NAMED;
+    std::string port_name;   // of a positional one the port in that place, empty if there is none
+    std::string signal_name; // expression text as written, empty for an unconnected ".d()"
 };
 
 struct Parameter {
     std::string name;
-    std::string default_value; // TODO: Figure out if this should be string or literal
+    std::string default_value; // expression text as written, evaluated by elaboration
     SV::DataType data_type;
+    bool local = false; // localparam, or parameter in the body of a module with a parameter port list
+};
+
+// Value given to a parameter of the instantiated module, e.g. #(.WIDTH(8)) or #(8)
+struct ParamOverride {
+    std::string name;  // empty if positional
+    std::string value; // expression text, evaluated in the scope of the parent
+};
+
+/**
+ * @brief Index range of an instance array "foo u_foo[255:0] (...)" or of an instantiation in a generate
+ * for loop. The whole range is one ModuleInstance, elements are only named when something looks at them.
+ * @var first_expr First index as written, "255" above, or the start value of the genvar
+ * @var last_expr  Last index, for a loop worked out from its condition, e.g. "(N)-1" for "i < N"
+ * @var step       Genvar step, 0 for an instance array, which counts towards last either way
+ * @var scope      Label of the generate block, empty for an instance array
+ * @var first      First index with the default parameters of the parent, see resolved
+ * @var resolved   False if the range depends on something that could not be evaluated, the range
+ *                 then counts as one element
+ */
+struct InstanceRange {
+    std::string first_expr;
+    std::string last_expr;
+    int         step  = 0;
+    std::string scope;
+
+    int  first    = 0;
+    int  last     = 0;
+    bool resolved = false;
+
+    static size_t Count(int first, int last, int step) {
+        if (step == 0) return size_t(first <= last ? int64_t(last) - first : int64_t(first) - last) + 1;
+        const int64_t steps = (int64_t(last) - first) / step;
+        return steps < 0 ? 0 : size_t(steps) + 1;
+    }
+
+    static int Index(int first, int last, int step, size_t element) {
+        if (step == 0) return first <= last ? first + int(element) : first - int(element);
+        return first + int(element) * step;
+    }
+
+    size_t count() const { return resolved ? Count(first, last, step) : 1; }
+    int    index(size_t element) const { return Index(first, last, step, element); }
 };
 
 struct Module;
 struct ModuleInstance {
-    Module* module;
+    Module* module = nullptr;
     std::string instance_name;
-    // std::vector<InstancePort> port_mapping; // TODO
+    Module* parent = nullptr; // module the instantiation is written in
+    Range   span;             // byte offsets of the instantiation in parent->source_file
+    std::vector<ParamOverride> param_overrides;
+    int32_t range = -1; // index into parent->instance_ranges, -1 if this is a single instance
+    std::vector<InstancePort> port_mapping; // in the order written
 };
 
 struct Module {
     std::string name;
     std::string source_file;
+    Range       span; // byte offsets of the declaration in source_file
 
     std::vector<Port>      ports;
     std::vector<Parameter> parameters;
 
     std::vector<Module*>        references;   // Modules that reference this module
     std::vector<ModuleInstance> dependencies; // Modules that this module depends on (instantiations)
+    std::vector<InstanceRange>  instance_ranges;
 
     // TODO: How do I connect it to the JSON parsing?
     // After constructing symbol table, still need to parse module instantiations
     // This is very temporary, jank solution
-    const json* module_cst;
+    const json* module_cst = nullptr; // only set while ParseCST runs, the JSON is gone after it
 };
 
+// Name of an instance as shown in the hierarchy, "u_foo[255:0]" for an instance array and
+// "g_bank[0:63].u_foo" for a generate loop, just the instance name otherwise. count is the number
+// of elements if the parameters of the parent are not the defaults the range was resolved with.
+inline std::string InstanceLabel(const ModuleInstance& instance, std::optional<size_t> count = std::nullopt) {
+    if (instance.range < 0 || !instance.parent) return instance.instance_name;
+    const InstanceRange& r = instance.parent->instance_ranges[instance.range];
+    const size_t       n = count.value_or(r.count());
+    // The last index reached, a loop stepping by 2 up to 7 ends at 6
+    const std::string  dims = r.resolved && n > 0
+                                  ? "[" + std::to_string(r.first) + ":" + std::to_string(r.index(n - 1)) + "]"
+                                  : "[" + r.first_expr + ":" + r.last_expr + "]";
+    return r.scope.empty() ? instance.instance_name + dims : r.scope + dims + "." + instance.instance_name;
+}
+
+// Name of one element of a ranged instance, "u_foo[3]" or "g_bank[3].u_foo"
+inline std::string ElementName(const ModuleInstance& instance, size_t element) {
+    if (instance.range < 0 || !instance.parent) return instance.instance_name;
+    const InstanceRange& r = instance.parent->instance_ranges[instance.range];
+    const std::string  dim = "[" + (r.resolved ? std::to_string(r.index(element)) : r.first_expr) + "]";
+    return r.scope.empty() ? instance.instance_name + dim : r.scope + dim + "." + instance.instance_name;
+}
+
+// Signals an expression connected to a port reads or drives, "w_0" for "w_0[3:0]", "a" and "b" for
+// "{a, b}". Constants and whatever is inside a select are not signals of their own.
+inline std::vector<std::string_view> SignalNames(std::string_view expr) {
+    std::vector<std::string_view> names;
+    int depth = 0; // inside [] selects
+    for (size_t i = 0; i < expr.size();) {
+        const char c = expr[i];
+        if (c == '[') depth++;
+        if (c == ']') depth = depth > 0 ? depth - 1 : 0;
+        const bool ident_start = std::isalpha(uint8_t(c)) || c == '_' || c == '\\';
+        if (!ident_start) {
+            // 32'hFF: the base and digits after the quote are part of the number
+            if (c == '\'') {
+                i++;
+                while (i < expr.size() && (std::isalnum(uint8_t(expr[i])) || expr[i] == '_' || expr[i] == '?')) i++;
+                continue;
+            }
+            // bus.data is the signal bus, and a system call like $clog2 is no signal at all
+            if (std::isdigit(uint8_t(c)) || c == '$' || c == '.') {
+                i++;
+                while (c == '.' && i < expr.size() && std::isspace(uint8_t(expr[i]))) i++;
+                while (i < expr.size() && (std::isalnum(uint8_t(expr[i])) || expr[i] == '_' || expr[i] == '$')) i++;
+                continue;
+            }
+            i++;
+            continue;
+        }
+
+        // Escaped identifiers run up to the next white space
+        size_t end = i + 1;
+        if (c == '\\') {
+            while (end < expr.size() && !std::isspace(uint8_t(expr[end]))) end++;
+        } else {
+            while (end < expr.size() && (std::isalnum(uint8_t(expr[end])) || expr[end] == '_' || expr[end] == '$')) end++;
+        }
+        if (depth == 0) names.push_back(expr.substr(i, end - i));
+        i = end;
+    }
+    return names;
+}
+
+// Elements of an instance, 1 unless it is ranged
+inline size_t NumElements(const ModuleInstance& instance) {
+    if (instance.range < 0 || !instance.parent) return 1;
+    return instance.parent->instance_ranges[instance.range].count();
+}
+
 }
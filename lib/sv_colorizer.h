@@ -1,16 +1,23 @@
 // sv_colorizer.h
 #pragma once
+#include <memory>
 #include <string>
+#include <string_view>
 #include <vector>
 #include <unordered_map>
 #include "common.h"
+#include "mapped_file.h"
 
 namespace sv {
 
-// One colored run of text.
-struct TextSpan { std::string text; Color color; };
-using LineSpans    = std::vector<TextSpan>;
-using ColorizedDoc = std::vector<LineSpans>;
+// One colored run of text, a view into the source of the document it is in
+struct TextSpan { std::string_view text; Color color; };
+using LineSpans = std::vector<TextSpan>;
+
+// Colored lines of a file, keeps the mapped source its spans point into alive
+struct ColorizedDoc : std::vector<LineSpans> {
+    std::shared_ptr<const SV::MappedFile> source;
+};
 
 struct ColorizerOpts {
     int  tab_spaces = 4;                 // expand \t to spaces
@@ -20,6 +27,15 @@ struct ColorizerOpts {
 
 // ---- Bazel/runfiles entry points ----
 
+// Raw tokens of one file as verible exports them, keyed by the resolved path
+json VeribleTokensViaBazelRunfiles(const char* file_path, bazel::tools::cpp::runfiles::Runfiles* rf, const ColorizerOpts& opt);
+
+// Colored lines of filepath from its verible tokens and its mapped source
+ColorizedDoc BuildDocFromVeribleJSON(const json& j, const std::string& filepath, std::shared_ptr<const SV::MappedFile> source, int tab_spaces);
+
+// Heap bytes held by a colorized document
+size_t DocBytes(const ColorizedDoc& doc);
+
 // Multiple files → map: filepath -> ColorizedDoc
 ColorizedDoc ColorizeFileViaBazelRunfiles(const char* file_path, bazel::tools::cpp::runfiles::Runfiles* rf, const ColorizerOpts& opt);
 
@@ -0,0 +1,156 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace task {
+
+/**
+ * @brief Interactive work is whatever the user is waiting on right now, like the file they clicked.
+ * Background work is everything else, like parsing the rest of the project.
+ */
+enum Priority : uint8_t {
+    PRIORITY_INTERACTIVE,
+    PRIORITY_BACKGROUND,
+    PRIORITY_COUNT,
+};
+
+/**
+ * @brief Cooperative cancellation, copies share one flag. A task whose token is cancelled before it
+ * starts is skipped, a running one has to check cancelled() itself.
+ */
+class CancelToken {
+public:
+    CancelToken() : flag(std::make_shared<std::atomic<bool>>(false)) {}
+
+    void cancel() const     { flag->store(true, std::memory_order_relaxed); }
+    bool cancelled() const  { return flag->load(std::memory_order_relaxed); }
+
+private:
+    std::shared_ptr<std::atomic<bool>> flag;
+};
+
+class TaskPool;
+struct TaskState;
+
+/**
+ * @brief Handle to a submitted task, to wait on it or to make other tasks depend on it
+ */
+class TaskHandle {
+public:
+    TaskHandle() = default;
+
+    bool valid() const { return state != nullptr; }
+
+    /**
+     * @brief True once the task ran, threw, or was skipped because it was cancelled
+     */
+    bool done() const;
+
+    /**
+     * @brief Block until done. On a pool thread it runs other tasks meanwhile, so waiting inside a
+     * task never deadlocks the pool.
+     * @throws Whatever the task threw
+     */
+    void wait() const;
+
+private:
+    friend class TaskPool;
+    explicit TaskHandle(std::shared_ptr<TaskState> state) : state(std::move(state)) {}
+
+    std::shared_ptr<TaskState> state;
+};
+
+/**
+ * @brief Work-stealing thread pool. Every worker has a deque per priority: it runs its own newest
+ * task first, and steals the oldest from the others when it runs dry. Tasks submitted from outside
+ * the pool go to a shared queue per priority.
+ * Interactive tasks always go before background ones, and background tasks never occupy every
+ * worker, so one is always free for what the user is waiting on.
+ */
+class TaskPool {
+public:
+    /**
+     * @param num_threads 0 means one per hardware thread
+     */
+    explicit TaskPool(size_t num_threads = 0);
+    ~TaskPool();
+
+    TaskPool(const TaskPool&)            = delete;
+    TaskPool& operator=(const TaskPool&) = delete;
+
+    /**
+     * @brief Run fn on the pool once every task in after is done, whether they succeeded or not
+     */
+    TaskHandle submit(std::function<void()> fn, Priority priority = PRIORITY_BACKGROUND,
+                      CancelToken token = CancelToken(), const std::vector<TaskHandle>& after = {});
+
+    /**
+     * @brief Continuation, fn runs once first is done
+     */
+    TaskHandle then(const TaskHandle& first, std::function<void()> fn, Priority priority = PRIORITY_BACKGROUND,
+                    CancelToken token = CancelToken()) {
+        return submit(std::move(fn), priority, std::move(token), {first});
+    }
+
+    /**
+     * @brief Call fn(i) for every i in [0, count), on at most max_parallel threads at once (0 means
+     * no limit), the calling thread included. Returns when every call returned, stops handing out
+     * indices once token is cancelled.
+     * @throws The first exception any call threw, the other calls still finish
+     */
+    void parallelFor(size_t count, const std::function<void(size_t)>& fn, Priority priority = PRIORITY_BACKGROUND,
+                     CancelToken token = CancelToken(), size_t max_parallel = 0);
+
+    size_t numThreads() const { return workers.size(); }
+
+    /**
+     * @brief True on one of this pool's worker threads
+     */
+    bool onWorker() const;
+
+private:
+    friend class TaskHandle;
+
+    struct Worker {
+        std::thread                            thread;
+        std::mutex                             mtx;
+        std::deque<std::shared_ptr<TaskState>> queues[PRIORITY_COUNT];
+    };
+
+    void                       workerLoop(size_t index);
+    void                       schedule(std::shared_ptr<TaskState> task);
+    std::shared_ptr<TaskState> take(size_t self);
+    std::shared_ptr<TaskState> takeFrom(size_t self, Priority priority);
+    void                       run(const std::shared_ptr<TaskState>& task);
+    bool                       runOne();
+
+    std::vector<std::unique_ptr<Worker>> workers;
+
+    // Tasks submitted from outside the pool
+    std::mutex                             shared_mtx;
+    std::deque<std::shared_ptr<TaskState>> shared[PRIORITY_COUNT];
+
+    // Sleeping workers wake up when queued goes up, counted per priority
+    std::mutex              sleep_mtx;
+    std::condition_variable sleep_cv;
+    std::atomic<size_t>     queued[PRIORITY_COUNT]{};
+    std::atomic<size_t>     running_background{0};
+    size_t                  max_background = 1;
+    bool                    stopping       = false;
+};
+
+/**
+ * @brief The pool everything in the process shares, one thread per hardware thread, started on first use
+ */
+TaskPool& Pool();
+
+}
@@ -0,0 +1,70 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "include/core/SkPicture.h"
+#include "include/core/SkRect.h"
+
+namespace graphics {
+
+/**
+ * @brief Rasterizes a recorded frame (SkPicture) into a pixel buffer by splitting the target area
+ * into tiles, and playing the picture back into every tile on a pool of worker threads. Every tile
+ * gets its own SkSurface over its sub-rectangle of the shared pixel buffer, so no two threads ever
+ * touch the same pixels.
+ */
+class TiledRenderer {
+public:
+    static constexpr int kDefaultTileSize = 256;
+
+    /**
+     * @param num_threads Total number of threads rasterizing, including the calling thread.
+     *                    0 means one per hardware thread.
+     * @param tile_size   Width and height of the tiles in pixels
+     */
+    explicit TiledRenderer(int num_threads = 0, int tile_size = kDefaultTileSize);
+    ~TiledRenderer();
+
+    TiledRenderer(const TiledRenderer&)            = delete;
+    TiledRenderer& operator=(const TiledRenderer&) = delete;
+
+    /**
+     * @brief Play back picture into area of the screen. Blocks until all tiles are done.
+     * @param picture   Recorded frame, in screen coordinates
+     * @param pixels    Pointer to the top left pixel of area (BGRA8888)
+     * @param row_bytes Stride of the pixel buffer
+     * @param area      Region of the screen to rasterize
+     */
+    void render(const SkPicture* picture, uint8_t* pixels, size_t row_bytes, const SkIRect& area);
+
+    int threadCount() const { return int(workers.size()) + 1; }
+
+private:
+    void workerLoop();
+    void runTiles();
+    void renderTile(const SkIRect& tile);
+
+    int tile_size;
+
+    std::vector<std::thread> workers;
+    std::mutex               mtx;
+    std::condition_variable  cv_start;
+    std::condition_variable  cv_done;
+    uint64_t                 generation      = 0;
+    int                      pending_workers = 0;
+    bool                     stopping        = false;
+
+    // Current job, written by render() before waking the workers
+    const SkPicture*     job_picture   = nullptr;
+    uint8_t*             job_pixels    = nullptr;
+    size_t               job_row_bytes = 0;
+    SkIRect              job_area;
+    std::vector<SkIRect> job_tiles;
+    std::atomic<size_t>  next_tile{0};
+};
+
+}
@@ -1,57 +1,47 @@
 #pragma once
 
+#include <algorithm>
 #include <cstdint>
 #include <stdexcept>
 #include <cmath>
 #include <iostream>
 
 // ===== vec2 =====
+// Everything on vec2 and AABB is constexpr and noexcept, they are used per node on every frame
 struct vec2 {
     float x, y;
 
-    vec2(float x = 0.0f, float y = 0.0f) : x(x), y(y) {}
+    constexpr vec2(float x = 0.0f, float y = 0.0f) noexcept : x(x), y(y) {}
 
-    // Indexing
-    float operator[](size_t index) const {
-        switch (index) {
-            case 0: return x;
-            case 1: return y;
-            default: throw std::runtime_error("Invalid index for vec2");
-        }
-    }
-    float& operator[](size_t index) {
-        switch (index) {
-            case 0: return x;
-            case 1: return y;
-            default: throw std::runtime_error("Invalid index for vec2");
-        }
-    }
+    // Indexing, anything but 0 is y
+    constexpr float  operator[](size_t index) const noexcept { return index == 0 ? x : y; }
+    constexpr float& operator[](size_t index) noexcept       { return index == 0 ? x : y; }
 
     // Comparison
-    bool operator==(const vec2& rhs) const { return x == rhs.x && y == rhs.y; }
-    bool operator!=(const vec2& rhs) const { return !(*this == rhs); }
+    constexpr bool operator==(const vec2& rhs) const noexcept { return x == rhs.x && y == rhs.y; }
+    constexpr bool operator!=(const vec2& rhs) const noexcept { return !(*this == rhs); }
 
     // Arithmetic with another vec2
-    vec2 operator+(const vec2& rhs) const { return vec2(x + rhs.x, y + rhs.y); }
-    vec2 operator-(const vec2& rhs) const { return vec2(x - rhs.x, y - rhs.y); }
-    vec2 operator*(const vec2& rhs) const { return vec2(x * rhs.x, y * rhs.y); }
-    vec2 operator/(const vec2& rhs) const { return vec2(x / rhs.x, y / rhs.y); }
+    constexpr vec2 operator+(const vec2& rhs) const noexcept { return vec2(x + rhs.x, y + rhs.y); }
+    constexpr vec2 operator-(const vec2& rhs) const noexcept { return vec2(x - rhs.x, y - rhs.y); }
+    constexpr vec2 operator*(const vec2& rhs) const noexcept { return vec2(x * rhs.x, y * rhs.y); }
+    constexpr vec2 operator/(const vec2& rhs) const noexcept { return vec2(x / rhs.x, y / rhs.y); }
 
     // Arithmetic with scalar
-    vec2 operator*(float s) const { return vec2(x * s, y * s); }
-    vec2 operator/(float s) const { return vec2(x / s, y / s); }
+    constexpr vec2 operator*(float s) const noexcept { return vec2(x * s, y * s); }
+    constexpr vec2 operator/(float s) const noexcept { return vec2(x / s, y / s); }
 
     // Compound assignment
-    vec2& operator+=(const vec2& rhs) { x += rhs.x; y += rhs.y; return *this; }
-    vec2& operator-=(const vec2& rhs) { x -= rhs.x; y -= rhs.y; return *this; }
-    vec2& operator*=(const vec2& rhs) { x *= rhs.x; y *= rhs.y; return *this; }
-    vec2& operator/=(const vec2& rhs) { x /= rhs.x; y /= rhs.y; return *this; }
+    constexpr vec2& operator+=(const vec2& rhs) noexcept { x += rhs.x; y += rhs.y; return *this; }
+    constexpr vec2& operator-=(const vec2& rhs) noexcept { x -= rhs.x; y -= rhs.y; return *this; }
+    constexpr vec2& operator*=(const vec2& rhs) noexcept { x *= rhs.x; y *= rhs.y; return *this; }
+    constexpr vec2& operator/=(const vec2& rhs) noexcept { x /= rhs.x; y /= rhs.y; return *this; }
 
-    vec2& operator*=(float s) { x *= s; y *= s; return *this; }
-    vec2& operator/=(float s) { x /= s; y /= s; return *this; }
+    constexpr vec2& operator*=(float s) noexcept { x *= s; y *= s; return *this; }
+    constexpr vec2& operator/=(float s) noexcept { x /= s; y /= s; return *this; }
 
     // Unary minus
-    vec2 operator-() const { return vec2(-x, -y); }
+    constexpr vec2 operator-() const noexcept { return vec2(-x, -y); }
 
     friend std::ostream& operator<<(std::ostream& os, const vec2& v) {
         return os << "(" << v.x << ", " << v.y << ")";
@@ -164,26 +154,37 @@ struct vec4 {
 };
 
 // Scalar * vecN (commutative scalar multiplication)
-inline vec2 operator*(float s, const vec2& v) { return v * s; }
+constexpr vec2 operator*(float s, const vec2& v) noexcept { return v * s; }
 inline vec3 operator*(float s, const vec3& v) { return v * s; }
 inline vec4 operator*(float s, const vec4& v) { return v * s; }
 
 struct AABB {
-    vec2 ul; 
-    vec2 br; 
+    vec2 ul;
+    vec2 br;
+
+    constexpr AABB() noexcept : ul(0, 0), br(0, 0) {}
+    constexpr AABB(float ul_x, float ul_y, float br_x, float br_y) noexcept : ul(ul_x, ul_y), br(br_x, br_y) {}
+    constexpr AABB(vec2 ul, vec2 br) noexcept : ul(ul), br(br) {}
 
-    AABB() {
-        ul = vec2(0, 0);
-        br = vec2(0, 0);
+    constexpr vec2  Center() const noexcept { return (ul + br) * 0.5f; }
+    constexpr vec2  Size()   const noexcept { return br - ul; }
+    constexpr float Area()   const noexcept { return (br.x - ul.x) * (br.y - ul.y); }
+
+    constexpr bool Contains(const vec2& p) const noexcept {
+        return p.x >= ul.x && p.x <= br.x && p.y >= ul.y && p.y <= br.y;
     }
 
-    AABB(float ul_x, float ul_y, float br_x, float br_y) {
-        ul = vec2(ul_x, ul_y);
-        br = vec2(br_x, br_y);
+    constexpr bool Intersects(const AABB& o) const noexcept {
+        return ul.x <= o.br.x && br.x >= o.ul.x && ul.y <= o.br.y && br.y >= o.ul.y;
     }
 
-    AABB(vec2 ul, vec2 br) {
-        this->ul = ul;
-        this->br = br;
+    // Grow to also cover o
+    constexpr void Expand(const AABB& o) noexcept {
+        ul.x = std::min(ul.x, o.ul.x);
+        ul.y = std::min(ul.y, o.ul.y);
+        br.x = std::max(br.x, o.br.x);
+        br.y = std::max(br.y, o.br.y);
     }
 };
+
+static_assert(AABB(0, 0, 2, 2).Intersects(AABB(vec2(1, 1), vec2(3, 3))), "vec2 and AABB have to stay usable at compile time");
@@ -0,0 +1,84 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "vec.h"
+
+namespace simd {
+
+/**
+ * @brief Boxes stored as structure of arrays, one array per coordinate, so a batch kernel loads 4 or 8
+ * boxes with one instruction per coordinate
+ * @var x0 ul.x of every box
+ * @var y0 ul.y of every box
+ * @var x1 br.x of every box
+ * @var y1 br.y of every box
+ */
+struct BoxBuffer {
+    std::vector<float> x0, y0, x1, y1;
+
+    size_t size() const { return x0.size(); }
+    bool   empty() const { return x0.empty(); }
+
+    void clear() {
+        x0.clear();
+        y0.clear();
+        x1.clear();
+        y1.clear();
+    }
+    void reserve(size_t n) {
+        x0.reserve(n);
+        y0.reserve(n);
+        x1.reserve(n);
+        y1.reserve(n);
+    }
+    void resize(size_t n) {
+        x0.resize(n);
+        y0.resize(n);
+        x1.resize(n);
+        y1.resize(n);
+    }
+    void push_back(const AABB& box) {
+        x0.push_back(box.ul.x);
+        y0.push_back(box.ul.y);
+        x1.push_back(box.br.x);
+        y1.push_back(box.br.y);
+    }
+    void set(size_t i, const AABB& box) {
+        x0[i] = box.ul.x;
+        y0[i] = box.ul.y;
+        x1[i] = box.br.x;
+        y1[i] = box.br.y;
+    }
+    AABB get(size_t i) const { return AABB(x0[i], y0[i], x1[i], y1[i]); }
+
+    size_t memoryBytes() const { return (x0.capacity() + y0.capacity() + x1.capacity() + y1.capacity()) * sizeof(float); }
+};
+
+/**
+ * @brief Instruction set the kernels run with on this machine: "avx2", "sse2" or "scalar"
+ */
+const char* KernelIsa();
+
+/**
+ * @brief Camera transform of every box, out = (in - offset) * scale, the same as worldToScreen per corner.
+ * out may be in, it is resized to fit.
+ */
+void TransformBoxes(const BoxBuffer& in, const vec2& offset, float scale, BoxBuffer& out);
+
+/**
+ * @brief Union of the boxes [first, first + count), AABB() if count is 0
+ */
+AABB Bounds(const BoxBuffer& boxes, size_t first, size_t count);
+inline AABB Bounds(const BoxBuffer& boxes) { return Bounds(boxes, 0, boxes.size()); }
+
+/**
+ * @brief Append every box of [first, first + count) that intersects rect to out, in order, with the same
+ * test as AABB::Intersects
+ * @param ids What to append per box, ids[i] for box i, nullptr appends i itself
+ */
+void CullBoxes(const BoxBuffer& boxes, size_t first, size_t count, const AABB& rect, const uint32_t* ids,
+               std::vector<uint32_t>& out);
+
+}
@@ -0,0 +1,133 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "layout.h"
+#include "spatial_index.h"
+#include "task_pool.h"
+
+namespace graphics {
+
+/**
+ * @brief How a net is drawn, every style is one path draw no matter how many nets it has
+ */
+enum WireStyle : uint8_t {
+    WIRE_SIGNAL, // only between instances under the same parent
+    WIRE_PORT,   // reaches a port of the parent as well
+    WIRE_BUS,    // touches an instance array or generate loop
+    WIRE_STYLE_COUNT,
+};
+
+/**
+ * @brief Axis aligned piece of a wire, in world space
+ */
+struct WireSegment {
+    vec2 from;
+    vec2 to;
+};
+
+/**
+ * @brief One signal under a parent, routed in the channel between the parent and its children
+ * @var bounds        Box around every segment of the net, in world space
+ * @var first_segment The net is segments[first_segment, +num_segments): the trunk on its track, then a
+ *                    horizontal stub to every port it connects
+ */
+struct WireNet {
+    AABB      bounds;
+    uint32_t  first_segment;
+    uint32_t  num_segments;
+    WireStyle style;
+};
+
+/**
+ * @brief The nets of one parent, so the next routing can take them over if the parent did not change
+ * @var item      Index of the parent in the snapshot the wires were routed for
+ * @var first_net The nets of the parent are nets[first_net, +num_nets), their segments follow each other too
+ */
+struct ParentWires {
+    uint32_t item;
+    uint32_t first_net;
+    uint32_t num_nets;
+    float    channel_width;
+};
+
+/**
+ * @brief Routed wires of one layout snapshot, immutable once routed
+ * @var generation    Generation of the snapshot the wires were routed for, they only fit that one
+ * @var parents       Every parent that was routed, in item order
+ * @var index         Over the bounds of the nets, id is the index into nets
+ * @var channel_width Widest channel between a parent and its children, for level of detail
+ */
+struct WireLayout {
+    uint64_t                 generation = 0;
+    std::vector<WireNet>     nets;
+    std::vector<WireSegment> segments;
+    std::vector<ParentWires> parents;
+    SpatialIndex             index;
+    float                    channel_width = 0.f;
+
+    size_t memoryBytes() const {
+        return nets.capacity() * sizeof(WireNet) + segments.capacity() * sizeof(WireSegment) +
+               parents.capacity() * sizeof(ParentWires) + index.memoryBytes();
+    }
+};
+
+/**
+ * @brief Route the nets under every expanded node of a snapshot.
+ *
+ * Channel routing: the children of a node are stacked in a column to its right, so every net of
+ * the node gets a vertical track in the gap between the two, and a horizontal stub from the track
+ * to every port it is connected to. Ports are spread over the height of the box they belong to.
+ * Tracks are handed out left edge first, so nets only share a track where they do not overlap.
+ * Parents are routed on the task pool in parallel.
+ *
+ * A parent whose children are the same boxes as in prev_snapshot, at most moved together with it,
+ * keeps its nets from prev_wires moved along instead of being routed again.
+ * @param prev_wires Wires routed for prev_snapshot, both or neither are given
+ * @return nullptr if token was cancelled before the routing was done
+ */
+std::shared_ptr<const WireLayout> routeWires(const LayoutSnapshot& snapshot,
+                                             const task::CancelToken& token = task::CancelToken(),
+                                             const LayoutSnapshot* prev_snapshot = nullptr,
+                                             const WireLayout* prev_wires = nullptr);
+
+/**
+ * @brief Routes the wires of every new layout on the task pool, behind interactive work. A new layout
+ * cancels the routing of the one before, the render loop only ever picks up finished results. Each
+ * routing starts from the latest finished one, so only parents that changed are routed again.
+ */
+class WireRouter {
+public:
+    WireRouter() = default;
+    ~WireRouter();
+
+    WireRouter(const WireRouter&)            = delete;
+    WireRouter& operator=(const WireRouter&) = delete;
+
+    /**
+     * @brief Start routing snapshot, nullptr drops the wires
+     */
+    void route(std::shared_ptr<const LayoutSnapshot> snapshot);
+
+    /**
+     * @brief Latest finished wires, nullptr until the first routing is done
+     */
+    std::shared_ptr<const WireLayout> wires() const;
+
+    /**
+     * @brief Block until every routing that was started is done
+     */
+    void waitIdle();
+
+private:
+    mutable std::mutex                    mtx;
+    std::shared_ptr<const WireLayout>     latest;
+    std::shared_ptr<const LayoutSnapshot> latest_snapshot; // the one latest was routed for
+    task::CancelToken                     token;
+    std::vector<task::TaskHandle>         jobs; // cancelled ones may still be running, and they all point back here
+};
+
+}
@@ -0,0 +1,231 @@
+#include <cmath>
+#include <cstring>
+#include <string_view>
+
+#include "code_text_cache.h"
+
+namespace graphics {
+
+// Header and run bookkeeping of a text blob, a guess since skia does not report it
+static constexpr size_t kBlobOverhead = 64;
+
+// Number of code points in a UTF-8 string, which is what a column is
+static size_t utf8Length(std::string_view text) {
+    size_t n = 0;
+    for (unsigned char c : text) n += (c & 0xC0) != 0x80;
+    return n;
+}
+
+// Byte offset of code point number col
+static size_t utf8Offset(std::string_view text, size_t col) {
+    size_t i = 0;
+    for (; i < text.size(); i++) {
+        if ((static_cast<unsigned char>(text[i]) & 0xC0) != 0x80) {
+            if (col == 0) break;
+            col--;
+        }
+    }
+    return i;
+}
+
+void CodeTextCache::sync(const sv::ColorizedDoc& doc, const SkFont& font, float max_width) {
+    // Lines already shaped are copies, only the ones still to be shaped read the mapping
+    intact = !doc.source || doc.source->Intact();
+
+    const bool same_doc   = (this->doc == &doc && source == doc.source && doc_size == doc.size());
+    const bool same_font  = (typeface == font.getTypeface() && font_size == font.getSize());
+    const bool same_width = (this->max_width == max_width);
+    if (same_doc && same_font && same_width) return;
+
+    if (!same_doc) {
+        this->doc = &doc;
+        source    = doc.source;
+        doc_size  = doc.size();
+
+        max_columns = 0;
+        for (size_t i = 0; intact && i < doc.size(); i++) {
+            size_t cols = 0;
+            for (const auto& span : doc[i]) cols += utf8Length(span.text);
+            max_columns = std::max(max_columns, cols);
+        }
+    }
+
+    this->font      = font;
+    this->max_width = max_width;
+    typeface        = font.getTypeface();
+    font_size       = font.getSize();
+
+    // Monospaced fonts never need per glyph measuring, every glyph is one column wide
+    monospace = typeface != nullptr && typeface->isFixedPitch();
+    advance   = font.measureText("M", 1, SkTextEncoding::kUTF8);
+    space_w   = monospace ? advance : font.measureText(" ", 1, SkTextEncoding::kUTF8);
+
+    // One column more than fits, the view is rarely aligned to a column
+    shape_width = max_width + (kScrollColumns + 1) * advance;
+
+    clearLines();
+}
+
+void CodeTextCache::invalidate() {
+    clearLines();
+    doc = nullptr;
+    source.reset();
+    doc_size = 0;
+}
+
+void CodeTextCache::clearLines() {
+    lines.clear();
+    bytes = 0;
+}
+
+const CodeLine& CodeTextCache::line(size_t idx, size_t first_col) {
+    auto it = lines.find(idx);
+    if (it != lines.end() && it->second.first_col <= first_col && first_col - it->second.first_col <= kScrollColumns) {
+        return it->second;
+    }
+
+    if (!intact) {
+        static const CodeLine empty;
+        return it != lines.end() ? it->second : empty;
+    }
+
+    if (it == lines.end()) {
+        if (lines.size() >= kMaxCachedLines) evictAround(idx);
+        it = lines.emplace(idx, CodeLine{}).first;
+    }
+
+    CodeLine& cached = it->second;
+    bytes -= cached.bytes;
+    cached = CodeLine{};
+    // Windows start on multiples of the scroll range, so all lines in view are shaped again together
+    cached.first_col = first_col - first_col % kScrollColumns;
+    buildLine((*doc)[idx], cached);
+    bytes += cached.bytes;
+    return cached;
+}
+
+float CodeTextCache::columnX(const CodeLine& line, size_t col) const {
+    const size_t rel = col - line.first_col;
+    if (monospace) return rel * advance;
+    if (line.col_x.empty()) return 0.f;
+    return line.col_x[std::min(rel, line.col_x.size() - 1)];
+}
+
+void CodeTextCache::evictAround(size_t idx) {
+    // Keep the lines closest to the one being drawn, they are the ones most likely to be drawn again
+    const size_t keep = kMaxCachedLines / 4;
+    for (auto it = lines.begin(); it != lines.end();) {
+        const size_t dist = it->first > idx ? it->first - idx : idx - it->first;
+        if (dist > keep) {
+            bytes -= it->second.bytes;
+            it = lines.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
+void CodeTextCache::buildLine(const sv::LineSpans& spans, CodeLine& out) {
+    // Shape every visible span first, then merge spans of the same color into one blob
+    struct Piece {
+        Color  color;
+        size_t first;
+        int    count;
+    };
+    std::vector<Piece> pieces;
+    glyphs.clear();
+    positions.clear();
+
+    size_t col = 0;
+    float  x   = 0.f;
+    for (const auto& span : spans) {
+        if (x > shape_width) break;
+        if (span.text.empty()) continue;
+
+        std::string_view text = span.text;
+        size_t span_cols = utf8Length(text);
+
+        // Clip away the columns left of the view
+        if (col + span_cols <= out.first_col) {
+            col += span_cols;
+            continue;
+        }
+        if (col < out.first_col) {
+            text       = text.substr(utf8Offset(text, out.first_col - col));
+            span_cols -= out.first_col - col;
+            col        = out.first_col;
+        }
+        col += span_cols;
+
+        // Whitespace is only advanced over
+        if (text.find_first_not_of(' ') == std::string_view::npos) {
+            for (size_t k = 0; !monospace && k < span_cols && out.col_x.size() <= kScrollColumns; k++) {
+                out.col_x.push_back(x + k * space_w);
+            }
+            x += span_cols * space_w;
+            continue;
+        }
+
+        // And the columns right of it. For monospaced fonts this is known before shaping
+        if (monospace) {
+            const size_t fit = size_t(std::ceil((shape_width - x) / advance)) + 1;
+            if (span_cols > fit) text = text.substr(0, utf8Offset(text, fit));
+        }
+
+        int count = font.countText(text.data(), text.size(), SkTextEncoding::kUTF8);
+        if (count <= 0) continue;
+
+        const size_t first = glyphs.size();
+        glyphs.resize(first + count);
+        positions.resize(first + count);
+        font.textToGlyphs(text.data(), text.size(), SkTextEncoding::kUTF8, glyphs.data() + first, count);
+
+        if (monospace) {
+            for (int i = 0; i < count; i++) positions[first + i] = x + i * advance;
+            x += count * advance;
+        } else {
+            widths.resize(count);
+            font.getWidths(glyphs.data() + first, count, widths.data());
+            for (int i = 0; i < count; i++) {
+                if (x > shape_width) {
+                    count = i;
+                    break;
+                }
+                positions[first + i] = x;
+                x += widths[i];
+            }
+            for (int i = 0; i < count && out.col_x.size() <= kScrollColumns; i++) out.col_x.push_back(positions[first + i]);
+            glyphs.resize(first + count);
+            positions.resize(first + count);
+            if (count == 0) continue;
+        }
+
+        pieces.push_back({span.color, first, count});
+    }
+    out.width = x;
+    if (!monospace) {
+        // Columns past the end of the line start where it ends
+        out.col_x.resize(kScrollColumns + 1, x);
+        out.bytes += out.col_x.size() * sizeof(float);
+    }
+
+    std::vector<bool> used(pieces.size(), false);
+    for (size_t i = 0; i < pieces.size(); i++) {
+        if (used[i]) continue;
+
+        SkTextBlobBuilder builder;
+        for (size_t j = i; j < pieces.size(); j++) {
+            if (used[j] || pieces[j].color.rgba() != pieces[i].color.rgba()) continue;
+
+            const auto& run = builder.allocRunPosH(font, pieces[j].count, 0.f);
+            std::memcpy(run.glyphs, glyphs.data() + pieces[j].first, pieces[j].count * sizeof(SkGlyphID));
+            std::memcpy(run.pos, positions.data() + pieces[j].first, pieces[j].count * sizeof(SkScalar));
+            used[j] = true;
+            out.bytes += pieces[j].count * (sizeof(SkGlyphID) + sizeof(SkScalar));
+        }
+        out.runs.push_back({pieces[i].color, builder.make()});
+        out.bytes += sizeof(CodeLineRun) + kBlobOverhead;
+    }
+}
+
+}
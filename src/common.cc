@@ -1,3 +1,9 @@
+#include <algorithm>
+#include <cerrno>
+#include <new>
+
+#include <unistd.h>
+
 #include "common.h"
 
 std::string ResolveUserPath(const char* arg) {
@@ -11,12 +17,32 @@ std::string ResolveUserPath(const char* arg) {
   return fs::weakly_canonical(base / p).string();
 }
 
-std::string ReadAll(FILE* f) {
-    std::ostringstream out;
-    char buf[8192];
-    size_t n;
-    while ((n = fread(buf, 1, sizeof(buf), f)) > 0) out.write(buf, n);
-    return out.str();
+char* IoBuffer::reserveTail(size_t n) {
+    if (cap - len < n) {
+        const size_t new_cap = std::max(len + n, cap * 2);
+        char*        grown   = static_cast<char*>(std::realloc(bytes, new_cap));
+        if (!grown) throw std::bad_alloc();
+        bytes = grown;
+        cap   = new_cap;
+    }
+    return bytes + len;
+}
+
+IoBuffer ReadAll(FILE* f) {
+    // Reads start at 64 KB and grow with the buffer, a pipe hands over up to its capacity per call
+    constexpr size_t kMinRead = size_t(1) << 16;
+
+    IoBuffer  out;
+    const int fd = fileno(f);
+    while (true) {
+        const size_t room = std::max(kMinRead, out.size() / 2);
+        char*        tail = out.reserveTail(room);
+        const ssize_t n   = read(fd, tail, room);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) break;
+        out.commit(size_t(n));
+    }
+    return out;
 }
 
 std::ostream& operator<<(std::ostream& os, const Color& c) {
@@ -1,12 +1,20 @@
 #include "common.h"
 #include "symbol_table.h"
 #include "cst.h"
+#include "profiler.h"
+#include "elaborate.h"
 
 namespace cst {
 
 SymTable::ModuleSymbolTable* global_module_symbol_table;
 
+SymTable::ModuleSymbolTable* GetModuleSymbolTable() {
+    return global_module_symbol_table;
+}
+
 json ParseFiles(size_t num_files, char** file_paths, bazel::tools::cpp::runfiles::Runfiles* rf) {
+    PROFILE_SCOPE("ParseFiles");
+
     // Parse multiple files
     std::vector<std::string> files_to_parse;
 
@@ -31,15 +39,74 @@ json ParseFiles(size_t num_files, char** file_paths, bazel::tools::cpp::runfiles
         throw std::runtime_error(err_msg);
     }
 
-    std::string verible_cst_json_str = ReadAll(pipe);
-    int         rc                   = pclose (pipe);
+    IoBuffer verible_cst_json;
+    int      rc;
+    {
+        PROFILE_SCOPE("ParseFiles/verible");
+        verible_cst_json = ReadAll(pipe);
+        rc               = pclose (pipe);
+    }
     if (rc != 0) {
         std::string err_msg = "verible returned " + std::to_string(rc);
         throw std::runtime_error(err_msg);
     }
-    std::cout << "Got: " << verible_cst_json_str.size() << " bytes of CST JSON\n";
+    std::cout << "Got: " << verible_cst_json.size() << " bytes of CST JSON\n";
 
-    return json::parse(verible_cst_json_str);
+    // Parsed in place, the output is never copied into a string
+    PROFILE_SCOPE("ParseFiles/json");
+    return json::parse(verible_cst_json.data(), verible_cst_json.data() + verible_cst_json.size());
+}
+
+// "parameter [type] NAME [dims] = value", "localparam" as the first token makes it local
+static void ParseParamDeclaration(SV::Module* module, const json& param_decl, bool force_local) {
+    auto param_type = find_first(param_decl, "kParamType");
+    if (param_type == nullptr) return; // type parameters, not evaluated
+
+    // The type may name a user type, so look for the name directly under kParamType
+    const json* name_node = nullptr;
+    for (const auto& child : *get_child_array(*param_type)) {
+        if (tag_of(child) == "kUnqualifiedId") name_node = find_first(child, "SymbolIdentifier");
+    }
+    if (name_node == nullptr) return;
+
+    SV::Parameter param;
+    param.name      = symbol_text(*name_node).value_or("");
+    param.data_type = SV::LOGIC;
+    param.local     = force_local || tag_of(*first_token(param_decl)) == "localparam";
+    if (auto assign = find_first(param_decl, "kTrailingAssign")) {
+        if (auto value = find_first(*assign, "kExpression")) param.default_value = node_text(*value);
+    }
+    module->parameters.push_back(std::move(param));
+}
+
+// Last identifier below node that is not inside a dimension, the declared name in "input logic [W-1:0] d"
+static const json* DeclaredName(const json& node) {
+    if (!node.is_object()) return nullptr;
+    if (tag_of(node) == "SymbolIdentifier") return &node;
+    if (tag_of(node).find("Dimensions") != std::string::npos) return nullptr;
+
+    const json* last = nullptr;
+    if (auto a = get_child_array(node)) {
+        for (const auto& c : *a) {
+            if (auto name = DeclaredName(c)) last = name;
+        }
+    }
+    return last;
+}
+
+// "input logic [31:0] d", a port without a direction has the one of the port before it
+static void ParsePortDeclaration(SV::Module* module, const json& port_decl) {
+    auto name_node = DeclaredName(port_decl);
+    if (name_node == nullptr) return;
+
+    SV::Port port;
+    port.name = symbol_text(*name_node).value_or("");
+    const std::string direction = tag_of(*first_token(port_decl));
+    if (direction == "input")       port.port_type = SV::INPUT;
+    else if (direction == "output") port.port_type = SV::OUTPUT;
+    else if (direction == "inout")  port.port_type = SV::INOUT;
+    else if (!module->ports.empty()) port.port_type = module->ports.back().port_type;
+    module->ports.push_back(std::move(port));
 }
 
 static void ParseModuleDeclarationCST(const std::string& file, const json& module_decl) {
@@ -49,12 +116,14 @@ static void ParseModuleDeclarationCST(const std::string& file, const json& modul
     SV::Module* module = new SV::Module;
     module->source_file = file;
     module->module_cst  = &module_decl;
+    if (auto span = node_range(module_decl)) module->span = *span;
 
     auto module_header = find_first(module_decl, "kModuleHeader");
     if (module_header == nullptr) {
         throw std::runtime_error("Could not find module header of module delcaration");
     }
 
+    bool has_param_ports = false;
     auto children = get_child_array(*module_header);
     for (const auto& child : *children) {
         auto child_tag = tag_of(child);
@@ -67,19 +136,27 @@ static void ParseModuleDeclarationCST(const std::string& file, const json& modul
                 throw std::runtime_error("Could not find name of module");
             }
         } else if (child_tag == "kFormalParameterListDeclaration") {
-            // Parameters
-            // TODO: Implement
+            // Parameters, the ones in the body come after the header ones below
+            std::vector<const json*> params;
+            collect_all(child, "kParamDeclaration", params);
+            for (const auto param : params) ParseParamDeclaration(module, *param, false);
+            has_param_ports = true;
         } else if (child_tag == "kParentGroup") {
             // Ports
             std::vector<const json*> ports;
             auto port_list = find_first(child, "kPortDeclarationList");
-            collect_all(*port_list, "kPortDeclaration", ports);
+            if (port_list) collect_all(*port_list, "kPortDeclaration", ports);
 
-            for (const auto port : ports) {
-                // TODO
-            }
+            for (const auto port : ports) ParsePortDeclaration(module, *port);
         }
     }
+
+    // A parameter in the body can not be overridden if the header has a parameter port list
+    std::vector<const json*> body_params;
+    for (const auto& child : *get_child_array(module_decl)) {
+        if (&child != module_header && !child.is_null()) collect_all(child, "kParamDeclaration", body_params);
+    }
+    for (const auto param : body_params) ParseParamDeclaration(module, *param, has_param_ports);
     
     // Insert module into symbol table
     SymTable::symbol_table_insert(global_module_symbol_table, module);
@@ -115,7 +192,113 @@ static void ParseModuleDeclarationsFromJSON(const std::string& file, const json&
     }
 }
 
-static void ParseModuleInstantiation(SV::Module* module, const json& module_inst_json) {
+static std::string WithoutSpaces(std::string s) {
+    s.erase(std::remove_if(s.begin(), s.end(), [](unsigned char c) { return std::isspace(c); }), s.end());
+    return s;
+}
+
+// Index range of a generate for loop, nullopt for a loop that does not count a genvar by a constant
+// step, like "for (genvar i = 0; i < N; i++)" does
+static std::optional<SV::InstanceRange> ParseLoopGenerate(const json& loop) {
+    auto header = find_first(loop, "kLoopHeader");
+    if (header == nullptr) return std::nullopt;
+    auto init = find_first(*header, "kForInitialization");
+    auto cond = find_first(*header, "kForCondition");
+    auto step = find_first(*header, "kForStepList");
+    if (init == nullptr || cond == nullptr || step == nullptr) return std::nullopt;
+
+    auto genvar_node = find_first(*init, "SymbolIdentifier");
+    auto start       = find_first(*init, "kExpression");
+    if (genvar_node == nullptr || start == nullptr) return std::nullopt;
+    const std::string genvar = symbol_text(*genvar_node).value_or("");
+
+    SV::InstanceRange range;
+    range.first_expr = node_text(*start);
+
+    // "i++", "++i", "i += 2", "i = i - 1"
+    const std::string step_text = WithoutSpaces(node_text(*step));
+    std::string amount;
+    int         sign = 1;
+    if (step_text == genvar + "++" || step_text == "++" + genvar) {
+        range.step = 1;
+    } else if (step_text == genvar + "--" || step_text == "--" + genvar) {
+        range.step = -1;
+    } else if (step_text.rfind(genvar + "+=", 0) == 0 || step_text.rfind(genvar + "-=", 0) == 0) {
+        sign   = step_text[genvar.size()] == '+' ? 1 : -1;
+        amount = step_text.substr(genvar.size() + 2);
+    } else if (step_text.rfind(genvar + "=" + genvar, 0) == 0 && step_text.size() > 2 * genvar.size() + 1) {
+        const char op = step_text[2 * genvar.size() + 1];
+        if (op != '+' && op != '-') return std::nullopt;
+        sign   = op == '+' ? 1 : -1;
+        amount = step_text.substr(2 * genvar.size() + 2);
+    } else {
+        return std::nullopt;
+    }
+    if (!amount.empty()) {
+        auto value = elab::EvalConstExpr(amount, nullptr);
+        if (!value || *value == 0 || *value > INT32_MAX || *value < -INT32_MAX) return std::nullopt;
+        range.step = sign * int(*value);
+    }
+
+    // "i < N" and the like, the last index is the last value that still passes
+    const std::string cond_text = WithoutSpaces(node_text(*cond));
+    if (cond_text.rfind(genvar, 0) != 0) return std::nullopt;
+    std::string op    = cond_text.substr(genvar.size(), 2);
+    std::string bound = cond_text.substr(genvar.size() + 2);
+    if (op != "<=" && op != ">=" && op != "!=") {
+        op    = op.substr(0, 1);
+        bound = cond_text.substr(genvar.size() + 1);
+    }
+    if (bound.empty()) return std::nullopt;
+
+    const bool up = range.step > 0;
+    if (op == "<=" || op == ">=")                   range.last_expr = bound;
+    else if (op == "<" && up)                       range.last_expr = "(" + bound + ")-1";
+    else if (op == ">" && !up)                      range.last_expr = "(" + bound + ")+1";
+    else if (op == "!=")                            range.last_expr = "(" + bound + (up ? ")-1" : ")+1");
+    else                                            return std::nullopt;
+
+    // Named after the label of the block, unnamed ones get a made up name like the tools do
+    range.scope = "genblk";
+    for (const auto& child : *get_child_array(loop)) {
+        if (tag_of(child) != "kGenerateBlock") continue;
+        if (auto begin = find_first(child, "kBegin")) {
+            if (auto label = find_first(*begin, "SymbolIdentifier")) range.scope = symbol_text(*label).value_or(range.scope);
+        }
+    }
+    return range;
+}
+
+// Index range of an instance array, "u_foo[7:0]" or "u_foo[8]", nullopt if the instance is no array
+static std::optional<SV::InstanceRange> ParseInstanceArray(const json& instance_variable_list) {
+    auto gate_instance = find_first(instance_variable_list, "kGateInstance");
+    if (gate_instance == nullptr || get_child_array(*gate_instance) == nullptr) return std::nullopt;
+
+    // Only the dimensions of the instance itself, not the ones of signals in the port list
+    for (const auto& child : *get_child_array(*gate_instance)) {
+        if (tag_of(child) != "kUnpackedDimensions") continue;
+
+        SV::InstanceRange range;
+        if (auto dim = find_first(child, "kDimensionRange")) {
+            auto left  = nth_child(*dim, 1);
+            auto right = nth_child(*dim, 3);
+            if (left == nullptr || right == nullptr) return std::nullopt;
+            range.first_expr = node_text(*left);
+            range.last_expr  = node_text(*right);
+            return range;
+        }
+        if (auto dim = find_first(child, "kDimensionScalar")) {
+            auto size = nth_child(*dim, 1);
+            if (size == nullptr) return std::nullopt;
+            range.first_expr = "0";
+            range.last_expr  = "(" + node_text(*size) + ")-1";
+            return range;
+        }
+    }
+    return std::nullopt;
+}
+
+static void ParseModuleInstantiation(SV::Module* module, const json& module_inst_json, const SV::InstanceRange* loop) {
     if (!module_inst_json.is_object()) return;
 
     // Get module name
@@ -131,30 +314,118 @@ static void ParseModuleInstantiation(SV::Module* module, const json& module_inst
     if (module_name_it == module_name_node->end()) return;
     auto module_name = module_name_it->get<std::string>();
 
-    // TODO: Get parameter list wiht "kActualParameterList"
-    
+    // Parameter overrides, "#(.NAME(value), ...)" or "#(value, ...)"
+    std::vector<SV::ParamOverride> param_overrides;
+    if (auto param_list = find_first(*instance_type, "kActualParameterList")) {
+        std::vector<const json*> by_name;
+        collect_all(*param_list, "kParamByName", by_name);
+        for (const auto param : by_name) {
+            auto name  = nth_child(*param, 1);
+            auto value = nth_child(*param, 2) ? find_first(*nth_child(*param, 2), "kExpression") : nullptr;
+            if (name == nullptr) continue;
+            param_overrides.push_back({symbol_text(*name).value_or(""), value ? node_text(*value) : ""});
+        }
+
+        if (by_name.empty()) {
+            // Positional, the values are the list items between the commas, "#8" has no parens at all
+            const json* values = nth_child(*param_list, 1);
+            if (values && tag_of(*values) == "kParenGroup") values = nth_child(*values, 1);
+            const std::string values_tag = values ? tag_of(*values) : "";
+            if (values_tag.size() > 4 && values_tag.compare(values_tag.size() - 4, 4, "List") == 0) {
+                for (const auto& value : *get_child_array(*values)) {
+                    if (!value.is_null() && tag_of(value) != ",") param_overrides.push_back({"", node_text(value)});
+                }
+            } else if (values) {
+                param_overrides.push_back({"", node_text(*values)});
+            }
+        }
+    }
+
+
     // Get instantiation name
     auto instance_veriable_list = find_first(module_inst_json, "kGateInstanceRegisterVariableList");
     if (instance_veriable_list == nullptr) return;
     auto instantiation_name = find_first(*instance_veriable_list, "SymbolIdentifier")->find("text")->get<std::string>();
-    // TODO: Parse port list
+
+    // Port connections, ".d(w_0)", ".clk" for ".clk(clk)" or "w_0" in port order
+    std::vector<SV::InstancePort> port_mapping;
+    if (auto port_list = find_first(*instance_veriable_list, "kPortActualList")) {
+        for (const auto& port : *get_child_array(*port_list)) {
+            if (port.is_null()) continue;
+            const std::string port_tag = tag_of(port);
+            if (port_tag == "kActualNamedPort") {
+                auto name = nth_child(port, 1);
+                if (name == nullptr) continue;
+                SV::InstancePort connection{SV::NAMED, symbol_text(*name).value_or(""), ""};
+                auto paren = nth_child(port, 2);
+                if (paren == nullptr)                      connection.signal_name = connection.port_name;
+                else if (auto value = nth_child(*paren, 1)) connection.signal_name = node_text(*value);
+                port_mapping.push_back(std::move(connection));
+            } else if (port_tag == "kActualPositionalPort") {
+                port_mapping.push_back({SV::POSITIONAL, "", node_text(port)});
+            }
+        }
+    }
 
     auto instantiated_module_node = SymTable::symbol_table_lookup(global_module_symbol_table, module_name);
     if (instantiated_module_node == nullptr) return;
     instantiated_module_node->references.push_back(module);
 
-    SV::ModuleInstance instance {.module = instantiated_module_node, .instance_name = instantiation_name};
+    SV::ModuleInstance instance;
+    instance.module        = instantiated_module_node;
+    instance.instance_name = instantiation_name;
+    instance.parent        = module;
+    if (auto span = node_range(module_inst_json)) instance.span = *span;
+    instance.param_overrides = std::move(param_overrides);
+    instance.port_mapping    = std::move(port_mapping);
+    // Declarations are all parsed before any instantiation, so the ports are known by now
+    const auto& module_ports = instantiated_module_node->ports;
+    for (size_t i = 0; i < instance.port_mapping.size(); i++) {
+        auto& connection = instance.port_mapping[i];
+        if (connection.port_type == SV::POSITIONAL && i < module_ports.size()) connection.port_name = module_ports[i].name;
+    }
+
+    // An array or a loop stays one instance with a range, its elements are named when they are looked at
+    std::optional<SV::InstanceRange> range = loop ? std::optional<SV::InstanceRange>(*loop) : ParseInstanceArray(*instance_veriable_list);
+    if (range) {
+        instance.range = int32_t(module->instance_ranges.size());
+        module->instance_ranges.push_back(std::move(*range));
+    }
     module->dependencies.push_back(instance);
 }
 
+// Instantiations below node, loop is the innermost generate for loop they are in. Nested loops are
+// only ranged over the innermost one.
+static void ParseInstantiationsUnder(SV::Module* module, const json& node, const SV::InstanceRange* loop) {
+    if (!node.is_object()) return;
+
+    const std::string tag = tag_of(node);
+    if (tag == "kInstantiationBase") {
+        ParseModuleInstantiation(module, node, loop);
+        return;
+    }
+
+    std::optional<SV::InstanceRange> inner;
+    if (tag == "kLoopGenerateConstruct" && (inner = ParseLoopGenerate(node))) loop = &*inner;
+
+    if (auto child_array = get_child_array(node)) {
+        for (const auto& child : *child_array) {
+            if (!child.is_null()) ParseInstantiationsUnder(module, child, loop);
+        }
+    }
+}
+
 static void ParseModuleInstantiationsFromModule(SV::Module* module) {
     if (!module->module_cst->is_object()) return;
 
-    std::vector<const json*> module_instantiations;
-    collect_all(*module->module_cst, "kInstantiationBase", module_instantiations);
+    ParseInstantiationsUnder(module, *module->module_cst, nullptr);
 
-    for (const auto& module_inst : module_instantiations) {
-        ParseModuleInstantiation(module, *module_inst);
+    // Ranges with the default parameters, elaboration resolves them again per specialization
+    if (module->instance_ranges.empty()) return;
+    const std::vector<std::string> values = elab::DefaultValues(module);
+    const elab::ParamLookup        scope  = elab::ModuleScope(module, values);
+    for (auto& range : module->instance_ranges) {
+        range.resolved = elab::ResolveRange(range, scope, range.first, range.last);
     }
 }
 
@@ -286,7 +557,81 @@ static void ParseModuleInstantiationsFromModule(SV::Module* module) {
 //     delete node;
 // }
 
+SV::Module* ParseDesignDB(const db::DesignDB& design) {
+    global_module_symbol_table = new SymTable::ModuleSymbolTable;
+    return ReadDesignDB(design, global_module_symbol_table);
+}
+
+SV::Module* ReadDesignDB(const db::DesignDB& design, SymTable::ModuleSymbolTable* table) {
+    PROFILE_SCOPE("ReadDesignDB");
+
+    std::vector<SV::Module*> modules(design.NumModules());
+    for (uint32_t i = 0; i < design.NumModules(); i++) {
+        const db::ModuleRecord& record = design.Module(i);
+
+        SV::Module* module = new SV::Module;
+        module->name = std::string(design.String(record.name));
+        if (record.file != db::kNone) module->source_file = std::string(design.String(design.File(record.file).path));
+        module->span = Range(record.span_start, record.span_end);
+        for (uint32_t k = record.first_param; k < record.first_param + record.num_params; k++) {
+            const db::ParamRecord& param = design.Param(k);
+            module->parameters.push_back({std::string(design.String(param.name)), std::string(design.String(param.value)), SV::LOGIC, param.local != 0});
+        }
+        for (uint32_t k = record.first_port; k < record.first_port + record.num_ports; k++) {
+            const db::PortRecord& record_port = design.Port(k);
+            SV::Port port;
+            port.name      = std::string(design.String(record_port.name));
+            port.port_type = SV::PortType(record_port.type);
+            module->ports.push_back(std::move(port));
+        }
+
+        modules[i] = module;
+        SymTable::symbol_table_insert(table, module);
+    }
+
+    for (uint32_t i = 0; i < design.NumModules(); i++) {
+        const db::ModuleRecord& record = design.Module(i);
+        modules[i]->dependencies.reserve(record.num_instances);
+        for (uint32_t k = record.first_instance; k < record.first_instance + record.num_instances; k++) {
+            const db::InstanceRecord& inst = design.Instance(k);
+            SV::ModuleInstance instance;
+            instance.module        = modules[inst.module];
+            instance.instance_name = std::string(design.String(inst.name));
+            instance.parent        = modules[i];
+            instance.span          = Range(inst.span_start, inst.span_end);
+            for (uint32_t p = inst.first_param; p < inst.first_param + inst.num_params; p++) {
+                const db::ParamRecord& param = design.Param(p);
+                instance.param_overrides.push_back({std::string(design.String(param.name)), std::string(design.String(param.value))});
+            }
+            for (uint32_t p = inst.first_port; p < inst.first_port + inst.num_ports; p++) {
+                const db::PortRecord& connection = design.Port(p);
+                instance.port_mapping.push_back({SV::PortInstanceType(connection.type), std::string(design.String(connection.name)),
+                                                 std::string(design.String(connection.signal))});
+            }
+            if (inst.range != db::kNone) {
+                const db::RangeRecord& r = design.Range(inst.range);
+                SV::InstanceRange range;
+                range.first_expr = std::string(design.String(r.first_expr));
+                range.last_expr  = std::string(design.String(r.last_expr));
+                range.scope      = std::string(design.String(r.scope));
+                range.step       = r.step;
+                range.first      = r.first;
+                range.last       = r.last;
+                range.resolved   = r.resolved != 0;
+                instance.range   = int32_t(modules[i]->instance_ranges.size());
+                modules[i]->instance_ranges.push_back(std::move(range));
+            }
+            modules[i]->dependencies.push_back(instance);
+            modules[inst.module]->references.push_back(modules[i]);
+        }
+    }
+
+    return design.Top() == db::kNone ? nullptr : modules[design.Top()];
+}
+
 [[nodiscard]] SV::Module* ParseCST(const json& cst_json) {
+    PROFILE_SCOPE("ParseCST");
+
     // Check that we have a valid json
     if (!cst_json.is_object()) return nullptr;
 
@@ -299,6 +644,10 @@ static void ParseModuleInstantiationsFromModule(SV::Module* module) {
     for (auto module : global_module_symbol_table->modules) {
         ParseModuleInstantiationsFromModule(module);
     }
+    // Callers drop the JSON once the hierarchy is built, nothing may point into it after that
+    for (auto module : global_module_symbol_table->modules) {
+        module->module_cst = nullptr;
+    }
 
     std::cout << "symbol table size: " << global_module_symbol_table->modules.size() << "\n";
 
@@ -309,8 +658,8 @@ static void ParseModuleInstantiationsFromModule(SV::Module* module) {
             std::cout << "    - " << reference->name << "\n";
         }
         std::cout << "Depends on: \n";
-        for (auto dependency: module->dependencies) {
-            std::cout << "    - " << dependency.module->name << " (" << dependency.instance_name << "0)" << "\n";
+        for (const auto& dependency: module->dependencies) {
+            std::cout << "    - " << dependency.module->name << " (" << SV::InstanceLabel(dependency) << ")" << "\n";
         }
     }
 
@@ -0,0 +1,80 @@
+#include "damage_tracker.h"
+
+namespace graphics {
+
+void DamageTracker::reset(int width, int height) {
+    bounds = SkIRect::MakeWH(width, height);
+    rects.clear();
+    full = true;
+}
+
+void DamageTracker::add(const SkIRect& rect) {
+    if (full) return;
+
+    SkIRect clipped = rect;
+    if (!clipped.intersect(bounds)) return;
+    rects.push_back(clipped);
+}
+
+void DamageTracker::add(const SkRect& rect) {
+    // Round out so anti-aliased edges are included
+    add(rect.roundOut());
+}
+
+void DamageTracker::addFull() {
+    full = true;
+    rects.clear();
+}
+
+void DamageTracker::merge(const DamageTracker& other) {
+    if (other.full) {
+        addFull();
+        return;
+    }
+    for (const auto& r : other.rects) add(r);
+}
+
+void DamageTracker::finalize() {
+    if (!full) {
+        // Merge rects that overlap, since uploading the same pixels twice is a waste
+        bool merged = true;
+        while (merged) {
+            merged = false;
+            for (size_t i = 0; i < rects.size() && !merged; i++) {
+                for (size_t j = i + 1; j < rects.size(); j++) {
+                    if (SkIRect::Intersects(rects[i], rects[j])) {
+                        rects[i].join(rects[j]);
+                        rects.erase(rects.begin() + j);
+                        merged = true;
+                        break;
+                    }
+                }
+            }
+        }
+
+        // Too many small uploads costs more than one bigger one
+        if (rects.size() > kMaxRects) {
+            SkIRect all = rects[0];
+            for (const auto& r : rects) all.join(r);
+            rects.assign(1, all);
+        }
+
+        int64_t damaged_area = 0;
+        for (const auto& r : rects) damaged_area += int64_t(r.width()) * r.height();
+        const int64_t screen_area = int64_t(bounds.width()) * bounds.height();
+        if (damaged_area > screen_area * kFullScreenFraction) {
+            full = true;
+        }
+    }
+
+    if (full) {
+        rects.assign(1, bounds);
+    }
+}
+
+void DamageTracker::clear() {
+    rects.clear();
+    full = false;
+}
+
+}
@@ -0,0 +1,341 @@
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <unordered_map>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "design_db.h"
+#include "line_index.h"
+#include "profiler.h"
+
+namespace db {
+
+namespace {
+
+uint32_t HashName(std::string_view name) {
+    // FNV-1a
+    uint32_t h = 2166136261u;
+    for (char c : name) {
+        h ^= uint8_t(c);
+        h *= 16777619u;
+    }
+    return h;
+}
+
+uint64_t Align8(uint64_t x) {
+    return (x + 7) & ~uint64_t(7);
+}
+
+size_t LineOf(const std::string& file, int offset) {
+    auto lines = SV::GetFileLineIndex(file);
+    return lines ? lines->Locate(size_t(std::max(0, offset))).line : 0;
+}
+
+class StringTable {
+public:
+    StringRef add(std::string_view s) {
+        auto it = offsets.find(std::string(s));
+        if (it != offsets.end()) return {it->second, uint32_t(s.size())};
+
+        const uint32_t offset = uint32_t(data.size());
+        data.append(s.data(), s.size());
+        offsets.emplace(std::string(s), offset);
+        return {offset, uint32_t(s.size())};
+    }
+
+    std::string data;
+
+private:
+    std::unordered_map<std::string, uint32_t> offsets;
+};
+
+template <typename T>
+void WriteAt(std::string& out, uint64_t offset, const std::vector<T>& records) {
+    if (!records.empty()) std::memcpy(&out[offset], records.data(), records.size() * sizeof(T));
+}
+
+} // namespace
+
+bool StatFile(const std::string& path, uint64_t& size, int64_t& mtime_ns) {
+    struct stat st;
+    if (stat(path.c_str(), &st) != 0) return false;
+    size     = uint64_t(st.st_size);
+    mtime_ns = int64_t(st.st_mtim.tv_sec) * 1000000000 + st.st_mtim.tv_nsec;
+    return true;
+}
+
+bool WriteDesignDB(const std::string& path, const std::vector<std::string>& files,
+                   const SymTable::ModuleSymbolTable* table, const SV::Module* top) {
+    PROFILE_SCOPE("WriteDesignDB");
+    if (!table) return false;
+
+    StringTable                 strings;
+    std::vector<FileRecord>     file_records;
+    std::vector<ModuleRecord>   module_records;
+    std::vector<InstanceRecord> instance_records;
+    std::vector<ParamRecord>    param_records;
+    std::vector<RangeRecord>    range_records;
+    std::vector<PortRecord>     port_records;
+    std::vector<uint32_t>       references;
+
+    std::unordered_map<std::string, uint32_t> file_index;
+    for (const auto& file : files) {
+        FileRecord f{strings.add(file), 0, 0};
+        StatFile(file, f.size, f.mtime_ns);
+        file_index.emplace(file, uint32_t(file_records.size()));
+        file_records.push_back(f);
+    }
+
+    auto module_index = [&](const SV::Module* m) {
+        auto it = table->hashmap.find(m->name);
+        return it == table->hashmap.end() ? kNone : uint32_t(it->second);
+    };
+
+    for (const SV::Module* m : table->modules) {
+        auto file = file_index.find(m->source_file);
+
+        ModuleRecord r{};
+        r.name            = strings.add(m->name);
+        r.file            = file == file_index.end() ? kNone : file->second;
+        r.line            = uint32_t(LineOf(m->source_file, m->span.start));
+        r.span_start      = m->span.start;
+        r.span_end        = m->span.end;
+        r.first_instance  = uint32_t(instance_records.size());
+        r.num_instances   = uint32_t(m->dependencies.size());
+        r.first_reference = uint32_t(references.size());
+        r.num_references  = uint32_t(m->references.size());
+        r.first_param     = uint32_t(param_records.size());
+        r.num_params      = uint32_t(m->parameters.size());
+        r.first_port      = uint32_t(port_records.size());
+        r.num_ports       = uint32_t(m->ports.size());
+        module_records.push_back(r);
+
+        for (const auto& param : m->parameters) {
+            param_records.push_back({strings.add(param.name), strings.add(param.default_value), uint32_t(param.local)});
+        }
+        for (const auto& port : m->ports) {
+            port_records.push_back({strings.add(port.name), strings.add(""), uint32_t(port.port_type)});
+        }
+
+        // Same order as dependencies, so an instance index minus first_instance is a dependency index
+        for (const auto& dep : m->dependencies) {
+            InstanceRecord inst{};
+            inst.name        = strings.add(dep.instance_name);
+            inst.module      = module_index(dep.module);
+            inst.parent      = uint32_t(module_records.size() - 1);
+            inst.line        = uint32_t(LineOf(m->source_file, dep.span.start));
+            inst.span_start  = dep.span.start;
+            inst.span_end    = dep.span.end;
+            inst.first_param = uint32_t(param_records.size());
+            inst.num_params  = uint32_t(dep.param_overrides.size());
+            inst.range       = kNone;
+            inst.first_port  = uint32_t(port_records.size());
+            inst.num_ports   = uint32_t(dep.port_mapping.size());
+            if (dep.range >= 0) {
+                const SV::InstanceRange& r = m->instance_ranges[dep.range];
+                inst.range = uint32_t(range_records.size());
+                range_records.push_back({strings.add(r.first_expr), strings.add(r.last_expr), strings.add(r.scope),
+                                         r.step, r.first, r.last, uint32_t(r.resolved)});
+            }
+            instance_records.push_back(inst);
+
+            for (const auto& param : dep.param_overrides) {
+                param_records.push_back({strings.add(param.name), strings.add(param.value), 0});
+            }
+            for (const auto& connection : dep.port_mapping) {
+                port_records.push_back({strings.add(connection.port_name), strings.add(connection.signal_name), uint32_t(connection.port_type)});
+            }
+        }
+        for (const SV::Module* ref : m->references) references.push_back(module_index(ref));
+    }
+
+    // Power of two, at most half full
+    uint32_t num_buckets = 1;
+    while (num_buckets < module_records.size() * 2) num_buckets <<= 1;
+    std::vector<uint32_t> buckets(num_buckets, kNone);
+    for (uint32_t i = 0; i < module_records.size(); i++) {
+        uint32_t b = HashName(table->modules[i]->name) & (num_buckets - 1);
+        while (buckets[b] != kNone) b = (b + 1) & (num_buckets - 1);
+        buckets[b] = i;
+    }
+
+    Header header{};
+    std::memcpy(header.magic, kMagic, sizeof(kMagic));
+    header.version           = kVersion;
+    header.top_module        = top ? module_index(top) : kNone;
+    header.num_files         = uint32_t(file_records.size());
+    header.num_modules       = uint32_t(module_records.size());
+    header.num_instances     = uint32_t(instance_records.size());
+    header.num_references    = uint32_t(references.size());
+    header.num_buckets       = num_buckets;
+    header.num_params        = uint32_t(param_records.size());
+    header.num_ranges        = uint32_t(range_records.size());
+    header.num_ports         = uint32_t(port_records.size());
+    header.files_offset      = Align8(sizeof(Header));
+    header.modules_offset    = Align8(header.files_offset + file_records.size() * sizeof(FileRecord));
+    header.instances_offset  = Align8(header.modules_offset + module_records.size() * sizeof(ModuleRecord));
+    header.params_offset     = Align8(header.instances_offset + instance_records.size() * sizeof(InstanceRecord));
+    header.ranges_offset     = Align8(header.params_offset + param_records.size() * sizeof(ParamRecord));
+    header.ports_offset      = Align8(header.ranges_offset + range_records.size() * sizeof(RangeRecord));
+    header.references_offset = Align8(header.ports_offset + port_records.size() * sizeof(PortRecord));
+    header.buckets_offset    = Align8(header.references_offset + references.size() * sizeof(uint32_t));
+    header.strings_offset    = Align8(header.buckets_offset + buckets.size() * sizeof(uint32_t));
+    header.strings_size      = strings.data.size();
+    header.total_size        = header.strings_offset + header.strings_size;
+
+    std::string out(header.total_size, '\0');
+    std::memcpy(&out[0], &header, sizeof(Header));
+    WriteAt(out, header.files_offset, file_records);
+    WriteAt(out, header.modules_offset, module_records);
+    WriteAt(out, header.instances_offset, instance_records);
+    WriteAt(out, header.params_offset, param_records);
+    WriteAt(out, header.ranges_offset, range_records);
+    WriteAt(out, header.ports_offset, port_records);
+    WriteAt(out, header.references_offset, references);
+    WriteAt(out, header.buckets_offset, buckets);
+    if (!strings.data.empty()) std::memcpy(&out[header.strings_offset], strings.data.data(), strings.data.size());
+
+    const std::string tmp = path + ".tmp";
+    {
+        std::ofstream f(tmp, std::ios::binary | std::ios::trunc);
+        if (!f) return false;
+        f.write(out.data(), std::streamsize(out.size()));
+        if (!f) return false;
+    }
+    std::error_code ec;
+    std::filesystem::rename(tmp, path, ec);
+    return !ec;
+}
+
+std::unique_ptr<DesignDB> DesignDB::Open(const std::string& path) {
+    PROFILE_SCOPE("DesignDB::Open");
+
+    const int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) return nullptr;
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || size_t(st.st_size) < sizeof(Header)) {
+        close(fd);
+        return nullptr;
+    }
+
+    void* mapping = mmap(nullptr, size_t(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (mapping == MAP_FAILED) return nullptr;
+
+    std::unique_ptr<DesignDB> db(new DesignDB);
+    db->mapping      = mapping;
+    db->mapping_size = size_t(st.st_size);
+
+    const char*   base = static_cast<const char*>(mapping);
+    const Header* h    = reinterpret_cast<const Header*>(base);
+    if (std::memcmp(h->magic, kMagic, sizeof(kMagic)) != 0 || h->version != kVersion || h->total_size != db->mapping_size) {
+        return nullptr;
+    }
+
+    auto fits = [&](uint64_t offset, uint64_t count, uint64_t size) {
+        return offset % 8 == 0 && offset <= db->mapping_size && count <= (db->mapping_size - offset) / size;
+    };
+    if (!fits(h->files_offset, h->num_files, sizeof(FileRecord)) ||
+        !fits(h->modules_offset, h->num_modules, sizeof(ModuleRecord)) ||
+        !fits(h->instances_offset, h->num_instances, sizeof(InstanceRecord)) ||
+        !fits(h->params_offset, h->num_params, sizeof(ParamRecord)) ||
+        !fits(h->ranges_offset, h->num_ranges, sizeof(RangeRecord)) ||
+        !fits(h->ports_offset, h->num_ports, sizeof(PortRecord)) ||
+        !fits(h->references_offset, h->num_references, sizeof(uint32_t)) ||
+        !fits(h->buckets_offset, h->num_buckets, sizeof(uint32_t)) ||
+        !fits(h->strings_offset, h->strings_size, 1) ||
+        h->num_buckets == 0 || (h->num_buckets & (h->num_buckets - 1)) != 0) {
+        return nullptr;
+    }
+
+    db->header     = h;
+    db->files      = reinterpret_cast<const FileRecord*>(base + h->files_offset);
+    db->modules    = reinterpret_cast<const ModuleRecord*>(base + h->modules_offset);
+    db->instances  = reinterpret_cast<const InstanceRecord*>(base + h->instances_offset);
+    db->params     = reinterpret_cast<const ParamRecord*>(base + h->params_offset);
+    db->ranges     = reinterpret_cast<const RangeRecord*>(base + h->ranges_offset);
+    db->ports      = reinterpret_cast<const PortRecord*>(base + h->ports_offset);
+    db->references = reinterpret_cast<const uint32_t*>(base + h->references_offset);
+    db->buckets    = reinterpret_cast<const uint32_t*>(base + h->buckets_offset);
+    db->strings    = base + h->strings_offset;
+
+    // Every index and string has to stay inside the file, so the accessors never have to check
+    auto string_ok = [&](const StringRef& s) { return uint64_t(s.offset) + s.length <= h->strings_size; };
+    auto index_ok  = [](uint32_t i, uint32_t n) { return i == kNone || i < n; };
+    if (!index_ok(h->top_module, h->num_modules)) return nullptr;
+    for (uint32_t i = 0; i < h->num_files; i++) {
+        if (!string_ok(db->files[i].path)) return nullptr;
+    }
+    for (uint32_t i = 0; i < h->num_modules; i++) {
+        const ModuleRecord& m = db->modules[i];
+        if (!string_ok(m.name) || !index_ok(m.file, h->num_files) ||
+            uint64_t(m.first_instance) + m.num_instances > h->num_instances ||
+            uint64_t(m.first_reference) + m.num_references > h->num_references ||
+            uint64_t(m.first_param) + m.num_params > h->num_params ||
+            uint64_t(m.first_port) + m.num_ports > h->num_ports) {
+            return nullptr;
+        }
+    }
+    for (uint32_t i = 0; i < h->num_instances; i++) {
+        const InstanceRecord& inst = db->instances[i];
+        if (!string_ok(inst.name) || inst.module >= h->num_modules || inst.parent >= h->num_modules ||
+            uint64_t(inst.first_param) + inst.num_params > h->num_params || !index_ok(inst.range, h->num_ranges) ||
+            uint64_t(inst.first_port) + inst.num_ports > h->num_ports) {
+            return nullptr;
+        }
+    }
+    for (uint32_t i = 0; i < h->num_params; i++) {
+        if (!string_ok(db->params[i].name) || !string_ok(db->params[i].value)) return nullptr;
+    }
+    for (uint32_t i = 0; i < h->num_ranges; i++) {
+        const RangeRecord& r = db->ranges[i];
+        if (!string_ok(r.first_expr) || !string_ok(r.last_expr) || !string_ok(r.scope)) return nullptr;
+    }
+    for (uint32_t i = 0; i < h->num_ports; i++) {
+        if (!string_ok(db->ports[i].name) || !string_ok(db->ports[i].signal)) return nullptr;
+    }
+    for (uint32_t i = 0; i < h->num_references; i++) {
+        if (db->references[i] >= h->num_modules) return nullptr;
+    }
+    for (uint32_t i = 0; i < h->num_buckets; i++) {
+        if (!index_ok(db->buckets[i], h->num_modules)) return nullptr;
+    }
+
+    return db;
+}
+
+DesignDB::~DesignDB() {
+    if (mapping) munmap(mapping, mapping_size);
+}
+
+uint32_t DesignDB::FindModule(std::string_view name) const {
+    const uint32_t mask = header->num_buckets - 1;
+    for (uint32_t b = HashName(name) & mask, probes = 0; probes < header->num_buckets; b = (b + 1) & mask, probes++) {
+        const uint32_t m = buckets[b];
+        if (m == kNone) return kNone;
+        if (String(modules[m].name) == name) return m;
+    }
+    return kNone;
+}
+
+bool DesignDB::UpToDate(const std::vector<std::string>& resolved_paths) const {
+    if (resolved_paths.size() != NumFiles()) return false;
+
+    for (uint32_t i = 0; i < NumFiles(); i++) {
+        const FileRecord& f = files[i];
+        if (String(f.path) != resolved_paths[i]) return false;
+
+        uint64_t size;
+        int64_t  mtime_ns;
+        if (!StatFile(resolved_paths[i], size, mtime_ns) || size != f.size || mtime_ns != f.mtime_ns) return false;
+    }
+    return true;
+}
+
+}
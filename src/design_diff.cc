@@ -0,0 +1,222 @@
+#include <functional>
+#include <unordered_set>
+
+#include "design_diff.h"
+#include "mem_stats.h"
+#include "profiler.h"
+
+namespace diff {
+
+namespace {
+
+// FNV-1a, fed field by field
+struct Hasher {
+    uint64_t h = 1469598103934665603ull;
+
+    void add(const void* data, size_t size) {
+        const uint8_t* p = static_cast<const uint8_t*>(data);
+        for (size_t i = 0; i < size; i++) {
+            h ^= p[i];
+            h *= 1099511628211ull;
+        }
+    }
+    void add(const std::string& s) {
+        add(s.data(), s.size());
+        add(uint64_t(s.size()));
+    }
+    void add(uint64_t x) { add(&x, sizeof(x)); }
+};
+
+// Everything about one instantiation that is written in its parent
+uint64_t InstanceHash(const SV::ModuleInstance& instance) {
+    Hasher h;
+    h.add(instance.instance_name);
+    h.add(instance.module ? instance.module->name : std::string());
+    for (const auto& param : instance.param_overrides) {
+        h.add(param.name);
+        h.add(param.value);
+    }
+    for (const auto& connection : instance.port_mapping) {
+        h.add(connection.port_name);
+        h.add(connection.signal_name);
+        h.add(uint64_t(connection.port_type));
+    }
+    if (instance.range >= 0 && instance.parent) {
+        const SV::InstanceRange& range = instance.parent->instance_ranges[instance.range];
+        h.add(range.first_expr);
+        h.add(range.last_expr);
+        h.add(range.scope);
+        h.add(uint64_t(int64_t(range.step)));
+    }
+    return h.h;
+}
+
+uint64_t LocalHash(const SV::Module* module) {
+    Hasher h;
+    h.add(module->name);
+    for (const auto& port : module->ports) {
+        h.add(port.name);
+        h.add(uint64_t(port.port_type) << 32 | uint64_t(port.data_type));
+        h.add(uint64_t(port.has_packed_dims) << 1 | uint64_t(port.has_unpacked_dims));
+        h.add(uint64_t(uint32_t(port.packed_dim.start)) << 32 | uint32_t(port.packed_dim.end));
+        h.add(uint64_t(uint32_t(port.inpacked_dim.start)) << 32 | uint32_t(port.inpacked_dim.end));
+    }
+    for (const auto& param : module->parameters) {
+        h.add(param.name);
+        h.add(param.default_value);
+        h.add(uint64_t(param.local));
+    }
+    for (const auto& dep : module->dependencies) h.add(InstanceHash(dep));
+    return h.h;
+}
+
+} // namespace
+
+const char* StatusName(Status status) {
+    switch (status) {
+        case DIFF_SAME:     return "same";
+        case DIFF_ADDED:    return "added";
+        case DIFF_REMOVED:  return "removed";
+        case DIFF_MODIFIED: return "modified";
+        default:            return "?";
+    }
+}
+
+void MerkleHashes::Build(const SymTable::ModuleSymbolTable* table) {
+    PROFILE_SCOPE("MerkleHashes::Build");
+
+    hashes.clear();
+    if (!table) return;
+    hashes.reserve(table->modules.size());
+
+    // Children first. A module that (indirectly) instantiates itself uses the local hash of the repeat,
+    // which is all that is known of it at that point.
+    std::unordered_set<const SV::Module*> in_progress;
+    std::function<const ModuleHash&(const SV::Module*)> visit = [&](const SV::Module* module) -> const ModuleHash& {
+        auto it = hashes.find(module);
+        if (it != hashes.end()) return it->second;
+
+        ModuleHash& hash = hashes[module];
+        hash.local = LocalHash(module);
+        in_progress.insert(module);
+
+        Hasher tree;
+        tree.add(hash.local);
+        for (const auto& dep : module->dependencies) {
+            if (!dep.module) continue;
+            tree.add(in_progress.count(dep.module) ? hashes[dep.module].local : visit(dep.module).tree);
+        }
+
+        in_progress.erase(module);
+        ModuleHash& done = hashes[module]; // visiting children may have rehashed the map
+        done.tree = tree.h;
+        return done;
+    };
+    for (const SV::Module* module : table->modules) visit(module);
+}
+
+ModuleHash MerkleHashes::Get(const SV::Module* module) const {
+    auto it = hashes.find(module);
+    return it == hashes.end() ? ModuleHash() : it->second;
+}
+
+size_t MerkleHashes::MemoryBytes() const {
+    return hashes.bucket_count() * sizeof(void*) + hashes.size() * (sizeof(std::pair<const SV::Module* const, ModuleHash>) + 2 * sizeof(void*));
+}
+
+void HierarchyDiff::Build(const SV::Module* old_top, const SymTable::ModuleSymbolTable* old_table,
+                          const SV::Module* new_top, const SymTable::ModuleSymbolTable* new_table) {
+    PROFILE_SCOPE("HierarchyDiff::Build");
+
+    diffs.clear();
+    memo.clear();
+    modules.clear();
+    top = nullptr;
+
+    old_hashes.Build(old_table);
+    new_hashes.Build(new_table);
+
+    // Modules by name, including the ones nothing instantiates
+    if (old_table && new_table) {
+        for (const SV::Module* m : new_table->modules) {
+            const SV::Module* old = SymTable::symbol_table_lookup(old_table, m->name);
+            if (!old) {
+                modules.push_back({m->name, DIFF_ADDED});
+            } else if (old_hashes.Get(old).local != new_hashes.Get(m).local) {
+                modules.push_back({m->name, DIFF_MODIFIED});
+            }
+        }
+        for (const SV::Module* m : old_table->modules) {
+            if (!SymTable::symbol_table_lookup(new_table, m->name)) modules.push_back({m->name, DIFF_REMOVED});
+        }
+    }
+
+    if (!old_top || !new_top) return;
+    if (old_hashes.Get(old_top).tree == new_hashes.Get(new_top).tree) {
+        diffs.push_back({DIFF_SAME, old_top, new_top, false, {}});
+        top = &diffs.back();
+        return;
+    }
+    top = compare(old_top, new_top);
+}
+
+const ModuleDiff* HierarchyDiff::compare(const SV::Module* old_module, const SV::Module* new_module) {
+    auto it = memo.find({old_module, new_module});
+    if (it != memo.end()) return it->second;
+
+    // In the memo before the children are compared, so comparing a module that instantiates itself terminates
+    diffs.push_back({DIFF_MODIFIED, old_module, new_module, false, {}});
+    ModuleDiff& d = diffs.back();
+    memo.emplace(std::make_pair(old_module, new_module), &d);
+    d.module_changed = old_hashes.Get(old_module).local != new_hashes.Get(new_module).local;
+
+    // Instances are matched by name, what is left over on either side was added or removed
+    std::unordered_map<std::string, int32_t> old_by_name;
+    for (size_t i = 0; i < old_module->dependencies.size(); i++) {
+        old_by_name.emplace(SV::InstanceLabel(old_module->dependencies[i]), int32_t(i));
+    }
+    std::vector<bool> matched(old_module->dependencies.size(), false);
+
+    std::vector<ChildDiff> children(new_module->dependencies.size());
+    for (size_t i = 0; i < new_module->dependencies.size(); i++) {
+        const SV::ModuleInstance& dep = new_module->dependencies[i];
+        ChildDiff& child = children[i];
+        child.new_dep = int32_t(i);
+
+        auto found = old_by_name.find(SV::InstanceLabel(dep));
+        if (found == old_by_name.end() || matched[found->second] || !dep.module) {
+            child.status = DIFF_ADDED;
+            continue;
+        }
+        matched[found->second] = true;
+        child.old_dep = found->second;
+
+        const SV::ModuleInstance& old_dep = old_module->dependencies[found->second];
+        if (!old_dep.module) {
+            child.status = DIFF_ADDED;
+            continue;
+        }
+        const bool same = InstanceHash(old_dep) == InstanceHash(dep) &&
+                          old_hashes.Get(old_dep.module).tree == new_hashes.Get(dep.module).tree;
+        if (!same) {
+            child.status = DIFF_MODIFIED;
+            child.diff   = compare(old_dep.module, dep.module);
+        }
+    }
+    for (size_t i = 0; i < matched.size(); i++) {
+        if (!matched[i]) children.push_back({DIFF_REMOVED, int32_t(i), -1, nullptr});
+    }
+
+    d.children = std::move(children);
+    return &d;
+}
+
+size_t HierarchyDiff::MemoryBytes() const {
+    size_t bytes = old_hashes.MemoryBytes() + new_hashes.MemoryBytes();
+    bytes += diffs.size() * sizeof(ModuleDiff) + memo.size() * (sizeof(std::pair<const std::pair<const SV::Module*, const SV::Module*>, const ModuleDiff*>) + 4 * sizeof(void*));
+    for (const auto& d : diffs) bytes += d.children.capacity() * sizeof(ChildDiff);
+    for (const auto& m : modules) bytes += sizeof(ModuleChange) + size_t(mem::StringBytes(m.name));
+    return bytes;
+}
+
+}
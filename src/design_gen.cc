@@ -0,0 +1,126 @@
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <random>
+#include <stdexcept>
+
+#include "design_gen.h"
+
+namespace gen {
+
+namespace {
+
+std::string ModuleName(size_t level, size_t index) {
+    return "l" + std::to_string(level) + "_m" + std::to_string(index);
+}
+
+// Instances written on a level, saturating instead of overflowing for absurd options
+uint64_t InstancesOnLevel(size_t fanout, size_t level) {
+    uint64_t n = 1;
+    for (size_t i = 0; i < level; i++) {
+        if (n > UINT64_MAX / std::max<size_t>(fanout, 1)) return UINT64_MAX;
+        n *= fanout;
+    }
+    return n;
+}
+
+void WriteModule(std::ostream& out, const std::string& name, const std::vector<std::string>& children,
+                 size_t filler_lines) {
+    out << "module " << name << " (\n"
+        << "    input  logic        clk,\n"
+        << "    input  logic [31:0] d,\n"
+        << "    output logic [31:0] q\n"
+        << ");\n";
+
+    for (size_t i = 0; i < filler_lines; i++) {
+        out << "    logic [31:0] pad_" << i << " = 32'd" << i << ";\n";
+    }
+
+    if (children.empty()) {
+        out << "    always_ff @(posedge clk) q <= d + 32'd1;\n";
+    } else {
+        for (size_t i = 0; i < children.size(); i++) out << "    logic [31:0] w_" << i << ";\n";
+        for (size_t i = 0; i < children.size(); i++) {
+            const std::string in = i == 0 ? "d" : "w_" + std::to_string(i - 1);
+            out << "    " << children[i] << " u_" << i << " (.clk(clk), .d(" << in << "), .q(w_" << i << "));\n";
+        }
+        out << "    assign q = w_" << children.size() - 1 << ";\n";
+    }
+
+    out << "endmodule\n\n";
+}
+
+} // namespace
+
+GenOpts OptsForInstances(uint64_t instances) {
+    GenOpts opts;
+    opts.fanout = 10;
+    opts.depth  = 0;
+    for (uint64_t n = 1; n < instances; n *= opts.fanout) opts.depth++;
+    opts.depth   = std::max<size_t>(opts.depth, 1);
+    opts.modules = 1 + opts.depth * 50;
+    return opts;
+}
+
+GeneratedDesign GenerateDesign(const GenOpts& opts, const std::string& out_dir) {
+    namespace fs = std::filesystem;
+    fs::create_directories(out_dir);
+    const std::string dir = fs::absolute(out_dir).string();
+
+    // Modules per level: one top, the rest spread evenly, never more than there are instances on a level
+    std::vector<size_t> level_size(opts.depth + 1, 1);
+    const size_t rest = opts.modules > 0 ? opts.modules - 1 : 0;
+    for (size_t l = 1; l <= opts.depth; l++) {
+        const size_t share = rest / opts.depth + (l <= rest % opts.depth ? 1 : 0);
+        level_size[l] = size_t(std::clamp<uint64_t>(share, 1, std::max<uint64_t>(1, InstancesOnLevel(opts.fanout, l))));
+    }
+
+    std::mt19937_64                        rng(opts.seed);
+    std::uniform_real_distribution<double> chance(0.0, 1.0);
+
+    GeneratedDesign design;
+    design.top = ModuleName(0, 0);
+
+    std::ofstream out;
+    size_t        in_file = 0;
+    auto next_file = [&] {
+        if (out.is_open()) out.close();
+        const std::string path = dir + "/design_" + std::to_string(design.files.size()) + ".sv";
+        out.open(path, std::ios::trunc);
+        if (!out) throw std::runtime_error("Failed to write: " + path);
+        design.files.push_back(path);
+        in_file = 0;
+    };
+
+    for (size_t l = 0; l <= opts.depth; l++) {
+        // Round robin over the next level until every module there is used once, so the top module
+        // is the only one nothing instantiates
+        size_t turn = 0;
+        for (size_t m = 0; m < level_size[l]; m++) {
+            std::vector<std::string> children;
+            if (l < opts.depth) {
+                for (size_t i = 0; i < opts.fanout; i++) {
+                    const bool   shared = turn >= level_size[l + 1] && chance(rng) < opts.reuse;
+                    const size_t pick   = shared ? 0 : turn++ % level_size[l + 1];
+                    children.push_back(ModuleName(l + 1, pick));
+                }
+            }
+
+            if (!out.is_open() || in_file == std::max<size_t>(opts.modules_per_file, 1)) next_file();
+            WriteModule(out, ModuleName(l, m), children, opts.filler_lines);
+            in_file++;
+            design.modules++;
+        }
+    }
+    out.close();
+
+    for (size_t l = 0; l <= opts.depth; l++) {
+        const uint64_t n = InstancesOnLevel(opts.fanout, l);
+        design.instances = n > UINT64_MAX - design.instances ? UINT64_MAX : design.instances + n;
+    }
+    for (const auto& file : design.files) design.bytes += fs::file_size(file);
+
+    return design;
+}
+
+}
@@ -0,0 +1,500 @@
+#include <algorithm>
+#include <cctype>
+#include <charconv>
+
+#include "elaborate.h"
+#include "mem_stats.h"
+#include "profiler.h"
+
+namespace elab {
+
+namespace {
+
+constexpr size_t kNoParam = SIZE_MAX;
+
+// Longest first, so "<<" is never read as two "<"
+constexpr std::string_view kOperators[] = {
+    "<<<", ">>>", "===", "!==",
+    "**", "<<", ">>", "<=", ">=", "==", "!=", "&&", "||",
+    "+", "-", "*", "/", "%", "<", ">", "&", "|", "^", "~", "!", "?", ":", "(", ")", ",",
+};
+
+// Binary operators from the loosest to the tightest binding
+const std::vector<std::vector<std::string_view>> kBinaryLevels = {
+    {"||"},
+    {"&&"},
+    {"|"},
+    {"^"},
+    {"&"},
+    {"==", "!=", "===", "!=="},
+    {"<", "<=", ">", ">="},
+    {"<<", ">>", "<<<", ">>>"},
+    {"+", "-"},
+    {"*", "/", "%"},
+    {"**"},
+};
+
+bool IsIdentStart(char c) { return std::isalpha(static_cast<unsigned char>(c)) || c == '_'; }
+bool IsIdentChar(char c)  { return std::isalnum(static_cast<unsigned char>(c)) || c == '_' || c == '$'; }
+
+int64_t Wrap(uint64_t x) { return static_cast<int64_t>(x); }
+
+/**
+ * @brief Recursive descent over the expression text. Nothing is allocated, a failure anywhere makes
+ * the whole expression fail.
+ */
+class ExprParser {
+public:
+    ExprParser(std::string_view text, const ParamLookup& lookup) : text(text), lookup(lookup) {}
+
+    std::optional<int64_t> parse() {
+        const int64_t value = ternary();
+        skipSpace();
+        if (!ok || pos != text.size()) return std::nullopt;
+        return value;
+    }
+
+private:
+    int64_t fail() {
+        ok = false;
+        return 0;
+    }
+
+    void skipSpace() {
+        while (pos < text.size() && std::isspace(static_cast<unsigned char>(text[pos]))) pos++;
+    }
+
+    std::string_view peekOp() {
+        skipSpace();
+        const std::string_view rest = text.substr(pos);
+        for (std::string_view op : kOperators) {
+            if (rest.substr(0, op.size()) == op) return op;
+        }
+        return {};
+    }
+
+    bool accept(std::string_view op) {
+        if (!ok || peekOp() != op) return false;
+        pos += op.size();
+        return true;
+    }
+
+    int64_t ternary() {
+        const int64_t cond = binary(0);
+        if (!accept("?")) return cond;
+        const int64_t a = ternary();
+        if (!accept(":")) return fail();
+        const int64_t b = ternary();
+        return cond ? a : b;
+    }
+
+    int64_t binary(size_t level) {
+        if (level == kBinaryLevels.size()) return unary();
+
+        int64_t lhs = binary(level + 1);
+        while (ok) {
+            const std::string_view op = peekOp();
+            const auto& ops = kBinaryLevels[level];
+            if (op.empty() || std::find(ops.begin(), ops.end(), op) == ops.end()) break;
+            pos += op.size();
+            lhs = apply(op, lhs, binary(level + 1));
+        }
+        return lhs;
+    }
+
+    int64_t apply(std::string_view op, int64_t a, int64_t b) {
+        const uint64_t ua = uint64_t(a), ub = uint64_t(b);
+        if (op == "||")  return a || b;
+        if (op == "&&")  return a && b;
+        if (op == "|")   return a | b;
+        if (op == "^")   return a ^ b;
+        if (op == "&")   return a & b;
+        if (op == "==" || op == "===") return a == b;
+        if (op == "!=" || op == "!==") return a != b;
+        if (op == "<")   return a < b;
+        if (op == "<=")  return a <= b;
+        if (op == ">")   return a > b;
+        if (op == ">=")  return a >= b;
+        if (op == "<<" || op == "<<<") return ub >= 64 ? 0 : Wrap(ua << ub);
+        if (op == ">>")  return ub >= 64 ? 0 : Wrap(ua >> ub);
+        if (op == ">>>") return ub >= 64 ? (a < 0 ? -1 : 0) : a >> ub;
+        if (op == "+")   return Wrap(ua + ub);
+        if (op == "-")   return Wrap(ua - ub);
+        if (op == "*")   return Wrap(ua * ub);
+        if (op == "/" || op == "%") {
+            if (b == 0 || (a == INT64_MIN && b == -1)) return fail();
+            return op == "/" ? a / b : a % b;
+        }
+        if (op == "**") return power(a, b);
+        return fail();
+    }
+
+    int64_t power(int64_t base, int64_t exp) {
+        if (exp < 0) {
+            if (base == 0) return fail();
+            if (base == 1) return 1;
+            if (base == -1) return (exp & 1) ? -1 : 1;
+            return 0;
+        }
+        uint64_t result = 1, b = uint64_t(base);
+        for (uint64_t e = uint64_t(exp); e; e >>= 1) {
+            if (e & 1) result *= b;
+            b *= b;
+        }
+        return Wrap(result);
+    }
+
+    int64_t unary() {
+        if (accept("+")) return unary();
+        if (accept("-")) return Wrap(0 - uint64_t(unary()));
+        if (accept("!")) return !unary();
+        if (accept("~")) return ~unary();
+        return primary();
+    }
+
+    int64_t primary() {
+        skipSpace();
+        if (!ok || pos >= text.size()) return fail();
+
+        if (accept("(")) {
+            const int64_t value = ternary();
+            return accept(")") ? value : fail();
+        }
+
+        const char c = text[pos];
+        if (std::isdigit(static_cast<unsigned char>(c)) || c == '\'') return number();
+        if (c == '$') return systemCall();
+        if (IsIdentStart(c)) {
+            const std::string_view name = identifier();
+            // Package and hierarchical references are out of reach
+            if (pos < text.size() && (text[pos] == '.' || text[pos] == ':')) return fail();
+            auto value = lookup ? lookup(name) : std::nullopt;
+            return value ? *value : fail();
+        }
+        return fail();
+    }
+
+    std::string_view identifier() {
+        const size_t start = pos;
+        while (pos < text.size() && IsIdentChar(text[pos])) pos++;
+        return text.substr(start, pos - start);
+    }
+
+    int64_t systemCall() {
+        pos++; // $
+        const std::string_view name = identifier();
+        if (!accept("(")) return fail();
+        const int64_t arg = ternary();
+        if (!accept(")")) return fail();
+
+        if (name == "clog2") {
+            int64_t bits = 0;
+            while (bits < 64 && (uint64_t(1) << bits) < uint64_t(arg)) bits++;
+            return arg <= 0 ? 0 : bits;
+        }
+        if (name == "signed" || name == "unsigned") return arg;
+        return fail();
+    }
+
+    // Digits of one base, with underscores, into a value. x, z and ? make it not a constant.
+    bool digits(int radix, uint64_t& value) {
+        const size_t start = pos;
+        value = 0;
+        for (; pos < text.size(); pos++) {
+            const char c = char(std::tolower(static_cast<unsigned char>(text[pos])));
+            if (c == '_') continue;
+
+            int d;
+            if (c >= '0' && c <= '9')      d = c - '0';
+            else if (c >= 'a' && c <= 'f') d = 10 + c - 'a';
+            else if (c == 'x' || c == 'z' || c == '?') return false;
+            else break;
+            if (d >= radix) break;
+            value = value * uint64_t(radix) + uint64_t(d);
+        }
+        return pos > start;
+    }
+
+    int64_t number() {
+        uint64_t size = 0;
+        if (text[pos] != '\'') {
+            if (!digits(10, size)) return fail();
+            skipSpace();
+            // Reals are not integers
+            if (pos < text.size() && (text[pos] == '.' || text[pos] == 'e' || text[pos] == 'E')) return fail();
+            if (pos >= text.size() || text[pos] != '\'') return Wrap(size);
+            if (size == 0) return fail();
+        }
+        pos++; // '
+
+        if (pos < text.size() && (text[pos] == 's' || text[pos] == 'S')) pos++;
+        if (pos >= text.size()) return fail();
+
+        int radix;
+        switch (std::tolower(static_cast<unsigned char>(text[pos]))) {
+            case 'b': radix = 2;  break;
+            case 'o': radix = 8;  break;
+            case 'd': radix = 10; break;
+            case 'h': radix = 16; break;
+            // '0 is zero at any width, '1 depends on the width of whatever it is assigned to
+            case '0': pos++; return 0;
+            default:  return fail();
+        }
+        pos++;
+        skipSpace();
+
+        uint64_t value;
+        if (!digits(radix, value)) return fail();
+        if (size > 0 && size < 64) value &= (uint64_t(1) << size) - 1;
+        return Wrap(value);
+    }
+
+    std::string_view   text;
+    const ParamLookup& lookup;
+    size_t             pos = 0;
+    bool               ok  = true;
+};
+
+std::optional<int64_t> ParseDecimal(std::string_view s) {
+    int64_t value;
+    auto [end, ec] = std::from_chars(s.data(), s.data() + s.size(), value);
+    if (ec != std::errc() || end != s.data() + s.size() || s.empty()) return std::nullopt;
+    return value;
+}
+
+// Integer values stay integers, so "8" and "4+4" make the same specialization
+std::string Canonical(const std::string& expr, const ParamLookup& lookup) {
+    auto value = EvalConstExpr(expr, lookup);
+    return value ? std::to_string(*value) : expr;
+}
+
+// Parameters of module resolved so far, the first count of them
+ParamLookup ScopeOf(const SV::Module* module, const std::vector<std::string>& values, size_t count) {
+    return [module, &values, count](std::string_view name) -> std::optional<int64_t> {
+        for (size_t i = count; i-- > 0;) {
+            if (module->parameters[i].name == name) return ParseDecimal(values[i]);
+        }
+        return std::nullopt;
+    };
+}
+
+size_t ParamIndex(const SV::Module* module, const SV::ParamOverride& param, size_t& positional) {
+    const auto& params = module->parameters;
+    if (param.name.empty()) {
+        for (size_t i = 0, n = 0; i < params.size(); i++) {
+            if (params[i].local) continue;
+            if (n++ == positional) {
+                positional++;
+                return i;
+            }
+        }
+        return kNoParam;
+    }
+    for (size_t i = 0; i < params.size(); i++) {
+        if (!params[i].local && params[i].name == param.name) return i;
+    }
+    return kNoParam;
+}
+
+uint64_t HashSpecialization(const SV::Module* module, const std::vector<std::string>& values) {
+    // FNV-1a over the module name and the values, each ended by a byte no name or value contains
+    uint64_t h = 1469598103934665603ull;
+    auto add = [&h](std::string_view s) {
+        for (char c : s) {
+            h ^= uint8_t(c);
+            h *= 1099511628211ull;
+        }
+        h ^= 0xff;
+        h *= 1099511628211ull;
+    };
+    add(module->name);
+    for (const auto& value : values) add(value);
+    return h;
+}
+
+uint64_t SaturatingAdd(uint64_t a, uint64_t b) {
+    return a > UINT64_MAX - b ? UINT64_MAX : a + b;
+}
+
+uint64_t SaturatingMul(uint64_t a, uint64_t b) {
+    return b != 0 && a > UINT64_MAX / b ? UINT64_MAX : a * b;
+}
+
+} // namespace
+
+std::optional<int64_t> EvalConstExpr(std::string_view expr, const ParamLookup& lookup) {
+    return ExprParser(expr, lookup).parse();
+}
+
+ParamLookup ModuleScope(const SV::Module* module, const std::vector<std::string>& values) {
+    return ScopeOf(module, values, std::min(values.size(), module->parameters.size()));
+}
+
+std::vector<std::string> DefaultValues(const SV::Module* module) {
+    std::vector<std::string> values;
+    for (size_t i = 0; i < module->parameters.size(); i++) {
+        values.push_back(Canonical(module->parameters[i].default_value, ScopeOf(module, values, i)));
+    }
+    return values;
+}
+
+bool ResolveRange(const SV::InstanceRange& range, const ParamLookup& lookup, int& first, int& last) {
+    auto f = EvalConstExpr(range.first_expr, lookup);
+    auto l = EvalConstExpr(range.last_expr, lookup);
+    if (!f || !l || *f < INT32_MIN || *f > INT32_MAX || *l < INT32_MIN || *l > INT32_MAX) return false;
+    first = int(*f);
+    last  = int(*l);
+    return true;
+}
+
+void Elaboration::Build(SV::Module* top_module, size_t max_specializations) {
+    PROFILE_SCOPE("Elaborate");
+
+    specs.clear();
+    by_hash.clear();
+    top           = kNoSpec;
+    max_specs     = std::max<size_t>(max_specializations, 1);
+    num_instances = 0;
+    truncated     = false;
+    if (!top_module) return;
+
+    // Appended specializations are elaborated in turn, so this loop is the worklist
+    top = Intern(top_module, DefaultValues(top_module));
+    for (uint32_t spec = 0; spec < specs.size(); spec++) ResolveChildren(spec);
+
+    CountInstances();
+}
+
+uint32_t Elaboration::Intern(SV::Module* module, std::vector<std::string>&& values) {
+    const uint64_t hash = HashSpecialization(module, values);
+    auto [first, last] = by_hash.equal_range(hash);
+    for (auto it = first; it != last; ++it) {
+        const Specialization& spec = specs[it->second];
+        if (spec.module == module && spec.values == values) return it->second;
+    }
+
+    if (specs.size() >= max_specs) {
+        truncated = true;
+        return kNoSpec;
+    }
+
+    const uint32_t index = uint32_t(specs.size());
+    specs.push_back({module, std::move(values), {}, {}, hash});
+    by_hash.emplace(hash, index);
+    return index;
+}
+
+void Elaboration::ResolveChildren(uint32_t spec) {
+    // Interning grows specs, so nothing may point into it while the children are resolved
+    const SV::Module*              module = specs[spec].module;
+    const std::vector<std::string> scope_values = specs[spec].values;
+    const ParamLookup              scope = ScopeOf(module, scope_values, scope_values.size());
+
+    std::vector<uint32_t> children;
+    std::vector<uint32_t> elements;
+    children.reserve(module->dependencies.size());
+    elements.reserve(module->dependencies.size());
+    for (const auto& dep : module->dependencies) {
+        SV::Module* child = dep.module;
+
+        // Every element of a range has the same parameters, only how many there are depends on ours
+        size_t count = 1;
+        if (dep.range >= 0) {
+            const SV::InstanceRange& range = module->instance_ranges[dep.range];
+            int first, last;
+            if (ResolveRange(range, scope, first, last)) count = SV::InstanceRange::Count(first, last, range.step);
+        }
+        elements.push_back(uint32_t(std::min<size_t>(count, UINT32_MAX)));
+
+        // Overrides are evaluated where the instantiation is written
+        std::vector<std::optional<std::string>> overridden(child->parameters.size());
+        size_t positional = 0;
+        for (const auto& param : dep.param_overrides) {
+            const size_t i = ParamIndex(child, param, positional);
+            if (i != kNoParam && !param.value.empty()) overridden[i] = Canonical(param.value, scope);
+        }
+
+        // Defaults are evaluated in the child, they may use the parameters before them
+        std::vector<std::string> values;
+        for (size_t i = 0; i < child->parameters.size(); i++) {
+            values.push_back(overridden[i] ? *overridden[i]
+                                           : Canonical(child->parameters[i].default_value, ScopeOf(child, values, i)));
+        }
+        children.push_back(Intern(child, std::move(values)));
+    }
+    specs[spec].children = std::move(children);
+    specs[spec].elements = std::move(elements);
+}
+
+void Elaboration::CountInstances() {
+    if (top == kNoSpec) return;
+
+    // Parents before children, a specialization that instantiates itself never gets its turn
+    std::vector<uint32_t> in_degree(specs.size(), 0);
+    for (const auto& spec : specs) {
+        for (uint32_t child : spec.children) if (child != kNoSpec) in_degree[child]++;
+    }
+
+    std::vector<uint32_t> ready{top};
+    specs[top].instances = 1;
+    size_t visited = 0;
+    while (!ready.empty()) {
+        const uint32_t s = ready.back();
+        ready.pop_back();
+        visited++;
+        num_instances = SaturatingAdd(num_instances, specs[s].instances);
+
+        for (size_t c = 0; c < specs[s].children.size(); c++) {
+            const uint32_t child = specs[s].children[c];
+            if (child == kNoSpec) continue;
+            const uint64_t n = SaturatingMul(specs[s].instances, specs[s].elements[c]);
+            specs[child].instances = SaturatingAdd(specs[child].instances, n);
+            if (--in_degree[child] == 0) ready.push_back(child);
+        }
+    }
+    if (visited < specs.size()) truncated = true;
+}
+
+std::vector<uint32_t> Elaboration::SpecializationsOf(const SV::Module* module) const {
+    std::vector<uint32_t> out;
+    for (uint32_t i = 0; i < specs.size(); i++) {
+        if (specs[i].module == module) out.push_back(i);
+    }
+    return out;
+}
+
+const std::string* Elaboration::Value(uint32_t spec, std::string_view name) const {
+    const Specialization& s = specs[spec];
+    for (size_t i = 0; i < s.values.size(); i++) {
+        if (s.module->parameters[i].name == name) return &s.values[i];
+    }
+    return nullptr;
+}
+
+std::string Elaboration::Describe(uint32_t spec) const {
+    const Specialization& s = specs[spec];
+    std::string out = s.module->name;
+
+    bool first = true;
+    for (size_t i = 0; i < s.values.size(); i++) {
+        if (s.module->parameters[i].local) continue;
+        out  += first ? " #(" : ", ";
+        out  += s.module->parameters[i].name + "=" + s.values[i];
+        first = false;
+    }
+    if (!first) out += ")";
+    return out;
+}
+
+size_t Elaboration::MemoryBytes() const {
+    size_t bytes = specs.capacity() * sizeof(Specialization);
+    for (const auto& spec : specs) {
+        bytes += spec.values.capacity() * sizeof(std::string);
+        bytes += (spec.children.capacity() + spec.elements.capacity()) * sizeof(uint32_t);
+        for (const auto& value : spec.values) bytes += size_t(mem::StringBytes(value));
+    }
+    bytes += by_hash.bucket_count() * sizeof(void*) + by_hash.size() * (sizeof(std::pair<const uint64_t, uint32_t>) + 2 * sizeof(void*));
+    return bytes;
+}
+
+}
@@ -0,0 +1,63 @@
+#include "include/ports/SkFontMgr_fontconfig.h"
+#include "include/ports/SkFontScanner_FreeType.h"
+
+#include "font_registry.h"
+
+namespace graphics {
+
+FontRegistry& FontRegistry::Get() {
+    static FontRegistry registry;
+    return registry;
+}
+
+void FontRegistry::warmUp() {
+    std::call_once(scan_started, [this] {
+        scan = std::async(std::launch::async, [] {
+            // Use default FontConfig + scanner
+            return SkFontMgr_New_FontConfig(nullptr, SkFontScanner_Make_FreeType());
+        }).share();
+    });
+}
+
+sk_sp<SkFontMgr> FontRegistry::manager() {
+    warmUp();
+    return scan.get();
+}
+
+std::string FontRegistry::key(const std::string& family, const SkFontStyle& style) {
+    return family + "|" + std::to_string(style.weight()) + "|" + std::to_string(style.width()) + "|" + std::to_string(int(style.slant()));
+}
+
+sk_sp<SkTypeface> FontRegistry::typeface(const std::string& family, const SkFontStyle& style) {
+    const std::string k = key(family, style);
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        auto it = typefaces.find(k);
+        if (it != typefaces.end()) return it->second;
+    }
+
+    // Matching can be slow, so do not hold the lock while doing it
+    sk_sp<SkTypeface> tf = manager()->matchFamilyStyle(family.c_str(), style);
+    if (!tf) {
+        throw std::runtime_error("No typeface found");
+    }
+
+    std::lock_guard<std::mutex> lock(mtx);
+    return typefaces.emplace(k, tf).first->second;
+}
+
+SkFont FontRegistry::font(const std::string& family, float size, const SkFontStyle& style) {
+    const std::string k = key(family, style) + "|" + std::to_string(size);
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        auto it = fonts.find(k);
+        if (it != fonts.end()) return it->second;
+    }
+
+    SkFont f(typeface(family, style), size);
+
+    std::lock_guard<std::mutex> lock(mtx);
+    return fonts.emplace(k, f).first->second;
+}
+
+}
@@ -0,0 +1,100 @@
+#include <utility>
+
+#include "frame_pipeline.h"
+#include "profiler.h"
+
+namespace graphics {
+
+FramePipeline::FramePipeline(int width, int height, TiledRenderer* tiles)
+    : width(width), height(height), row_bytes(size_t(width) * 4), tiles(tiles) {
+    for (auto& buffer : buffers) {
+        buffer.pixels.assign(row_bytes * height, 0);
+        buffer.stale.reset(width, height);   // nothing has been drawn into any buffer yet
+        buffer.changed.reset(width, height);
+    }
+    pending_damage.reset(width, height);
+    pending_damage.clear();
+
+    render_thread = std::thread(&FramePipeline::renderLoop, this);
+}
+
+FramePipeline::~FramePipeline() {
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        stopping = true;
+    }
+    cv.notify_all();
+    render_thread.join();
+}
+
+void FramePipeline::submit(sk_sp<SkPicture> frame, const DamageTracker& damage) {
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        pending = std::move(frame);
+        pending_damage.merge(damage);
+        for (auto& buffer : buffers) buffer.stale.merge(damage);
+    }
+    cv.notify_one();
+}
+
+void FramePipeline::renderLoop() {
+    // The raster is part of the frame, its time shows in the profiler overlay
+    prof::SetFrameThread();
+
+    std::unique_lock<std::mutex> lock(mtx);
+    while (true) {
+        cv.wait(lock, [this] { return stopping || pending; });
+        if (stopping) return;
+
+        // Take the newest frame, and everything the back buffer is missing
+        sk_sp<SkPicture> frame        = std::move(pending);
+        DamageTracker    frame_damage = pending_damage;
+        pending_damage.clear();
+
+        Buffer&       back  = buffers[rendering];
+        DamageTracker stale = back.stale;
+        back.stale.clear();
+
+        lock.unlock();
+        {
+            PROFILE_SCOPE("raster");
+            stale.finalize();
+            for (const auto& r : stale.rects) {
+                uint8_t* dst = back.pixels.data() + size_t(r.y()) * row_bytes + size_t(r.x()) * 4;
+                tiles->render(frame.get(), dst, row_bytes, r);
+            }
+        }
+        lock.lock();
+
+        // If the ready frame was never presented, the texture is still further behind than one frame
+        back.changed = frame_damage;
+        if (ready_fresh) back.changed.merge(buffers[ready].changed);
+
+        std::swap(rendering, ready);
+        ready_fresh = true;
+    }
+}
+
+bool FramePipeline::present(SDL_Texture* texture) {
+    DamageTracker changed;
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        if (!ready_fresh) return false;
+        std::swap(presenting, ready);
+        ready_fresh = false;
+        changed     = buffers[presenting].changed;
+    }
+
+    // The render thread never touches the presenting buffer, so no lock is needed to read it
+    PROFILE_SCOPE("upload");
+    const Buffer& front = buffers[presenting];
+    changed.finalize();
+    for (const auto& r : changed.rects) {
+        SDL_Rect       sdl_rect = {r.x(), r.y(), r.width(), r.height()};
+        const uint8_t* src      = front.pixels.data() + size_t(r.y()) * row_bytes + size_t(r.x()) * 4;
+        SDL_UpdateTexture(texture, &sdl_rect, src, int(row_bytes));
+    }
+    return true;
+}
+
+}
@@ -22,7 +22,32 @@ SkColor color_to_sk(Color color) {
            (uint32_t(color.b8));
 }
 
-static CodePanel g_code_panel;
+static bool g_mem_overlay = false;
+
+static CodePanel     g_code_panel;
+static CodeTextCache g_code_text_cache;
+static GraphView     g_graph_view;
+
+struct LoadStatus {
+    bool        visible  = false;
+    std::string text;
+    float       fraction = 0.f;
+};
+static LoadStatus g_load_status;
+static SearchBox  g_search;
+
+// File the code panel shows, and where it was asked to go
+struct SourceTarget {
+    bool        pending = false;
+    std::string file;
+    size_t      line = 0;
+};
+static std::string                             g_code_file;
+static SourceTarget                            g_source_target;
+static std::function<void(const std::string&)> g_open_file;
+
+static constexpr int   kSearchRows  = 12;
+static constexpr float kSearchRowH  = 22.f;
 
 void initWindow(int width, int height, bool debug_counters) {
     DEBUG_COUNTERS = debug_counters;
@@ -38,27 +63,21 @@ void initWindow(int width, int height, bool debug_counters) {
     default_window->renderer = SDL_CreateRenderer(default_window->window, -1, SDL_RENDERER_ACCELERATED | SDL_RENDERER_PRESENTVSYNC); // Enabled VSync
     default_window->fb_texture = SDL_CreateTexture(default_window->renderer, SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_STREAMING, width, height);
 
-    // BGRA matches SDL_PIXELFORMAT_ARGB8888 bytes on little-endian
-    SkImageInfo info = SkImageInfo::Make(width, height, kBGRA_8888_SkColorType, kPremul_SkAlphaType);
-
-    default_window->rowBytes = info.minRowBytes(); // == W * 4 for BGRA8888
-    default_window->pixels   = std::vector<uint8_t>(default_window->rowBytes * height, 0);
+    // First frame has to draw everything
+    default_window->damage.reset(width, height);
 
-    // NEW API: wrap your pixels
-    default_window->surface = SkSurfaces::WrapPixels(info, default_window->pixels.data(), default_window->rowBytes);
-    if (!default_window->surface) {
-        throw std::runtime_error("Could not create surface");
-    }
+    // Frames are rastered in tiles on all cores, on a render thread of their own. The pixel
+    // buffers are BGRA, which matches SDL_PIXELFORMAT_ARGB8888 bytes on little-endian
+    default_window->tiles    = std::make_unique<TiledRenderer>();
+    default_window->pipeline = std::make_unique<FramePipeline>(width, height, default_window->tiles.get());
+    mem::Set(mem::MEM_RENDER, "frame buffers", int64_t(default_window->pipeline->memoryBytes()));
 
     // Init camera
     default_window->camera.pos   = vec2(0.f, 0.f);
     default_window->camera.scale = 1.f;
 
-    // Create default font
-    default_window->default_font = createNewFont("DejaVu Sans", 20);
-
-    // Debug font
-    default_window->dbg_font = createNewFont("DejaVu Sans", 20);
+    // Fonts are picked up on the first frame, so the fontconfig scan can run while the project is parsed
+    FontRegistry::Get().warmUp();
 
     // Very temporary
     const float code_panel_width = 650;
@@ -66,6 +85,7 @@ void initWindow(int width, int height, bool debug_counters) {
         .pos = {width - code_panel_width - 32, 32},
         .size = {code_panel_width, height - 64.0f},
         .scrollY = 0.f,
+        .scrollX = 0.f,
         .visible = true,
     };
 }
@@ -83,7 +103,355 @@ inline vec2 getMouse() {
     int mx, my; SDL_GetMouseState(&mx, &my); return {float(mx), float(my)};
 }
 
+static SkRect codePanelRect(const CodePanel& panel) {
+    return SkRect::MakeXYWH(panel.pos.x, panel.pos.y, panel.size.x, panel.size.y);
+}
+
+static bool insideCodePanel(const vec2& p) {
+    if (!g_code_panel.visible) return false;
+    return codePanelRect(g_code_panel).contains(p.x, p.y);
+}
+
+static float codePanelMaxScroll(const CodePanel& panel, const sv::ColorizedDoc& doc, const SkFont& code_font) {
+    const float lineH = code_font.getSize() * 1.35f;
+    return std::max(0.f, doc.size() * lineH - (panel.size.y - 32.f));
+}
+
+static float codePanelMaxScrollX(const CodePanel& panel) {
+    const float textW = panel.size.x - 28.f;
+    return std::max(0.f, g_code_text_cache.maxColumns() * g_code_text_cache.charAdvance() - textW);
+}
+
+// Bounds of a string drawn with drawString at pos, padded a bit for anti-aliasing
+static SkRect stringRect(const std::string& text, const vec2& pos, const SkFont& font) {
+    SkRect bounds;
+    font.measureText(text.data(), text.size(), SkTextEncoding::kUTF8, &bounds);
+    bounds.offset(pos.x, pos.y);
+    bounds.outset(2.f, 2.f);
+    return bounds;
+}
+
+// Top right corner, sized for the most rows the overlay shows
+static constexpr int   kProfilerRows  = 14;
+static constexpr float kProfilerRowH  = 16.f;
+static constexpr float kProfilerGraphH = 60.f;
+
+static SkRect profilerRect() {
+    const float w = 440.f;
+    const float h = (kProfilerRows + 1) * kProfilerRowH + kProfilerGraphH + 24.f;
+    return SkRect::MakeXYWH(default_window->width - w - 10.f, 10.f, w, h);
+}
+
+// Below the profiler overlay when that is up, top right otherwise
+static constexpr int   kMemoryRows = 16;
+static constexpr float kMemoryRowH = 16.f;
+
+static SkRect memoryRect() {
+    const float w   = 440.f;
+    const float h   = (kMemoryRows + 2) * kMemoryRowH + 8.f;
+    const float top = prof::Enabled() ? profilerRect().bottom() + 10.f : 10.f;
+    return SkRect::MakeXYWH(default_window->width - w - 10.f, top, w, h);
+}
+
+// Bottom center, over the node graph
+static SkRect loadStatusRect() {
+    const float w = 520.f;
+    const float h = 64.f;
+    return SkRect::MakeXYWH((default_window->width - w) * 0.5f, default_window->height - h - 48.f, w, h);
+}
+
+void setLoadStatus(bool visible, const std::string& text, float fraction) {
+    if (visible == g_load_status.visible && text == g_load_status.text && fraction == g_load_status.fraction) return;
+    g_load_status = {visible, text, std::clamp(fraction, 0.f, 1.f)};
+    if (default_window) default_window->damage.add(loadStatusRect());
+}
+
+void invalidateWindow() {
+    g_code_text_cache.invalidate();
+    if (default_window) default_window->damage.addFull();
+}
+
+static void drawLoadStatus(SkCanvas* canvas, const SkRect& rect, SkFont& font) {
+    SkPaint bg;
+    bg.setAntiAlias(true);
+    bg.setColor(0xE0101112);
+    canvas->drawRoundRect(rect, 8.f, 8.f, bg);
+
+    SkPaint text;
+    text.setAntiAlias(true);
+    text.setColor(SK_ColorWHITE);
+    canvas->drawString(g_load_status.text.c_str(), rect.left() + 16.f, rect.top() + 26.f, font, text);
+
+    const SkRect track = SkRect::MakeLTRB(rect.left() + 16.f, rect.bottom() - 22.f, rect.right() - 16.f, rect.bottom() - 14.f);
+    SkPaint bar;
+    bar.setAntiAlias(true);
+    bar.setColor(0xFF3A3D41);
+    canvas->drawRoundRect(track, 4.f, 4.f, bar);
+    bar.setColor(color_to_sk(palette[BLUE]));
+    SkRect done = track;
+    done.fRight = track.left() + track.width() * g_load_status.fraction;
+    canvas->drawRoundRect(done, 4.f, 4.f, bar);
+}
+
+void setCodePanelFile(const std::string& file) {
+    g_code_file = file;
+    g_code_panel.highlightLine = -1;
+}
+
+void setOpenFileHandler(std::function<void(const std::string&)> handler) {
+    g_open_file = std::move(handler);
+}
+
+void showSource(const std::string& file, size_t offset) {
+    auto lines = SV::GetFileLineIndex(file);
+    if (!lines) return;
+
+    g_source_target = {true, file, lines->Locate(offset).line};
+    if (file != g_code_file && g_open_file) g_open_file(file);
+}
+
+// Go to the instantiation of a node, or to the declaration of its module
+static void showNodeSource(NodeId node, bool declaration) {
+    const GraphItem* item = g_graph_view.snapshot ? g_graph_view.snapshot->find(node) : nullptr;
+    if (!item) return;
+
+    if (!declaration && item->instance && item->instance->parent) {
+        showSource(item->instance->parent->source_file, item->instance->span.start);
+    } else {
+        showSource(item->module->source_file, item->module->span.start);
+    }
+}
+
+// Scroll once the file asked for is the one in the panel
+static void applySourceTarget(const sv::ColorizedDoc& doc) {
+    if (!g_source_target.pending || g_source_target.file != g_code_file || doc.empty()) return;
+
+    // A few lines of context above the target
+    const float lineH = default_window->code_font.getSize() * 1.35f;
+    const float line  = float(std::min(g_source_target.line, doc.size() - 1));
+    g_code_panel.scrollY       = std::clamp((line - 3.f) * lineH, 0.f, codePanelMaxScroll(g_code_panel, doc, default_window->code_font));
+    g_code_panel.scrollX       = 0.f;
+    g_code_panel.highlightLine = int64_t(line);
+    g_source_target.pending    = false;
+    default_window->damage.add(codePanelRect(g_code_panel));
+}
+
+// Top left, below the FPS counter
+static SkRect searchRect() {
+    return SkRect::MakeXYWH(10.f, 40.f, 600.f, (kSearchRows + 1) * kSearchRowH + 16.f);
+}
+
+void setSearchIndex(std::shared_ptr<const search::SearchIndex> index) {
+    g_search.index = std::move(index);
+    g_search.results.clear();
+}
+
+void setHierarchyDiff(std::shared_ptr<const diff::HierarchyDiff> diff) {
+    g_graph_view.diff = std::move(diff);
+    // Already on screen, lay it out again with the new colors
+    if (g_graph_view.module) buildGraphView(g_graph_view, g_graph_view.module, default_window->default_font);
+}
+
+void setElaboration(std::shared_ptr<const elab::Elaboration> elaboration) {
+    g_graph_view.elaboration = std::move(elaboration);
+    if (g_graph_view.module) buildGraphView(g_graph_view, g_graph_view.module, default_window->default_font);
+}
+
+static void runSearch() {
+    g_search.results.clear();
+    g_search.cursor = 0;
+    if (!g_search.index) return;
+
+    g_search.results = g_search.index->Query(g_search.query, kSearchRows);
+}
+
+void focusInstance(const std::vector<uint32_t>& path) {
+    if (!g_graph_view.layout) return;
+    g_graph_view.layout->reveal(path);
+    g_search.focus_pending = true;
+    g_search.focus_path    = path;
+    g_search.focus_until   = (g_graph_view.snapshot ? g_graph_view.snapshot->generation : 0) + 2;
+}
+
+// Children of an item are the items in its subtree range, one subtree after the other
+static const GraphItem* findItemByPath(const LayoutSnapshot& snap, const std::vector<uint32_t>& path) {
+    if (snap.items.empty()) return nullptr;
+
+    uint32_t i = 0;
+    for (size_t p = 0; p < path.size(); p++) {
+        const GraphItem& item = snap.items[i];
+        if (!item.expanded) return nullptr;
+
+        uint32_t child = i + 1;
+        for (uint32_t k = 0; k < path[p] && child < item.subtree_end; k++) child = snap.items[child].subtree_end;
+        if (child >= item.subtree_end) return nullptr;
+        i = child;
+
+        // Same as LayoutEngine::reveal, deeper than a range means through its first element
+        if (snap.items[i].is_range && p + 1 < path.size()) {
+            if (!snap.items[i].expanded || snap.items[i].subtree_end == i + 1) return nullptr;
+            i++;
+        }
+    }
+    return &snap.items[i];
+}
+
+// Center the camera on the focused instance as soon as a layout has it
+static void updateFocus() {
+    if (!g_search.focus_pending || !g_graph_view.snapshot) return;
+
+    const LayoutSnapshot& snap = *g_graph_view.snapshot;
+    const GraphItem*      item = findItemByPath(snap, g_search.focus_path);
+    if (!item) {
+        if (snap.generation > g_search.focus_until) g_search.focus_pending = false;
+        return;
+    }
+
+    Camera& camera = default_window->camera;
+    if (default_window->default_font.getSize() * camera.scale < g_graph_view.lod.label_min_px) {
+        camera.scale = 1.f; // close enough to read the labels
+    }
+    camera.pos = item->box.Center() - vec2(default_window->width, default_window->height) * (0.5f / camera.scale);
+
+    g_graph_view.selected  = item->node;
+    g_search.focus_pending = false;
+    default_window->damage.addFull();
+}
+
+static void drawSearchBox(SkCanvas* canvas, const SkRect& rect, SkFont& font) {
+    SkPaint bg;
+    bg.setAntiAlias(true);
+    bg.setColor(0xF0101112);
+    canvas->drawRoundRect(rect, 6.f, 6.f, bg);
+
+    canvas->save();
+    canvas->clipRect(rect);
+
+    SkPaint text;
+    text.setAntiAlias(true);
+    text.setColor(SK_ColorWHITE);
+    const float x = rect.left() + 10.f;
+    float       y = rect.top() + kSearchRowH;
+    const std::string prompt = "Find: " + g_search.query + "_";
+    canvas->drawString(prompt.c_str(), x, y, font, text);
+
+    SkPaint highlight;
+    highlight.setColor(0xFF2C313A);
+    SkPaint dim;
+    dim.setAntiAlias(true);
+    dim.setColor(0xFF8A8F98);
+    for (size_t i = 0; i < g_search.results.size(); i++) {
+        y += kSearchRowH;
+        if (int(i) == g_search.cursor) {
+            canvas->drawRect(SkRect::MakeLTRB(rect.left() + 4.f, y - kSearchRowH + 5.f, rect.right() - 4.f, y + 5.f), highlight);
+        }
+
+        const search::Entry& entry = (*g_search.index)[g_search.results[i].entry];
+        const std::string    label(g_search.index->Text(g_search.results[i].entry));
+        if (entry.kind == search::ENTRY_MODULE) {
+            canvas->drawString("module", x, y, font, dim);
+            canvas->drawString(label.c_str(), x + 70.f, y, font, text);
+        } else {
+            canvas->drawString(label.c_str(), x, y, font, text);
+        }
+    }
+
+    canvas->restore();
+}
+
+// Returns true if the event was for the search box
+static bool handleSearchEvent(const SDL_Event& e) {
+    if (e.type == SDL_KEYDOWN && e.key.keysym.sym == SDLK_f && (SDL_GetModState() & KMOD_CTRL)) {
+        g_search.open = true;
+        SDL_StartTextInput();
+        default_window->damage.add(searchRect());
+        return true;
+    }
+    if (!g_search.open) return false;
+
+    if (e.type == SDL_TEXTINPUT) {
+        g_search.query += e.text.text;
+        runSearch();
+    } else if (e.type == SDL_KEYDOWN) {
+        switch (e.key.keysym.sym) {
+            case SDLK_ESCAPE:
+                g_search.open = false;
+                SDL_StopTextInput();
+                break;
+            case SDLK_BACKSPACE:
+                // Drop one UTF-8 character
+                while (!g_search.query.empty() && (g_search.query.back() & 0xC0) == 0x80) g_search.query.pop_back();
+                if (!g_search.query.empty()) g_search.query.pop_back();
+                runSearch();
+                break;
+            case SDLK_UP:
+                g_search.cursor = std::max(0, g_search.cursor - 1);
+                break;
+            case SDLK_DOWN:
+                g_search.cursor = std::min(int(g_search.results.size()) - 1, g_search.cursor + 1);
+                break;
+            case SDLK_RETURN: {
+                if (g_search.results.empty()) break;
+                uint32_t entry = g_search.results[g_search.cursor].entry;
+                if ((*g_search.index)[entry].kind == search::ENTRY_MODULE) entry = (*g_search.index)[entry].first_instance;
+                if (entry != search::kNoEntry) focusInstance(g_search.index->InstancePath(entry));
+                break;
+            }
+            default:
+                return false;
+        }
+    } else {
+        return false;
+    }
+
+    default_window->damage.add(searchRect());
+    return true;
+}
+
+// Record everything drawn this frame into a display list, so it can be played back per tile
+static sk_sp<SkPicture> recordFrame(SV::Module* root, const sv::ColorizedDoc& g_doc, const std::string& fps_string) {
+    SkPictureRecorder recorder;
+    SkRTreeFactory    rtree; // lets tile playback skip everything outside the tile
+    SkCanvas* canvas = recorder.beginRecording(SkRect::MakeWH(default_window->width, default_window->height), &rtree);
+    PROFILE_SCOPE("record");
+    drawFrame(canvas, root, g_doc, fps_string);
+    return recorder.finishRecordingAsPicture();
+}
+
+// Record the frame and hand it to the render thread if anything changed. Never waits on a raster.
+static void submitDamage(SV::Module* root, const sv::ColorizedDoc& g_doc, const std::string& fps_string) {
+    DamageTracker& damage = default_window->damage;
+    damage.finalize();
+    if (damage.empty()) return;
+
+    sk_sp<SkPicture> frame = recordFrame(root, g_doc, fps_string);
+    mem::Set(mem::MEM_RENDER, "recorded frame", int64_t(frame->approximateBytesUsed()));
+    default_window->pipeline->submit(std::move(frame), damage);
+    damage.clear();
+}
+
+// Blocks until the font registry is ready, which it normally is by the time the first frame is drawn
+static void ensureFonts() {
+    if (default_window->fonts_ready) return;
+
+    // Create default font
+    default_window->default_font = createNewFont("DejaVu Sans", 20);
+
+    // Debug font
+    default_window->dbg_font = createNewFont("DejaVu Sans", 20);
+
+    // Small monospaced font for the profiler overlay and the search box
+    default_window->mono_font = createNewFont("DejaVu Sans Mono", 12);
+
+    // Source code, at the size of the rest of the window
+    default_window->code_font = createNewFont("DejaVu Sans Mono", 20);
+
+    default_window->fonts_ready = true;
+}
+
 bool updateWindow(SV::Module* root, sv::ColorizedDoc& g_doc) {
+    ensureFonts();
+
     static uint32_t startTime   = SDL_GetTicks();
     static float    fps         = 0.0f;
     static int      frame_count = 0;
@@ -96,22 +464,71 @@ bool updateWindow(SV::Module* root, sv::ColorizedDoc& g_doc) {
     SDL_Event e;
     static bool dragging = false;
     static vec2 lastMouse(0, 0);
+    static vec2 downMouse(0, 0);
     const float minScale = 0.05f;
     const float maxScale = 50.0f;
     const float zoomStep = 1.1f; // 10% per wheel notch
 
+    const uint64_t events_start = prof::Enabled() ? prof::NowNs() : 0;
     while (SDL_PollEvent(&e)) {
         if (e.type == SDL_QUIT) running = false;
 
+        // Typing goes to the search box while it is open
+        if (handleSearchEvent(e)) continue;
+
+        // F3 toggles the profiler and its overlay, F4 dumps everything recorded as a Chrome trace
+        if (e.type == SDL_KEYDOWN && e.key.keysym.sym == SDLK_F3) {
+            prof::SetEnabled(!prof::Enabled());
+            if (!prof::Enabled()) default_window->damage.add(profilerRect());
+        }
+        // F5 toggles the memory overlay, and with it the accounting that walks big structures
+        if (e.type == SDL_KEYDOWN && e.key.keysym.sym == SDLK_F5) {
+            g_mem_overlay = !g_mem_overlay;
+            if (g_mem_overlay) mem::SetEnabled(true);
+            else               default_window->damage.add(memoryRect());
+        }
+        if (e.type == SDL_KEYDOWN && e.key.keysym.sym == SDLK_F4) {
+            const std::string trace_path = ResolveUserPath("sv_trace.json");
+            if (prof::WriteChromeTrace(trace_path)) {
+                std::cout << "Wrote trace to " << trace_path << "\n";
+            } else {
+                std::cerr << "Could not write trace to " << trace_path << "\n";
+            }
+        }
+
         // TODO: Modify the position of the camera based on either shift + mouse click and drag, or 
         // scrolling/double finger touchpad movement. Zoom camera with ctrl + scolling
         // Start/stop LMB drag panningc
         if (e.type == SDL_MOUSEBUTTONDOWN && e.button.button == SDL_BUTTON_LEFT) {
             dragging = true;
             lastMouse = {float(e.button.x), float(e.button.y)};
+            downMouse = lastMouse;
         }
         if (e.type == SDL_MOUSEBUTTONUP && e.button.button == SDL_BUTTON_LEFT) {
             dragging = false;
+
+            // A click that did not drag selects the node under the mouse
+            vec2 up{float(e.button.x), float(e.button.y)};
+            vec2 moved = up - downMouse;
+            if (std::abs(moved.x) + std::abs(moved.y) < 4.f && !insideCodePanel(up)) {
+                NodeId picked = pickNode(g_graph_view, default_window->camera, up);
+                if (picked != g_graph_view.selected) {
+                    g_graph_view.selected = picked;
+                    default_window->damage.addFull();
+                }
+
+                // Click shows where the instance is instantiated, double click where its module is declared
+                if (picked != kNoNode) showNodeSource(picked, e.button.clicks >= 2);
+            }
+        }
+
+        // Right click expands or collapses the node under the mouse
+        if (e.type == SDL_MOUSEBUTTONUP && e.button.button == SDL_BUTTON_RIGHT && g_graph_view.layout) {
+            vec2 up{float(e.button.x), float(e.button.y)};
+            NodeId picked = pickNode(g_graph_view, default_window->camera, up);
+            if (picked != kNoNode && !insideCodePanel(up)) {
+                g_graph_view.layout->toggleExpanded(picked);
+            }
         }
 
         // Drag to pan (scale-aware)
@@ -134,9 +551,21 @@ bool updateWindow(SV::Module* root, sv::ColorizedDoc& g_doc) {
             const bool ctrl  = (SDL_GetModState() & KMOD_CTRL) != 0;
             const bool shift = (SDL_GetModState() & KMOD_SHIFT) != 0;
 
+            vec2 mouse = getMouse();                                // screen coords
+
+            // Scrolling over the code panel scrolls the code instead of zooming, shift scrolls sideways
+            if (insideCodePanel(mouse)) {
+                const float dx = shift ? wy : -wx;
+                const float dy = shift ? 0.f : wy;
+                const float maxScroll  = codePanelMaxScroll(g_code_panel, g_doc, default_window->code_font);
+                const float maxScrollX = codePanelMaxScrollX(g_code_panel);
+                g_code_panel.scrollY = std::clamp(g_code_panel.scrollY - flip * dy * scroll_sensitivity * 2.f, 0.f, maxScroll);
+                g_code_panel.scrollX = std::clamp(g_code_panel.scrollX - flip * dx * scroll_sensitivity * 2.f, 0.f, maxScrollX);
+                continue;
+            }
+
             // ZOOM WITHOUT CTRL
             // --- Zoom about mouse cursor ---
-            vec2 mouse = getMouse();                                // screen coords
             vec2 anchorWorld = screenToWorld(mouse, default_window->camera);
         
             float factor   = std::pow(zoomStep, flip * wy);
@@ -175,20 +604,28 @@ bool updateWindow(SV::Module* root, sv::ColorizedDoc& g_doc) {
         }
     }
 
-    // Clear screen
-    SkCanvas* canvas = default_window->surface->getCanvas();
-    canvas->clear(0xFF1B1C1D);
-    
-    // Draw the graphc
-    vec2 root_pos = vec2(200, 200);
-    drawNodeGraph(canvas, root, "", root_pos);
+    if (events_start != 0) prof::Record("events", events_start, prof::NowNs() - events_start);
 
-    if (g_code_panel.visible) {
-        renderCodePanel(canvas, g_code_panel, g_doc, default_window->default_font);
+    // Layout runs in the background, pick up the result when it is done
+    {
+        PROFILE_SCOPE("layout/sync");
+        if (g_graph_view.module != root) {
+            buildGraphView(g_graph_view, root, default_window->default_font);
+        }
+        if (syncGraphView(g_graph_view)) {
+            default_window->damage.addFull();
+        }
+        updateFocus();
     }
+    applySourceTarget(g_doc);
 
+    // Figure out what changed since the last frame
+    static Camera      last_camera  = default_window->camera;
+    static float       last_scrollY = g_code_panel.scrollY;
+    static float       last_scrollX = g_code_panel.scrollX;
+    static std::string last_fps_string;
+    vec2 fps_counter_pos(10, 20);
 
-    // Draw FPS counter if enabled
     if (DEBUG_COUNTERS) {
         // FPS Counter
         Uint32 currentTime = SDL_GetTicks();
@@ -198,39 +635,179 @@ bool updateWindow(SV::Module* root, sv::ColorizedDoc& g_doc) {
             startTime = currentTime;
             fps_string = "FPS: " + std::to_string(int(fps));        
         }
-        // FPS Counter Debug Counter
-        vec2 fps_counter_pos(10, 20);
-        drawString(canvas, fps_string.c_str(), fps_counter_pos, default_window->dbg_font, SK_ColorWHITE);
+        if (fps_string != last_fps_string) {
+            default_window->damage.add(stringRect(last_fps_string, fps_counter_pos, default_window->dbg_font));
+            default_window->damage.add(stringRect(fps_string, fps_counter_pos, default_window->dbg_font));
+            last_fps_string = fps_string;
+        }
     }
+
+    if (default_window->camera.pos != last_camera.pos || default_window->camera.scale != last_camera.scale) {
+        // The node graph covers the whole canvas
+        default_window->damage.addFull();
+        last_camera = default_window->camera;
+    }
+
+    if (g_code_panel.scrollY != last_scrollY || g_code_panel.scrollX != last_scrollX) {
+        default_window->damage.add(codePanelRect(g_code_panel));
+        last_scrollY = g_code_panel.scrollY;
+        last_scrollX = g_code_panel.scrollX;
+    }
+
+    // The overlay shows live numbers, so it is redrawn every frame while it is up
+    if (prof::Enabled()) {
+        default_window->damage.add(profilerRect());
+    }
+    if (g_mem_overlay) {
+        default_window->damage.add(memoryRect());
+    }
+
+    // Rastering happens on the render thread, upload whatever it finished most recently
+    submitDamage(root, g_doc, fps_string);
+    default_window->pipeline->present(default_window->fb_texture);
+    {
+        PROFILE_SCOPE("present");
+        SDL_RenderClear(default_window->renderer);
+        SDL_RenderCopy(default_window->renderer, default_window->fb_texture, nullptr, nullptr);
+        SDL_RenderPresent(default_window->renderer);
+    }
+    prof::FrameMark();
     
-    // upload pixels to the window
-    SDL_UpdateTexture(default_window->fb_texture, nullptr, default_window->pixels.data(), (int)default_window->rowBytes);
-    SDL_RenderClear(default_window->renderer);
-    SDL_RenderCopy(default_window->renderer, default_window->fb_texture, nullptr, nullptr);
-    SDL_RenderPresent(default_window->renderer);
-    
-    if (running == false)
+    if (running == false) {
+        default_window->pipeline.reset();
         SDL_Quit();
+    }
 
     return running;
 }
 
-SkFont createNewFont(std::string font_name, int font_size) {
-    // Use default FontConfig + scanner
-    auto mgr = SkFontMgr_New_FontConfig(nullptr, SkFontScanner_Make_FreeType());
+void drawFrame(SkCanvas* canvas, SV::Module* root, const sv::ColorizedDoc& g_doc, const std::string& fps_string) {
+    // Clear screen
+    canvas->clear(0xFF1B1C1D);
+    
+    // Draw the graphc
+    {
+        PROFILE_SCOPE("drawNodeGraph");
+        drawNodeGraph(canvas, g_graph_view, default_window->camera, default_window->default_font);
+    }
+
+    if (g_code_panel.visible) {
+        PROFILE_SCOPE("renderCodePanel");
+        renderCodePanel(canvas, g_code_panel, g_doc, default_window->code_font);
+    }
 
-    sk_sp<SkTypeface> tf = mgr->matchFamilyStyle(
-        font_name.c_str(),
-        SkFontStyle(SkFontStyle::kNormal_Weight,
-                    SkFontStyle::kNormal_Width,
-                    SkFontStyle::kUpright_Slant));
+    // Draw FPS counter if enabled
+    if (DEBUG_COUNTERS) {
+        vec2 fps_counter_pos(10, 20);
+        drawString(canvas, fps_string.c_str(), fps_counter_pos, default_window->dbg_font, SK_ColorWHITE);
+    }
+
+    if (g_search.open) {
+        drawSearchBox(canvas, searchRect(), default_window->mono_font);
+    }
 
-    if (!tf) {
-        throw std::runtime_error("No typeface found");
+    if (g_load_status.visible) {
+        drawLoadStatus(canvas, loadStatusRect(), default_window->dbg_font);
     }
 
-    return SkFont(tf, font_size);
+    if (prof::Enabled()) {
+        drawProfilerOverlay(canvas, profilerRect(), default_window->mono_font);
+    }
 
+    if (g_mem_overlay) {
+        drawMemoryOverlay(canvas, memoryRect(), default_window->mono_font);
+    }
+}
+
+void drawProfilerOverlay(SkCanvas* canvas, const SkRect& rect, SkFont& font) {
+    SkPaint bg;
+    bg.setColor(0xE0101112);
+    canvas->drawRect(rect, bg);
+
+    SkPaint text;
+    text.setAntiAlias(true);
+    text.setColor(SK_ColorWHITE);
+
+    // One row per phase, times in ms
+    char  row[128];
+    float x = rect.left() + 8.f;
+    float y = rect.top() + kProfilerRowH;
+    std::snprintf(row, sizeof(row), "%-24s %7s %7s %7s %7s", "phase", "last", "p50", "p95", "p99");
+    canvas->drawString(row, x, y, font, text);
+
+    int rows = 0;
+    for (const auto& s : prof::GetPhaseStats()) {
+        if (++rows > kProfilerRows) break;
+        y += kProfilerRowH;
+        std::snprintf(row, sizeof(row), "%-24.24s %7.2f %7.2f %7.2f %7.2f", s.name.c_str(), s.last, s.p50, s.p95, s.p99);
+        canvas->drawString(row, x, y, font, text);
+    }
+
+    // Frame time graph along the bottom, the line marks 16.7ms
+    const std::vector<float> frame_times = prof::GetFrameTimes();
+    const SkRect graph  = SkRect::MakeLTRB(rect.left() + 8.f, rect.bottom() - kProfilerGraphH - 8.f,
+                                           rect.right() - 8.f, rect.bottom() - 8.f);
+    const float  max_ms = 50.f;
+
+    SkPaint line;
+    line.setColor(0x80FFFFFF);
+    const float budget_y = graph.bottom() - graph.height() * (16.7f / max_ms);
+    canvas->drawLine(graph.left(), budget_y, graph.right(), budget_y, line);
+
+    if (frame_times.empty()) return;
+    const float bar_w = graph.width() / float(frame_times.size());
+    SkPaint bar;
+    for (size_t i = 0; i < frame_times.size(); i++) {
+        const float ms = std::min(frame_times[i], max_ms);
+        bar.setColor(frame_times[i] > 16.7f ? 0xFFE06C75 : 0xFF98C379);
+        canvas->drawRect(SkRect::MakeLTRB(graph.left() + i * bar_w, graph.bottom() - graph.height() * (ms / max_ms),
+                                          graph.left() + (i + 1) * bar_w, graph.bottom()), bar);
+    }
+}
+
+void drawMemoryOverlay(SkCanvas* canvas, const SkRect& rect, SkFont& font) {
+    SkPaint bg;
+    bg.setColor(0xE0101112);
+    canvas->drawRect(rect, bg);
+
+    SkPaint text;
+    text.setAntiAlias(true);
+    text.setColor(SK_ColorWHITE);
+    SkPaint dim = text;
+    dim.setColor(0xFFA0A0A0);
+
+    // One row per subsystem followed by its sources, in MB
+    auto mb = [](int64_t bytes) { return double(bytes) / (1024.0 * 1024.0); };
+    char  row[128];
+    float x = rect.left() + 8.f;
+    float y = rect.top() + kMemoryRowH;
+    std::snprintf(row, sizeof(row), "%-26s %9s %9s", "memory (MB)", "current", "peak");
+    canvas->drawString(row, x, y, font, text);
+
+    int rows = 0;
+    const auto sources = mem::GetSourceStats();
+    for (const auto& sub : mem::GetSubsystemStats()) {
+        if (++rows > kMemoryRows) break;
+        y += kMemoryRowH;
+        std::snprintf(row, sizeof(row), "%-26s %9.1f %9.1f", mem::SubsystemName(sub.subsystem), mb(sub.current), mb(sub.peak));
+        canvas->drawString(row, x, y, font, text);
+
+        for (const auto& s : sources) {
+            if (s.subsystem != sub.subsystem) continue;
+            if (++rows > kMemoryRows) break;
+            y += kMemoryRowH;
+            std::snprintf(row, sizeof(row), "  %-24.24s %9.1f %9.1f", s.name.c_str(), mb(s.current), mb(s.peak));
+            canvas->drawString(row, x, y, font, dim);
+        }
+    }
+
+    std::snprintf(row, sizeof(row), "%-26s %9.1f %9.1f", "resident set size", mb(mem::CurrentRSS()), mb(mem::PeakRSS()));
+    canvas->drawString(row, x, rect.bottom() - 8.f, font, text);
+}
+
+SkFont createNewFont(std::string font_name, int font_size) {
+    // Every font comes from the shared registry, the fontconfig database is only scanned once
+    return FontRegistry::Get().font(font_name, font_size);
 }
 
 void drawString(SkCanvas* canvas, const char* text, vec2& pos, SkFont& font, Color color) {
@@ -249,28 +826,252 @@ void drawBox(SkCanvas* canvas, vec2& pos, vec2& size, Color color) {
     canvas->drawRoundRect(rect, 10, 10, paint);
 }
 
-static void drawTextSV(SkCanvas* c, std::string_view sv, float x, float y, SkFont& font, Color col){
-    if(sv.empty()) return;
-    SkPaint p; p.setAntiAlias(true); p.setColor(color_to_sk(col));
-    c->drawSimpleText(sv.data(), sv.size(), SkTextEncoding::kUTF8, x, y, font, p);
+void buildGraphView(GraphView& view, SV::Module* root, const SkFont& font) {
+    view.module   = root;
+    view.selected = kNoNode;
+    view.snapshot = nullptr;
+    view.wires    = nullptr;
+    if (!view.layout) {
+        view.layout = std::make_unique<LayoutEngine>(font);
+    }
+    if (!view.router) {
+        view.router = std::make_unique<WireRouter>();
+    }
+    // None of the nets of another design can be taken over
+    view.router->route(nullptr);
+    view.layout->setRoot(root, view.diff ? view.diff->Top() : nullptr, view.elaboration);
+}
+
+bool syncGraphView(GraphView& view) {
+    if (!view.layout) return false;
+
+    bool changed = false;
+    auto latest  = view.layout->snapshot();
+    if (latest != view.snapshot) {
+        view.snapshot = std::move(latest);
+        if (mem::Enabled()) {
+            mem::Set(mem::MEM_RENDER, "layout snapshot", view.snapshot ? int64_t(view.snapshot->memoryBytes()) : 0);
+        }
+        // Every layout can move ports, only the parents whose channel changed are routed again
+        if (view.router) view.router->route(view.snapshot);
+        changed = true;
+    }
+
+    if (view.router) {
+        auto wires = view.router->wires();
+        if (wires != view.wires) {
+            view.wires = std::move(wires);
+            mem::Set(mem::MEM_RENDER, "wires", view.wires ? int64_t(view.wires->memoryBytes()) : 0);
+            changed = true;
+        }
+    }
+    return changed;
+}
+
+// Rects of one color, drawn with a single path draw
+struct RectBatch {
+    uint32_t      rgba;
+    SkPathBuilder path;
+};
+
+static void addToBatch(std::vector<RectBatch>& batches, const Color& color, const AABB& box) {
+    const uint32_t rgba = color.rgba();
+    for (auto& batch : batches) {
+        if (batch.rgba == rgba) {
+            batch.path.addRect(SkRect::MakeLTRB(box.ul.x, box.ul.y, box.br.x, box.br.y));
+            return;
+        }
+    }
+    batches.push_back({rgba, SkPathBuilder()});
+    batches.back().path.addRect(SkRect::MakeLTRB(box.ul.x, box.ul.y, box.br.x, box.br.y));
+}
+
+// Zoomed out drawing. Walks the tree from the root and stops descending as soon as a subtree is
+// off screen or small enough to be drawn as a single box, so the work done is bounded by what fits
+// on the screen and not by the number of nodes.
+static void drawNodeGraphLod(SkCanvas* canvas, const LayoutSnapshot& layout, const AABB& viewport, float scale, const LodOpts& lod) {
+    std::vector<RectBatch> nodes;      // nodes that have their children drawn as well
+    std::vector<RectBatch> aggregates; // whole subtrees drawn as one box
+    std::vector<RectBatch> summaries;  // tiny subtrees merged into runs
+
+    // Tiny subtrees next to each other are merged until the run itself is big enough to see
+    bool  run_active = false;
+    AABB  run_box;
+    Color run_color;
+    auto flush_run = [&]() {
+        if (run_active) addToBatch(summaries, run_color, run_box);
+        run_active = false;
+    };
+
+    const float aggregate_world = lod.aggregate_px / scale;
+    const float summary_world   = lod.summary_px / scale;
+
+    for (uint32_t i = 0; i < layout.items.size();) {
+        const GraphItem& item = layout.items[i];
+        if (!item.subtree.Intersects(viewport)) {
+            i = item.subtree_end;
+            continue;
+        }
+
+        const vec2  extent = item.subtree.Size();
+        const float size   = std::max(extent.x, extent.y);
+        if (size < summary_world) {
+            if (run_active) {
+                AABB merged = run_box;
+                merged.Expand(item.subtree);
+                const vec2 merged_extent = merged.Size();
+                if (std::max(merged_extent.x, merged_extent.y) < summary_world * 2.f) {
+                    run_box = merged;
+                    i = item.subtree_end;
+                    continue;
+                }
+                flush_run();
+            }
+            run_active = true;
+            run_box    = item.subtree;
+            run_color  = item.type_color;
+            i = item.subtree_end;
+            continue;
+        }
+        flush_run();
+
+        if (size < aggregate_world || item.subtree_end == i + 1) {
+            addToBatch(aggregates, item.type_color, item.subtree);
+            i = item.subtree_end;
+            continue;
+        }
+
+        addToBatch(nodes, item.type_color, item.box);
+        i++;
+    }
+    flush_run();
+
+    SkPaint paint;
+    paint.setAntiAlias(false);
+    for (auto* batches : {&summaries, &aggregates}) {
+        for (auto& batch : *batches) {
+            paint.setColor(color_to_sk(Color(batch.rgba)));
+            paint.setAlphaf(batches == &summaries ? 0.6f : 0.35f);
+            canvas->drawPath(batch.path.detach(), paint);
+        }
+    }
+    paint.setAlphaf(1.f);
+    for (auto& batch : nodes) {
+        paint.setColor(color_to_sk(Color(batch.rgba)));
+        canvas->drawPath(batch.path.detach(), paint);
+    }
+}
+
+// Wires of the nets in view, every style is one path draw however many nets are on screen
+static void drawWires(SkCanvas* canvas, const WireLayout& wires, const AABB& viewport, float scale, float min_span_px, const LodOpts& lod) {
+    // In a channel this narrow the tracks are one smear
+    if (wires.channel_width * scale < lod.wire_min_px) return;
+
+    // Per thread, the headless export draws several views at once
+    thread_local std::vector<uint32_t> visible;
+    visible.clear();
+    wires.index.queryRect(viewport, visible);
+
+    const float   min_span = min_span_px / scale;
+    SkPathBuilder paths[WIRE_STYLE_COUNT];
+    size_t        drawn[WIRE_STYLE_COUNT] = {};
+    for (uint32_t id : visible) {
+        const WireNet& net = wires.nets[id];
+        if (net.bounds.br.y - net.bounds.ul.y < min_span) continue;
+        SkPathBuilder& path = paths[net.style];
+        drawn[net.style]++;
+        for (uint32_t s = net.first_segment; s < net.first_segment + net.num_segments; s++) {
+            path.moveTo(wires.segments[s].from.x, wires.segments[s].from.y);
+            path.lineTo(wires.segments[s].to.x, wires.segments[s].to.y);
+        }
+    }
+
+    static const Color colors[WIRE_STYLE_COUNT]   = {Color(0x6C7A89FFu), Color(0x1982C4FFu), Color(0xF6BD60FFu)};
+    static const float widths_px[WIRE_STYLE_COUNT] = {0.f, 0.f, 2.f}; // 0 is a hairline, the cheapest stroke there is
+
+    SkPaint paint;
+    paint.setAntiAlias(false); // axis aligned, there is nothing to smooth
+    paint.setStyle(SkPaint::kStroke_Style);
+    for (int style = 0; style < WIRE_STYLE_COUNT; style++) {
+        if (drawn[style] == 0) continue;
+        paint.setColor(color_to_sk(colors[style]));
+        paint.setAlphaf(0.8f);
+        paint.setStrokeWidth(widths_px[style] / scale);
+        canvas->drawPath(paths[style].detach(), paint);
+    }
 }
 
-void drawNodeGraph(SkCanvas* canvas, SV::Module* root, std::string instance_name, vec2& root_position) {
-    if (root == nullptr) return;
+void drawNodeGraph(SkCanvas* canvas, GraphView& view, const Camera& camera, SkFont& font) {
+    if (!view.snapshot) return;
+    const LayoutSnapshot& layout = *view.snapshot;
+
+    canvas->save();
+    canvas->scale(camera.scale, camera.scale);
+    canvas->translate(-camera.pos.x, -camera.pos.y);
+
+    // Part of the world that is on screen, whatever the canvas is backed by
+    const SkRect clip = canvas->getLocalClipBounds();
+    const AABB   viewport(clip.left(), clip.top(), clip.right(), clip.bottom());
 
-    // TODO: Draw logic for module structure
-    // For now, just hard program in something
-    const float lineH = default_window->default_font.getSize() * 1.35f;
+    if (const GraphItem* selected = layout.find(view.selected)) {
+        const AABB& box = selected->box;
+        SkPaint paint;
+        paint.setAntiAlias(true);
+        paint.setColor(color_to_sk(palette[BLUE]));
+        canvas->drawRoundRect(SkRect::MakeLTRB(box.ul.x - 4, box.ul.y, box.br.x + 4, box.br.y), 4, 4, paint);
+    }
 
-    std::string text = root->name + " (" + instance_name + ")";
-    drawString(canvas, text.c_str(), root_position, default_window->default_font, SK_ColorWHITE);
-    root_position += vec2(0, lineH);
+    const float label_px = font.getSize() * camera.scale;
+    const bool  detailed = label_px >= view.lod.label_min_px;
 
-    for (int i = 0; i < root->dependencies.size(); i++) {
-        vec2 new_root_pos = root_position + vec2(40, 0);
-        drawNodeGraph(canvas, root->dependencies[i].module, root->dependencies[i].instance_name, new_root_pos);
-        root_position.y = new_root_pos.y;
+    // Under the nodes, wires routed for an older layout would not meet the ports any more
+    if (view.wires && view.wires->generation == layout.generation) {
+        PROFILE_SCOPE("drawWires");
+        drawWires(canvas, *view.wires, viewport, camera.scale, detailed ? 0.f : view.lod.aggregate_px, view.lod);
     }
+
+    if (detailed) {
+        // Labels are readable, draw every visible node in full
+        // Per thread, the headless export draws several views at once
+        thread_local std::vector<uint32_t> visible;
+        visible.clear();
+        layout.index.queryRect(viewport, visible);
+
+        SkFontMetrics metrics;
+        font.getMetrics(&metrics);
+        SkPaint text;
+        text.setAntiAlias(true);
+        SkPaint stack;
+        stack.setAntiAlias(true);
+        stack.setStyle(SkPaint::kStroke_Style);
+        for (uint32_t id : visible) {
+            const GraphItem& item = layout.items[id];
+            if (item.is_range) {
+                // Stacked outlines, so an instance array reads as many instances in one box
+                stack.setColor(color_to_sk(item.type_color));
+                stack.setAlphaf(0.7f);
+                for (int k = 0; k < 2; k++) {
+                    const float d = 3.f * float(k);
+                    canvas->drawRect(SkRect::MakeLTRB(item.box.ul.x - 2 + d, item.box.ul.y - 1 + d, item.box.br.x + 2 + d, item.box.br.y + 1 + d), stack);
+                }
+            }
+            // Shaped when the node was created, nothing is laid out again per frame
+            if (!item.label->blob) continue;
+            text.setColor(color_to_sk(item.color));
+            canvas->drawTextBlob(item.label->blob, item.box.ul.x, item.box.ul.y - metrics.fAscent, text);
+        }
+    } else {
+        drawNodeGraphLod(canvas, layout, viewport, camera.scale, view.lod);
+    }
+
+    canvas->restore();
+}
+
+NodeId pickNode(const GraphView& view, const Camera& camera, const vec2& screen_pos) {
+    if (!view.snapshot) return kNoNode;
+
+    int64_t item = view.snapshot->index.pick(screenToWorld(screen_pos, camera));
+    return item < 0 ? kNoNode : view.snapshot->items[item].node;
 }
 
 void renderSourceFile(SkCanvas* canvas, vec2 pos, const char* source_code, size_t scroll_line_number) {
@@ -291,22 +1092,40 @@ void renderCodePanel(SkCanvas* canvas, const CodePanel& panel, const sv::Coloriz
     canvas->save();
     canvas->clipRect(contentR, true);
 
-    float y = contentR.top() + 8.f + lineH - panel.scrollY;
-    const float x0 = contentR.left() + 12.f;
-
-    for (const auto& line : doc) {
-        float bottom = y + lineH * 0.2f;
-        if (bottom >= contentR.top() && y - lineH <= contentR.bottom()) {
-            float x = x0;
-            for (const auto& span : line) {
-                if (span.text.empty()) continue;
-                SkScalar w = code_font.measureText(span.text.data(), span.text.size(), SkTextEncoding::kUTF8);
-                drawTextSV(canvas, span.text, x, y, code_font, span.color);
-                x += w;
-            }
+    const float x0    = contentR.left() + 12.f;
+    const float textW = contentR.right() - x0;
+
+    g_code_text_cache.sync(doc, code_font, textW);
+
+    // Only the lines and columns inside the panel are touched, so the cost does not depend on the
+    // size of the document. Horizontal scrolling moves in whole columns, plus a sub-column offset.
+    // Shaped lines cover a few more columns than the panel, so most scrolling only moves them
+    const float  top       = 8.f + lineH;
+    const size_t first     = size_t(std::max(0.f, std::floor((panel.scrollY - top) / lineH)));
+    const float  advance   = std::max(1.f, g_code_text_cache.charAdvance());
+    const size_t first_col = size_t(std::max(0.f, panel.scrollX) / advance);
+    const float  xoff      = x0 - (panel.scrollX - first_col * advance);
+
+    if (panel.highlightLine >= int64_t(first)) {
+        const float hy = contentR.top() + top + panel.highlightLine * lineH - panel.scrollY;
+        SkPaint mark;
+        mark.setColor(color_to_sk(Color(0x2F3A4AFFu)));
+        canvas->drawRect(SkRect::MakeLTRB(contentR.left(), hy - lineH * 0.8f, contentR.right(), hy + lineH * 0.2f), mark);
+    }
+
+    SkPaint paint;
+    paint.setAntiAlias(true);
+    float y = contentR.top() + top + first * lineH - panel.scrollY;
+    for (size_t i = first; i < doc.size() && y - lineH <= contentR.bottom(); i++, y += lineH) {
+        // One blob per color on the line, shaped once and reused every frame
+        const CodeLine& line = g_code_text_cache.line(i, first_col);
+        const float     lx   = xoff - g_code_text_cache.columnX(line, first_col);
+        for (const auto& run : line.runs) {
+            paint.setColor(color_to_sk(run.color));
+            canvas->drawTextBlob(run.blob, lx, y, paint);
         }
-        y += lineH;
     }
+    mem::Set(mem::MEM_RENDER, "code text cache", int64_t(g_code_text_cache.memoryBytes()));
 
     canvas->restore();
 }
@@ -0,0 +1,166 @@
+#include <atomic>
+#include <condition_variable>
+#include <cstring>
+#include <cmath>
+#include <mutex>
+#include <thread>
+
+#include "include/docs/SkPDFDocument.h"
+#include "include/svg/SkSVGCanvas.h"
+
+#include "headless.h"
+
+namespace graphics {
+
+ExportFormat exportFormatFromPath(const std::string& path) {
+    auto ends_with = [&](const char* ext) {
+        const size_t n = strlen(ext);
+        return path.size() >= n && path.compare(path.size() - n, n, ext) == 0;
+    };
+    if (ends_with(".svg")) return EXPORT_SVG;
+    if (ends_with(".pdf")) return EXPORT_PDF;
+    return EXPORT_PNG;
+}
+
+/**
+ * @brief Holds bytes of the raster budget every renderView shares, waiting until they are free. A
+ * surface bigger than the whole budget still gets drawn, just not next to any other.
+ */
+class RasterBudget {
+public:
+    RasterBudget(size_t bytes, size_t limit) : bytes(bytes) {
+        std::unique_lock<std::mutex> lock(mtx);
+        cv.wait(lock, [&] { return in_use == 0 || in_use + bytes <= limit; });
+        in_use += bytes;
+    }
+    ~RasterBudget() {
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+            in_use -= bytes;
+        }
+        cv.notify_all();
+    }
+
+private:
+    size_t bytes;
+
+    static inline std::mutex              mtx;
+    static inline std::condition_variable cv;
+    static inline size_t                  in_use = 0;
+};
+
+static void drawView(SkCanvas* canvas, GraphView& graph, const Camera& camera, SkFont& font, Color background, int width, int height) {
+    // Vector backends have nothing to clear, so paint the background as a rect
+    SkPaint bg;
+    bg.setColor(color_to_sk(background));
+    canvas->drawRect(SkRect::MakeWH(width, height), bg);
+
+    drawNodeGraph(canvas, graph, camera, font);
+}
+
+bool renderView(const ExportView& view, const HeadlessOpts& opts) {
+    if (view.module == nullptr || view.output_path.empty()) return false;
+
+    SkFont font = FontRegistry::Get().font(opts.font_family, opts.font_size);
+
+    // Lay out in this thread, there is nothing to keep responsive
+    LayoutOpts layout_opts;
+    layout_opts.background     = false;
+    layout_opts.origin         = vec2(0, 0);
+    // An export shows the whole hierarchy, at once
+    layout_opts.expand_depth   = UINT32_MAX;
+    layout_opts.nodes_per_pass = 0;
+
+    GraphView graph;
+    graph.module = view.module;
+    graph.layout = std::make_unique<LayoutEngine>(font, layout_opts);
+    // Once per distinct parameter set, so labels read the same as in the window
+    auto elaboration = std::make_shared<elab::Elaboration>();
+    elaboration->Build(view.module);
+    graph.layout->setRoot(view.module, nullptr, elaboration);
+    graph.snapshot = graph.layout->snapshot();
+    if (!graph.snapshot) return false;
+    graph.wires = routeWires(*graph.snapshot);
+
+    int    width  = view.width;
+    int    height = view.height;
+    Camera camera;
+    if (view.camera) {
+        camera = *view.camera;
+        if (width <= 0)  width  = 1920;
+        if (height <= 0) height = 1080;
+    } else {
+        // Fit the camera to the whole subtree
+        const AABB bounds = graph.snapshot->bounds;
+        const vec2 extent = bounds.Size() + vec2(2 * opts.margin, 2 * opts.margin);
+        if (width <= 0 || height <= 0) {
+            const float shrink = std::min(1.f, opts.max_size / std::max(extent.x, extent.y));
+            width  = std::max(1, int(std::ceil(extent.x * shrink)));
+            height = std::max(1, int(std::ceil(extent.y * shrink)));
+        }
+        camera.scale = std::min(width / extent.x, height / extent.y);
+        camera.pos   = bounds.Center() - vec2(width, height) / (2.f * camera.scale);
+    }
+
+    SkFILEWStream out(view.output_path.c_str());
+    if (!out.isValid()) return false;
+
+    switch (view.format) {
+        case EXPORT_PNG: {
+            RasterBudget budget(size_t(width) * size_t(height) * 4, opts.max_raster_bytes);
+            auto surface = SkSurfaces::Raster(SkImageInfo::MakeN32Premul(width, height));
+            if (!surface) return false;
+            drawView(surface->getCanvas(), graph, camera, font, opts.background, width, height);
+
+            SkPixmap pixmap;
+            if (!surface->peekPixels(&pixmap)) return false;
+            return SkPngEncoder::Encode(&out, pixmap, {});
+        }
+        case EXPORT_SVG: {
+            auto canvas = SkSVGCanvas::Make(SkRect::MakeWH(width, height), &out);
+            if (!canvas) return false;
+            drawView(canvas.get(), graph, camera, font, opts.background, width, height);
+            canvas.reset(); // the SVG is finished when the canvas goes away
+            return true;
+        }
+        case EXPORT_PDF: {
+            SkPDF::Metadata metadata;
+            metadata.fTitle   = view.module->name.c_str();
+            metadata.fCreator = "sv_project_visualizer";
+            auto document = SkPDF::MakeDocument(&out, metadata);
+            if (!document) return false;
+            drawView(document->beginPage(width, height), graph, camera, font, opts.background, width, height);
+            document->endPage();
+            document->close();
+            return true;
+        }
+    }
+    return false;
+}
+
+size_t renderViews(const std::vector<ExportView>& views, const HeadlessOpts& opts) {
+    int num_threads = opts.threads > 0 ? opts.threads : int(std::max(1u, std::thread::hardware_concurrency()));
+    num_threads = std::min<int>(num_threads, views.size());
+
+    std::atomic<size_t> next{0};
+    std::atomic<size_t> written{0};
+    auto work = [&]() {
+        for (size_t i = next++; i < views.size(); i = next++) {
+            try {
+                if (renderView(views[i], opts)) written++;
+                else std::cerr << "Could not write " << views[i].output_path << "\n";
+            } catch (const std::exception& e) {
+                std::cerr << "Could not render " << views[i].output_path << ": " << e.what() << "\n";
+            }
+        }
+    };
+
+    std::vector<std::thread> workers;
+    for (int i = 1; i < num_threads; i++) workers.emplace_back(work);
+    work();
+    for (auto& worker : workers) worker.join();
+
+    return written;
+}
+
+}
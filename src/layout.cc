@@ -0,0 +1,468 @@
+#include <algorithm>
+#include <functional>
+
+#include "layout.h"
+#include "mem_stats.h"
+#include "profiler.h"
+
+namespace graphics {
+
+// Elements of a range bigger than this start out collapsed, however shallow they are
+static constexpr size_t kExpandElementsUpTo = 16;
+
+LayoutEngine::LayoutEngine(const SkFont& font, const LayoutOpts& options) : font(font), options(options) {
+    if (this->options.line_height <= 0.f) {
+        this->options.line_height = font.getSize() * 1.35f;
+    }
+    // Colors used to tell module types apart when zoomed out
+    type_colors = {
+        Color(0xFF595EFFu), Color(0xFFCA3AFFu), Color(0x8AC926FFu), Color(0x1982C4FFu),
+        Color(0x6A4C93FFu), Color(0xF28482FFu), Color(0x84A59DFFu), Color(0xF6BD60FFu),
+    };
+    // Unchanged is dimmed, so the changes stand out at every zoom level
+    diff_colors = {Color(0x5A5A5AFFu), Color(0x8AC926FFu), Color(0xFF595EFFu), Color(0xFFCA3AFFu)};
+
+    if (this->options.background) {
+        worker = std::thread(&LayoutEngine::threadLoop, this);
+    }
+}
+
+LayoutEngine::~LayoutEngine() {
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        stopping = true;
+    }
+    cv.notify_all();
+    if (worker.joinable()) worker.join();
+}
+
+void LayoutEngine::setRoot(SV::Module* root, const diff::ModuleDiff* diff, std::shared_ptr<const elab::Elaboration> elaboration) {
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        // A new root makes everything queued before it pointless
+        requests.clear();
+    }
+    Request request{Request::SET_ROOT, root};
+    request.diff        = diff;
+    request.elaboration = std::move(elaboration);
+    push(request);
+}
+
+size_t LayoutSnapshot::memoryBytes() const {
+    return items.capacity() * sizeof(GraphItem) + item_of_node.capacity() * sizeof(uint32_t) + index.memoryBytes() + label_bytes;
+}
+
+void LayoutEngine::setExpanded(NodeId id, bool expanded) {
+    push({Request::SET_EXPANDED, nullptr, id, expanded});
+}
+
+void LayoutEngine::toggleExpanded(NodeId id) {
+    push({Request::TOGGLE, nullptr, id});
+}
+
+void LayoutEngine::reveal(const std::vector<uint32_t>& path) {
+    Request request{Request::REVEAL};
+    request.path = path;
+    push(request);
+}
+
+void LayoutEngine::push(const Request& request) {
+    if (!options.background) {
+        std::deque<Request> batch = {request};
+        process(batch);
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        requests.push_back(request);
+    }
+    cv.notify_one();
+}
+
+std::shared_ptr<const LayoutSnapshot> LayoutEngine::snapshot() const {
+    std::lock_guard<std::mutex> lock(mtx);
+    return latest;
+}
+
+void LayoutEngine::waitIdle() {
+    std::unique_lock<std::mutex> lock(mtx);
+    cv_idle.wait(lock, [this] { return requests.empty() && !working; });
+}
+
+void LayoutEngine::threadLoop() {
+    while (true) {
+        std::deque<Request> batch;
+        {
+            std::unique_lock<std::mutex> lock(mtx);
+            cv.wait(lock, [this] { return stopping || !requests.empty(); });
+            if (stopping) return;
+            batch.swap(requests);
+            working = true;
+        }
+
+        process(batch);
+
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+            working = false;
+        }
+        cv_idle.notify_all();
+    }
+}
+
+void LayoutEngine::process(std::deque<Request>& batch) {
+    PROFILE_SCOPE("layout");
+
+    // Apply everything that piled up, then lay out and publish once
+    for (const auto& request : batch) apply(request);
+    do {
+        budget = options.nodes_per_pass > 0 ? options.nodes_per_pass : SIZE_MAX;
+        unfinished.clear();
+        if (root_node != kNoNode) {
+            layoutSubtree(root_node);
+        }
+        // Whatever did not fit is created next pass, the ones created so far are already laid out
+        for (NodeId id : unfinished) markLayoutDirty(id);
+    } while (!options.background && !unfinished.empty());
+    publish();
+
+    // Queued behind whatever the user asked for meanwhile, so a big expansion never holds up a click
+    if (!unfinished.empty()) push({Request::MATERIALIZE});
+}
+
+void LayoutEngine::apply(const Request& request) {
+    switch (request.type) {
+        case Request::SET_ROOT:
+            pool.Clear();
+            // Old snapshots keep the old labels alive for as long as they need them
+            // Nothing of the last snapshot carries over to a new graph
+            published   = nullptr;
+            labels      = std::make_shared<std::deque<NodeLabel>>();
+            label_bytes = 0;
+            elaboration = request.elaboration;
+            // An elaboration of some other top says nothing about this root
+            if (elaboration && (elaboration->Top() == elab::kNoSpec || elaboration->Get(elaboration->Top()).module != request.root)) {
+                elaboration = nullptr;
+            }
+            root_node = request.root ? createNode(request.root, "", elaboration ? elaboration->Top() : elab::kNoSpec) : kNoNode;
+            diffing   = request.diff != nullptr;
+            if (root_node != kNoNode) pool[root_node].expanded = options.expand_depth > 0;
+            if (root_node != kNoNode && diffing) setDiffStatus(root_node, request.diff->status, request.diff);
+            break;
+
+        case Request::SET_EXPANDED:
+        case Request::TOGGLE: {
+            if (request.node >= pool.size()) return;
+            const bool expanded = request.type == Request::TOGGLE ? !pool[request.node].expanded : request.expanded;
+            if (expanded == pool[request.node].expanded) return;
+
+            pool[request.node].expanded = expanded;
+            pool.MarkDirty(request.node);
+            markLayoutDirty(request.node);
+            break;
+        }
+
+        case Request::REVEAL: {
+            NodeId id = root_node;
+            for (size_t k = 0; k < request.path.size() && id != kNoNode; k++) {
+                expandNode(id);
+
+                NodeId child = pool[id].first_child;
+                for (uint32_t i = 0; i < request.path[k] && child != kNoNode; i++) child = pool[child].next_sibling;
+                id = child;
+
+                // Deeper than a range, go on through its first element
+                if (id != kNoNode && pool[id].is_range && k + 1 < request.path.size()) {
+                    expandNode(id);
+                    id = pool[id].first_child;
+                }
+            }
+            break;
+        }
+
+        case Request::MATERIALIZE:
+            // Nothing to apply, the pass itself goes on creating the nodes
+            break;
+    }
+}
+
+NodeId LayoutEngine::createNode(SV::Module* module, const std::string& instance_name, uint32_t spec) {
+    if (budget > 0) budget--;
+
+    // Shaped once here, drawing it every frame is then just the glyphs. With its parameter values, as
+    // far as they are known, so the configurations of one module tell apart.
+    const std::string name = spec != elab::kNoSpec ? elaboration->Describe(spec) : module->name;
+    labels->push_back({name + " (" + instance_name + ")", nullptr});
+    NodeLabel& label = labels->back();
+    label.blob       = SkTextBlob::MakeFromText(label.text.data(), label.text.size(), font, SkTextEncoding::kUTF8);
+    label_bytes     += sizeof(NodeLabel) + size_t(mem::StringBytes(label.text));
+
+    NodeId id = pool.Create();
+    pool[id].module     = module;
+    pool[id].label      = &label;
+    pool[id].spec       = spec;
+    pool[id].type_color = type_colors[std::hash<std::string>{}(module->name) % type_colors.size()];
+    pool.SetSize(id, vec2(font.measureText(label.text.data(), label.text.size(), SkTextEncoding::kUTF8), options.line_height));
+    return id;
+}
+
+void LayoutEngine::initChild(NodeId parent, NodeId child) {
+    pool.AddChild(parent, child);
+    pool[child].expanded = pool[child].depth < options.expand_depth;
+}
+
+void LayoutEngine::expandNode(NodeId id) {
+    if (!pool[id].expanded) {
+        pool[id].expanded = true;
+        pool.MarkDirty(id);
+        markLayoutDirty(id);
+    }
+    if (!pool[id].children_built) {
+        // The path goes through these children, so they are all needed now
+        const size_t left = budget;
+        budget = SIZE_MAX;
+        buildChildren(id);
+        budget = left;
+        markLayoutDirty(id);
+    }
+}
+
+bool LayoutEngine::isRecursive(NodeId parent, const SV::Module* module) const {
+    // A range node has the module of its elements, it is not an instantiation of its own
+    for (NodeId a = parent; a != kNoNode; a = pool[a].parent) {
+        if (!pool[a].is_range && pool[a].module == module) return true;
+    }
+    return false;
+}
+
+size_t LayoutEngine::numElements(NodeId parent, const SV::ModuleInstance& instance) const {
+    // Resolved with the parameters of this very parent, not with the defaults of its module
+    if (parent != kNoNode && pool[parent].spec != elab::kNoSpec && pool[parent].module == instance.parent) {
+        const elab::Specialization& s = elaboration->Get(pool[parent].spec);
+        const size_t                i = size_t(&instance - instance.parent->dependencies.data());
+        if (i < s.elements.size()) return s.elements[i];
+    }
+    return SV::NumElements(instance);
+}
+
+void LayoutEngine::buildChildren(NodeId id) {
+    if (pool[id].is_range) return buildElements(id);
+
+    SV::Module*             module = pool[id].module;
+    const diff::ModuleDiff* d      = pool[id].diff;
+    // Goes on where the last pass ran out of budget
+    for (size_t i = pool[id].materialized; i < module->dependencies.size(); i++, pool[id].materialized++) {
+        if (budget == 0) return;
+        const SV::ModuleInstance& dependency = module->dependencies[i];
+        // A module that (indirectly) instantiates itself would never end, so stop at the repeat
+        const bool recursive = isRecursive(id, dependency.module);
+
+        const uint32_t spec  = pool[id].spec != elab::kNoSpec ? elaboration->Get(pool[id].spec).children[i] : elab::kNoSpec;
+        const auto     count = dependency.range >= 0 ? std::optional<size_t>(numElements(id, dependency)) : std::nullopt;
+        NodeId         child = createNode(dependency.module, SV::InstanceLabel(dependency, count), spec);
+        pool[child].instance = &dependency;
+        initChild(id, child);
+        if (d) {
+            setDiffStatus(child, d->children[i].status, d->children[i].diff);
+        } else if (diffing) {
+            // Everything under an added instance is new, everything under an unchanged one is the same
+            setDiffStatus(child, pool[id].diff_status == diff::DIFF_ADDED ? diff::DIFF_ADDED : diff::DIFF_SAME, nullptr);
+        }
+        if (dependency.range >= 0) {
+            // One box for the whole range, the elements are only created when it is expanded
+            pool[child].is_range = true;
+            pool[child].expanded = false;
+        } else if (recursive) {
+            pool[child].expanded       = false;
+            pool[child].children_built = true;
+        }
+    }
+    pool[id].children_built = true;
+    if (d) buildRemoved(id);
+}
+
+void LayoutEngine::buildRemoved(NodeId id) {
+    // Instances that are only in the base revision, collapsed since there is nothing of them to expand into
+    const diff::ModuleDiff* d = pool[id].diff;
+    for (const diff::ChildDiff& change : d->children) {
+        if (change.status != diff::DIFF_REMOVED) continue;
+
+        const SV::ModuleInstance& dependency = d->old_module->dependencies[change.old_dep];
+        NodeId child = createNode(dependency.module, SV::InstanceLabel(dependency));
+        pool[child].instance = &dependency;
+        initChild(id, child);
+        pool[child].expanded       = false;
+        pool[child].children_built = true;
+        setDiffStatus(child, diff::DIFF_REMOVED, nullptr);
+    }
+}
+
+void LayoutEngine::setDiffStatus(NodeId id, diff::Status status, const diff::ModuleDiff* diff) {
+    pool[id].diff_status = status;
+    pool[id].diff        = status == diff::DIFF_MODIFIED ? diff : nullptr;
+    pool[id].color       = diff_colors[status];
+    pool[id].type_color  = diff_colors[status];
+}
+
+void LayoutEngine::buildElements(NodeId id) {
+    const SV::ModuleInstance* instance  = pool[id].instance;
+    const bool                recursive = isRecursive(id, instance->module);
+    const size_t              count     = numElements(pool[id].parent, *instance);
+    for (size_t e = pool[id].materialized; e < count; e++, pool[id].materialized++) {
+        if (budget == 0) return;
+        NodeId child = createNode(instance->module, SV::ElementName(*instance, e), pool[id].spec);
+        pool[child].instance = instance;
+        pool[child].element  = int32_t(e);
+        initChild(id, child);
+        // Every element changed the way the range did
+        if (diffing) setDiffStatus(child, pool[id].diff_status, pool[id].diff);
+        if (recursive) {
+            pool[child].expanded       = false;
+            pool[child].children_built = true;
+        } else if (count > kExpandElementsUpTo) {
+            pool[child].expanded = false;
+        }
+    }
+    pool[id].children_built = true;
+}
+
+void LayoutEngine::markLayoutDirty(NodeId id) {
+    for (NodeId n = id; n != kNoNode; n = pool[n].parent) {
+        pool[n].layout_dirty = true;
+    }
+}
+
+void LayoutEngine::layoutSubtree(NodeId id) {
+    if (!pool[id].layout_dirty) return;
+
+    // Children are created the first time they are needed, as many as the budget of the pass allows.
+    // Creating nodes can move the pool, so nodes are always looked up again by id below.
+    if (pool[id].expanded && !pool[id].children_built) {
+        buildChildren(id);
+        if (!pool[id].children_built) unfinished.push_back(id);
+    }
+
+    const vec2 size   = pool[id].rec_size;
+    float band_top    = 0.f;
+    float band_bottom = size.y;
+
+    if (pool[id].expanded && pool[id].num_children > 0) {
+        // Stack the child subtrees below each other, then center them on this node
+        float y = 0.f;
+        for (NodeId c = pool[id].first_child; c != kNoNode; c = pool[c].next_sibling) {
+            layoutSubtree(c);
+            pool.SetRelPos(c, vec2(size.x + options.gap_x, y - pool[c].band_top));
+            y += pool[c].band_bottom - pool[c].band_top + options.gap_y;
+        }
+        const float span   = y - options.gap_y;
+        const float offset = (size.y - span) * 0.5f;
+        for (NodeId c = pool[id].first_child; c != kNoNode; c = pool[c].next_sibling) {
+            pool.SetRelPos(c, pool[c].rel_pos + vec2(0, offset));
+        }
+
+        band_top    = std::min(0.f, offset);
+        band_bottom = std::max(size.y, offset + span);
+    }
+
+    pool[id].band_top     = band_top;
+    pool[id].band_bottom  = band_bottom;
+    pool[id].layout_dirty  = false;
+    pool[id].publish_dirty = true;
+}
+
+void LayoutEngine::publish() {
+    auto snap = std::make_shared<LayoutSnapshot>();
+    snap->generation  = ++generation;
+    snap->labels      = labels;
+    snap->label_bytes = label_bytes;
+
+    if (root_node != kNoNode) {
+        // Put the top of the whole graph at the origin
+        pool.SetRelPos(root_node, options.origin - vec2(0, pool[root_node].band_top));
+
+        snap->item_of_node.assign(pool.size(), UINT32_MAX);
+        snap->items.reserve(last_items);
+
+        // A subtree nothing changed in since the last snapshot is the same run of items there, at most
+        // moved as a whole because something above or before it grew or shrank
+        const LayoutSnapshot* prev = published.get();
+
+        struct Entry { NodeId id; vec2 parent_pos; uint32_t parent_item; };
+        std::vector<Entry>    stack = {{root_node, vec2(0, 0), UINT32_MAX}};
+        std::vector<uint32_t> parent_item;
+        parent_item.reserve(last_items);
+        while (!stack.empty()) {
+            Entry e = stack.back();
+            stack.pop_back();
+
+            NodeGraph& node = pool[e.id];
+            const vec2     pos  = e.parent_pos + node.rel_pos;
+            const uint32_t item = uint32_t(snap->items.size());
+
+            const uint32_t old = prev && !node.publish_dirty && e.id < prev->item_of_node.size() ? prev->item_of_node[e.id] : UINT32_MAX;
+            if (old != UINT32_MAX) {
+                const uint32_t end   = prev->items[old].subtree_end;
+                const vec2     delta = pos - prev->items[old].box.ul;
+                const int64_t  shift = int64_t(item) - int64_t(old);
+                snap->items.insert(snap->items.end(), prev->items.begin() + old, prev->items.begin() + end);
+                for (uint32_t i = item; i < snap->items.size(); i++) {
+                    GraphItem& copy = snap->items[i];
+                    copy.box         = AABB(copy.box.ul + delta, copy.box.br + delta);
+                    copy.subtree     = AABB(copy.subtree.ul + delta, copy.subtree.br + delta);
+                    copy.subtree_end = uint32_t(int64_t(copy.subtree_end) + shift);
+                    snap->item_of_node[copy.node] = i;
+                    // Only the end of the copied root is worked out below, the rest is already right
+                    parent_item.push_back(i == item ? e.parent_item : item);
+                }
+                continue;
+            }
+            node.publish_dirty = false;
+
+            const AABB tree = pool.GetAABB(e.id);
+            snap->item_of_node[e.id] = item;
+            snap->items.push_back({e.id, AABB(pos, pos + node.rec_size), AABB(tree.ul + pos, tree.br + pos), item + 1,
+                                   node.module, node.instance, node.label, node.color, node.type_color, node.depth, node.expanded,
+                                   node.children_built ? node.num_children > 0 : node.is_range || !node.module->dependencies.empty(),
+                                   node.is_range});
+            parent_item.push_back(e.parent_item);
+
+            if (!node.expanded) continue;
+            // Reversed on the stack, so children come out in order
+            const size_t mark = stack.size();
+            for (NodeId c = node.first_child; c != kNoNode; c = pool[c].next_sibling) stack.push_back({c, pos, item});
+            std::reverse(stack.begin() + mark, stack.end());
+        }
+
+        // Children come after their parents, so going backwards every subtree is done before its parent
+        for (size_t i = snap->items.size(); i-- > 1;) {
+            auto& parent = snap->items[parent_item[i]];
+            parent.subtree_end = std::max(parent.subtree_end, snap->items[i].subtree_end);
+        }
+
+        AABB bb = pool.GetAABB(root_node);
+        snap->bounds = AABB(bb.ul + pool[root_node].rel_pos, bb.br + pool[root_node].rel_pos);
+
+        // Refit the index of the last snapshot to where its items went, only what is new is built
+        std::vector<AABB> boxes(snap->items.size());
+        for (size_t i = 0; i < snap->items.size(); i++) boxes[i] = snap->items[i].box;
+        if (prev) {
+            std::vector<uint32_t> remap(prev->items.size(), UINT32_MAX);
+            for (size_t i = 0; i < prev->items.size(); i++) {
+                const NodeId id = prev->items[i].node;
+                if (id < snap->item_of_node.size()) remap[i] = snap->item_of_node[id];
+            }
+            snap->index = prev->index;
+            snap->index.update(remap, boxes);
+        } else {
+            snap->index.update({}, boxes);
+        }
+    }
+    last_items = snap->items.size();
+
+    std::lock_guard<std::mutex> lock(mtx);
+    latest    = snap;
+    published = std::move(snap);
+}
+
+}
@@ -0,0 +1,74 @@
+#include <algorithm>
+#include <cstring>
+#include <mutex>
+#include <unordered_map>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include "line_index.h"
+#include "mapped_file.h"
+#include "mem_stats.h"
+#include "profiler.h"
+
+namespace SV {
+
+void LineIndex::Build(std::string_view source) {
+    line_starts.assign(1, 0);
+
+    const char*  data = source.data();
+    const size_t size = source.size();
+    size_t       i    = 0;
+
+#if defined(__SSE2__)
+    // Compare 16 bytes against '\n' at once, then walk the set bits of the mask
+    const __m128i newline = _mm_set1_epi8('\n');
+    for (; i + 16 <= size; i += 16) {
+        const __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+        uint32_t      mask  = uint32_t(_mm_movemask_epi8(_mm_cmpeq_epi8(chunk, newline)));
+        while (mask) {
+            line_starts.push_back(i + __builtin_ctz(mask) + 1);
+            mask &= mask - 1;
+        }
+    }
+#endif
+
+    // Tail, or everything without SSE2. memchr is vectorized by the C library.
+    while (i < size) {
+        const void* hit = std::memchr(data + i, '\n', size - i);
+        if (!hit) break;
+        i = size_t(static_cast<const char*>(hit) - data) + 1;
+        line_starts.push_back(i);
+    }
+}
+
+LineCol LineIndex::Locate(size_t offset) const {
+    // Last line start at or before offset
+    auto it = std::upper_bound(line_starts.begin(), line_starts.end(), offset);
+    const size_t line = size_t(it - line_starts.begin()) - 1;
+    return {line, offset - line_starts[line]};
+}
+
+std::shared_ptr<const LineIndex> GetFileLineIndex(const std::string& path) {
+    static std::mutex mtx;
+    static std::unordered_map<std::string, std::shared_ptr<const LineIndex>> cache;
+
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        auto it = cache.find(path);
+        if (it != cache.end()) return it->second;
+    }
+
+    PROFILE_SCOPE("GetFileLineIndex");
+    const auto file = GetSourceFile(path);
+    if (!file || !file->Intact()) return nullptr;
+    auto index = std::make_shared<const LineIndex>(file->Text());
+
+    std::lock_guard<std::mutex> lock(mtx);
+    auto [it, inserted] = cache.emplace(path, index);
+    if (inserted) mem::Add(mem::MEM_DOCS, "line indexes", int64_t(index->MemoryBytes()));
+    return it->second;
+}
+
+}
@@ -2,38 +2,93 @@
 #include "graphics.h"
 #include "cst.h"
 #include <symbol_table.h>
+#include "project_loader.h"
 
 int main(int argc, char** argv) {
-    if (argc < 2) { std::cerr << "usage: sv_cst_test <file.sv> [file_2.sv ...]\n"; return 2; }
+    if (argc < 2) { std::cerr << "usage: sv_cst_test [--db=<design.db>] [--base=<design.db>] [--mem-report] <file.sv> [file_2.sv ...]\n"; return 2; }
 
-    // Initialize the window
-    graphics::initWindow(1920, 1080, true); 
+    // --db=<path> keeps the parsed hierarchy in a design database, --base=<path> colors the graph by
+    // what changed since the revision in another one, --mem-report prints where the memory went on
+    // exit, the rest are files to parse
+    std::string              db_path;
+    std::string              base_path;
+    bool                     mem_report = false;
+    std::vector<std::string> files;
+    for (int i = 1; i < argc; i++) {
+        const std::string arg = argv[i];
+        if      (arg.rfind("--db=", 0) == 0)   db_path    = ResolveUserPath(arg.substr(5).c_str());
+        else if (arg.rfind("--base=", 0) == 0) base_path  = ResolveUserPath(arg.substr(7).c_str());
+        else if (arg == "--mem-report")        mem_report = true;
+        else                                   files.push_back(arg);
+    }
+    if (mem_report) mem::SetEnabled(true);
+
+    // Profile from the start, including the parse, if asked to
+    if (std::getenv("SV_PROFILE")) prof::SetEnabled(true);
+
+    // Scan the font database in the background while the project is parsed
+    graphics::FontRegistry::Get().warmUp();
 
     // Create runfile
     std::string error;
     auto* rf = bazel::tools::cpp::runfiles::Runfiles::Create(argv[0], &error);
     if (!rf) { std::cerr << "runfiles error: " << error << "\n"; return 1; }
 
-    // Parse and colorize a .sv file
-    sv::ColorizedDoc g_doc = sv::ColorizeFileViaBazelRunfiles(argv[1], rf, {});
-    std::cout << "g_doc size: " << g_doc.size() << "\n";;
+    // Load the project in the background
+    sv::ProjectLoader loader;
+    loader.setDatabase(db_path);
+    loader.setBaseDatabase(base_path);
+    loader.start(files, rf);
 
-    for (auto& line : g_doc) {
-        for (auto& word : line) {
-            std::cout << word;
+    // Initialize the window while the project is parsed
+    graphics::initWindow(1920, 1080, true); 
+    graphics::setOpenFileHandler([&loader](const std::string& file) { loader.openFile(file); });
+
+    sv::ColorizedDoc g_doc;
+    SV::Module*      root        = nullptr;
+    bool             interactive = false;
+
+    // Main loop, the loaded model is swapped in as it becomes ready
+    while (graphics::updateWindow(root, g_doc)) {
+        if (auto loaded = loader.takeDoc()) {
+            g_doc = std::move(loaded->doc);
+            std::cout << "g_doc size: " << g_doc.size() << "\n";
+            mem::Set(mem::MEM_DOCS, "code panel document", int64_t(sv::DocBytes(g_doc)));
+            graphics::setCodePanelFile(loaded->file);
+            graphics::invalidateWindow();
+        }
+        if (auto top = loader.takeRoot()) {
+            root = *top;
+            graphics::setSearchIndex(loader.searchIndex());
+            graphics::setHierarchyDiff(loader.diff());
+            graphics::setElaboration(loader.elaboration());
+            graphics::invalidateWindow();
         }
-        std::cout << "\n";
+
+        const sv::LoadProgress progress = loader.progress();
+        if (progress.state == sv::LOAD_RUNNING) {
+            const std::string text = progress.phase + " (" + std::to_string(progress.files_done) + "/" + std::to_string(progress.files_total) + ")";
+            graphics::setLoadStatus(true, text, progress.fraction());
+        } else if (progress.state == sv::LOAD_FAILED) {
+            graphics::setLoadStatus(true, "Loading failed: " + progress.error, 1.f);
+        } else {
+            graphics::setLoadStatus(false);
+        }
+
+        // Whatever the viewer uses on top of the loaded project shows up as a phase of its own
+        if (!interactive && progress.state != sv::LOAD_RUNNING) {
+            mem::BeginPhase("Interactive");
+            interactive = true;
+        }
+    }
+
+    // Closing the window while loading stops the load
+    loader.cancel();
+
+    if (mem_report) {
+        mem::EndPhase();
+        mem::WriteReport(std::cout);
     }
-    
-    // Parse json
-    size_t num_files = argc - 1;
-    json cst_json = cst::ParseFiles(num_files, &argv[1], rf); // Assumes that all parameters passed are files to parse
-
-    // Parse CST json file
-    SV::Module* root = cst::ParseCST(cst_json);
-    
-    // Main loop
-    while (graphics::updateWindow(root, g_doc)) {} // TODO: make it so that there is a start and end thing so i can put stuff here perhaps
 
     return 0;
 }
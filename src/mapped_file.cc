@@ -0,0 +1,98 @@
+#include <mutex>
+#include <unordered_map>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "mapped_file.h"
+#include "mem_stats.h"
+#include "profiler.h"
+
+namespace SV {
+
+namespace {
+
+int64_t MtimeNs(const struct stat& st) {
+    return int64_t(st.st_mtim.tv_sec) * 1000000000 + int64_t(st.st_mtim.tv_nsec);
+}
+
+}
+
+std::shared_ptr<const MappedFile> MappedFile::Open(const std::string& path) {
+    PROFILE_SCOPE("MappedFile::Open");
+
+    const int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) return nullptr;
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode)) {
+        close(fd);
+        return nullptr;
+    }
+
+    std::shared_ptr<MappedFile> file(new MappedFile);
+    file->path     = path;
+    file->size     = size_t(st.st_size);
+    file->mtime_ns = MtimeNs(st);
+    file->dev      = uint64_t(st.st_dev);
+    file->ino      = uint64_t(st.st_ino);
+
+    // An empty file cannot be mapped, it is an empty view instead
+    if (file->size > 0) {
+        void* mapping = mmap(nullptr, file->size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (mapping == MAP_FAILED) {
+            close(fd);
+            return nullptr;
+        }
+        // Every reader goes front to back
+        madvise(mapping, file->size, MADV_SEQUENTIAL);
+        file->mapping = mapping;
+    }
+    close(fd);
+    return file;
+}
+
+MappedFile::~MappedFile() {
+    if (mapping) munmap(mapping, size);
+}
+
+bool MappedFile::Intact() const {
+    struct stat st;
+    if (stat(path.c_str(), &st) != 0) return true;
+    if (uint64_t(st.st_dev) != dev || uint64_t(st.st_ino) != ino) return true;
+    return SameAs(uint64_t(st.st_size), MtimeNs(st));
+}
+
+std::shared_ptr<const MappedFile> GetSourceFile(const std::string& path) {
+    static std::mutex mtx;
+    static std::unordered_map<std::string, std::shared_ptr<const MappedFile>> cache;
+    static int64_t mapped = 0; // bytes of the cached files, kept up to date on every insert
+
+    // Editors usually write a new file and rename it over the old one, the old mapping then stays
+    // valid for whoever still holds it
+    struct stat st;
+    if (stat(path.c_str(), &st) != 0) return nullptr;
+
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        auto it = cache.find(path);
+        if (it != cache.end() && it->second->SameAs(uint64_t(st.st_size), MtimeNs(st))) return it->second;
+    }
+
+    auto file = MappedFile::Open(path);
+    if (!file) return nullptr;
+
+    std::lock_guard<std::mutex> lock(mtx);
+    auto& entry = cache[path];
+    if (entry) mapped -= int64_t(entry->Size());
+    entry = file;
+    mapped += int64_t(file->Size());
+
+    // Page cache and not heap, but it is what the project costs in address space
+    mem::Set(mem::MEM_DOCS, "mapped sources", mapped);
+    return file;
+}
+
+}
@@ -0,0 +1,278 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <mutex>
+
+#include "mem_stats.h"
+
+namespace mem {
+
+namespace {
+
+// Bookkeeping of the allocator per heap block, and of a std::map or unordered_map node
+constexpr int64_t kBlockOverhead = 16;
+constexpr int64_t kNodeOverhead  = 32;
+
+struct Source {
+    int64_t current = 0;
+    int64_t peak    = 0;
+};
+
+struct MemState {
+    std::mutex mtx;
+
+    std::map<std::pair<int, std::string>, Source> sources;
+    int64_t subsystem_current[MEM_NUM_SUBSYSTEMS] = {};
+    int64_t subsystem_peak[MEM_NUM_SUBSYSTEMS]    = {};
+
+    bool                                  in_phase = false;
+    PhaseMemory                           phase;
+    std::chrono::steady_clock::time_point phase_start;
+    std::vector<PhaseMemory>              phases;
+
+    // VmHWM is reset at the start of every phase, so the peak of the whole run is kept here
+    int64_t process_peak = 0;
+};
+
+std::atomic<bool> g_enabled{false};
+
+MemState& State() {
+    static MemState state;
+    return state;
+}
+
+// Value of a "Name:   1234 kB" line of /proc/self/status, in bytes
+int64_t ReadStatusField(const char* field) {
+    std::ifstream status("/proc/self/status");
+    std::string   line;
+    const size_t  len = std::strlen(field);
+    while (std::getline(status, line)) {
+        if (line.compare(0, len, field) == 0 && line.size() > len && line[len] == ':') {
+            return std::atoll(line.c_str() + len + 1) * 1024;
+        }
+    }
+    return 0;
+}
+
+// Make VmHWM start over from the current RSS, so it becomes the peak of what comes next.
+// Supported since Linux 4.0, where it fails the peak of the whole run is reported instead.
+void ResetPeakRSS() {
+    if (FILE* f = std::fopen("/proc/self/clear_refs", "w")) {
+        std::fputs("5", f);
+        std::fclose(f);
+    }
+}
+
+void Apply(MemState& state, Subsystem subsystem, const char* source, int64_t delta, bool absolute) {
+    Source& s = state.sources[{int(subsystem), source}];
+    if (absolute) delta -= s.current;
+    s.current += delta;
+    s.peak     = std::max(s.peak, s.current);
+
+    state.subsystem_current[subsystem] += delta;
+    state.subsystem_peak[subsystem]     = std::max(state.subsystem_peak[subsystem], state.subsystem_current[subsystem]);
+}
+
+void EndPhaseLocked(MemState& state) {
+    if (!state.in_phase) return;
+
+    state.phase.rss_end  = CurrentRSS();
+    state.phase.rss_peak = std::max(ReadStatusField("VmHWM"), state.phase.rss_end);
+    state.phase.seconds  = std::chrono::duration<double>(std::chrono::steady_clock::now() - state.phase_start).count();
+    state.process_peak   = std::max(state.process_peak, state.phase.rss_peak);
+    state.phases.push_back(state.phase);
+    state.in_phase = false;
+}
+
+std::string Megabytes(int64_t bytes) {
+    char buf[32];
+    std::snprintf(buf, sizeof(buf), "%.1f MB", double(bytes) / (1024.0 * 1024.0));
+    return buf;
+}
+
+} // namespace
+
+const char* SubsystemName(Subsystem subsystem) {
+    switch (subsystem) {
+        case MEM_CST:    return "cst";
+        case MEM_DESIGN: return "design";
+        case MEM_DOCS:   return "documents";
+        case MEM_RENDER: return "render";
+        default:         return "?";
+    }
+}
+
+void SetEnabled(bool enabled) {
+    g_enabled.store(enabled, std::memory_order_relaxed);
+}
+
+bool Enabled() {
+    return g_enabled.load(std::memory_order_relaxed);
+}
+
+void Set(Subsystem subsystem, const char* source, int64_t bytes) {
+    MemState& state = State();
+    std::lock_guard<std::mutex> lock(state.mtx);
+    Apply(state, subsystem, source, bytes, true);
+}
+
+void Add(Subsystem subsystem, const char* source, int64_t delta) {
+    MemState& state = State();
+    std::lock_guard<std::mutex> lock(state.mtx);
+    Apply(state, subsystem, source, delta, false);
+}
+
+std::vector<SourceStats> GetSourceStats() {
+    MemState& state = State();
+    std::lock_guard<std::mutex> lock(state.mtx);
+
+    std::vector<SourceStats> out;
+    for (const auto& [key, s] : state.sources) out.push_back({Subsystem(key.first), key.second, s.current, s.peak});
+    return out;
+}
+
+std::vector<SubsystemStats> GetSubsystemStats() {
+    MemState& state = State();
+    std::lock_guard<std::mutex> lock(state.mtx);
+
+    std::vector<SubsystemStats> out;
+    for (int i = 0; i < MEM_NUM_SUBSYSTEMS; i++) out.push_back({Subsystem(i), state.subsystem_current[i], state.subsystem_peak[i]});
+    return out;
+}
+
+int64_t CurrentRSS() {
+    return ReadStatusField("VmRSS");
+}
+
+int64_t PeakRSS() {
+    MemState& state = State();
+    std::lock_guard<std::mutex> lock(state.mtx);
+    return std::max(state.process_peak, ReadStatusField("VmHWM"));
+}
+
+void BeginPhase(const std::string& name) {
+    MemState& state = State();
+    std::lock_guard<std::mutex> lock(state.mtx);
+    EndPhaseLocked(state);
+
+    state.process_peak = std::max(state.process_peak, ReadStatusField("VmHWM"));
+    ResetPeakRSS();
+
+    state.in_phase        = true;
+    state.phase           = PhaseMemory();
+    state.phase.name      = name;
+    state.phase.rss_start = CurrentRSS();
+    state.phase_start     = std::chrono::steady_clock::now();
+}
+
+void EndPhase() {
+    MemState& state = State();
+    std::lock_guard<std::mutex> lock(state.mtx);
+    EndPhaseLocked(state);
+}
+
+std::vector<PhaseMemory> GetPhases() {
+    MemState& state = State();
+    std::lock_guard<std::mutex> lock(state.mtx);
+    return state.phases;
+}
+
+void WriteReport(std::ostream& out) {
+    char row[160];
+
+    out << "Memory by subsystem (estimated heap bytes)\n";
+    std::snprintf(row, sizeof(row), "  %-28s %12s %12s\n", "", "current", "peak");
+    out << row;
+    const auto sources = GetSourceStats();
+    for (const auto& sub : GetSubsystemStats()) {
+        std::snprintf(row, sizeof(row), "  %-28s %12s %12s\n", SubsystemName(sub.subsystem),
+                      Megabytes(sub.current).c_str(), Megabytes(sub.peak).c_str());
+        out << row;
+        for (const auto& s : sources) {
+            if (s.subsystem != sub.subsystem) continue;
+            std::snprintf(row, sizeof(row), "    %-26s %12s %12s\n", s.name.c_str(),
+                          Megabytes(s.current).c_str(), Megabytes(s.peak).c_str());
+            out << row;
+        }
+    }
+
+    out << "Resident set size per phase\n";
+    std::snprintf(row, sizeof(row), "  %-40s %9s %12s %12s %12s\n", "phase", "seconds", "start", "end", "peak");
+    out << row;
+    for (const auto& p : GetPhases()) {
+        std::snprintf(row, sizeof(row), "  %-40.40s %9.3f %12s %12s %12s\n", p.name.c_str(), p.seconds,
+                      Megabytes(p.rss_start).c_str(), Megabytes(p.rss_end).c_str(), Megabytes(p.rss_peak).c_str());
+        out << row;
+    }
+    out << "Resident set size now " << Megabytes(CurrentRSS()) << ", peak " << Megabytes(PeakRSS()) << "\n";
+}
+
+int64_t JsonBytes(const json& root) {
+    // Explicit stack, CSTs nest deep enough to worry about recursion
+    int64_t                  bytes = 0;
+    std::vector<const json*> stack{&root};
+    while (!stack.empty()) {
+        const json* j = stack.back();
+        stack.pop_back();
+
+        switch (j->type()) {
+            case json::value_t::object: {
+                const auto& obj = j->get_ref<const json::object_t&>();
+                bytes += int64_t(sizeof(json::object_t)) + kBlockOverhead;
+                for (const auto& [key, value] : obj) {
+                    bytes += int64_t(sizeof(std::pair<const std::string, json>)) + kNodeOverhead + StringBytes(key);
+                    stack.push_back(&value);
+                }
+                break;
+            }
+            case json::value_t::array: {
+                const auto& arr = j->get_ref<const json::array_t&>();
+                bytes += int64_t(sizeof(json::array_t) + arr.capacity() * sizeof(json)) + 2 * kBlockOverhead;
+                for (const auto& value : arr) stack.push_back(&value);
+                break;
+            }
+            case json::value_t::string:
+                bytes += int64_t(sizeof(json::string_t)) + kBlockOverhead + StringBytes(j->get_ref<const json::string_t&>());
+                break;
+            default:
+                break;
+        }
+    }
+    return bytes + int64_t(sizeof(json));
+}
+
+int64_t ModuleBytes(const SymTable::ModuleSymbolTable* table) {
+    if (!table) return 0;
+
+    int64_t bytes = int64_t(sizeof(*table) + table->modules.capacity() * sizeof(SV::Module*));
+    bytes += int64_t(table->hashmap.bucket_count() * sizeof(void*));
+    for (const auto& [name, index] : table->hashmap) {
+        bytes += int64_t(sizeof(std::pair<const std::string, size_t>)) + kNodeOverhead + StringBytes(name);
+    }
+
+    for (const SV::Module* m : table->modules) {
+        bytes += int64_t(sizeof(SV::Module)) + kBlockOverhead + StringBytes(m->name) + StringBytes(m->source_file);
+        bytes += int64_t(m->dependencies.capacity() * sizeof(SV::ModuleInstance));
+        bytes += int64_t(m->instance_ranges.capacity() * sizeof(SV::InstanceRange));
+        for (const auto& range : m->instance_ranges) {
+            bytes += StringBytes(range.first_expr) + StringBytes(range.last_expr) + StringBytes(range.scope);
+        }
+        for (const auto& dep : m->dependencies) {
+            bytes += StringBytes(dep.instance_name) + int64_t(dep.param_overrides.capacity() * sizeof(SV::ParamOverride));
+            for (const auto& param : dep.param_overrides) bytes += StringBytes(param.name) + StringBytes(param.value);
+            bytes += int64_t(dep.port_mapping.capacity() * sizeof(SV::InstancePort));
+            for (const auto& connection : dep.port_mapping) bytes += StringBytes(connection.port_name) + StringBytes(connection.signal_name);
+        }
+        bytes += int64_t(m->references.capacity() * sizeof(SV::Module*));
+        bytes += int64_t(m->ports.capacity() * sizeof(SV::Port) + m->parameters.capacity() * sizeof(SV::Parameter));
+        for (const auto& port : m->ports) bytes += StringBytes(port.name);
+        for (const auto& param : m->parameters) bytes += StringBytes(param.name) + StringBytes(param.default_value);
+    }
+    return bytes;
+}
+
+}
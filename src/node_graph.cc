@@ -0,0 +1,64 @@
+#include "node_graph.h"
+
+namespace graphics {
+
+NodeId NodeGraphPool::Create() {
+    nodes.emplace_back();
+    return NodeId(nodes.size() - 1);
+}
+
+void NodeGraphPool::Clear() {
+    nodes.clear();
+}
+
+void NodeGraphPool::AddChild(NodeId parent, NodeId child) {
+    NodeGraph& p = nodes[parent];
+    NodeGraph& c = nodes[child];
+    c.parent       = parent;
+    c.depth        = p.depth + 1;
+    c.next_sibling = kNoNode;
+
+    if (p.last_child == kNoNode) p.first_child = child;
+    else                         nodes[p.last_child].next_sibling = child;
+    p.last_child = child;
+    p.num_children++;
+
+    MarkDirty(parent);
+}
+
+void NodeGraphPool::MarkDirty(NodeId id) {
+    for (NodeId n = id; n != kNoNode && !nodes[n].bb_dirty; n = nodes[n].parent) {
+        nodes[n].bb_dirty = true;
+    }
+}
+
+void NodeGraphPool::SetRelPos(NodeId id, const vec2& pos) {
+    nodes[id].rel_pos = pos;
+    if (nodes[id].parent != kNoNode) MarkDirty(nodes[id].parent);
+}
+
+void NodeGraphPool::SetSize(NodeId id, const vec2& size) {
+    nodes[id].rec_size = size;
+    MarkDirty(id);
+}
+
+AABB NodeGraphPool::GetAABB(NodeId id) const {
+    const NodeGraph& node = nodes[id];
+    if (!node.bb_dirty) return node.cached_bb;
+
+    AABB bb(vec2(0, 0), node.rec_size);
+    if (node.expanded) {
+        for (NodeId c = node.first_child; c != kNoNode; c = nodes[c].next_sibling) {
+            AABB child_bb = GetAABB(c);
+            child_bb.ul += nodes[c].rel_pos;
+            child_bb.br += nodes[c].rel_pos;
+            bb.Expand(child_bb);
+        }
+    }
+
+    node.cached_bb = bb;
+    node.bb_dirty  = false;
+    return bb;
+}
+
+}
@@ -0,0 +1,222 @@
+#include <algorithm>
+#include <atomic>
+#include <deque>
+#include <fstream>
+#include <iomanip>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string_view>
+
+#include "profiler.h"
+
+namespace prof {
+
+namespace {
+
+constexpr size_t kHistoryFrames      = 240;     // frames of history kept for the statistics
+constexpr size_t kMaxEventsPerThread = 1 << 17; // events kept for the trace per thread, older ones are dropped
+
+struct TraceEvent {
+    const char* name;
+    uint64_t    start_ns;
+    uint64_t    dur_ns;
+};
+
+/**
+ * @brief What one thread recorded. Only the owning thread writes it, so its lock is only ever
+ * contended while a frame mark or a trace export reads it.
+ * @var frame_thread Scopes of this thread are part of the frame, and go into the per phase totals
+ * @var frame_totals Summed time per phase since the last frame mark, keyed by the name literal
+ */
+struct ThreadBuffer {
+    std::mutex             mtx;
+    uint32_t               tid          = 0;
+    bool                   frame_thread = false;
+    std::deque<TraceEvent> events;
+    std::vector<std::pair<const char*, uint64_t>> frame_totals;
+};
+
+struct ProfilerState {
+    std::mutex mtx;
+
+    std::vector<std::shared_ptr<ThreadBuffer>> threads; // outlive their thread, the trace still wants them
+
+    // Per phase ring buffer of frame totals in ms, all indexed by the same frame counter
+    std::map<std::string, std::vector<float>, std::less<>> history;
+    size_t frames = 0;
+
+    std::deque<float> frame_times;
+    uint64_t          last_mark_ns = 0;
+};
+
+std::atomic<bool> g_enabled{false};
+
+ProfilerState& State() {
+    static ProfilerState state;
+    return state;
+}
+
+ThreadBuffer& LocalBuffer() {
+    thread_local std::shared_ptr<ThreadBuffer> buffer = [] {
+        auto b = std::make_shared<ThreadBuffer>();
+
+        ProfilerState& state = State();
+        std::lock_guard<std::mutex> lock(state.mtx);
+        b->tid = uint32_t(state.threads.size()) + 1;
+        state.threads.push_back(b);
+        return b;
+    }();
+    return *buffer;
+}
+
+double Percentile(std::vector<float> values, double p) {
+    if (values.empty()) return 0.0;
+    std::sort(values.begin(), values.end());
+    return values[size_t(p * (values.size() - 1) + 0.5)];
+}
+
+} // namespace
+
+void SetEnabled(bool enabled) {
+    g_enabled.store(enabled, std::memory_order_relaxed);
+}
+
+bool Enabled() {
+    return g_enabled.load(std::memory_order_relaxed);
+}
+
+void Record(const char* name, uint64_t start_ns, uint64_t dur_ns) {
+    ThreadBuffer& buffer = LocalBuffer();
+    std::lock_guard<std::mutex> lock(buffer.mtx);
+    if (buffer.events.size() >= kMaxEventsPerThread) buffer.events.pop_front();
+    buffer.events.push_back({name, start_ns, dur_ns});
+    if (!buffer.frame_thread) return;
+
+    // A frame has a handful of phases, a linear search beats any map
+    for (auto& [phase, total] : buffer.frame_totals) {
+        if (phase == name) {
+            total += dur_ns;
+            return;
+        }
+    }
+    buffer.frame_totals.push_back({name, dur_ns});
+}
+
+void SetFrameThread() {
+    ThreadBuffer& buffer = LocalBuffer();
+    std::lock_guard<std::mutex> lock(buffer.mtx);
+    buffer.frame_thread = true;
+}
+
+void FrameMark() {
+    if (!Enabled()) return;
+    SetFrameThread();
+
+    ProfilerState& state = State();
+    const uint64_t now = NowNs();
+
+    std::lock_guard<std::mutex> lock(state.mtx);
+    if (state.last_mark_ns != 0) {
+        if (state.frame_times.size() >= kHistoryFrames) state.frame_times.pop_front();
+        state.frame_times.push_back((now - state.last_mark_ns) / 1e6f);
+    }
+    state.last_mark_ns = now;
+
+    // Phases that did not run this frame count as zero
+    const size_t slot = state.frames % kHistoryFrames;
+    for (auto& [name, ring] : state.history) ring[slot] = 0.f;
+
+    std::vector<std::pair<const char*, uint64_t>> totals;
+    for (const auto& thread : state.threads) {
+        {
+            std::lock_guard<std::mutex> thread_lock(thread->mtx);
+            if (!thread->frame_thread) continue;
+            totals.swap(thread->frame_totals);
+        }
+        for (const auto& [name, total] : totals) {
+            auto it = state.history.find(std::string_view(name));
+            if (it == state.history.end()) it = state.history.emplace(name, std::vector<float>(kHistoryFrames, 0.f)).first;
+            it->second[slot] += total / 1e6f;
+        }
+        totals.clear();
+    }
+    state.frames++;
+}
+
+std::vector<PhaseStats> GetPhaseStats() {
+    ProfilerState& state = State();
+    std::lock_guard<std::mutex> lock(state.mtx);
+
+    std::vector<PhaseStats> stats;
+    if (state.frames == 0) return stats;
+
+    const size_t count = std::min(state.frames, kHistoryFrames);
+    const size_t last  = (state.frames - 1) % kHistoryFrames;
+    for (const auto& [name, ring] : state.history) {
+        std::vector<float> values(ring.begin(), ring.begin() + count);
+
+        PhaseStats s;
+        s.name = name;
+        s.last = ring[last];
+        s.p50  = Percentile(values, 0.50);
+        s.p95  = Percentile(values, 0.95);
+        s.p99  = Percentile(values, 0.99);
+        s.max  = *std::max_element(values.begin(), values.end());
+        stats.push_back(s);
+    }
+    return stats;
+}
+
+std::vector<float> GetFrameTimes() {
+    ProfilerState& state = State();
+    std::lock_guard<std::mutex> lock(state.mtx);
+    return std::vector<float>(state.frame_times.begin(), state.frame_times.end());
+}
+
+bool WriteChromeTrace(const std::string& path) {
+    std::ofstream out(path);
+    if (!out) return false;
+
+    ProfilerState& state = State();
+    std::lock_guard<std::mutex> lock(state.mtx);
+
+    // Steady clock time is large, relative to the first event the trace keeps its nanoseconds
+    uint64_t origin = UINT64_MAX;
+    for (const auto& thread : state.threads) {
+        std::lock_guard<std::mutex> thread_lock(thread->mtx);
+        for (const auto& e : thread->events) origin = std::min(origin, e.start_ns);
+    }
+
+    // Complete ("X") events, timestamps in microseconds
+    out << std::fixed << std::setprecision(3);
+    out << "{\"traceEvents\":[\n";
+    bool first = true;
+    for (const auto& thread : state.threads) {
+        std::lock_guard<std::mutex> thread_lock(thread->mtx);
+        for (const auto& e : thread->events) {
+            if (!first) out << ",\n";
+            first = false;
+            out << "{\"name\":\"" << e.name << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << thread->tid
+                << ",\"ts\":" << (e.start_ns - origin) / 1000.0 << ",\"dur\":" << e.dur_ns / 1000.0 << "}";
+        }
+    }
+    out << "\n],\"displayTimeUnit\":\"ms\"}\n";
+    return bool(out);
+}
+
+void Reset() {
+    ProfilerState& state = State();
+    std::lock_guard<std::mutex> lock(state.mtx);
+    for (const auto& thread : state.threads) {
+        std::lock_guard<std::mutex> thread_lock(thread->mtx);
+        thread->events.clear();
+        thread->frame_totals.clear();
+    }
+    state.history.clear();
+    state.frame_times.clear();
+    state.frames       = 0;
+    state.last_mark_ns = 0;
+}
+
+}
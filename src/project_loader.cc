@@ -0,0 +1,295 @@
+#include <algorithm>
+
+#include "cst.h"
+#include "design_db.h"
+#include "line_index.h"
+#include "mem_stats.h"
+#include "profiler.h"
+#include "project_loader.h"
+
+namespace sv {
+
+ProjectLoader::~ProjectLoader() {
+    cancel();
+    if (worker.joinable()) worker.join();
+    for (auto& job : open_jobs) job.wait();
+}
+
+void ProjectLoader::start(std::vector<std::string> files, bazel::tools::cpp::runfiles::Runfiles* rf,
+                          const ColorizerOpts& opt, int num_threads) {
+    cancel();
+    if (worker.joinable()) worker.join();
+
+    this->files       = std::move(files);
+    this->rf          = rf;
+    this->opt         = opt;
+    this->num_threads = num_threads;
+    cancelled         = false;
+
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        status             = LoadProgress();
+        status.state       = LOAD_RUNNING;
+        status.phase       = "Starting";
+        status.files_total = this->files.size();
+        doc.reset();
+        root.reset();
+        search_index.reset();
+        specializations.reset();
+        hierarchy_diff.reset();
+    }
+
+    worker = std::thread(&ProjectLoader::run, this);
+}
+
+void ProjectLoader::cancel() {
+    cancelled = true;
+}
+
+LoadProgress ProjectLoader::progress() const {
+    std::lock_guard<std::mutex> lock(mtx);
+    return status;
+}
+
+void ProjectLoader::openFile(const std::string& path) {
+    // Forget jobs that are done
+    open_jobs.erase(std::remove_if(open_jobs.begin(), open_jobs.end(), [](const task::TaskHandle& job) {
+        return job.done();
+    }), open_jobs.end());
+
+    // The user is waiting on this one, it goes ahead of the project still parsing
+    open_jobs.push_back(task::Pool().submit([this, path] {
+        try {
+            LoadedDoc loaded{ResolveUserPath(path.c_str()), ColorizeFileViaBazelRunfiles(path.c_str(), rf, opt)};
+
+            std::lock_guard<std::mutex> lock(mtx);
+            doc = std::move(loaded);
+        } catch (const std::exception& e) {
+            std::cerr << "Could not open " << path << ": " << e.what() << "\n";
+        }
+    }, task::PRIORITY_INTERACTIVE));
+}
+
+std::optional<LoadedDoc> ProjectLoader::takeDoc() {
+    std::lock_guard<std::mutex> lock(mtx);
+    std::optional<LoadedDoc> out = std::move(doc);
+    doc.reset();
+    return out;
+}
+
+std::optional<SV::Module*> ProjectLoader::takeRoot() {
+    std::lock_guard<std::mutex> lock(mtx);
+    std::optional<SV::Module*> out = root;
+    root.reset();
+    return out;
+}
+
+std::shared_ptr<const search::SearchIndex> ProjectLoader::searchIndex() const {
+    std::lock_guard<std::mutex> lock(mtx);
+    return search_index;
+}
+
+std::shared_ptr<const elab::Elaboration> ProjectLoader::elaboration() const {
+    std::lock_guard<std::mutex> lock(mtx);
+    return specializations;
+}
+
+std::shared_ptr<const diff::HierarchyDiff> ProjectLoader::diff() const {
+    std::lock_guard<std::mutex> lock(mtx);
+    return hierarchy_diff;
+}
+
+bool ProjectLoader::finished() const {
+    std::lock_guard<std::mutex> lock(mtx);
+    return status.state != LOAD_RUNNING;
+}
+
+void ProjectLoader::setPhase(const std::string& phase) {
+    mem::BeginPhase(phase);
+
+    std::lock_guard<std::mutex> lock(mtx);
+    status.phase = phase;
+}
+
+void ProjectLoader::finish(LoadState state, const std::string& error) {
+    mem::EndPhase();
+
+    std::lock_guard<std::mutex> lock(mtx);
+    status.state = state;
+    status.error = error;
+    status.phase = state == LOAD_DONE ? "Done" : state == LOAD_CANCELLED ? "Cancelled" : "Failed";
+}
+
+void ProjectLoader::parseFiles(std::vector<json>& per_file) {
+    // Every file gets its own verible run, so they can run side by side and progress is per file
+    std::mutex  err_mtx;
+    std::string first_error;
+
+    task::Pool().parallelFor(files.size(), [&](size_t i) {
+        if (cancelled) return;
+        try {
+            char* path  = const_cast<char*>(files[i].c_str());
+            per_file[i] = cst::ParseFiles(1, &path, rf);
+        } catch (const std::exception& e) {
+            std::lock_guard<std::mutex> lock(err_mtx);
+            if (first_error.empty()) first_error = files[i] + ": " + e.what();
+            cancelled = true;
+        }
+
+        std::lock_guard<std::mutex> lock(mtx);
+        status.files_done++;
+    }, task::PRIORITY_BACKGROUND, task::CancelToken(), size_t(std::max(num_threads, 0)));
+
+    if (!first_error.empty()) throw std::runtime_error(first_error);
+}
+
+SV::Module* ProjectLoader::loadDatabase(const std::vector<std::string>& resolved) {
+    if (db_path.empty()) return nullptr;
+
+    auto design = db::DesignDB::Open(db_path);
+    if (!design || !design->UpToDate(resolved) || design->Top() == db::kNone) return nullptr;
+
+    setPhase("Reading design database");
+    return cst::ParseDesignDB(*design);
+}
+
+namespace {
+
+// The base revision has to live as long as the difference that points into it
+struct BaseRevision {
+    SymTable::ModuleSymbolTable table;
+    diff::HierarchyDiff         diff;
+
+    ~BaseRevision() {
+        for (SV::Module* module : table.modules) delete module;
+    }
+};
+
+}
+
+std::shared_ptr<const diff::HierarchyDiff> ProjectLoader::compareToBase(const SV::Module* top) {
+    if (base_path.empty()) return nullptr;
+
+    auto design = db::DesignDB::Open(base_path);
+    if (!design) {
+        std::cerr << "Could not open base design database " << base_path << "\n";
+        return nullptr;
+    }
+
+    setPhase("Comparing with base revision");
+    auto base = std::make_shared<BaseRevision>();
+    const SV::Module* base_top = cst::ReadDesignDB(*design, &base->table);
+    base->diff.Build(base_top, &base->table, top, cst::GetModuleSymbolTable());
+    mem::Set(mem::MEM_DESIGN, "base revision", mem::ModuleBytes(&base->table) + int64_t(base->diff.MemoryBytes()));
+
+    size_t added = 0, removed = 0, modified = 0;
+    for (const auto& change : base->diff.Modules()) {
+        added    += change.status == diff::DIFF_ADDED;
+        removed  += change.status == diff::DIFF_REMOVED;
+        modified += change.status == diff::DIFF_MODIFIED;
+    }
+    std::cout << "Compared with " << base_path << ": " << added << " modules added, " << removed << " removed, "
+              << modified << " modified, " << base->diff.NumCompared() << " module pairs visited\n";
+
+    // Aliasing pointer, the difference keeps the whole base revision alive
+    return std::shared_ptr<const diff::HierarchyDiff>(base, &base->diff);
+}
+
+void ProjectLoader::run() {
+    PROFILE_SCOPE("ProjectLoader");
+
+    try {
+        // The code panel only shows the first file, hand it over before the slow part starts
+        if (!files.empty()) {
+            setPhase("Colorizing " + files[0]);
+            LoadedDoc first{ResolveUserPath(files[0].c_str()), ColorizeFileViaBazelRunfiles(files[0].c_str(), rf, opt)};
+
+            std::lock_guard<std::mutex> lock(mtx);
+            doc = std::move(first);
+        }
+        if (cancelled) return finish(LOAD_CANCELLED);
+
+        std::vector<std::string> resolved;
+        for (const auto& file : files) resolved.push_back(ResolveUserPath(file.c_str()));
+
+        // Nothing changed since the database was written, skip verible altogether
+        SV::Module* top = loadDatabase(resolved);
+        if (top) {
+            std::lock_guard<std::mutex> lock(mtx);
+            status.files_done = files.size();
+        } else {
+            setPhase("Parsing files");
+            std::vector<json> per_file(files.size());
+            parseFiles(per_file);
+            if (cancelled) return finish(LOAD_CANCELLED);
+
+            // Walking the DOM takes a while on big projects, so only when memory is looked at
+            if (mem::Enabled()) {
+                int64_t bytes = 0;
+                for (const auto& j : per_file) bytes += mem::JsonBytes(j);
+                mem::Set(mem::MEM_CST, "per file json", bytes);
+            }
+
+            // Instantiations refer to modules in other files, so the hierarchy is built once everything is in
+            setPhase("Building module hierarchy");
+            // Moved, not copied, so the DOM of a file is only ever in memory once
+            json cst_json = json::object();
+            for (auto& j : per_file) {
+                if (!j.is_object()) continue;
+                for (auto& [file, cst] : j.items()) cst_json[file] = std::move(cst);
+                j = json();
+            }
+            mem::Set(mem::MEM_CST, "per file json", 0);
+            if (mem::Enabled()) mem::Set(mem::MEM_CST, "merged json", mem::JsonBytes(cst_json));
+            top = cst::ParseCST(cst_json);
+            if (cancelled) return finish(LOAD_CANCELLED);
+
+            if (!db_path.empty()) {
+                setPhase("Writing design database");
+                if (!db::WriteDesignDB(db_path, resolved, cst::GetModuleSymbolTable(), top)) {
+                    std::cerr << "Could not write design database " << db_path << "\n";
+                }
+            }
+        }
+        // The DOM is gone once the hierarchy is built
+        mem::Set(mem::MEM_CST, "per file json", 0);
+        mem::Set(mem::MEM_CST, "merged json", 0);
+        mem::Set(mem::MEM_DESIGN, "modules", mem::ModuleBytes(cst::GetModuleSymbolTable()));
+
+        // Once per distinct parameter set, not once per instance
+        setPhase("Elaborating parameters");
+        auto elaborated = std::make_shared<elab::Elaboration>();
+        elaborated->Build(top);
+        mem::Set(mem::MEM_DESIGN, "specializations", int64_t(elaborated->MemoryBytes()));
+        if (cancelled) return finish(LOAD_CANCELLED);
+
+        setPhase("Indexing");
+        auto index = std::make_shared<search::SearchIndex>();
+        index->Build(top, cst::GetModuleSymbolTable());
+        mem::Set(mem::MEM_DESIGN, "search index", int64_t(index->MemoryBytes()));
+
+        auto compared = compareToBase(top);
+        if (cancelled) return finish(LOAD_CANCELLED);
+
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+            root            = top;
+            search_index    = std::move(index);
+            specializations = std::move(elaborated);
+            hierarchy_diff  = std::move(compared);
+        }
+
+        // Jumping to source needs the line starts of every file, find them now and not on the first click
+        setPhase("Indexing source lines");
+        for (const auto& file : resolved) {
+            if (cancelled) return finish(LOAD_CANCELLED);
+            SV::GetFileLineIndex(file);
+        }
+        finish(LOAD_DONE);
+    } catch (const std::exception& e) {
+        std::cerr << "Loading failed: " << e.what() << "\n";
+        finish(LOAD_FAILED, e.what());
+    }
+}
+
+}
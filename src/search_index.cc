@@ -0,0 +1,399 @@
+#include <algorithm>
+#include <cctype>
+#include <charconv>
+
+#include "profiler.h"
+#include "search_index.h"
+
+namespace search {
+
+namespace {
+
+char ToLower(char c) {
+    return char(std::tolower(static_cast<unsigned char>(c)));
+}
+
+uint32_t Trigram(const char* s) {
+    return (uint32_t(uint8_t(s[0])) << 16) | (uint32_t(uint8_t(s[1])) << 8) | uint32_t(uint8_t(s[2]));
+}
+
+// Trigrams of s, sorted and without duplicates
+void Trigrams(std::string_view s, std::vector<uint32_t>& out) {
+    out.clear();
+    for (size_t i = 0; i + 3 <= s.size(); i++) out.push_back(Trigram(s.data() + i));
+    std::sort(out.begin(), out.end());
+    out.erase(std::unique(out.begin(), out.end()), out.end());
+}
+
+bool IsElement(const SV::InstanceRange& r, int index) {
+    if (r.step == 0) return r.first <= r.last ? index >= r.first && index <= r.last : index <= r.first && index >= r.last;
+    const int64_t offset = int64_t(index) - r.first;
+    return offset % r.step == 0 && offset / r.step >= 0 && size_t(offset / r.step) < r.count();
+}
+
+// Length of the start of path naming instance, or one element of it like "u_foo[3]" or
+// "g_bank[3].u_foo". 0 if it names neither
+size_t MatchInstance(const SV::ModuleInstance& instance, std::string_view path) {
+    auto whole = [&](size_t n) -> size_t { return n == path.size() || path[n] == '.' ? n : 0; };
+
+    const std::string label = SV::InstanceLabel(instance);
+    if (path.substr(0, label.size()) == label && whole(label.size())) return label.size();
+
+    if (instance.range < 0 || !instance.parent) return 0;
+    const SV::InstanceRange& r = instance.parent->instance_ranges[instance.range];
+    if (!r.resolved) return 0;
+
+    const std::string& name = r.scope.empty() ? instance.instance_name : r.scope;
+    if (path.size() <= name.size() || path.substr(0, name.size()) != name || path[name.size()] != '[') return 0;
+    const size_t close = path.find(']', name.size());
+    if (close == std::string_view::npos) return 0;
+
+    int index = 0;
+    const auto [end, ec] = std::from_chars(path.data() + name.size() + 1, path.data() + close, index);
+    if (ec != std::errc() || end != path.data() + close || !IsElement(r, index)) return 0;
+
+    size_t n = close + 1;
+    if (!r.scope.empty()) {
+        if (path.size() <= n || path[n] != '.' || path.substr(n + 1, instance.instance_name.size()) != instance.instance_name) return 0;
+        n += 1 + instance.instance_name.size();
+    }
+    return n <= path.size() ? whole(n) : 0;
+}
+
+} // namespace
+
+void SearchIndex::addText(Entry& entry, std::string_view s) {
+    entry.text_offset = uint32_t(text.size());
+    entry.text_len    = uint32_t(s.size());
+    text.append(s.data(), s.size());
+}
+
+void SearchIndex::Build(SV::Module* root, const SymTable::ModuleSymbolTable* table, size_t max_instances) {
+    PROFILE_SCOPE("SearchIndex::Build");
+
+    entries.clear();
+    text.clear();
+    path_lookup.clear();
+    was_truncated = false;
+
+    std::unordered_map<const SV::Module*, uint32_t> module_entry;
+    if (table) {
+        for (SV::Module* module : table->modules) {
+            Entry e{ENTRY_MODULE, module};
+            addText(e, module->name);
+            module_entry[module] = uint32_t(entries.size());
+            entries.push_back(e);
+        }
+    }
+
+    // Depth first over the hierarchy, so every subtree is contiguous and the parent always exists
+    struct Pending { SV::Module* module; uint32_t parent; uint32_t dep_index; };
+    std::vector<Pending> stack;
+    if (root) stack.push_back({root, kNoEntry, 0});
+
+    size_t      instances = 0;
+    std::string path;
+    while (!stack.empty()) {
+        if (instances == max_instances) {
+            was_truncated = true;
+            break;
+        }
+        const Pending p = stack.back();
+        stack.pop_back();
+
+        Entry e{ENTRY_INSTANCE, p.module, p.parent, p.dep_index};
+        if (p.parent == kNoEntry) {
+            path = p.module->name;
+        } else {
+            const Entry& parent = entries[p.parent];
+            path.assign(text, parent.text_offset, parent.text_len);
+            path += '.';
+            e.segment_offset = uint32_t(path.size());
+            e.depth          = parent.depth + 1;
+            path += SV::InstanceLabel(parent.module->dependencies[p.dep_index]);
+        }
+        addText(e, path);
+
+        const uint32_t id = uint32_t(entries.size());
+        entries.push_back(e);
+        instances++;
+
+        auto it = module_entry.find(p.module);
+        if (it != module_entry.end() && entries[it->second].first_instance == kNoEntry) {
+            entries[it->second].first_instance = id;
+        }
+
+        // A module that (indirectly) instantiates itself would never end, its repeat is a leaf
+        bool recursive = false;
+        for (uint32_t a = e.parent; a != kNoEntry && !recursive; a = entries[a].parent) {
+            recursive = entries[a].module == p.module;
+        }
+        if (recursive) continue;
+
+        // Reversed on the stack, so children come out in order
+        const auto& deps = p.module->dependencies;
+        for (size_t i = deps.size(); i-- > 0;) {
+            if (deps[i].module) stack.push_back({deps[i].module, id, uint32_t(i)});
+        }
+    }
+
+    lower.resize(text.size());
+    std::transform(text.begin(), text.end(), lower.begin(), ToLower);
+
+    // Text is final now, so views into it stay valid
+    path_lookup.reserve(instances);
+    for (uint32_t i = 0; i < entries.size(); i++) {
+        if (entries[i].kind == ENTRY_INSTANCE) path_lookup.emplace(Text(i), i);
+    }
+
+    by_segment.resize(entries.size());
+    for (uint32_t i = 0; i < entries.size(); i++) by_segment[i] = i;
+    auto segment = [this](uint32_t i) {
+        const Entry& e = entries[i];
+        return std::string_view(lower).substr(e.text_offset + e.segment_offset, e.text_len - e.segment_offset);
+    };
+    std::sort(by_segment.begin(), by_segment.end(), [&](uint32_t a, uint32_t b) { return segment(a) < segment(b); });
+
+    buildTrigrams();
+}
+
+void SearchIndex::buildTrigrams() {
+    // (trigram, entry) pairs, sorted, then squashed into CSR
+    std::vector<uint64_t> pairs;
+    std::vector<uint32_t> tris;
+    for (uint32_t i = 0; i < entries.size(); i++) {
+        Trigrams(std::string_view(lower).substr(entries[i].text_offset, entries[i].text_len), tris);
+        for (uint32_t t : tris) pairs.push_back((uint64_t(t) << 32) | i);
+    }
+    std::sort(pairs.begin(), pairs.end());
+
+    trigrams.clear();
+    offsets.clear();
+    postings.resize(pairs.size());
+    for (size_t i = 0; i < pairs.size(); i++) {
+        const uint32_t t = uint32_t(pairs[i] >> 32);
+        if (trigrams.empty() || trigrams.back() != t) {
+            trigrams.push_back(t);
+            offsets.push_back(uint32_t(i));
+        }
+        postings[i] = uint32_t(pairs[i]);
+    }
+    offsets.push_back(uint32_t(pairs.size()));
+}
+
+size_t SearchIndex::MemoryBytes() const {
+    size_t bytes = entries.capacity() * sizeof(Entry) + text.capacity() + lower.capacity();
+    bytes += (trigrams.capacity() + offsets.capacity() + postings.capacity() + by_segment.capacity()) * sizeof(uint32_t);
+    bytes += path_lookup.bucket_count() * sizeof(void*) + path_lookup.size() * (sizeof(std::pair<std::string_view, uint32_t>) + sizeof(void*));
+    return bytes;
+}
+
+uint32_t SearchIndex::FindPath(std::string_view path) const {
+    auto it = path_lookup.find(path);
+    if (it != path_lookup.end()) return it->second;
+
+    // Elements of instance arrays are not indexed on their own. Walk down from the top, resolving
+    // every element to the entry of its whole array: top.u_arr[3].u_x is under top.u_arr[3:0]
+    const size_t dot = path.find('.');
+    if (dot == std::string_view::npos) return kNoEntry;
+    it = path_lookup.find(path.substr(0, dot));
+    if (it == path_lookup.end() || entries[it->second].parent != kNoEntry) return kNoEntry;
+
+    uint32_t         at   = it->second;
+    std::string_view rest = path.substr(dot + 1);
+    std::string      child;
+    while (!rest.empty()) {
+        uint32_t next = kNoEntry;
+        size_t   used = 0;
+        for (const auto& dependency : entries[at].module->dependencies) {
+            used = MatchInstance(dependency, rest);
+            if (used == 0) continue;
+
+            child.assign(Text(at));
+            child += '.';
+            child += SV::InstanceLabel(dependency);
+            auto found = path_lookup.find(child);
+            if (found != path_lookup.end()) {
+                next = found->second;
+                break;
+            }
+        }
+        if (next == kNoEntry) return kNoEntry;
+
+        at   = next;
+        rest = rest.substr(std::min(rest.size(), used + 1));
+    }
+    return at;
+}
+
+std::vector<uint32_t> SearchIndex::InstancePath(uint32_t entry) const {
+    std::vector<uint32_t> path;
+    for (uint32_t e = entry; e != kNoEntry && entries[e].parent != kNoEntry; e = entries[e].parent) {
+        path.push_back(entries[e].dep_index);
+    }
+    std::reverse(path.begin(), path.end());
+    return path;
+}
+
+std::vector<uint32_t> SearchIndex::shortQueryCandidates(std::string_view query) const {
+    // Every entry whose last segment starts with the query
+    auto segment = [this](uint32_t i) {
+        const Entry& e = entries[i];
+        return std::string_view(lower).substr(e.text_offset + e.segment_offset, e.text_len - e.segment_offset);
+    };
+    auto it = std::lower_bound(by_segment.begin(), by_segment.end(), query,
+                               [&](uint32_t i, std::string_view q) { return segment(i) < q; });
+
+    std::vector<uint32_t> out;
+    for (; it != by_segment.end() && out.size() < kMaxCandidates; ++it) {
+        if (segment(*it).substr(0, query.size()) != query) break;
+        out.push_back(*it);
+    }
+    return out;
+}
+
+int SearchIndex::score(uint32_t entry, std::string_view query) const {
+    const Entry&           e    = entries[entry];
+    const std::string_view s    = std::string_view(lower).substr(e.text_offset, e.text_len);
+    const std::string_view orig = Text(entry);
+
+    // Start of a word: start of the text, after a separator, or a lower to upper case change
+    auto boundary = [&](size_t j) {
+        return j == 0 || s[j - 1] == '.' || s[j - 1] == '_' ||
+               (std::isupper(static_cast<unsigned char>(orig[j])) && std::islower(static_cast<unsigned char>(orig[j - 1])));
+    };
+
+    int result;
+    const size_t pos = s.find(query);
+    if (pos != std::string_view::npos) {
+        // Substring match, best when it is in the last segment and starts a word
+        result = 1000;
+        if (pos >= e.segment_offset)          result += 400;
+        if (boundary(pos))                    result += 200;
+        if (pos + query.size() == s.size())   result += 100;
+        if (s.size() == query.size())         result += 300;
+    } else {
+        // Subsequence match, rewards consecutive characters and word starts
+        result = 0;
+        size_t j   = 0;
+        size_t run = 0;
+        size_t last = std::string_view::npos;
+        for (char c : query) {
+            const size_t at = s.find(c, j);
+            if (at == std::string_view::npos) return -1;
+
+            run = (last != std::string_view::npos && at == last + 1) ? run + 1 : 0;
+            result += 10 + int(run) * 6;
+            if (boundary(at))            result += 8;
+            if (at >= e.segment_offset)  result += 4;
+            result -= int(std::min<size_t>(at - j, 8));
+            last = at;
+            j    = at + 1;
+        }
+    }
+
+    // Prefer short texts and modules over their many instances
+    result -= int(s.size() / 8);
+    if (e.kind == ENTRY_MODULE) result += 50;
+    return result;
+}
+
+std::vector<Result> SearchIndex::Query(std::string_view query, size_t max_results) const {
+    PROFILE_SCOPE("SearchIndex::Query");
+
+    std::string q;
+    for (char c : query) {
+        if (!std::isspace(static_cast<unsigned char>(c))) q += ToLower(c);
+    }
+    if (q.empty() || entries.empty()) return {};
+
+    std::vector<uint32_t> candidates;
+    if (q.size() < 3) {
+        candidates = shortQueryCandidates(q);
+    } else {
+        // Posting lists of the query trigrams, rarest first. Trigrams in a large share of all entries
+        // (like the name of the top module, which starts every path) are left out.
+        std::vector<uint32_t> tris;
+        Trigrams(q, tris);
+
+        std::vector<std::pair<const uint32_t*, const uint32_t*>> lists;
+        for (uint32_t t : tris) {
+            auto it = std::lower_bound(trigrams.begin(), trigrams.end(), t);
+            if (it == trigrams.end() || *it != t) continue;
+            const size_t k = size_t(it - trigrams.begin());
+            lists.push_back({postings.data() + offsets[k], postings.data() + offsets[k + 1]});
+        }
+        std::sort(lists.begin(), lists.end(), [](const auto& a, const auto& b) { return a.second - a.first < b.second - b.first; });
+
+        const size_t common = size_t(entries.size() * kCommonTrigramFraction);
+        size_t useful = 0;
+        while (useful < lists.size() && size_t(lists[useful].second - lists[useful].first) <= common) useful++;
+        if (useful == 0 && !lists.empty()) useful = 1;
+
+        // An entry has to share most of the useful trigrams, so a typo or a fuzzy query still matches.
+        // The posting lists are sorted, merging them counts the lists every entry is in without
+        // touching memory proportional to the number of entries
+        using Cursor = std::pair<const uint32_t*, const uint32_t*>;
+        std::vector<Cursor> heap(lists.begin(), lists.begin() + useful);
+        auto later = [](const Cursor& a, const Cursor& b) { return *a.first > *b.first; };
+        std::make_heap(heap.begin(), heap.end(), later);
+
+        const uint32_t need = uint32_t(std::max<size_t>(1, useful - useful / 3));
+        std::vector<std::pair<uint32_t, uint32_t>> matched; // entry, lists it is in
+        uint32_t current = kNoEntry;
+        uint32_t hits    = 0;
+        while (!heap.empty()) {
+            std::pop_heap(heap.begin(), heap.end(), later);
+            Cursor& cursor = heap.back();
+            const uint32_t e = *cursor.first++;
+            if (cursor.first == cursor.second) {
+                heap.pop_back();
+            } else {
+                std::push_heap(heap.begin(), heap.end(), later);
+            }
+
+            if (e != current) {
+                if (hits >= need) matched.push_back({current, hits});
+                current = e;
+                hits    = 0;
+            }
+            hits++;
+        }
+        if (hits >= need) matched.push_back({current, hits});
+
+        if (matched.size() > kMaxCandidates) {
+            std::nth_element(matched.begin(), matched.begin() + kMaxCandidates, matched.end(),
+                             [](const auto& a, const auto& b) { return a.second > b.second; });
+            matched.resize(kMaxCandidates);
+        }
+        candidates.reserve(matched.size());
+        for (const auto& [e, n] : matched) candidates.push_back(e);
+
+        // No trigram in common with anything, try the start of the query as a name prefix
+        if (candidates.empty()) candidates = shortQueryCandidates(std::string_view(q).substr(0, 2));
+    }
+
+    // The exact path is always a candidate, however common its trigrams are
+    const uint32_t exact = FindPath(query);
+    if (exact != kNoEntry) candidates.push_back(exact);
+    std::sort(candidates.begin(), candidates.end());
+    candidates.erase(std::unique(candidates.begin(), candidates.end()), candidates.end());
+
+    std::vector<Result> results;
+    for (uint32_t c : candidates) {
+        const int s = score(c, q);
+        if (s >= 0) results.push_back({c, s});
+    }
+
+    auto better = [this](const Result& a, const Result& b) {
+        if (a.score != b.score) return a.score > b.score;
+        if (entries[a.entry].text_len != entries[b.entry].text_len) return entries[a.entry].text_len < entries[b.entry].text_len;
+        return a.entry < b.entry;
+    };
+    const size_t n = std::min(max_results, results.size());
+    std::partial_sort(results.begin(), results.begin() + n, results.end(), better);
+    results.resize(n);
+    return results;
+}
+
+}
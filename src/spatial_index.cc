@@ -0,0 +1,217 @@
+#include <algorithm>
+#include <limits>
+
+#include "spatial_index.h"
+
+namespace graphics {
+
+void SpatialIndex::build(std::vector<Item> items) {
+    clear();
+    if (items.empty()) return;
+
+    nodes.reserve(2 * (items.size() / kLeafSize + 1));
+    buildRecursive(items, 0, uint32_t(items.size()));
+
+    // Split into the arrays the queries read, in the order the tree put the items in
+    ids.reserve(items.size());
+    boxes.reserve(items.size());
+    for (const Item& item : items) {
+        ids.push_back(item.id);
+        boxes.push_back(item.box);
+    }
+    built_area = leafArea();
+}
+
+uint32_t SpatialIndex::buildRecursive(std::vector<Item>& items, uint32_t first, uint32_t count) {
+    const uint32_t node_idx = uint32_t(nodes.size());
+    nodes.emplace_back();
+
+    AABB box = items[first].box;
+    AABB centers(items[first].box.Center(), items[first].box.Center());
+    for (uint32_t i = first; i < first + count; i++) {
+        box.Expand(items[i].box);
+        const vec2 c = items[i].box.Center();
+        centers.Expand(AABB(c, c));
+    }
+    nodes[node_idx].box = box;
+
+    if (count <= kLeafSize) {
+        nodes[node_idx].first = first;
+        nodes[node_idx].count = count;
+        return node_idx;
+    }
+
+    // Median split along the longest axis of the centers
+    const vec2 extent = centers.Size();
+    const bool split_x = extent.x >= extent.y;
+    const uint32_t half = count / 2;
+    std::nth_element(items.begin() + first, items.begin() + first + half, items.begin() + first + count,
+        [split_x](const Item& a, const Item& b) {
+            return split_x ? a.box.Center().x < b.box.Center().x
+                           : a.box.Center().y < b.box.Center().y;
+        });
+
+    buildRecursive(items, first, half); // left child is always node_idx + 1
+    const uint32_t right = buildRecursive(items, first + half, count - half);
+    nodes[node_idx].right = right;
+    return node_idx;
+}
+
+void SpatialIndex::refit(const std::vector<AABB>& moved) {
+    if (nodes.empty()) return;
+    refitRecursive(0, moved);
+}
+
+AABB SpatialIndex::refitRecursive(uint32_t node_idx, const std::vector<AABB>& moved) {
+    Node& node = nodes[node_idx];
+    if (node.count > 0) {
+        for (uint32_t i = node.first; i < node.first + node.count; i++) {
+            if (ids[i] != kDead) boxes.set(i, moved[ids[i]]);
+        }
+        node.box = simd::Bounds(boxes, node.first, node.count);
+        return node.box;
+    }
+
+    AABB box = refitRecursive(node_idx + 1, moved);
+    box.Expand(refitRecursive(node.right, moved));
+    nodes[node_idx].box = box;
+    return box;
+}
+
+void SpatialIndex::update(const std::vector<uint32_t>& remap, const std::vector<AABB>& new_boxes) {
+    auto rebuild = [&] {
+        std::vector<Item> items(new_boxes.size());
+        for (size_t i = 0; i < new_boxes.size(); i++) items[i] = {new_boxes[i], uint32_t(i)};
+        build(std::move(items));
+    };
+    if (nodes.empty()) return rebuild();
+
+    // Slots keep their place in the tree, only their id changes
+    constexpr float inf = std::numeric_limits<float>::infinity();
+    std::vector<bool> kept(new_boxes.size(), false);
+    for (size_t i = 0; i < ids.size(); i++) {
+        if (ids[i] == kDead) continue;
+        ids[i] = ids[i] < remap.size() ? remap[ids[i]] : kDead;
+        if (ids[i] == kDead || ids[i] >= new_boxes.size()) {
+            ids[i] = kDead;
+            boxes.set(i, AABB(inf, inf, -inf, -inf));
+            dead++;
+        } else {
+            kept[ids[i]] = true;
+        }
+    }
+
+    std::vector<Item> added;
+    for (size_t i = 0; i < new_boxes.size(); i++) {
+        if (!kept[i]) added.push_back({new_boxes[i], uint32_t(i)});
+    }
+    // Past half holes, or too deep to graft again, a fresh tree is cheaper to query
+    if (dead > new_boxes.size() / 2 || (!added.empty() && grafts >= kMaxGrafts)) return rebuild();
+
+    refitRecursive(0, new_boxes);
+    if (leafArea() > 2.f * built_area) return rebuild();
+    if (!added.empty()) graft(std::move(added));
+}
+
+void SpatialIndex::graft(std::vector<Item> added) {
+    SpatialIndex sub;
+    sub.build(std::move(added));
+
+    // A new root with the old tree on the left, so the left child stays the next node, and the new one right
+    const uint32_t old_nodes = uint32_t(nodes.size());
+    const uint32_t old_slots = uint32_t(ids.size());
+    std::vector<Node> merged;
+    merged.reserve(1 + nodes.size() + sub.nodes.size());
+    merged.emplace_back();
+    for (Node node : nodes) {
+        if (node.count == 0) node.right += 1;
+        merged.push_back(node);
+    }
+    for (Node node : sub.nodes) {
+        if (node.count == 0) node.right += 1 + old_nodes;
+        else                 node.first += old_slots;
+        merged.push_back(node);
+    }
+    merged[0].box   = nodes[0].box;
+    merged[0].box.Expand(sub.nodes[0].box);
+    merged[0].right = 1 + old_nodes;
+    nodes = std::move(merged);
+
+    ids.insert(ids.end(), sub.ids.begin(), sub.ids.end());
+    boxes.reserve(ids.size());
+    for (size_t i = 0; i < sub.ids.size(); i++) boxes.push_back(sub.boxes.get(i));
+    built_area += sub.built_area;
+    grafts++;
+}
+
+float SpatialIndex::leafArea() const {
+    float area = 0.f;
+    for (const Node& node : nodes) {
+        // A leaf of only emptied slots is inverted, and covers nothing
+        if (node.count > 0 && node.box.br.x >= node.box.ul.x) area += node.box.Area();
+    }
+    return area;
+}
+
+void SpatialIndex::queryRect(const AABB& rect, std::vector<uint32_t>& out) const {
+    if (nodes.empty()) return;
+
+    uint32_t stack[64];
+    int      top = 0;
+    stack[top++] = 0;
+    while (top > 0) {
+        const Node& node = nodes[stack[--top]];
+        if (!node.box.Intersects(rect)) continue;
+
+        if (node.count > 0) {
+            simd::CullBoxes(boxes, node.first, node.count, rect, ids.data(), out);
+        } else {
+            const uint32_t left = uint32_t(&node - nodes.data()) + 1;
+            stack[top++] = node.right;
+            stack[top++] = left;
+        }
+    }
+}
+
+int64_t SpatialIndex::pick(const vec2& p) const {
+    if (nodes.empty()) return -1;
+
+    int64_t best      = -1;
+    float   best_area = 0.f;
+
+    uint32_t stack[64];
+    int      top = 0;
+    stack[top++] = 0;
+    while (top > 0) {
+        const Node& node = nodes[stack[--top]];
+        if (!node.box.Contains(p)) continue;
+
+        if (node.count > 0) {
+            for (uint32_t i = node.first; i < node.first + node.count; i++) {
+                // Prefer the smallest box, so nested boxes pick the innermost one
+                const AABB box = boxes.get(i);
+                if (box.Contains(p) && (best < 0 || box.Area() < best_area)) {
+                    best      = ids[i];
+                    best_area = box.Area();
+                }
+            }
+        } else {
+            const uint32_t left = uint32_t(&node - nodes.data()) + 1;
+            stack[top++] = node.right;
+            stack[top++] = left;
+        }
+    }
+
+    return best;
+}
+
+void SpatialIndex::clear() {
+    nodes.clear();
+    ids.clear();
+    boxes.clear();
+    dead       = 0;
+    grafts     = 0;
+    built_area = 0.f;
+}
+
+}
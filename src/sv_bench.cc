@@ -0,0 +1,378 @@
+#include <filesystem>
+#include <map>
+#include <sstream>
+
+#include <benchmark/benchmark.h>
+
+#include "common.h"
+#include "cst.h"
+#include "design_gen.h"
+#include "graphics.h"
+#include "search_index.h"
+#include "sv_colorizer.h"
+#include "symbol_table.h"
+#include "vec_batch.h"
+
+// Benchmarks of the hot paths against synthetic designs of 10 to 1M instances.
+//   bazel run -c opt //:sv_bench -- --benchmark_format=json --benchmark_out=bench.json
+// Every result carries instances, modules and bytes counters, so scaling curves can be plotted
+// straight from the JSON.
+
+namespace {
+
+bazel::tools::cpp::runfiles::Runfiles* g_rf = nullptr;
+
+constexpr int64_t kMinInstances = 10;
+constexpr int64_t kMaxInstances = 1000000;
+
+// Most visible nodes a drawn view is expanded to, more than any screen can show
+constexpr size_t kMaxVisibleNodes = 200000;
+
+std::string OptsKey(const gen::GenOpts& opts) {
+    std::ostringstream key;
+    key << "m" << opts.modules << "_f" << opts.fanout << "_d" << opts.depth << "_r" << int(opts.reuse * 100)
+        << "_l" << opts.filler_lines << "_p" << opts.modules_per_file << "_s" << opts.seed;
+    return key.str();
+}
+
+// Generated once per shape, reused by every benchmark of the run
+const gen::GeneratedDesign& Design(const gen::GenOpts& opts) {
+    static std::map<std::string, gen::GeneratedDesign> designs;
+    const std::string key = OptsKey(opts);
+    auto it = designs.find(key);
+    if (it != designs.end()) return it->second;
+
+    const auto dir = std::filesystem::temp_directory_path() / "sv_bench" / key;
+    return designs.emplace(key, gen::GenerateDesign(opts, dir.string())).first->second;
+}
+
+json ParseDesign(const gen::GeneratedDesign& design) {
+    std::vector<char*> files;
+    for (const auto& f : design.files) files.push_back(const_cast<char*>(f.c_str()));
+    return cst::ParseFiles(files.size(), files.data(), g_rf);
+}
+
+const json& DesignJSON(const gen::GenOpts& opts) {
+    static std::map<std::string, json> parsed;
+    const std::string key = OptsKey(opts);
+    auto it = parsed.find(key);
+    if (it != parsed.end()) return it->second;
+    return parsed.emplace(key, ParseDesign(Design(opts))).first->second;
+}
+
+// The modules stay alive for the whole run, later benchmarks point into them
+SV::Module* DesignRoot(const gen::GenOpts& opts) {
+    static std::map<std::string, SV::Module*> roots;
+    const std::string key = OptsKey(opts);
+    auto it = roots.find(key);
+    if (it != roots.end()) return it->second;
+    return roots.emplace(key, cst::ParseCST(DesignJSON(opts))).first->second;
+}
+
+void SetCounters(benchmark::State& state, const gen::GeneratedDesign& design) {
+    state.counters["instances"] = double(design.instances);
+    state.counters["modules"]   = double(design.modules);
+    state.counters["bytes"]     = double(design.bytes);
+    state.SetComplexityN(int64_t(design.instances));
+}
+
+SkFont BenchFont(const char* family, float size) {
+    return graphics::FontRegistry::Get().font(family, size);
+}
+
+// Lay out a design and expand it level by level until kMaxVisibleNodes are visible or nothing is left
+void ExpandedView(graphics::GraphView& view, SV::Module* root, const SkFont& font) {
+    view.module = root;
+    view.layout = std::make_unique<graphics::LayoutEngine>(font);
+    view.layout->setRoot(root);
+    view.layout->waitIdle();
+
+    for (;;) {
+        auto snapshot = view.layout->snapshot();
+        size_t expanding = 0;
+        for (const auto& item : snapshot->items) {
+            if (snapshot->items.size() + expanding >= kMaxVisibleNodes) break;
+            if (item.has_children && !item.expanded) {
+                view.layout->setExpanded(item.node, true);
+                expanding++;
+            }
+        }
+        view.layout->waitIdle();
+        if (expanding == 0) break;
+    }
+    view.snapshot = view.layout->snapshot();
+    view.wires    = graphics::routeWires(*view.snapshot);
+}
+
+void BM_ParseFiles(benchmark::State& state) {
+    const gen::GenOpts opts = gen::OptsForInstances(uint64_t(state.range(0)));
+    const auto&        design = Design(opts);
+    for (auto _ : state) benchmark::DoNotOptimize(ParseDesign(design));
+    SetCounters(state, design);
+    state.SetBytesProcessed(int64_t(state.iterations() * design.bytes));
+}
+BENCHMARK(BM_ParseFiles)->RangeMultiplier(10)->Range(kMinInstances, kMaxInstances)->Unit(benchmark::kMillisecond)->Complexity();
+
+// File size instead of instances, the same hierarchy with more declarations per module
+void BM_ParseFilesFiller(benchmark::State& state) {
+    gen::GenOpts opts = gen::OptsForInstances(1000);
+    opts.filler_lines = size_t(state.range(0));
+    const auto& design = Design(opts);
+    for (auto _ : state) benchmark::DoNotOptimize(ParseDesign(design));
+    SetCounters(state, design);
+    state.SetBytesProcessed(int64_t(state.iterations() * design.bytes));
+}
+BENCHMARK(BM_ParseFilesFiller)->RangeMultiplier(10)->Range(1, 1000)->Unit(benchmark::kMillisecond);
+
+void BM_ParseCST(benchmark::State& state) {
+    const gen::GenOpts opts = gen::OptsForInstances(uint64_t(state.range(0)));
+    const json&        cst_json = DesignJSON(opts);
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(cst::ParseCST(cst_json));
+        state.PauseTiming();
+        SymTable::symbol_table_destroy(cst::GetModuleSymbolTable());
+        state.ResumeTiming();
+    }
+    SetCounters(state, Design(opts));
+}
+BENCHMARK(BM_ParseCST)->RangeMultiplier(10)->Range(kMinInstances, kMaxInstances)->Unit(benchmark::kMillisecond)->Complexity();
+
+void BM_BuildDocFromVeribleJSON(benchmark::State& state) {
+    gen::GenOpts opts = gen::OptsForInstances(1000);
+    opts.filler_lines = size_t(state.range(0));
+    const auto&       design = Design(opts);
+    const std::string file   = design.files[0];
+    const json        tokens = sv::VeribleTokensViaBazelRunfiles(file.c_str(), g_rf, sv::ColorizerOpts());
+    const auto        source = SV::GetSourceFile(file);
+
+    for (auto _ : state) benchmark::DoNotOptimize(sv::BuildDocFromVeribleJSON(tokens, file, source, 4));
+    state.SetBytesProcessed(int64_t(state.iterations() * source->Size()));
+    state.counters["bytes"] = double(source->Size());
+}
+BENCHMARK(BM_BuildDocFromVeribleJSON)->RangeMultiplier(10)->Range(1, 1000)->Unit(benchmark::kMillisecond);
+
+std::vector<SV::Module*> SyntheticModules(size_t n) {
+    std::vector<SV::Module*> modules(n);
+    for (size_t i = 0; i < n; i++) {
+        modules[i] = new SV::Module;
+        modules[i]->name = "module_" + std::to_string(i);
+    }
+    return modules;
+}
+
+void BM_SymbolTableInsert(benchmark::State& state) {
+    const auto modules = SyntheticModules(size_t(state.range(0)));
+    for (auto _ : state) {
+        // Only the table goes away, the modules are reused
+        SymTable::ModuleSymbolTable table;
+        for (auto* m : modules) SymTable::symbol_table_insert(&table, m);
+        benchmark::DoNotOptimize(table.modules.data());
+    }
+    state.SetItemsProcessed(int64_t(state.iterations() * modules.size()));
+    state.SetComplexityN(state.range(0));
+    for (auto* m : modules) delete m;
+}
+BENCHMARK(BM_SymbolTableInsert)->RangeMultiplier(10)->Range(kMinInstances, kMaxInstances)->Complexity();
+
+void BM_SymbolTableLookup(benchmark::State& state) {
+    const auto modules = SyntheticModules(size_t(state.range(0)));
+    SymTable::ModuleSymbolTable table;
+    for (auto* m : modules) SymTable::symbol_table_insert(&table, m);
+
+    // Every name once, and as many names that are not in the table
+    std::vector<std::string> names;
+    for (auto* m : modules) {
+        names.push_back(m->name);
+        names.push_back(m->name + "_missing");
+    }
+    for (auto _ : state) {
+        for (const auto& name : names) benchmark::DoNotOptimize(SymTable::symbol_table_lookup(&table, name));
+    }
+    state.SetItemsProcessed(int64_t(state.iterations() * names.size()));
+    state.SetComplexityN(state.range(0));
+    for (auto* m : modules) delete m;
+}
+BENCHMARK(BM_SymbolTableLookup)->RangeMultiplier(10)->Range(kMinInstances, kMaxInstances)->Complexity();
+
+void BM_SearchIndexBuild(benchmark::State& state) {
+    const gen::GenOpts opts = gen::OptsForInstances(uint64_t(state.range(0)));
+    SV::Module*        root = DesignRoot(opts);
+    // The symbol table of this design, not of whatever was parsed last
+    SymTable::ModuleSymbolTable table;
+    std::vector<SV::Module*>    stack{root};
+    while (!stack.empty()) {
+        SV::Module* m = stack.back();
+        stack.pop_back();
+        if (SymTable::symbol_table_insert(&table, m) != SymTable::INSERT_OK) continue;
+        for (const auto& dep : m->dependencies) stack.push_back(dep.module);
+    }
+
+    for (auto _ : state) {
+        search::SearchIndex index;
+        index.Build(root, &table);
+        benchmark::DoNotOptimize(index.size());
+    }
+    SetCounters(state, Design(opts));
+}
+BENCHMARK(BM_SearchIndexBuild)->RangeMultiplier(10)->Range(kMinInstances, kMaxInstances)->Unit(benchmark::kMillisecond)->Complexity();
+
+void DrawNodeGraph(benchmark::State& state, bool fit) {
+    const gen::GenOpts opts = gen::OptsForInstances(uint64_t(state.range(0)));
+    SkFont             font = BenchFont("DejaVu Sans", 20.f);
+
+    graphics::GraphView view;
+    ExpandedView(view, DesignRoot(opts), font);
+
+    const int width  = 1920;
+    const int height = 1080;
+    auto surface = SkSurfaces::Raster(SkImageInfo::MakeN32Premul(width, height));
+
+    // Either the whole graph, where level of detail kicks in, or the root at 1:1
+    graphics::Camera camera;
+    if (fit) {
+        const AABB bounds = view.snapshot->bounds;
+        const vec2 extent = bounds.Size();
+        camera.scale = std::min(width / std::max(extent.x, 1.f), height / std::max(extent.y, 1.f));
+        camera.pos   = bounds.Center() - vec2(width, height) / (2.f * camera.scale);
+    } else {
+        camera.pos = view.snapshot->items[0].box.ul - vec2(20, 20);
+    }
+
+    for (auto _ : state) {
+        surface->getCanvas()->clear(SK_ColorBLACK);
+        graphics::drawNodeGraph(surface->getCanvas(), view, camera, font);
+    }
+    SetCounters(state, Design(opts));
+    state.counters["visible_nodes"] = double(view.snapshot->items.size());
+    state.counters["nets"]          = double(view.wires->nets.size());
+}
+
+void BM_DrawNodeGraphFit(benchmark::State& state)    { DrawNodeGraph(state, true); }
+void BM_DrawNodeGraphZoomed(benchmark::State& state) { DrawNodeGraph(state, false); }
+BENCHMARK(BM_DrawNodeGraphFit)->RangeMultiplier(10)->Range(kMinInstances, kMaxInstances)->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_DrawNodeGraphZoomed)->RangeMultiplier(10)->Range(kMinInstances, kMaxInstances)->Unit(benchmark::kMillisecond);
+
+// Routing every net of an expanded view, the work done on the task pool after every layout
+void BM_RouteWires(benchmark::State& state) {
+    const gen::GenOpts opts = gen::OptsForInstances(uint64_t(state.range(0)));
+    SkFont             font = BenchFont("DejaVu Sans", 20.f);
+
+    graphics::GraphView view;
+    ExpandedView(view, DesignRoot(opts), font);
+
+    for (auto _ : state) benchmark::DoNotOptimize(graphics::routeWires(*view.snapshot));
+    SetCounters(state, Design(opts));
+    state.counters["visible_nodes"] = double(view.snapshot->items.size());
+    state.counters["nets"]          = double(view.wires->nets.size());
+    state.counters["segments"]      = double(view.wires->segments.size());
+}
+BENCHMARK(BM_RouteWires)->RangeMultiplier(10)->Range(kMinInstances, kMaxInstances)->Unit(benchmark::kMillisecond);
+
+void BM_RenderCodePanel(benchmark::State& state) {
+    gen::GenOpts opts = gen::OptsForInstances(1000);
+    opts.filler_lines = size_t(state.range(0));
+    const std::string file = Design(opts).files[0];
+    const json        tokens = sv::VeribleTokensViaBazelRunfiles(file.c_str(), g_rf, sv::ColorizerOpts());
+    const auto        doc    = sv::BuildDocFromVeribleJSON(tokens, file, SV::GetSourceFile(file), 4);
+    SkFont            font   = BenchFont("DejaVu Sans Mono", 12.f);
+
+    auto surface = SkSurfaces::Raster(SkImageInfo::MakeN32Premul(960, 1080));
+
+    graphics::CodePanel panel{};
+    panel.pos     = vec2(0, 0);
+    panel.size    = vec2(960, 1080);
+    panel.visible = true;
+
+    // Scrolls through the file, so the text cache is exercised and not only hit
+    float scroll = 0.f;
+    for (auto _ : state) {
+        panel.scrollY = scroll;
+        graphics::renderCodePanel(surface->getCanvas(), panel, doc, font);
+        scroll = scroll > float(doc.size()) * 16.f ? 0.f : scroll + 160.f;
+    }
+    state.counters["lines"] = double(doc.size());
+}
+BENCHMARK(BM_RenderCodePanel)->RangeMultiplier(10)->Range(1, 1000)->Unit(benchmark::kMicrosecond);
+
+// Boxes of a laid out graph, rows of nodes like the layout makes them
+simd::BoxBuffer GridBoxes(size_t n) {
+    simd::BoxBuffer boxes;
+    boxes.reserve(n);
+    for (size_t i = 0; i < n; i++) {
+        const float x = float(i % 1000) * 240.f, y = float(i / 1000) * 24.f;
+        boxes.push_back(AABB(x, y, x + 200.f, y + 18.f));
+    }
+    return boxes;
+}
+
+// The batch kernels against the per box AABB code they replace, the isa label says which kernels ran
+void BM_CullBoxes(benchmark::State& state) {
+    const simd::BoxBuffer boxes = GridBoxes(size_t(state.range(0)));
+    const AABB            view(50000.f, 100.f, 50000.f + 1920.f, 100.f + 1080.f);
+    std::vector<uint32_t> out;
+    for (auto _ : state) {
+        out.clear();
+        simd::CullBoxes(boxes, 0, boxes.size(), view, nullptr, out);
+        benchmark::DoNotOptimize(out.data());
+    }
+    state.SetItemsProcessed(int64_t(state.iterations()) * state.range(0));
+    state.SetLabel(simd::KernelIsa());
+}
+BENCHMARK(BM_CullBoxes)->RangeMultiplier(10)->Range(1000, 1000000);
+
+void BM_CullBoxesPerBox(benchmark::State& state) {
+    const simd::BoxBuffer boxes = GridBoxes(size_t(state.range(0)));
+    std::vector<AABB>     aos;
+    for (size_t i = 0; i < boxes.size(); i++) aos.push_back(boxes.get(i));
+    const AABB            view(50000.f, 100.f, 50000.f + 1920.f, 100.f + 1080.f);
+    std::vector<uint32_t> out;
+    for (auto _ : state) {
+        out.clear();
+        for (size_t i = 0; i < aos.size(); i++) {
+            if (aos[i].Intersects(view)) out.push_back(uint32_t(i));
+        }
+        benchmark::DoNotOptimize(out.data());
+    }
+    state.SetItemsProcessed(int64_t(state.iterations()) * state.range(0));
+}
+BENCHMARK(BM_CullBoxesPerBox)->RangeMultiplier(10)->Range(1000, 1000000);
+
+void BM_TransformBoxes(benchmark::State& state) {
+    const simd::BoxBuffer boxes = GridBoxes(size_t(state.range(0)));
+    simd::BoxBuffer       screen;
+    for (auto _ : state) {
+        simd::TransformBoxes(boxes, vec2(1000.f, 500.f), 0.25f, screen);
+        benchmark::DoNotOptimize(screen.x0.data());
+    }
+    state.SetItemsProcessed(int64_t(state.iterations()) * state.range(0));
+    state.SetLabel(simd::KernelIsa());
+}
+BENCHMARK(BM_TransformBoxes)->RangeMultiplier(10)->Range(1000, 1000000);
+
+void BM_BoundsBoxes(benchmark::State& state) {
+    const simd::BoxBuffer boxes = GridBoxes(size_t(state.range(0)));
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(simd::Bounds(boxes));
+    }
+    state.SetItemsProcessed(int64_t(state.iterations()) * state.range(0));
+    state.SetLabel(simd::KernelIsa());
+}
+BENCHMARK(BM_BoundsBoxes)->RangeMultiplier(10)->Range(1000, 1000000);
+
+}
+
+int main(int argc, char** argv) {
+    benchmark::Initialize(&argc, argv);
+    if (benchmark::ReportUnrecognizedArguments(argc, argv)) return 1;
+
+    // Verible is found through the runfiles, like in every other binary
+    std::string error;
+    g_rf = bazel::tools::cpp::runfiles::Runfiles::Create(argv[0], &error);
+    if (!g_rf) { std::cerr << "runfiles error: " << error << "\n"; return 1; }
+
+    graphics::FontRegistry::Get().warmUp();
+
+    benchmark::RunSpecifiedBenchmarks();
+    benchmark::Shutdown();
+    return 0;
+}
@@ -1,12 +1,14 @@
 // sv_colorizer.cpp (relevant bits)
 
+#include <algorithm>
 #include <cctype>
 #include <iostream>
-#include <fstream>
 #include <unordered_set>
 #include <string>
 #include "common.h"
 #include "sv_colorizer.h"
+#include "mem_stats.h"
+#include "profiler.h"
 
 // ---------- token classification ----------
 namespace {
@@ -48,9 +50,9 @@ static const std::unordered_set<std::string> kSymbolTags = {
 };
 
 // Return true if this token is punctuation/operator. Prefer tag, fall back to lex slice.
-inline bool IsSymbolToken(const std::string& tag, const std::string& lex) {
+inline bool IsSymbolToken(const std::string& tag, std::string_view lex) {
     if (kSymbolTags.count(tag)) return true;
-    if (kSymbolTags.count(lex)) return true;
+    if (lex.size() <= 3 && kSymbolTags.count(std::string(lex))) return true; // short enough to never allocate
     // Single-character punctuation heuristic
     if (tag.size() == 1 && std::ispunct(static_cast<unsigned char>(tag[0]))) return true;
     if (lex.size() == 1 && std::ispunct(static_cast<unsigned char>(lex[0]))) return true;
@@ -62,7 +64,7 @@ inline bool IsWhitespaceToken(const std::string& tag) {
     return tag == "TK_SPACE" || tag == "TK_NEWLINE";
 }
 
-inline bool LooksComment(const std::string& lex) {
+inline bool LooksComment(std::string_view lex) {
     return lex.rfind("//", 0) == 0 || lex.rfind("/*", 0) == 0;
 }
 
@@ -70,13 +72,13 @@ inline bool LooksStringToken(const std::string& tag) {
     return tag == "TK_StringLiteral";
 }
 
-inline bool LooksNumberToken(const std::string& tag, const std::string& lex) {
+inline bool LooksNumberToken(const std::string& tag, std::string_view lex) {
     if (tag.find("Number") != std::string::npos) return true; // TK_DecNumber, TK_HexNumber, …
     // Fallback if tag is generic: digits or SystemVerilog number like 'h, 'd, 'b
     return !lex.empty() && (std::isdigit(static_cast<unsigned char>(lex[0])) || lex[0] == '\'');
 }
 
-inline bool LooksPP(const std::string& tag, const std::string& lex) {
+inline bool LooksPP(const std::string& tag, std::string_view lex) {
     if (!lex.empty() && lex[0] == '`') return true;              // `define, `include, macro use
     return tag.rfind("PP_", 0) == 0;                              // any preproc token
 }
@@ -100,7 +102,7 @@ inline bool IsSymbolIdentifier(const std::string& tag) {
     return false;
 }
 
-inline Color ColorFor(const std::string& tag, const std::string& lex) {
+inline Color ColorFor(const std::string& tag, std::string_view lex) {
     if (IsWhitespaceToken(tag))          return COL_TEXT;
     if (LooksComment(lex))               return COL_COMMENT;
     if (LooksStringToken(tag))           return COL_STRING;
@@ -113,28 +115,39 @@ inline Color ColorFor(const std::string& tag, const std::string& lex) {
     return COL_TEXT; // identifiers, etc.
 }
 
-static void AppendWhitespaceExpanded(const std::string& s, int tab_spaces,
+// What an expanded tab points into, spans never own their text
+static constexpr std::string_view kSpaces = "                                ";
+
+static void AppendWhitespaceExpanded(std::string_view s, int tab_spaces,
                                      sv::LineSpans& line) {
-    for (char ch : s) {
-        if (ch == '\t') line.push_back({std::string(tab_spaces, ' '), COL_TEXT});
-        else if (ch != '\r') line.push_back({std::string(1, ch), COL_TEXT});
+    const std::string_view tab = kSpaces.substr(0, size_t(std::clamp(tab_spaces, 0, int(kSpaces.size()))));
+    size_t run = 0; // start of the plain whitespace since the last tab or \r
+    for (size_t i = 0; i <= s.size(); i++) {
+        if (i < s.size() && s[i] != '\t' && s[i] != '\r') continue;
+        if (i > run) line.push_back({s.substr(run, i - run), COL_TEXT});
+        if (i < s.size() && s[i] == '\t') line.push_back({tab, COL_TEXT});
+        run = i + 1;
     }
 }
 
-static std::string ReadFile(const std::string& p) { 
-    std::ifstream f(p, std::ios::binary); 
-    if (!f) throw std::runtime_error("Failed to open: " + p); 
-    std::ostringstream ss; ss << f.rdbuf(); 
-    return ss.str();
-}
+} // namespace
+
+namespace sv {
 
-static sv::ColorizedDoc BuildDocFromVeribleJSON(const json& j,
-                                                const std::string& filepath,
-                                                const std::string& source,
-                                                int tab_spaces)
+ColorizedDoc BuildDocFromVeribleJSON(const json& j,
+                                    const std::string& filepath,
+                                    std::shared_ptr<const SV::MappedFile> file,
+                                    int tab_spaces)
 {
+    PROFILE_SCOPE("BuildDocFromVeribleJSON");
+
     sv::ColorizedDoc doc;
-    if (!j.contains(filepath)) return doc;
+    // Written in place since verible read it, the tokens would not match and the views could fault
+    if (!file || !file->Intact() || !j.contains(filepath)) return doc;
+
+    // Every span is a view into the mapping, the document keeps it alive
+    doc.source = std::move(file);
+    const std::string_view source = doc.source->Text();
 
     const json& fobj = j.at(filepath);
     const bool has_raw = fobj.contains("rawtokens");
@@ -144,11 +157,10 @@ static sv::ColorizedDoc BuildDocFromVeribleJSON(const json& j,
     sv::LineSpans current;
 
     for (const auto& t : toks) {
-        const std::string tag = t.at("tag").get<std::string>();
-        size_t a = t.at("start").get<size_t>();
-        size_t b = t.at("end").get<size_t>();
-        if (b > source.size()) b = source.size();
-        std::string lex = source.substr(a, b - a);
+        const std::string& tag = t.at("tag").get_ref<const std::string&>();
+        size_t b = std::min(t.at("end").get<size_t>(), source.size());
+        size_t a = std::min(t.at("start").get<size_t>(), b);
+        const std::string_view lex = source.substr(a, b - a);
 
         if (IsWhitespaceToken(tag)) {
             // Verible usually gives text for TK_SPACE/TK_NEWLINE too, but compute from source anyway
@@ -165,10 +177,10 @@ static sv::ColorizedDoc BuildDocFromVeribleJSON(const json& j,
         size_t p = 0;
         while (true) {
             size_t nl = lex.find('\n', p);
-            const std::string piece = (nl == std::string::npos) ? lex.substr(p)
-                                                                : lex.substr(p, nl - p);
+            const std::string_view piece = (nl == std::string_view::npos) ? lex.substr(p)
+                                                                          : lex.substr(p, nl - p);
             if (!piece.empty()) current.push_back({piece, ColorFor(tag, piece)});
-            if (nl == std::string::npos) break;
+            if (nl == std::string_view::npos) break;
             doc.push_back(std::move(current));
             current = sv::LineSpans{};
             p = nl + 1;
@@ -179,11 +191,14 @@ static sv::ColorizedDoc BuildDocFromVeribleJSON(const json& j,
     return doc;
 }
 
-} // namespace
-
-namespace sv {
+size_t DocBytes(const ColorizedDoc& doc) {
+    // The text itself is in the mapped source, counted with the mapped files
+    size_t bytes = doc.capacity() * sizeof(LineSpans);
+    for (const auto& line : doc) bytes += line.capacity() * sizeof(TextSpan);
+    return bytes;
+}
 
-ColorizedDoc ColorizeFileViaBazelRunfiles(const char* file_path, bazel::tools::cpp::runfiles::Runfiles* rf, const ColorizerOpts& opt) {
+json VeribleTokensViaBazelRunfiles(const char* file_path, bazel::tools::cpp::runfiles::Runfiles* rf, const ColorizerOpts& opt) {
     const std::string sv_file = ResolveUserPath(file_path);
     const std::string tool = rf->Rlocation("verible~/verible/verilog/tools/syntax/verible-verilog-syntax");
 
@@ -194,13 +209,19 @@ ColorizedDoc ColorizeFileViaBazelRunfiles(const char* file_path, bazel::tools::c
     FILE* pipe = popen(cmd.str().c_str(), "r");
     if (!pipe) throw std::runtime_error(std::string("failed to exec: ") + cmd.str());
 
-    std::string verible_json_str = ReadAll(pipe);
+    const IoBuffer verible_json = ReadAll(pipe);
     int rc = pclose(pipe);
     if (rc != 0) throw std::runtime_error("verible returned " + std::to_string(rc));
 
-    json j = json::parse(verible_json_str);
-    const std::string src = ReadFile(sv_file);
-    return BuildDocFromVeribleJSON(j, sv_file, src, opt.tab_spaces);
+    return json::parse(verible_json.data(), verible_json.data() + verible_json.size());
+}
+
+ColorizedDoc ColorizeFileViaBazelRunfiles(const char* file_path, bazel::tools::cpp::runfiles::Runfiles* rf, const ColorizerOpts& opt) {
+    const std::string sv_file = ResolveUserPath(file_path);
+    const json        j       = VeribleTokensViaBazelRunfiles(file_path, rf, opt);
+    auto              src     = SV::GetSourceFile(sv_file);
+    if (!src) throw std::runtime_error("Failed to open: " + sv_file);
+    return BuildDocFromVeribleJSON(j, sv_file, std::move(src), opt.tab_spaces);
 }
 
 } // namespace sv
@@ -0,0 +1,55 @@
+#include "common.h"
+#include "cst.h"
+#include "headless.h"
+
+// Render the hierarchy under every module of a project to an image, without opening a window
+int main(int argc, char** argv) {
+    std::string out_dir = ".";
+    std::string format  = "png";
+    bool        top_only = false;
+    std::vector<char*> files;
+
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if      (arg.rfind("--out=", 0) == 0)    out_dir  = arg.substr(6);
+        else if (arg.rfind("--format=", 0) == 0) format   = arg.substr(9);
+        else if (arg == "--top-only")            top_only = true;
+        else                                     files.push_back(argv[i]);
+    }
+    if (files.empty() || (format != "png" && format != "svg" && format != "pdf")) {
+        std::cerr << "usage: sv_export [--out=DIR] [--format=png|svg|pdf] [--top-only] <file.sv> [file_2.sv ...]\n";
+        return 2;
+    }
+
+    // Get runfiles
+    std::string error;
+    auto* rf = bazel::tools::cpp::runfiles::Runfiles::Create(argv[0], &error);
+    if (!rf) { std::cerr << "runfiles error: " << error << "\n"; return 1; }
+
+    // Scan the font database while parsing
+    graphics::FontRegistry::Get().warmUp();
+
+    json cst_json = cst::ParseFiles(files.size(), files.data(), rf);
+    SV::Module* root = cst::ParseCST(cst_json);
+
+    std::vector<SV::Module*> modules;
+    if (top_only) modules.push_back(root);
+    else          modules = cst::GetModuleSymbolTable()->modules;
+
+    const std::string out_path = ResolveUserPath(out_dir.c_str());
+    std::filesystem::create_directories(out_path);
+
+    std::vector<graphics::ExportView> views;
+    for (auto module : modules) {
+        graphics::ExportView view;
+        view.module      = module;
+        view.output_path = out_path + "/" + module->name + "." + format;
+        view.format      = graphics::exportFormatFromPath(view.output_path);
+        views.push_back(view);
+    }
+
+    size_t written = graphics::renderViews(views);
+    std::cout << "Wrote " << written << " of " << views.size() << " diagrams to " << out_path << "\n";
+
+    return written == views.size() ? 0 : 1;
+}
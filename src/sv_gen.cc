@@ -0,0 +1,51 @@
+#include <iostream>
+
+#include "design_gen.h"
+
+// Write a synthetic SystemVerilog design, for benchmarks and for trying the viewer on big projects
+int main(int argc, char** argv) {
+    gen::GenOpts opts;
+    std::string  out_dir = "generated";
+    uint64_t     instances = 0;
+
+    try {
+        for (int i = 1; i < argc; i++) {
+            std::string arg = argv[i];
+            auto value = [&](const char* flag) { return arg.substr(std::string(flag).size()); };
+            if      (arg.rfind("--out=", 0) == 0)              out_dir                = value("--out=");
+            else if (arg.rfind("--instances=", 0) == 0)        instances              = std::stoull(value("--instances="));
+            else if (arg.rfind("--modules=", 0) == 0)          opts.modules           = std::stoul(value("--modules="));
+            else if (arg.rfind("--fanout=", 0) == 0)           opts.fanout            = std::stoul(value("--fanout="));
+            else if (arg.rfind("--depth=", 0) == 0)            opts.depth             = std::stoul(value("--depth="));
+            else if (arg.rfind("--reuse=", 0) == 0)            opts.reuse             = std::stod(value("--reuse="));
+            else if (arg.rfind("--filler=", 0) == 0)           opts.filler_lines      = std::stoul(value("--filler="));
+            else if (arg.rfind("--modules-per-file=", 0) == 0) opts.modules_per_file  = std::stoul(value("--modules-per-file="));
+            else if (arg.rfind("--seed=", 0) == 0)             opts.seed              = std::stoull(value("--seed="));
+            else throw std::invalid_argument(arg);
+        }
+    } catch (const std::exception&) {
+        std::cerr << "usage: sv_gen [--out=DIR] [--instances=N | --modules=N --fanout=N --depth=N] [--reuse=0..1]\n"
+                     "              [--filler=LINES] [--modules-per-file=N] [--seed=N]\n";
+        return 2;
+    }
+    if (instances > 0) {
+        const gen::GenOpts sized = gen::OptsForInstances(instances);
+        opts.modules = sized.modules;
+        opts.fanout  = sized.fanout;
+        opts.depth   = sized.depth;
+    }
+
+    // Relative to where bazel run was started, not to the runfiles tree
+    if (const char* bwd = std::getenv("BUILD_WORKING_DIRECTORY"); bwd && *bwd && out_dir[0] != '/') {
+        out_dir = std::string(bwd) + "/" + out_dir;
+    }
+
+    const gen::GeneratedDesign design = gen::GenerateDesign(opts, out_dir);
+
+    // One JSON object, so scripts can pick up the files and sizes
+    std::cout << "{\"top\": \"" << design.top << "\", \"modules\": " << design.modules
+              << ", \"instances\": " << design.instances << ", \"bytes\": " << design.bytes << ", \"files\": [";
+    for (size_t i = 0; i < design.files.size(); i++) std::cout << (i ? ", " : "") << "\"" << design.files[i] << "\"";
+    std::cout << "]}\n";
+    return 0;
+}
@@ -0,0 +1,241 @@
+#include <chrono>
+
+#include "common.h"
+#include "cst.h"
+#include "design_db.h"
+#include "design_diff.h"
+#include "elaborate.h"
+
+namespace {
+
+void Usage() {
+    std::cerr << "usage: sv_query --build <design.db> <file.sv> [file_2.sv ...]\n"
+                 "       sv_query <design.db> stats | top | modules\n"
+                 "       sv_query <design.db> info|usages|children <module>\n"
+                 "       sv_query <design.db> tree [max_depth]\n"
+                 "       sv_query <design.db> specializations\n"
+                 "       sv_query <design.db> diff <base.db>\n"
+                 "       sv_query <design.db> path <top.u_a.u_b>\n";
+}
+
+// file:line of something declared at line in file, lines printed one based like compilers do
+std::string Location(const db::DesignDB& design, uint32_t file, uint32_t line) {
+    if (file == db::kNone) return "?";
+    return std::string(design.String(design.File(file).path)) + ":" + std::to_string(line + 1);
+}
+
+// Instance name with the range of an instance array or generate loop, as the hierarchy view shows it
+std::string InstanceName(const db::DesignDB& design, const db::InstanceRecord& inst) {
+    const std::string name(design.String(inst.name));
+    if (inst.range == db::kNone) return name;
+
+    const db::RangeRecord& r     = design.Range(inst.range);
+    const size_t           count = SV::InstanceRange::Count(r.first, r.last, r.step);
+    const std::string      dims  = r.resolved && count > 0
+        ? "[" + std::to_string(r.first) + ":" + std::to_string(SV::InstanceRange::Index(r.first, r.last, r.step, count - 1)) + "]"
+        : "[" + std::string(design.String(r.first_expr)) + ":" + std::string(design.String(r.last_expr)) + "]";
+    return r.scope.length == 0 ? name + dims : std::string(design.String(r.scope)) + dims + "." + name;
+}
+
+uint32_t FindModuleOrComplain(const db::DesignDB& design, const std::string& name) {
+    const uint32_t m = design.FindModule(name);
+    if (m == db::kNone) std::cerr << "no module named " << name << "\n";
+    return m;
+}
+
+void PrintTree(const db::DesignDB& design, uint32_t module, const std::string& name, int depth, int max_depth,
+               std::vector<uint32_t>& stack) {
+    std::cout << std::string(size_t(depth) * 2, ' ') << name << " (" << design.String(design.Module(module).name) << ")\n";
+
+    // A module that (indirectly) instantiates itself would never end
+    if (depth == max_depth || std::find(stack.begin(), stack.end(), module) != stack.end()) return;
+
+    stack.push_back(module);
+    const db::ModuleRecord& m = design.Module(module);
+    for (uint32_t i = m.first_instance; i < m.first_instance + m.num_instances; i++) {
+        const db::InstanceRecord& inst = design.Instance(i);
+        PrintTree(design, inst.module, InstanceName(design, inst), depth + 1, max_depth, stack);
+    }
+    stack.pop_back();
+}
+
+// Only the instances that changed, marked + added, - removed, ~ modified
+void PrintDiff(const diff::ModuleDiff* d, int depth, std::vector<const diff::ModuleDiff*>& stack) {
+    // The same pair of modules below itself changed the same way again
+    if (std::find(stack.begin(), stack.end(), d) != stack.end()) return;
+
+    stack.push_back(d);
+    for (const diff::ChildDiff& child : d->children) {
+        if (child.status == diff::DIFF_SAME) continue;
+        const SV::ModuleInstance& inst = child.status == diff::DIFF_REMOVED ? d->old_module->dependencies[child.old_dep]
+                                                                             : d->new_module->dependencies[child.new_dep];
+        const char mark = child.status == diff::DIFF_ADDED ? '+' : child.status == diff::DIFF_REMOVED ? '-' : '~';
+        std::cout << std::string(size_t(depth) * 2, ' ') << mark << " " << SV::InstanceLabel(inst) << " (" << inst.module->name << ")"
+                  << (child.diff && child.diff->module_changed ? " *" : "") << "\n";
+        if (child.diff) PrintDiff(child.diff, depth + 1, stack);
+    }
+    stack.pop_back();
+}
+
+int Build(const std::string& db_path, std::vector<char*>& files, const char* argv0) {
+    std::string error;
+    auto* rf = bazel::tools::cpp::runfiles::Runfiles::Create(argv0, &error);
+    if (!rf) { std::cerr << "runfiles error: " << error << "\n"; return 1; }
+
+    json cst_json = cst::ParseFiles(files.size(), files.data(), rf);
+    SV::Module* top = cst::ParseCST(cst_json);
+
+    std::vector<std::string> resolved;
+    for (char* file : files) resolved.push_back(ResolveUserPath(file));
+
+    const std::string out = ResolveUserPath(db_path.c_str());
+    if (!db::WriteDesignDB(out, resolved, cst::GetModuleSymbolTable(), top)) {
+        std::cerr << "could not write " << out << "\n";
+        return 1;
+    }
+    std::cout << "Wrote " << cst::GetModuleSymbolTable()->modules.size() << " modules to " << out << "\n";
+    return 0;
+}
+
+}
+
+// Answer questions about a design from its database, without running verible or opening a window
+int main(int argc, char** argv) {
+    if (argc < 3) { Usage(); return 2; }
+
+    if (std::string(argv[1]) == "--build") {
+        if (argc < 4) { Usage(); return 2; }
+        std::vector<char*> files(&argv[3], &argv[argc]);
+        return Build(argv[2], files, argv[0]);
+    }
+
+    const auto start  = std::chrono::steady_clock::now();
+    const auto design = db::DesignDB::Open(ResolveUserPath(argv[1]));
+    if (!design) { std::cerr << "not a design database: " << argv[1] << "\n"; return 1; }
+    const double open_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+    const std::string command = argv[2];
+    const std::string arg     = argc > 3 ? argv[3] : "";
+
+    if (command == "stats") {
+        std::cout << "files:     " << design->NumFiles() << "\n"
+                  << "modules:   " << design->NumModules() << "\n"
+                  << "instances: " << design->NumInstances() << "\n"
+                  << "opened in: " << open_ms << " ms\n";
+    } else if (command == "top") {
+        if (design->Top() == db::kNone) { std::cerr << "no top module\n"; return 1; }
+        std::cout << design->String(design->Module(design->Top()).name) << "\n";
+    } else if (command == "modules") {
+        for (uint32_t i = 0; i < design->NumModules(); i++) {
+            const db::ModuleRecord& m = design->Module(i);
+            std::cout << design->String(m.name) << "\t" << Location(*design, m.file, m.line) << "\n";
+        }
+    } else if (command == "info") {
+        const uint32_t i = FindModuleOrComplain(*design, arg);
+        if (i == db::kNone) return 1;
+        const db::ModuleRecord& m = design->Module(i);
+        std::cout << design->String(m.name) << "\n"
+                  << "  declared at: " << Location(*design, m.file, m.line) << "\n"
+                  << "  instances:   " << m.num_instances << "\n"
+                  << "  used:        " << m.num_references << " times\n";
+        for (uint32_t k = m.first_param; k < m.first_param + m.num_params; k++) {
+            const db::ParamRecord& param = design->Param(k);
+            std::cout << "  " << (param.local ? "localparam " : "parameter  ") << design->String(param.name) << " = "
+                      << design->String(param.value) << "\n";
+        }
+    } else if (command == "usages") {
+        const uint32_t i = FindModuleOrComplain(*design, arg);
+        if (i == db::kNone) return 1;
+        // Instances of the module, found through the modules that reference it
+        std::vector<uint32_t> parents(design->ReferencesBegin(i), design->ReferencesEnd(i));
+        std::sort(parents.begin(), parents.end());
+        parents.erase(std::unique(parents.begin(), parents.end()), parents.end());
+        for (uint32_t p : parents) {
+            const db::ModuleRecord& parent = design->Module(p);
+            for (uint32_t k = parent.first_instance; k < parent.first_instance + parent.num_instances; k++) {
+                const db::InstanceRecord& inst = design->Instance(k);
+                if (inst.module != i) continue;
+                std::cout << design->String(parent.name) << "." << InstanceName(*design, inst) << "\t"
+                          << Location(*design, parent.file, inst.line) << "\n";
+            }
+        }
+    } else if (command == "children") {
+        const uint32_t i = FindModuleOrComplain(*design, arg);
+        if (i == db::kNone) return 1;
+        const db::ModuleRecord& m = design->Module(i);
+        for (uint32_t k = m.first_instance; k < m.first_instance + m.num_instances; k++) {
+            const db::InstanceRecord& inst = design->Instance(k);
+            std::cout << InstanceName(*design, inst) << "\t" << design->String(design->Module(inst.module).name) << "\t"
+                      << Location(*design, m.file, inst.line) << "\n";
+        }
+    } else if (command == "tree") {
+        if (design->Top() == db::kNone) { std::cerr << "no top module\n"; return 1; }
+        const int max_depth = arg.empty() ? -1 : std::stoi(arg);
+        std::vector<uint32_t> stack;
+        const uint32_t top = design->Top();
+        PrintTree(*design, top, std::string(design->String(design->Module(top).name)), 0, max_depth, stack);
+    } else if (command == "specializations") {
+        // Every distinct parameter set under the top, the most used first
+        SV::Module* top = cst::ParseDesignDB(*design);
+        if (top == nullptr) { std::cerr << "no top module\n"; return 1; }
+        elab::Elaboration elaboration;
+        elaboration.Build(top);
+
+        std::vector<uint32_t> order(elaboration.NumSpecializations());
+        for (uint32_t i = 0; i < order.size(); i++) order[i] = i;
+        std::stable_sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) {
+            return elaboration.Get(a).instances > elaboration.Get(b).instances;
+        });
+        for (uint32_t i : order) std::cout << elaboration.Get(i).instances << "\t" << elaboration.Describe(i) << "\n";
+        std::cout << elaboration.NumInstances() << " instances, " << elaboration.NumSpecializations() << " specializations"
+                  << (elaboration.Truncated() ? " (truncated)" : "") << "\n";
+    } else if (command == "diff") {
+        // What changed since the base revision, modules first and then the hierarchy
+        const auto base = db::DesignDB::Open(ResolveUserPath(arg.c_str()));
+        if (!base) { std::cerr << "not a design database: " << arg << "\n"; return 1; }
+        SymTable::ModuleSymbolTable base_table;
+        const SV::Module* base_top = cst::ReadDesignDB(*base, &base_table);
+        const SV::Module* top      = cst::ParseDesignDB(*design);
+
+        diff::HierarchyDiff hierarchy;
+        hierarchy.Build(base_top, &base_table, top, cst::GetModuleSymbolTable());
+        for (const auto& change : hierarchy.Modules()) std::cout << diff::StatusName(change.status) << "\t" << change.name << "\n";
+
+        if (const diff::ModuleDiff* d = hierarchy.Top()) {
+            std::cout << d->new_module->name << (d->module_changed ? " *" : "") << "\n";
+            std::vector<const diff::ModuleDiff*> stack;
+            PrintDiff(d, 1, stack);
+        }
+        std::cout << hierarchy.Modules().size() << " modules changed, " << hierarchy.NumCompared() << " module pairs visited\n";
+    } else if (command == "path") {
+        // top.u_a.u_b, the first segment has to be the top module
+        std::vector<std::string> segments;
+        std::stringstream ss(arg);
+        for (std::string s; std::getline(ss, s, '.');) segments.push_back(s);
+        if (segments.empty() || design->Top() == db::kNone || segments[0] != design->String(design->Module(design->Top()).name)) {
+            std::cerr << "path has to start with the top module\n";
+            return 1;
+        }
+
+        uint32_t module = design->Top();
+        uint32_t file   = design->Module(module).file;
+        uint32_t line   = design->Module(module).line;
+        for (size_t s = 1; s < segments.size(); s++) {
+            const db::ModuleRecord& m = design->Module(module);
+            uint32_t found = db::kNone;
+            for (uint32_t k = m.first_instance; k < m.first_instance + m.num_instances && found == db::kNone; k++) {
+                if (design->String(design->Instance(k).name) == segments[s]) found = k;
+            }
+            if (found == db::kNone) { std::cerr << "no instance " << segments[s] << " in " << design->String(m.name) << "\n"; return 1; }
+            file   = m.file;
+            line   = design->Instance(found).line;
+            module = design->Instance(found).module;
+        }
+        std::cout << arg << "\t" << design->String(design->Module(module).name) << "\t" << Location(*design, file, line) << "\n";
+    } else {
+        Usage();
+        return 2;
+    }
+
+    return 0;
+}
@@ -0,0 +1,303 @@
+#include <algorithm>
+#include <chrono>
+
+#include "task_pool.h"
+
+namespace task {
+
+/**
+ * @brief Shared between the pool, the handles and the tasks that depend on it
+ * @var blockers   Dependencies that are not done yet, plus one until submit is through with it
+ * @var dependents Tasks to unblock once this one is done
+ */
+struct TaskState {
+    std::function<void()> fn;
+    Priority              priority = PRIORITY_BACKGROUND;
+    CancelToken           token;
+    TaskPool*             pool = nullptr;
+    std::atomic<size_t>   blockers{1};
+
+    std::mutex                              mtx;
+    std::condition_variable                 cv;
+    bool                                    finished = false;
+    std::exception_ptr                      error;
+    std::vector<std::shared_ptr<TaskState>> dependents;
+};
+
+namespace {
+
+// Which pool the current thread works for, which worker it is, and the priority of the task it runs
+thread_local TaskPool* t_pool    = nullptr;
+thread_local size_t    t_index   = 0;
+thread_local Priority  t_running = PRIORITY_COUNT;
+
+}
+
+// ----- TaskHandle -----
+
+bool TaskHandle::done() const {
+    if (!state) return true;
+    std::lock_guard<std::mutex> lock(state->mtx);
+    return state->finished;
+}
+
+void TaskHandle::wait() const {
+    if (!state) return;
+
+    TaskPool* pool = state->pool;
+    if (pool && pool->onWorker()) {
+        // A waiting background task gives its slot back, otherwise the tasks it waits on may find
+        // every slot taken by tasks waiting on them
+        const bool background = t_running == PRIORITY_BACKGROUND;
+        if (background) {
+            {
+                std::lock_guard<std::mutex> lock(pool->sleep_mtx);
+                pool->running_background--;
+            }
+            pool->sleep_cv.notify_one();
+        }
+
+        // Help out instead of blocking a worker, the task waited on may well be queued behind us
+        while (!done()) {
+            if (pool->runOne()) continue;
+            std::unique_lock<std::mutex> lock(state->mtx);
+            state->cv.wait_for(lock, std::chrono::milliseconds(1), [this] { return state->finished; });
+        }
+
+        // Taken back even over the cap, it is released as soon as the task finishes
+        if (background) pool->running_background++;
+    } else {
+        std::unique_lock<std::mutex> lock(state->mtx);
+        state->cv.wait(lock, [this] { return state->finished; });
+    }
+
+    std::exception_ptr error;
+    {
+        std::lock_guard<std::mutex> lock(state->mtx);
+        error = state->error;
+    }
+    if (error) std::rethrow_exception(error);
+}
+
+// ----- TaskPool -----
+
+TaskPool::TaskPool(size_t num_threads) {
+    if (num_threads == 0) num_threads = std::max(1u, std::thread::hardware_concurrency());
+    // Background work never takes the last worker, unless there is only one
+    max_background = num_threads > 1 ? num_threads - 1 : 1;
+
+    workers.reserve(num_threads);
+    for (size_t i = 0; i < num_threads; i++) workers.push_back(std::make_unique<Worker>());
+    for (size_t i = 0; i < num_threads; i++) workers[i]->thread = std::thread(&TaskPool::workerLoop, this, i);
+}
+
+TaskPool::~TaskPool() {
+    {
+        std::lock_guard<std::mutex> lock(sleep_mtx);
+        stopping = true;
+    }
+    sleep_cv.notify_all();
+    for (auto& w : workers) w->thread.join();
+}
+
+bool TaskPool::onWorker() const {
+    return t_pool == this;
+}
+
+TaskHandle TaskPool::submit(std::function<void()> fn, Priority priority, CancelToken token, const std::vector<TaskHandle>& after) {
+    auto task      = std::make_shared<TaskState>();
+    task->fn       = std::move(fn);
+    task->priority = priority;
+    task->token    = std::move(token);
+    task->pool     = this;
+    task->blockers = 1 + after.size();
+
+    for (const TaskHandle& dep : after) {
+        if (!dep.state) {
+            task->blockers--;
+            continue;
+        }
+        std::lock_guard<std::mutex> lock(dep.state->mtx);
+        if (dep.state->finished) task->blockers--;
+        else                     dep.state->dependents.push_back(task);
+    }
+
+    // Whoever takes blockers to zero schedules it, here or when the last dependency finishes
+    if (--task->blockers == 0) schedule(task);
+    return TaskHandle(task);
+}
+
+void TaskPool::schedule(std::shared_ptr<TaskState> task) {
+    const Priority priority = task->priority;
+    if (t_pool == this) {
+        // Own deque, newest first, it is the one whose data is still in cache
+        Worker& self = *workers[t_index];
+        std::lock_guard<std::mutex> lock(self.mtx);
+        self.queues[priority].push_back(std::move(task));
+    } else {
+        std::lock_guard<std::mutex> lock(shared_mtx);
+        shared[priority].push_back(std::move(task));
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(sleep_mtx);
+        queued[priority]++;
+    }
+    sleep_cv.notify_one();
+}
+
+// self is the worker looking, workers.size() for a thread outside the pool
+std::shared_ptr<TaskState> TaskPool::takeFrom(size_t self, Priority priority) {
+    if (self < workers.size()) {
+        Worker& own = *workers[self];
+        std::lock_guard<std::mutex> lock(own.mtx);
+        if (!own.queues[priority].empty()) {
+            auto task = std::move(own.queues[priority].back());
+            own.queues[priority].pop_back();
+            return task;
+        }
+    }
+    {
+        std::lock_guard<std::mutex> lock(shared_mtx);
+        if (!shared[priority].empty()) {
+            auto task = std::move(shared[priority].front());
+            shared[priority].pop_front();
+            return task;
+        }
+    }
+    // Steal the oldest task of somebody else, it is the one its owner gets to last
+    const size_t n = workers.size();
+    for (size_t k = 0; k < n; k++) {
+        const size_t v = (self + 1 + k) % n;
+        if (v == self) continue;
+        Worker& victim = *workers[v];
+        std::lock_guard<std::mutex> lock(victim.mtx);
+        if (!victim.queues[priority].empty()) {
+            auto task = std::move(victim.queues[priority].front());
+            victim.queues[priority].pop_front();
+            return task;
+        }
+    }
+    return nullptr;
+}
+
+std::shared_ptr<TaskState> TaskPool::take(size_t self) {
+    if (queued[PRIORITY_INTERACTIVE] > 0) {
+        if (auto task = takeFrom(self, PRIORITY_INTERACTIVE)) {
+            queued[PRIORITY_INTERACTIVE]--;
+            return task;
+        }
+    }
+
+    if (queued[PRIORITY_BACKGROUND] == 0) return nullptr;
+    // Claim a background slot before looking, so the cap holds with every worker looking at once
+    size_t running = running_background.load();
+    do {
+        if (running >= max_background) return nullptr;
+    } while (!running_background.compare_exchange_weak(running, running + 1));
+
+    if (auto task = takeFrom(self, PRIORITY_BACKGROUND)) {
+        queued[PRIORITY_BACKGROUND]--;
+        return task;
+    }
+    running_background--;
+    return nullptr;
+}
+
+void TaskPool::run(const std::shared_ptr<TaskState>& task) {
+    if (!task->token.cancelled()) {
+        // Tasks run inside wait() nest, the outer one continues once this one is done
+        const Priority outer = t_running;
+        t_running = task->priority;
+        try {
+            task->fn();
+        } catch (...) {
+            std::lock_guard<std::mutex> lock(task->mtx);
+            task->error = std::current_exception();
+        }
+        t_running = outer;
+    }
+    task->fn = nullptr; // let go of whatever it captured
+
+    if (task->priority == PRIORITY_BACKGROUND) {
+        {
+            std::lock_guard<std::mutex> lock(sleep_mtx);
+            running_background--;
+        }
+        // A background task may have been waiting for the slot
+        if (queued[PRIORITY_BACKGROUND] > 0) sleep_cv.notify_one();
+    }
+
+    std::vector<std::shared_ptr<TaskState>> dependents;
+    {
+        std::lock_guard<std::mutex> lock(task->mtx);
+        task->finished = true;
+        dependents.swap(task->dependents);
+    }
+    task->cv.notify_all();
+    for (auto& dep : dependents) {
+        if (--dep->blockers == 0) schedule(std::move(dep));
+    }
+}
+
+bool TaskPool::runOne() {
+    auto task = take(t_pool == this ? t_index : workers.size());
+    if (!task) return false;
+    run(task);
+    return true;
+}
+
+void TaskPool::workerLoop(size_t index) {
+    t_pool  = this;
+    t_index = index;
+
+    while (true) {
+        if (runOne()) continue;
+
+        std::unique_lock<std::mutex> lock(sleep_mtx);
+        sleep_cv.wait(lock, [this] {
+            return stopping || queued[PRIORITY_INTERACTIVE] > 0 ||
+                   (queued[PRIORITY_BACKGROUND] > 0 && running_background < max_background);
+        });
+        if (stopping) return;
+    }
+}
+
+void TaskPool::parallelFor(size_t count, const std::function<void(size_t)>& fn, Priority priority,
+                           CancelToken token, size_t max_parallel) {
+    if (count == 0) return;
+
+    size_t threads = workers.size() + (onWorker() ? 0 : 1);
+    if (max_parallel > 0) threads = std::min(threads, max_parallel);
+    threads = std::min(threads, count);
+
+    // Indices are handed out one at a time, so uneven items still spread evenly
+    std::atomic<size_t> next{0};
+    std::mutex          err_mtx;
+    std::exception_ptr  first_error;
+    auto body = [&] {
+        size_t i;
+        while (!token.cancelled() && (i = next++) < count) {
+            try {
+                fn(i);
+            } catch (...) {
+                std::lock_guard<std::mutex> lock(err_mtx);
+                if (!first_error) first_error = std::current_exception();
+            }
+        }
+    };
+
+    std::vector<TaskHandle> helpers;
+    for (size_t t = 1; t < threads; t++) helpers.push_back(submit(body, priority, token));
+    body();
+    for (const auto& h : helpers) h.wait();
+
+    if (first_error) std::rethrow_exception(first_error);
+}
+
+TaskPool& Pool() {
+    static TaskPool pool;
+    return pool;
+}
+
+}
@@ -0,0 +1,105 @@
+#include "include/core/SkCanvas.h"
+#include "include/core/SkSurface.h"
+
+#include "tiled_renderer.h"
+#include "profiler.h"
+
+namespace graphics {
+
+TiledRenderer::TiledRenderer(int num_threads, int tile_size) : tile_size(tile_size) {
+    if (num_threads <= 0) {
+        num_threads = std::max(1u, std::thread::hardware_concurrency());
+    }
+
+    // The calling thread renders tiles too, so it counts as one of them
+    for (int i = 0; i < num_threads - 1; i++) {
+        workers.emplace_back(&TiledRenderer::workerLoop, this);
+    }
+}
+
+TiledRenderer::~TiledRenderer() {
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        stopping = true;
+    }
+    cv_start.notify_all();
+    for (auto& worker : workers) worker.join();
+}
+
+void TiledRenderer::render(const SkPicture* picture, uint8_t* pixels, size_t row_bytes, const SkIRect& area) {
+    if (picture == nullptr || pixels == nullptr || area.isEmpty()) return;
+
+    std::unique_lock<std::mutex> lock(mtx);
+    job_picture   = picture;
+    job_pixels    = pixels;
+    job_row_bytes = row_bytes;
+    job_area      = area;
+
+    job_tiles.clear();
+    for (int y = area.top(); y < area.bottom(); y += tile_size) {
+        for (int x = area.left(); x < area.right(); x += tile_size) {
+            job_tiles.push_back(SkIRect::MakeLTRB(x, y, std::min(x + tile_size, area.right()),
+                                                        std::min(y + tile_size, area.bottom())));
+        }
+    }
+    next_tile = 0;
+
+    // Not worth waking anyone up for a single tile
+    if (workers.empty() || job_tiles.size() == 1) {
+        lock.unlock();
+        runTiles();
+        return;
+    }
+
+    pending_workers = int(workers.size());
+    generation++;
+    lock.unlock();
+    cv_start.notify_all();
+
+    runTiles();
+
+    lock.lock();
+    cv_done.wait(lock, [this] { return pending_workers == 0; });
+}
+
+void TiledRenderer::workerLoop() {
+    uint64_t seen_generation = 0;
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(mtx);
+            cv_start.wait(lock, [&] { return stopping || generation != seen_generation; });
+            if (stopping) return;
+            seen_generation = generation;
+        }
+
+        runTiles();
+
+        std::lock_guard<std::mutex> lock(mtx);
+        if (--pending_workers == 0) cv_done.notify_one();
+    }
+}
+
+void TiledRenderer::runTiles() {
+    // Threads grab tiles until there are none left, so a slow tile does not hold up the others
+    for (size_t i = next_tile++; i < job_tiles.size(); i = next_tile++) {
+        renderTile(job_tiles[i]);
+    }
+}
+
+void TiledRenderer::renderTile(const SkIRect& tile) {
+    PROFILE_SCOPE("raster/tile");
+
+    SkImageInfo info = SkImageInfo::Make(tile.width(), tile.height(), kBGRA_8888_SkColorType, kPremul_SkAlphaType);
+    uint8_t*    base = job_pixels + size_t(tile.y() - job_area.y()) * job_row_bytes
+                                  + size_t(tile.x() - job_area.x()) * info.bytesPerPixel();
+
+    auto surface = SkSurfaces::WrapPixels(info, base, job_row_bytes);
+    if (!surface) return;
+
+    // The picture is recorded in screen coordinates, move it so the tile origin ends up at (0, 0)
+    SkCanvas* canvas = surface->getCanvas();
+    canvas->translate(-tile.x(), -tile.y());
+    canvas->drawPicture(job_picture);
+}
+
+}
@@ -0,0 +1,235 @@
+#include <algorithm>
+
+#include "vec_batch.h"
+
+#if defined(__x86_64__) || defined(_M_X64) || (defined(__i386__) && defined(__SSE2__))
+#define SIMD_SSE2 1
+#include <immintrin.h>
+#endif
+
+// AVX2 is picked at runtime, so one binary runs everywhere and still uses it where it is there
+#if defined(SIMD_SSE2) && (defined(__GNUC__) || defined(__clang__))
+#define SIMD_AVX2 1
+#define SIMD_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+
+namespace simd {
+
+namespace {
+
+enum Isa { ISA_SCALAR, ISA_SSE2, ISA_AVX2 };
+
+Isa DetectIsa() {
+#if defined(SIMD_AVX2)
+    if (__builtin_cpu_supports("avx2")) return ISA_AVX2;
+#endif
+#if defined(SIMD_SSE2)
+    return ISA_SSE2;
+#else
+    return ISA_SCALAR;
+#endif
+}
+
+const Isa g_isa = DetectIsa();
+
+// ----- scalar, also the tail of every vector loop -----
+
+void TransformScalar(const BoxBuffer& in, size_t first, size_t last, float ox, float oy, float scale, BoxBuffer& out) {
+    for (size_t i = first; i < last; i++) {
+        out.x0[i] = (in.x0[i] - ox) * scale;
+        out.y0[i] = (in.y0[i] - oy) * scale;
+        out.x1[i] = (in.x1[i] - ox) * scale;
+        out.y1[i] = (in.y1[i] - oy) * scale;
+    }
+}
+
+void BoundsScalar(const BoxBuffer& b, size_t first, size_t last, AABB& bb) {
+    for (size_t i = first; i < last; i++) {
+        bb.ul.x = std::min(bb.ul.x, b.x0[i]);
+        bb.ul.y = std::min(bb.ul.y, b.y0[i]);
+        bb.br.x = std::max(bb.br.x, b.x1[i]);
+        bb.br.y = std::max(bb.br.y, b.y1[i]);
+    }
+}
+
+void CullScalar(const BoxBuffer& b, size_t first, size_t last, const AABB& r, const uint32_t* ids, std::vector<uint32_t>& out) {
+    for (size_t i = first; i < last; i++) {
+        if (b.x0[i] <= r.br.x && b.x1[i] >= r.ul.x && b.y0[i] <= r.br.y && b.y1[i] >= r.ul.y) {
+            out.push_back(ids ? ids[i] : uint32_t(i));
+        }
+    }
+}
+
+// Append the lanes set in mask, lowest first, so the order is the same as the scalar loop
+inline void AppendLanes(unsigned mask, size_t base, const uint32_t* ids, std::vector<uint32_t>& out) {
+    while (mask) {
+        const size_t i = base + size_t(__builtin_ctz(mask));
+        out.push_back(ids ? ids[i] : uint32_t(i));
+        mask &= mask - 1;
+    }
+}
+
+#if defined(SIMD_SSE2)
+
+// ----- SSE2, 4 boxes at a time -----
+
+size_t TransformSSE2(const BoxBuffer& in, size_t first, size_t n, float ox, float oy, float scale, BoxBuffer& out) {
+    const __m128 vox = _mm_set1_ps(ox), voy = _mm_set1_ps(oy), vs = _mm_set1_ps(scale);
+    size_t i = first;
+    for (; i + 4 <= n; i += 4) {
+        _mm_storeu_ps(&out.x0[i], _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(&in.x0[i]), vox), vs));
+        _mm_storeu_ps(&out.y0[i], _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(&in.y0[i]), voy), vs));
+        _mm_storeu_ps(&out.x1[i], _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(&in.x1[i]), vox), vs));
+        _mm_storeu_ps(&out.y1[i], _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(&in.y1[i]), voy), vs));
+    }
+    return i;
+}
+
+inline float HorizontalMin(__m128 v) {
+    v = _mm_min_ps(v, _mm_shuffle_ps(v, v, _MM_SHUFFLE(2, 3, 0, 1)));
+    v = _mm_min_ps(v, _mm_shuffle_ps(v, v, _MM_SHUFFLE(1, 0, 3, 2)));
+    return _mm_cvtss_f32(v);
+}
+inline float HorizontalMax(__m128 v) {
+    v = _mm_max_ps(v, _mm_shuffle_ps(v, v, _MM_SHUFFLE(2, 3, 0, 1)));
+    v = _mm_max_ps(v, _mm_shuffle_ps(v, v, _MM_SHUFFLE(1, 0, 3, 2)));
+    return _mm_cvtss_f32(v);
+}
+
+size_t BoundsSSE2(const BoxBuffer& b, size_t first, size_t last, AABB& bb) {
+    if (last - first < 4) return first;
+    __m128 x0 = _mm_loadu_ps(&b.x0[first]), y0 = _mm_loadu_ps(&b.y0[first]);
+    __m128 x1 = _mm_loadu_ps(&b.x1[first]), y1 = _mm_loadu_ps(&b.y1[first]);
+    size_t i = first + 4;
+    for (; i + 4 <= last; i += 4) {
+        x0 = _mm_min_ps(x0, _mm_loadu_ps(&b.x0[i]));
+        y0 = _mm_min_ps(y0, _mm_loadu_ps(&b.y0[i]));
+        x1 = _mm_max_ps(x1, _mm_loadu_ps(&b.x1[i]));
+        y1 = _mm_max_ps(y1, _mm_loadu_ps(&b.y1[i]));
+    }
+    bb = AABB(HorizontalMin(x0), HorizontalMin(y0), HorizontalMax(x1), HorizontalMax(y1));
+    return i;
+}
+
+size_t CullSSE2(const BoxBuffer& b, size_t first, size_t last, const AABB& r, const uint32_t* ids, std::vector<uint32_t>& out) {
+    const __m128 rx0 = _mm_set1_ps(r.ul.x), ry0 = _mm_set1_ps(r.ul.y);
+    const __m128 rx1 = _mm_set1_ps(r.br.x), ry1 = _mm_set1_ps(r.br.y);
+    size_t i = first;
+    for (; i + 4 <= last; i += 4) {
+        __m128 hit = _mm_cmple_ps(_mm_loadu_ps(&b.x0[i]), rx1);
+        hit = _mm_and_ps(hit, _mm_cmpge_ps(_mm_loadu_ps(&b.x1[i]), rx0));
+        hit = _mm_and_ps(hit, _mm_cmple_ps(_mm_loadu_ps(&b.y0[i]), ry1));
+        hit = _mm_and_ps(hit, _mm_cmpge_ps(_mm_loadu_ps(&b.y1[i]), ry0));
+        AppendLanes(unsigned(_mm_movemask_ps(hit)), i, ids, out);
+    }
+    return i;
+}
+
+#endif
+
+#if defined(SIMD_AVX2)
+
+// ----- AVX2, 8 boxes at a time, one whole spatial index leaf -----
+
+SIMD_TARGET_AVX2 size_t TransformAVX2(const BoxBuffer& in, size_t n, float ox, float oy, float scale, BoxBuffer& out) {
+    const __m256 vox = _mm256_set1_ps(ox), voy = _mm256_set1_ps(oy), vs = _mm256_set1_ps(scale);
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        _mm256_storeu_ps(&out.x0[i], _mm256_mul_ps(_mm256_sub_ps(_mm256_loadu_ps(&in.x0[i]), vox), vs));
+        _mm256_storeu_ps(&out.y0[i], _mm256_mul_ps(_mm256_sub_ps(_mm256_loadu_ps(&in.y0[i]), voy), vs));
+        _mm256_storeu_ps(&out.x1[i], _mm256_mul_ps(_mm256_sub_ps(_mm256_loadu_ps(&in.x1[i]), vox), vs));
+        _mm256_storeu_ps(&out.y1[i], _mm256_mul_ps(_mm256_sub_ps(_mm256_loadu_ps(&in.y1[i]), voy), vs));
+    }
+    return i;
+}
+
+SIMD_TARGET_AVX2 size_t BoundsAVX2(const BoxBuffer& b, size_t first, size_t last, AABB& bb) {
+    if (last - first < 8) return first;
+    __m256 x0 = _mm256_loadu_ps(&b.x0[first]), y0 = _mm256_loadu_ps(&b.y0[first]);
+    __m256 x1 = _mm256_loadu_ps(&b.x1[first]), y1 = _mm256_loadu_ps(&b.y1[first]);
+    size_t i = first + 8;
+    for (; i + 8 <= last; i += 8) {
+        x0 = _mm256_min_ps(x0, _mm256_loadu_ps(&b.x0[i]));
+        y0 = _mm256_min_ps(y0, _mm256_loadu_ps(&b.y0[i]));
+        x1 = _mm256_max_ps(x1, _mm256_loadu_ps(&b.x1[i]));
+        y1 = _mm256_max_ps(y1, _mm256_loadu_ps(&b.y1[i]));
+    }
+    // Fold the halves, the rest is the SSE2 reduction
+    bb = AABB(HorizontalMin(_mm_min_ps(_mm256_castps256_ps128(x0), _mm256_extractf128_ps(x0, 1))),
+              HorizontalMin(_mm_min_ps(_mm256_castps256_ps128(y0), _mm256_extractf128_ps(y0, 1))),
+              HorizontalMax(_mm_max_ps(_mm256_castps256_ps128(x1), _mm256_extractf128_ps(x1, 1))),
+              HorizontalMax(_mm_max_ps(_mm256_castps256_ps128(y1), _mm256_extractf128_ps(y1, 1))));
+    return i;
+}
+
+SIMD_TARGET_AVX2 size_t CullAVX2(const BoxBuffer& b, size_t first, size_t last, const AABB& r, const uint32_t* ids, std::vector<uint32_t>& out) {
+    const __m256 rx0 = _mm256_set1_ps(r.ul.x), ry0 = _mm256_set1_ps(r.ul.y);
+    const __m256 rx1 = _mm256_set1_ps(r.br.x), ry1 = _mm256_set1_ps(r.br.y);
+    size_t i = first;
+    for (; i + 8 <= last; i += 8) {
+        __m256 hit = _mm256_cmp_ps(_mm256_loadu_ps(&b.x0[i]), rx1, _CMP_LE_OQ);
+        hit = _mm256_and_ps(hit, _mm256_cmp_ps(_mm256_loadu_ps(&b.x1[i]), rx0, _CMP_GE_OQ));
+        hit = _mm256_and_ps(hit, _mm256_cmp_ps(_mm256_loadu_ps(&b.y0[i]), ry1, _CMP_LE_OQ));
+        hit = _mm256_and_ps(hit, _mm256_cmp_ps(_mm256_loadu_ps(&b.y1[i]), ry0, _CMP_GE_OQ));
+        AppendLanes(unsigned(_mm256_movemask_ps(hit)), i, ids, out);
+    }
+    return i;
+}
+
+#endif
+
+} // namespace
+
+const char* KernelIsa() {
+    switch (g_isa) {
+        case ISA_AVX2: return "avx2";
+        case ISA_SSE2: return "sse2";
+        default:       return "scalar";
+    }
+}
+
+void TransformBoxes(const BoxBuffer& in, const vec2& offset, float scale, BoxBuffer& out) {
+    const size_t n = in.size();
+    if (&out != &in) out.resize(n);
+
+    size_t done = 0;
+#if defined(SIMD_AVX2)
+    if (g_isa == ISA_AVX2) done = TransformAVX2(in, n, offset.x, offset.y, scale, out);
+#endif
+#if defined(SIMD_SSE2)
+    if (g_isa >= ISA_SSE2) done = TransformSSE2(in, done, n, offset.x, offset.y, scale, out);
+#endif
+    TransformScalar(in, done, n, offset.x, offset.y, scale, out);
+}
+
+AABB Bounds(const BoxBuffer& boxes, size_t first, size_t count) {
+    if (count == 0) return AABB();
+
+    const size_t last = first + count;
+    AABB   bb   = boxes.get(first);
+    size_t done = first;
+#if defined(SIMD_AVX2)
+    if (g_isa == ISA_AVX2) done = BoundsAVX2(boxes, first, last, bb);
+#endif
+#if defined(SIMD_SSE2)
+    if (g_isa == ISA_SSE2) done = BoundsSSE2(boxes, first, last, bb);
+#endif
+    BoundsScalar(boxes, done, last, bb);
+    return bb;
+}
+
+void CullBoxes(const BoxBuffer& boxes, size_t first, size_t count, const AABB& rect, const uint32_t* ids,
+               std::vector<uint32_t>& out) {
+    const size_t last = first + count;
+    size_t       done = first;
+#if defined(SIMD_AVX2)
+    if (g_isa == ISA_AVX2) done = CullAVX2(boxes, first, last, rect, ids, out);
+#endif
+#if defined(SIMD_SSE2)
+    // Also the 4 to 7 left over by AVX2, leaves are often not full
+    if (g_isa >= ISA_SSE2) done = CullSSE2(boxes, done, last, rect, ids, out);
+#endif
+    CullScalar(boxes, done, last, rect, ids, out);
+}
+
+}
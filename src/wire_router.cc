@@ -0,0 +1,336 @@
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <queue>
+#include <string_view>
+#include <unordered_map>
+
+#include "profiler.h"
+#include "wire_router.h"
+
+namespace graphics {
+
+namespace {
+
+// Parents routed per task, a fully expanded design has plenty of them to spread over every worker
+constexpr size_t kParentsPerTask = 64;
+
+// Boxes moved together are moved by the same delta, give or take rounding
+constexpr float kSamePos = 1e-3f;
+
+// Wires of a run of parents, merged once every run is routed. first_net of parents counts from the
+// start of the run
+struct WirePart {
+    std::vector<WireNet>     nets;
+    std::vector<WireSegment> segments;
+    std::vector<ParentWires> parents;
+    float                    channel_width = 0.f;
+};
+
+/**
+ * @var parent On the right edge of the parent, otherwise on the left edge of a child
+ */
+struct Terminal {
+    uint32_t net;
+    float    y;
+    bool     parent;
+};
+
+struct NetSpan {
+    float    top       = 0.f;
+    float    bottom    = 0.f;
+    uint32_t terminals = 0;
+    uint32_t track     = 0;
+    bool     port      = false;
+    bool     bus       = false;
+    bool     constant  = false;
+};
+
+// Port k of n, spread evenly over the height of the box so the stubs of one box never overlap
+float PortY(const AABB& box, size_t k, size_t n) {
+    return box.ul.y + (box.br.y - box.ul.y) * float(k + 1) / float(n + 1);
+}
+
+bool SamePos(vec2 a, vec2 b) {
+    return std::abs(a.x - b.x) <= kSamePos && std::abs(a.y - b.y) <= kSamePos;
+}
+
+// The channel of parent p is laid out like the one of old in prev, only moved
+bool SameChannel(const LayoutSnapshot& prev, uint32_t old, const LayoutSnapshot& snap, uint32_t p) {
+    const GraphItem& parent = snap.items[p];
+    const GraphItem& before = prev.items[old];
+    if (parent.module != before.module || !SamePos(parent.box.Size(), before.box.Size())) return false;
+
+    uint32_t c = p + 1;
+    uint32_t d = old + 1;
+    for (; c < parent.subtree_end && d < before.subtree_end; c = snap.items[c].subtree_end, d = prev.items[d].subtree_end) {
+        const GraphItem& child = snap.items[c];
+        const GraphItem& was   = prev.items[d];
+        if (child.node != was.node || child.instance != was.instance || child.is_range != was.is_range) return false;
+        if (!SamePos(child.box.ul - parent.box.ul, was.box.ul - before.box.ul) || !SamePos(child.box.Size(), was.box.Size())) {
+            return false;
+        }
+    }
+    return c >= parent.subtree_end && d >= before.subtree_end;
+}
+
+// Nets the previous routing found for a parent, moved by delta
+void CopyParent(const WireLayout& prev, const ParentWires& from, vec2 delta, WirePart& out) {
+    for (uint32_t n = from.first_net; n < from.first_net + from.num_nets; n++) {
+        WireNet net = prev.nets[n];
+        for (uint32_t s = net.first_segment; s < net.first_segment + net.num_segments; s++) {
+            out.segments.push_back({prev.segments[s].from + delta, prev.segments[s].to + delta});
+        }
+        net.bounds        = AABB(net.bounds.ul + delta, net.bounds.br + delta);
+        net.first_segment = uint32_t(out.segments.size()) - net.num_segments;
+        out.nets.push_back(net);
+    }
+}
+
+// Returns the width of the channel, 0 if the parent has no nets
+float RouteParent(const LayoutSnapshot& snap, uint32_t p, WirePart& out) {
+    const GraphItem&  parent = snap.items[p];
+    const SV::Module* module = parent.module;
+
+    std::unordered_map<std::string_view, uint32_t> net_of;
+    std::vector<NetSpan>                           spans;
+    std::vector<Terminal>                          terminals;
+
+    // The children are stacked in one column, the channel is the gap up to it
+    const float left  = parent.box.br.x;
+    float       right = 0.f;
+    bool        any   = false;
+    for (uint32_t c = p + 1; c < parent.subtree_end; c = snap.items[c].subtree_end) {
+        const GraphItem& child = snap.items[c];
+        // A removed instance belongs to the base revision, its signals are not the ones in module
+        if (!child.instance || child.instance->parent != module) continue;
+        right = any ? std::min(right, child.box.ul.x) : child.box.ul.x;
+        any   = true;
+
+        const auto& ports = child.instance->port_mapping;
+        for (size_t k = 0; k < ports.size(); k++) {
+            const float y = PortY(child.box, k, ports.size());
+            for (std::string_view signal : SV::SignalNames(ports[k].signal_name)) {
+                auto [it, added] = net_of.try_emplace(signal, uint32_t(spans.size()));
+                if (added) spans.emplace_back();
+                spans[it->second].bus |= child.is_range;
+                terminals.push_back({it->second, y, false});
+            }
+        }
+    }
+    if (terminals.empty() || right <= left) return 0.f;
+
+    // Ports of the parent only matter if something below it is connected to them
+    for (size_t k = 0; k < module->ports.size(); k++) {
+        auto it = net_of.find(module->ports[k].name);
+        if (it == net_of.end()) continue;
+        spans[it->second].port = true;
+        terminals.push_back({it->second, PortY(parent.box, k, module->ports.size()), true});
+    }
+    // A parameter handed down, like WIDTH in ".W(WIDTH)", is no wire
+    for (const auto& param : module->parameters) {
+        auto it = net_of.find(param.name);
+        if (it != net_of.end()) spans[it->second].constant = true;
+    }
+
+    // Grouped by net, so every net ends up as one run of segments
+    std::stable_sort(terminals.begin(), terminals.end(), [](const Terminal& a, const Terminal& b) { return a.net < b.net; });
+    for (const Terminal& t : terminals) {
+        NetSpan& span = spans[t.net];
+        span.top    = span.terminals == 0 ? t.y : std::min(span.top, t.y);
+        span.bottom = span.terminals == 0 ? t.y : std::max(span.bottom, t.y);
+        span.terminals++;
+    }
+
+    // Left edge first: going down the channel, a net takes the lowest track that is free again
+    std::vector<uint32_t> order;
+    for (uint32_t n = 0; n < spans.size(); n++) {
+        if (spans[n].terminals >= 2 && !spans[n].constant) order.push_back(n);
+    }
+    if (order.empty()) return 0.f;
+    std::sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) { return spans[a].top < spans[b].top; });
+
+    using Busy = std::pair<float, uint32_t>; // bottom of the net on the track, track
+    std::priority_queue<Busy, std::vector<Busy>, std::greater<Busy>>             busy;
+    std::priority_queue<uint32_t, std::vector<uint32_t>, std::greater<uint32_t>> free_tracks;
+    uint32_t num_tracks = 0;
+    for (uint32_t n : order) {
+        while (!busy.empty() && busy.top().first < spans[n].top) {
+            free_tracks.push(busy.top().second);
+            busy.pop();
+        }
+        if (free_tracks.empty()) {
+            spans[n].track = num_tracks++;
+        } else {
+            spans[n].track = free_tracks.top();
+            free_tracks.pop();
+        }
+        busy.push({spans[n].bottom, spans[n].track});
+    }
+
+    const float width = right - left;
+    for (size_t t = 0; t < terminals.size();) {
+        const uint32_t n   = terminals[t].net;
+        size_t         end = t;
+        while (end < terminals.size() && terminals[end].net == n) end++;
+
+        const NetSpan& span = spans[n];
+        if (span.terminals >= 2 && !span.constant) {
+            const float x = left + width * float(span.track + 1) / float(num_tracks + 1);
+
+            WireNet net;
+            net.bounds        = AABB(span.port ? left : x, span.top, right, span.bottom);
+            net.first_segment = uint32_t(out.segments.size());
+            net.style         = span.bus ? WIRE_BUS : span.port ? WIRE_PORT : WIRE_SIGNAL;
+            if (span.top < span.bottom) out.segments.push_back({vec2(x, span.top), vec2(x, span.bottom)});
+            for (size_t k = t; k < end; k++) {
+                const float y = terminals[k].y;
+                out.segments.push_back(terminals[k].parent ? WireSegment{vec2(left, y), vec2(x, y)}
+                                                           : WireSegment{vec2(x, y), vec2(right, y)});
+            }
+            net.num_segments = uint32_t(out.segments.size()) - net.first_segment;
+            out.nets.push_back(net);
+        }
+        t = end;
+    }
+    return width;
+}
+
+} // namespace
+
+std::shared_ptr<const WireLayout> routeWires(const LayoutSnapshot& snapshot, const task::CancelToken& token,
+                                             const LayoutSnapshot* prev_snapshot, const WireLayout* prev_wires) {
+    PROFILE_SCOPE("routeWires");
+
+    auto wires        = std::make_shared<WireLayout>();
+    wires->generation = snapshot.generation;
+
+    // Only a node with visible children has a channel to route, the elements of a range are not
+    // connected to the range itself
+    std::vector<uint32_t> parents;
+    for (uint32_t i = 0; i < snapshot.items.size(); i++) {
+        const GraphItem& item = snapshot.items[i];
+        if (item.expanded && !item.is_range && item.subtree_end > i + 1) parents.push_back(i);
+    }
+
+    // Where a parent was in the previous routing, if it is one that can be taken over
+    auto previous = [&](uint32_t p) -> const ParentWires* {
+        if (!prev_snapshot || !prev_wires) return nullptr;
+        const GraphItem* was = prev_snapshot->find(snapshot.items[p].node);
+        if (!was) return nullptr;
+        const uint32_t old = uint32_t(was - prev_snapshot->items.data());
+        auto it = std::lower_bound(prev_wires->parents.begin(), prev_wires->parents.end(), old,
+                                   [](const ParentWires& w, uint32_t item) { return w.item < item; });
+        if (it == prev_wires->parents.end() || it->item != old || !SameChannel(*prev_snapshot, old, snapshot, p)) return nullptr;
+        return &*it;
+    };
+
+    std::vector<WirePart> parts((parents.size() + kParentsPerTask - 1) / kParentsPerTask);
+    task::Pool().parallelFor(parts.size(), [&](size_t part) {
+        WirePart&    out = parts[part];
+        const size_t end = std::min(parents.size(), (part + 1) * kParentsPerTask);
+        for (size_t k = part * kParentsPerTask; k < end; k++) {
+            const uint32_t p     = parents[k];
+            const uint32_t first = uint32_t(out.nets.size());
+            float          width = 0.f;
+            if (const ParentWires* was = previous(p)) {
+                CopyParent(*prev_wires, *was, snapshot.items[p].box.ul - prev_snapshot->items[was->item].box.ul, out);
+                width = was->channel_width;
+            } else {
+                width = RouteParent(snapshot, p, out);
+            }
+            out.parents.push_back({p, first, uint32_t(out.nets.size()) - first, width});
+            out.channel_width = std::max(out.channel_width, width);
+        }
+    }, task::PRIORITY_BACKGROUND, token);
+    if (token.cancelled()) return nullptr;
+
+    size_t num_nets     = 0;
+    size_t num_segments = 0;
+    for (const WirePart& part : parts) {
+        num_nets     += part.nets.size();
+        num_segments += part.segments.size();
+    }
+    wires->nets.reserve(num_nets);
+    wires->segments.reserve(num_segments);
+    wires->parents.reserve(parents.size());
+    for (const WirePart& part : parts) {
+        const uint32_t base = uint32_t(wires->segments.size());
+        for (ParentWires parent : part.parents) {
+            parent.first_net += uint32_t(wires->nets.size());
+            wires->parents.push_back(parent);
+        }
+        for (WireNet net : part.nets) {
+            net.first_segment += base;
+            wires->nets.push_back(net);
+        }
+        wires->segments.insert(wires->segments.end(), part.segments.begin(), part.segments.end());
+        wires->channel_width = std::max(wires->channel_width, part.channel_width);
+    }
+
+    std::vector<SpatialIndex::Item> index_items;
+    index_items.reserve(wires->nets.size());
+    for (size_t i = 0; i < wires->nets.size(); i++) {
+        index_items.push_back({wires->nets[i].bounds, uint32_t(i)});
+    }
+    wires->index.build(std::move(index_items));
+    return wires;
+}
+
+WireRouter::~WireRouter() {
+    token.cancel();
+    waitIdle();
+}
+
+void WireRouter::route(std::shared_ptr<const LayoutSnapshot> snapshot) {
+    std::lock_guard<std::mutex> lock(mtx);
+
+    // Whatever is still being routed is for a layout that is gone
+    token.cancel();
+    token = task::CancelToken();
+    if (!snapshot) {
+        latest          = nullptr;
+        latest_snapshot = nullptr;
+        return;
+    }
+
+    // Forget jobs that are done
+    jobs.erase(std::remove_if(jobs.begin(), jobs.end(), [](const task::TaskHandle& job) {
+        return job.done();
+    }), jobs.end());
+
+    // Behind interactive work like opening a file, the nodes are drawn without wires meanwhile
+    task::CancelToken mine = token;
+    jobs.push_back(task::Pool().submit([this, snapshot, mine] {
+        std::shared_ptr<const WireLayout>     prev_wires;
+        std::shared_ptr<const LayoutSnapshot> prev_snapshot;
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+            prev_wires    = latest;
+            prev_snapshot = latest_snapshot;
+        }
+        auto wires = routeWires(*snapshot, mine, prev_snapshot.get(), prev_wires.get());
+
+        std::lock_guard<std::mutex> lock(mtx);
+        if (wires && !mine.cancelled()) {
+            latest          = std::move(wires);
+            latest_snapshot = snapshot;
+        }
+    }, task::PRIORITY_BACKGROUND, mine));
+}
+
+std::shared_ptr<const WireLayout> WireRouter::wires() const {
+    std::lock_guard<std::mutex> lock(mtx);
+    return latest;
+}
+
+void WireRouter::waitIdle() {
+    std::vector<task::TaskHandle> waiting;
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        waiting = jobs;
+    }
+    for (const auto& job : waiting) job.wait();
+}
+
+}
@@ -0,0 +1,98 @@
+#include <fstream>
+#include <string>
+
+#include "gtest/gtest.h"
+
+#include "code_text_cache.h"
+
+namespace graphics {
+namespace {
+
+// A document with one span per line of contents, backed by a file of its own
+sv::ColorizedDoc Doc(const std::string& name, const std::string& contents) {
+    const std::string path = testing::TempDir() + "/" + name;
+    std::ofstream(path, std::ios::binary) << contents;
+
+    sv::ColorizedDoc doc;
+    doc.source = SV::MappedFile::Open(path);
+    std::string_view text = doc.source->Text();
+    while (!text.empty()) {
+        const size_t end = std::min(text.find('\n'), text.size());
+        doc.push_back({sv::TextSpan{text.substr(0, end), Color()}});
+        text.remove_prefix(std::min(end + 1, text.size()));
+    }
+    return doc;
+}
+
+TEST(CodeTextCache, MeasuresTheLongestLine) {
+    const sv::ColorizedDoc doc = Doc("longest.sv", "module a;\n  wire [7:0] longest_line;\nendmodule\n");
+    CodeTextCache cache;
+    cache.sync(doc, SkFont(), 400.f);
+    EXPECT_EQ(cache.maxColumns(), std::string("  wire [7:0] longest_line;").size());
+}
+
+TEST(CodeTextCache, NoticesADocumentMovedIntoTheSameObject) {
+    // Same object and the same number of lines, only the source tells them apart
+    sv::ColorizedDoc doc = Doc("short.sv", "a\nb\n");
+    CodeTextCache cache;
+    cache.sync(doc, SkFont(), 400.f);
+    EXPECT_EQ(cache.maxColumns(), 1u);
+
+    doc = Doc("long.sv", "a_much_longer_line\nb\n");
+    cache.sync(doc, SkFont(), 400.f);
+    EXPECT_EQ(cache.maxColumns(), 18u);
+}
+
+TEST(CodeTextCache, InvalidateMeasuresTheDocumentAgain) {
+    sv::ColorizedDoc doc = Doc("edited.sv", "abc\nlonger line\n");
+    CodeTextCache cache;
+    cache.sync(doc, SkFont(), 400.f);
+    EXPECT_EQ(cache.maxColumns(), 11u);
+
+    // Edited in place, nothing about the object or its source changed
+    doc[1][0].text = doc[1][0].text.substr(0, 2);
+    cache.invalidate();
+    cache.sync(doc, SkFont(), 400.f);
+    EXPECT_EQ(cache.maxColumns(), 3u);
+}
+
+TEST(CodeTextCache, StopsShapingOnceTheSourceIsWrittenInPlace) {
+    const sv::ColorizedDoc doc = Doc("in_place.sv", "module a;\nendmodule\n");
+    CodeTextCache cache;
+    cache.sync(doc, SkFont(), 400.f);
+    EXPECT_FALSE(cache.line(0).runs.empty());
+
+    // The spans point past the end of the file now, only lines shaped before are still drawn
+    std::ofstream(testing::TempDir() + "/in_place.sv", std::ios::binary | std::ios::trunc) << "x";
+    cache.sync(doc, SkFont(), 400.f);
+    EXPECT_FALSE(cache.line(0).runs.empty());
+    EXPECT_TRUE(cache.line(1).runs.empty());
+}
+
+TEST(CodeTextCache, ScrollingWithinTheWindowReusesTheLine) {
+    const sv::ColorizedDoc doc = Doc("wide.sv", std::string(500, 'x') + "\n");
+    CodeTextCache cache;
+    cache.sync(doc, SkFont(), 200.f);
+
+    const CodeLine* line = &cache.line(0, 3);
+    EXPECT_EQ(line->first_col, 0u);
+    EXPECT_EQ(cache.columnX(*line, 0), 0.f);
+
+    // Every column up to the end of the window is drawn from the same blobs, moved
+    for (size_t col = 0; col <= CodeTextCache::kScrollColumns; col++) {
+        const CodeLine& scrolled = cache.line(0, col);
+        EXPECT_EQ(&scrolled, line);
+        EXPECT_EQ(scrolled.first_col, 0u);
+        if (col > 0) {
+            EXPECT_GE(cache.columnX(scrolled, col), cache.columnX(scrolled, col - 1));
+        }
+    }
+
+    // Past it the line is shaped again, starting on a multiple of the window
+    const CodeLine& next = cache.line(0, CodeTextCache::kScrollColumns + 5);
+    EXPECT_EQ(next.first_col, CodeTextCache::kScrollColumns);
+    EXPECT_EQ(cache.columnX(next, next.first_col), 0.f);
+}
+
+}
+}
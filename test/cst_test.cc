@@ -0,0 +1,93 @@
+#include <memory>
+#include <string>
+
+#include "gtest/gtest.h"
+
+#include "cst.h"
+
+namespace cst {
+namespace {
+
+using bazel::tools::cpp::runfiles::Runfiles;
+
+// test/ranges.sv through verible, found through the runfiles like in the binaries
+class RangesTest : public testing::Test {
+protected:
+    static void SetUpTestSuite() {
+        std::string error;
+        std::unique_ptr<Runfiles> rf(Runfiles::CreateForTest(BAZEL_CURRENT_REPOSITORY, &error));
+        ASSERT_NE(rf, nullptr) << error;
+
+        char  path[]  = "test/ranges.sv";
+        char* paths[] = {path};
+        top = ParseCST(ParseFiles(1, paths, rf.get()));
+    }
+
+    static const SV::ModuleInstance* Find(const std::string& name) {
+        for (const auto& dep : top->dependencies) {
+            if (dep.instance_name == name) return &dep;
+        }
+        return nullptr;
+    }
+
+    static SV::Module* top;
+};
+
+SV::Module* RangesTest::top = nullptr;
+
+TEST_F(RangesTest, OneInstancePerRange) {
+    ASSERT_NE(top, nullptr);
+    EXPECT_EQ(top->name, "ranges_top");
+    EXPECT_EQ(top->dependencies.size(), 6u);
+    EXPECT_EQ(top->instance_ranges.size(), 5u);
+}
+
+TEST_F(RangesTest, InstanceArrays) {
+    ASSERT_NE(top, nullptr);
+    const SV::ModuleInstance* arr = Find("u_arr");
+    ASSERT_NE(arr, nullptr);
+    EXPECT_EQ(SV::InstanceLabel(*arr), "u_arr[3:0]");
+    EXPECT_EQ(SV::NumElements(*arr), 4u);
+
+    // A size counts from 0
+    const SV::ModuleInstance* sized = Find("u_sized");
+    ASSERT_NE(sized, nullptr);
+    EXPECT_EQ(SV::InstanceLabel(*sized), "u_sized[0:3]");
+    EXPECT_EQ(SV::ElementName(*sized, 3), "u_sized[3]");
+}
+
+TEST_F(RangesTest, GenerateLoops) {
+    ASSERT_NE(top, nullptr);
+
+    // Resolved with the default parameters of the parent
+    const SV::ModuleInstance* up = Find("u_up");
+    ASSERT_NE(up, nullptr);
+    const SV::InstanceRange& r = top->instance_ranges[up->range];
+    EXPECT_EQ(r.first_expr, "0");
+    EXPECT_EQ(r.last_expr, "(N)-1");
+    EXPECT_EQ(r.step, 1);
+    EXPECT_TRUE(r.resolved);
+    EXPECT_EQ(SV::InstanceLabel(*up), "g_up[0:7].u_up");
+
+    const SV::ModuleInstance* down = Find("u_down");
+    ASSERT_NE(down, nullptr);
+    EXPECT_EQ(top->instance_ranges[down->range].step, -2);
+    EXPECT_EQ(SV::InstanceLabel(*down), "g_down[7:1].u_down");
+    EXPECT_EQ(SV::NumElements(*down), 4u);
+
+    // Unnamed blocks get a made up name, "k = k + 1" is a step too
+    const SV::ModuleInstance* anon = Find("u_anon");
+    ASSERT_NE(anon, nullptr);
+    EXPECT_EQ(SV::InstanceLabel(*anon), "genblk[0:2].u_anon");
+}
+
+TEST_F(RangesTest, OtherLoopsStaySingleInstances) {
+    ASSERT_NE(top, nullptr);
+    const SV::ModuleInstance* pow = Find("u_pow");
+    ASSERT_NE(pow, nullptr);
+    EXPECT_EQ(pow->range, -1);
+    EXPECT_EQ(SV::InstanceLabel(*pow), "u_pow");
+}
+
+}
+}
@@ -0,0 +1,106 @@
+#include "gtest/gtest.h"
+
+#include "damage_tracker.h"
+
+namespace graphics {
+namespace {
+
+DamageTracker Tracker(int width, int height) {
+    DamageTracker damage;
+    damage.reset(width, height);
+    damage.clear();
+    return damage;
+}
+
+TEST(DamageTracker, StartsFullyDamaged) {
+    DamageTracker damage;
+    damage.reset(640, 480);
+    damage.finalize();
+    ASSERT_EQ(damage.rects.size(), 1u);
+    EXPECT_EQ(damage.rects[0], SkIRect::MakeWH(640, 480));
+    EXPECT_TRUE(damage.full);
+}
+
+TEST(DamageTracker, ClearedTrackerIsEmpty) {
+    DamageTracker damage = Tracker(640, 480);
+    EXPECT_TRUE(damage.empty());
+    damage.finalize();
+    EXPECT_TRUE(damage.rects.empty());
+}
+
+TEST(DamageTracker, ClipsToBounds) {
+    DamageTracker damage = Tracker(100, 100);
+    damage.add(SkIRect::MakeLTRB(90, 90, 120, 130));
+    damage.add(SkIRect::MakeLTRB(200, 200, 210, 210)); // entirely outside
+    damage.finalize();
+    ASSERT_EQ(damage.rects.size(), 1u);
+    EXPECT_EQ(damage.rects[0], SkIRect::MakeLTRB(90, 90, 100, 100));
+}
+
+TEST(DamageTracker, RoundsOutFractionalRects) {
+    DamageTracker damage = Tracker(100, 100);
+    damage.add(SkRect::MakeLTRB(10.5f, 10.2f, 20.1f, 20.9f));
+    damage.finalize();
+    ASSERT_EQ(damage.rects.size(), 1u);
+    EXPECT_EQ(damage.rects[0], SkIRect::MakeLTRB(10, 10, 21, 21));
+}
+
+TEST(DamageTracker, MergesOverlappingRects) {
+    DamageTracker damage = Tracker(1000, 1000);
+    damage.add(SkIRect::MakeLTRB(0, 0, 10, 10));
+    damage.add(SkIRect::MakeLTRB(500, 500, 510, 510));
+    damage.add(SkIRect::MakeLTRB(5, 5, 20, 20));
+    // Overlaps the merged rect of the first and third, but neither of them alone
+    damage.add(SkIRect::MakeLTRB(15, 0, 30, 3));
+    damage.finalize();
+    ASSERT_EQ(damage.rects.size(), 2u);
+    EXPECT_EQ(damage.rects[0], SkIRect::MakeLTRB(0, 0, 30, 20));
+    EXPECT_EQ(damage.rects[1], SkIRect::MakeLTRB(500, 500, 510, 510));
+    EXPECT_FALSE(damage.full);
+}
+
+TEST(DamageTracker, KeepsTouchingRectsApart) {
+    DamageTracker damage = Tracker(1000, 1000);
+    damage.add(SkIRect::MakeLTRB(0, 0, 10, 10));
+    damage.add(SkIRect::MakeLTRB(10, 0, 20, 10));
+    damage.finalize();
+    EXPECT_EQ(damage.rects.size(), 2u);
+}
+
+TEST(DamageTracker, CollapsesManyRectsIntoTheirBounds) {
+    DamageTracker damage = Tracker(1000, 1000);
+    for (int i = 0; i <= int(DamageTracker::kMaxRects); i++) damage.add(SkIRect::MakeXYWH(i * 20, i * 20, 10, 10));
+    damage.finalize();
+    ASSERT_EQ(damage.rects.size(), 1u);
+    EXPECT_EQ(damage.rects[0], SkIRect::MakeLTRB(0, 0, int(DamageTracker::kMaxRects) * 20 + 10, int(DamageTracker::kMaxRects) * 20 + 10));
+    EXPECT_FALSE(damage.full);
+}
+
+TEST(DamageTracker, LargeDamageBecomesFull) {
+    DamageTracker damage = Tracker(100, 100);
+    damage.add(SkIRect::MakeLTRB(0, 0, 100, 70));
+    damage.finalize();
+    EXPECT_TRUE(damage.full);
+    ASSERT_EQ(damage.rects.size(), 1u);
+    EXPECT_EQ(damage.rects[0], SkIRect::MakeWH(100, 100));
+}
+
+TEST(DamageTracker, MergeTakesOverDamageOfAnotherTracker) {
+    DamageTracker a = Tracker(100, 100);
+    DamageTracker b = Tracker(100, 100);
+    b.add(SkIRect::MakeLTRB(1, 2, 3, 4));
+    a.merge(b);
+    ASSERT_EQ(a.rects.size(), 1u);
+    EXPECT_EQ(a.rects[0], SkIRect::MakeLTRB(1, 2, 3, 4));
+
+    b.addFull();
+    a.merge(b);
+    EXPECT_TRUE(a.full);
+
+    // Nothing is added on top of a full redraw
+    a.add(SkIRect::MakeLTRB(1, 2, 3, 4));
+    EXPECT_TRUE(a.rects.empty());
+}
+
+}
+}
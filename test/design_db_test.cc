@@ -0,0 +1,196 @@
+#include <cstddef>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "design_db.h"
+
+namespace db {
+namespace {
+
+std::string ReadFile(const std::string& path) {
+    std::ifstream     f(path, std::ios::binary);
+    std::stringstream ss;
+    ss << f.rdbuf();
+    return ss.str();
+}
+
+void WriteFile(const std::string& path, const std::string& contents) {
+    std::ofstream(path, std::ios::binary | std::ios::trunc) << contents;
+}
+
+template <typename T>
+void Patch(std::string& bytes, size_t offset, T value) {
+    std::memcpy(&bytes[offset], &value, sizeof(T));
+}
+
+// top                  in top.sv
+//   u_leaf[3:0]        leaf #(.W(8)) (.d(bus[0]))
+//   u_other            leaf
+class DesignDBTest : public testing::Test {
+protected:
+    void SetUp() override {
+        source = testing::TempDir() + "/design_db_top.sv";
+        path   = testing::TempDir() + "/design_db_test.db";
+        WriteFile(source, "module top;\n  leaf #(.W(8)) u_leaf[3:0] (.d(bus[0]));\n  leaf u_other ();\nendmodule\n");
+
+        top.name        = "top";
+        top.source_file = source;
+        top.span        = Range(0, 80);
+        leaf.name       = "leaf";
+        leaf.parameters.push_back({"W", "4", SV::LOGIC, false});
+        leaf.ports.push_back({});
+        leaf.ports.back().name = "d";
+
+        SV::InstanceRange range;
+        range.first_expr = "3";
+        range.last_expr  = "0";
+        range.first      = 3;
+        range.last       = 0;
+        range.resolved   = true;
+        top.instance_ranges.push_back(range);
+
+        SV::ModuleInstance arrayed;
+        arrayed.module        = &leaf;
+        arrayed.instance_name = "u_leaf";
+        arrayed.parent        = &top;
+        arrayed.span          = Range(14, 54);
+        arrayed.range         = 0;
+        arrayed.param_overrides.push_back({"W", "8"});
+        arrayed.port_mapping.push_back({SV::NAMED, "d", "bus[0]"});
+        top.dependencies.push_back(arrayed);
+
+        SV::ModuleInstance single;
+        single.module        = &leaf;
+        single.instance_name = "u_other";
+        single.parent        = &top;
+        single.span          = Range(57, 73);
+        top.dependencies.push_back(single);
+
+        leaf.references = {&top, &top};
+        SymTable::symbol_table_insert(&table, &top);
+        SymTable::symbol_table_insert(&table, &leaf);
+        ASSERT_TRUE(WriteDesignDB(path, {source}, &table, &top));
+    }
+
+    // The written file with one field changed
+    std::unique_ptr<DesignDB> OpenPatched(size_t offset, uint64_t value, size_t size) {
+        std::string bytes = ReadFile(path);
+        if (size == 4) Patch(bytes, offset, uint32_t(value));
+        else Patch(bytes, offset, value);
+        const std::string patched = path + ".patched";
+        WriteFile(patched, bytes);
+        return DesignDB::Open(patched);
+    }
+
+    std::string                 source;
+    std::string                 path;
+    SV::Module                  top;
+    SV::Module                  leaf;
+    SymTable::ModuleSymbolTable table;
+};
+
+TEST_F(DesignDBTest, RoundTrip) {
+    const auto design = DesignDB::Open(path);
+    ASSERT_NE(design, nullptr);
+    ASSERT_EQ(design->NumModules(), 2u);
+    EXPECT_EQ(design->NumInstances(), 2u);
+    EXPECT_EQ(design->NumRanges(), 1u);
+
+    const uint32_t t = design->FindModule("top");
+    const uint32_t l = design->FindModule("leaf");
+    ASSERT_NE(t, kNone);
+    ASSERT_NE(l, kNone);
+    EXPECT_EQ(design->FindModule("nope"), kNone);
+    EXPECT_EQ(design->Top(), t);
+    EXPECT_EQ(design->String(design->File(design->Module(t).file).path), source);
+    EXPECT_EQ(design->Module(l).file, kNone);
+
+    // Instances with their line, range, overrides and connections
+    const ModuleRecord& m = design->Module(t);
+    ASSERT_EQ(m.num_instances, 2u);
+    const InstanceRecord& arrayed = design->Instance(m.first_instance);
+    EXPECT_EQ(design->String(arrayed.name), "u_leaf");
+    EXPECT_EQ(arrayed.module, l);
+    EXPECT_EQ(arrayed.parent, t);
+    EXPECT_EQ(arrayed.line, 1u);
+    ASSERT_NE(arrayed.range, kNone);
+    EXPECT_EQ(design->Range(arrayed.range).first, 3);
+    EXPECT_EQ(design->Range(arrayed.range).last, 0);
+    EXPECT_EQ(design->String(design->Range(arrayed.range).first_expr), "3");
+    ASSERT_EQ(arrayed.num_params, 1u);
+    EXPECT_EQ(design->String(design->Param(arrayed.first_param).value), "8");
+    ASSERT_EQ(arrayed.num_ports, 1u);
+    EXPECT_EQ(design->String(design->Port(arrayed.first_port).signal), "bus[0]");
+
+    const InstanceRecord& single = design->Instance(m.first_instance + 1);
+    EXPECT_EQ(design->String(single.name), "u_other");
+    EXPECT_EQ(single.line, 2u);
+    EXPECT_EQ(single.range, kNone);
+
+    // Declarations of leaf and who instantiates it
+    const ModuleRecord& lm = design->Module(l);
+    ASSERT_EQ(lm.num_params, 1u);
+    EXPECT_EQ(design->String(design->Param(lm.first_param).name), "W");
+    EXPECT_EQ(design->String(design->Param(lm.first_param).value), "4");
+    ASSERT_EQ(lm.num_ports, 1u);
+    EXPECT_EQ(design->String(design->Port(lm.first_port).name), "d");
+    EXPECT_EQ(std::vector<uint32_t>(design->ReferencesBegin(l), design->ReferencesEnd(l)), (std::vector<uint32_t>{t, t}));
+}
+
+TEST_F(DesignDBTest, UpToDateFollowsTheSources) {
+    const auto design = DesignDB::Open(path);
+    ASSERT_NE(design, nullptr);
+    EXPECT_TRUE(design->UpToDate({source}));
+    EXPECT_FALSE(design->UpToDate({}));
+    EXPECT_FALSE(design->UpToDate({source, source}));
+
+    WriteFile(source, "module top;\nendmodule\n");
+    EXPECT_FALSE(design->UpToDate({source}));
+}
+
+TEST_F(DesignDBTest, RejectsCorruptedHeaders) {
+    const std::string bytes = ReadFile(path);
+    ASSERT_NE(OpenPatched(offsetof(Header, num_files), 1, 4), nullptr);  // unchanged value still opens
+
+    EXPECT_EQ(OpenPatched(offsetof(Header, magic), 0, 8), nullptr);
+    EXPECT_EQ(OpenPatched(offsetof(Header, version), kVersion + 1, 4), nullptr);
+    EXPECT_EQ(OpenPatched(offsetof(Header, total_size), bytes.size() + 1, 8), nullptr);
+    EXPECT_EQ(OpenPatched(offsetof(Header, top_module), 2, 4), nullptr);
+    EXPECT_EQ(OpenPatched(offsetof(Header, num_modules), 1000, 4), nullptr);
+    EXPECT_EQ(OpenPatched(offsetof(Header, modules_offset), bytes.size(), 8), nullptr);
+    EXPECT_EQ(OpenPatched(offsetof(Header, instances_offset), 4, 8), nullptr);  // misaligned
+    EXPECT_EQ(OpenPatched(offsetof(Header, num_buckets), 3, 4), nullptr);      // not a power of two
+    EXPECT_EQ(OpenPatched(offsetof(Header, strings_size), 0, 8), nullptr);
+}
+
+TEST_F(DesignDBTest, RejectsRecordsPointingOutside) {
+    const auto design = DesignDB::Open(path);
+    ASSERT_NE(design, nullptr);
+    const Header header = *reinterpret_cast<const Header*>(ReadFile(path).data());
+    const uint32_t t     = design->FindModule("top");
+
+    const size_t module   = header.modules_offset + t * sizeof(ModuleRecord);
+    const size_t instance = header.instances_offset;
+    EXPECT_EQ(OpenPatched(module + offsetof(ModuleRecord, num_instances), 3, 4), nullptr);
+    EXPECT_EQ(OpenPatched(module + offsetof(ModuleRecord, name) + offsetof(StringRef, length), 1u << 20, 4), nullptr);
+    EXPECT_EQ(OpenPatched(instance + offsetof(InstanceRecord, module), 2, 4), nullptr);
+    EXPECT_EQ(OpenPatched(instance + offsetof(InstanceRecord, range), 1, 4), nullptr);
+    EXPECT_EQ(OpenPatched(header.references_offset, 5, 4), nullptr);
+}
+
+TEST(DesignDB, RejectsMissingAndShortFiles) {
+    EXPECT_EQ(DesignDB::Open(testing::TempDir() + "/missing.db"), nullptr);
+
+    const std::string path = testing::TempDir() + "/short.db";
+    WriteFile(path, std::string(kMagic, sizeof(kMagic)));
+    EXPECT_EQ(DesignDB::Open(path), nullptr);
+}
+
+}
+}
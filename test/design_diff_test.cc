@@ -0,0 +1,179 @@
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "design_diff.h"
+
+namespace diff {
+namespace {
+
+// One revision of a design, modules by name
+struct Revision {
+    std::vector<std::unique_ptr<SV::Module>> modules;
+    SymTable::ModuleSymbolTable              table;
+
+    SV::Module* add(const std::string& name) {
+        modules.push_back(std::make_unique<SV::Module>());
+        modules.back()->name = name;
+        SymTable::symbol_table_insert(&table, modules.back().get());
+        return modules.back().get();
+    }
+
+    SV::Module* operator[](const std::string& name) { return SymTable::symbol_table_lookup(&table, name); }
+
+    void instantiate(const std::string& parent, const std::string& module, const std::string& name) {
+        SV::ModuleInstance instance;
+        instance.module        = (*this)[module];
+        instance.instance_name = name;
+        instance.parent        = (*this)[parent];
+        instance.parent->dependencies.push_back(instance);
+        instance.module->references.push_back(instance.parent);
+    }
+};
+
+// top
+//   u_x (x)    l0 (leaf)
+//   u_y (y)    l0 (leaf)
+//   u_z (z)
+//   u_g (gone)
+void Base(Revision& r) {
+    for (const char* name : {"top", "x", "y", "z", "leaf"}) r.add(name);
+    r.instantiate("top", "x", "u_x");
+    r.instantiate("top", "y", "u_y");
+    r.instantiate("top", "z", "u_z");
+    r.instantiate("x", "leaf", "l0");
+    r.instantiate("y", "leaf", "l0");
+}
+
+Status ChildStatus(const ModuleDiff* d, const std::string& module) {
+    for (const ChildDiff& child : d->children) {
+        const SV::Module* parent = child.new_dep >= 0 ? d->new_module : d->old_module;
+        const int32_t     dep    = child.new_dep >= 0 ? child.new_dep : child.old_dep;
+        if (parent->dependencies[dep].module->name == module) return child.status;
+    }
+    ADD_FAILURE() << "no instance of " << module;
+    return DIFF_SAME;
+}
+
+TEST(MerkleHashes, TreeHashFollowsChanges) {
+    Revision a, b;
+    Base(a);
+    Base(b);
+    b["leaf"]->parameters.push_back({});
+    b["leaf"]->parameters.back().name = "W";
+
+    MerkleHashes ha, hb;
+    ha.Build(&a.table);
+    hb.Build(&b.table);
+
+    EXPECT_EQ(ha.Get(a["z"]).tree, hb.Get(b["z"]).tree);
+    EXPECT_NE(ha.Get(a["leaf"]).local, hb.Get(b["leaf"]).local);
+    EXPECT_EQ(ha.Get(a["x"]).local, hb.Get(b["x"]).local);
+    EXPECT_NE(ha.Get(a["x"]).tree, hb.Get(b["x"]).tree);
+    EXPECT_NE(ha.Get(a["top"]).tree, hb.Get(b["top"]).tree);
+
+    SV::Module stranger;
+    EXPECT_EQ(ha.Get(&stranger).tree, 0u);
+}
+
+TEST(HierarchyDiff, SameDesign) {
+    Revision a, b;
+    Base(a);
+    Base(b);
+
+    HierarchyDiff d;
+    d.Build(a["top"], &a.table, b["top"], &b.table);
+    ASSERT_NE(d.Top(), nullptr);
+    EXPECT_EQ(d.Top()->status, DIFF_SAME);
+    EXPECT_TRUE(d.Top()->children.empty());
+    EXPECT_TRUE(d.Modules().empty());
+    EXPECT_EQ(d.NumCompared(), 1u);
+}
+
+TEST(HierarchyDiff, Statuses) {
+    Revision a, b;
+    Base(a);
+    Base(b);
+    a.add("gone");
+    a.instantiate("top", "gone", "u_g");
+    b.add("fresh");
+    b.instantiate("top", "fresh", "u_n");
+    b["leaf"]->parameters.push_back({});
+    b["leaf"]->parameters.back().name = "W";
+
+    HierarchyDiff d;
+    d.Build(a["top"], &a.table, b["top"], &b.table);
+    const ModuleDiff* top = d.Top();
+    ASSERT_NE(top, nullptr);
+    EXPECT_EQ(top->status, DIFF_MODIFIED);
+    EXPECT_TRUE(top->module_changed);
+
+    // New instances in order, the removed one after them
+    ASSERT_EQ(top->children.size(), 5u);
+    EXPECT_EQ(ChildStatus(top, "x"), DIFF_MODIFIED);
+    EXPECT_EQ(ChildStatus(top, "y"), DIFF_MODIFIED);
+    EXPECT_EQ(ChildStatus(top, "z"), DIFF_SAME);
+    EXPECT_EQ(ChildStatus(top, "fresh"), DIFF_ADDED);
+    EXPECT_EQ(ChildStatus(top, "gone"), DIFF_REMOVED);
+    EXPECT_EQ(top->children.back().status, DIFF_REMOVED);
+    EXPECT_EQ(top->children.back().new_dep, -1);
+
+    // x only changed below, leaf itself changed
+    const ModuleDiff* x = top->children[0].diff;
+    ASSERT_NE(x, nullptr);
+    EXPECT_FALSE(x->module_changed);
+    ASSERT_EQ(x->children.size(), 1u);
+    EXPECT_EQ(x->children[0].status, DIFF_MODIFIED);
+    EXPECT_TRUE(x->children[0].diff->module_changed);
+
+    // leaf is compared once for both x and y, z is never entered
+    EXPECT_EQ(top->children[1].diff->children[0].diff, x->children[0].diff);
+    EXPECT_EQ(d.NumCompared(), 4u);
+
+    std::vector<std::pair<std::string, Status>> modules;
+    for (const auto& m : d.Modules()) modules.emplace_back(m.name, m.status);
+    EXPECT_EQ(modules, (std::vector<std::pair<std::string, Status>>{
+                           {"top", DIFF_MODIFIED}, {"leaf", DIFF_MODIFIED}, {"fresh", DIFF_ADDED}, {"gone", DIFF_REMOVED}}));
+}
+
+TEST(HierarchyDiff, RenamedInstanceIsRemovedAndAdded) {
+    Revision a, b;
+    Base(a);
+    Base(b);
+    b["top"]->dependencies[2].instance_name = "u_z2";
+
+    HierarchyDiff d;
+    d.Build(a["top"], &a.table, b["top"], &b.table);
+    ASSERT_NE(d.Top(), nullptr);
+    ASSERT_EQ(d.Top()->children.size(), 4u);
+    EXPECT_EQ(d.Top()->children[2].status, DIFF_ADDED);
+    EXPECT_EQ(d.Top()->children[3].status, DIFF_REMOVED);
+    EXPECT_EQ(d.Top()->children[3].old_dep, 2);
+}
+
+TEST(HierarchyDiff, SelfInstantiationTerminates) {
+    Revision a, b;
+    for (Revision* r : {&a, &b}) {
+        r->add("r");
+        r->instantiate("r", "r", "u_r");
+    }
+    b["r"]->parameters.push_back({});
+
+    HierarchyDiff d;
+    d.Build(a["r"], &a.table, b["r"], &b.table);
+    ASSERT_NE(d.Top(), nullptr);
+    EXPECT_EQ(d.Top()->children.at(0).diff, d.Top());
+}
+
+TEST(HierarchyDiff, MissingTop) {
+    Revision a;
+    Base(a);
+    HierarchyDiff d;
+    d.Build(a["top"], &a.table, nullptr, nullptr);
+    EXPECT_EQ(d.Top(), nullptr);
+}
+
+}
+}
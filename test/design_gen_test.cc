@@ -0,0 +1,124 @@
+#include <fstream>
+#include <map>
+#include <regex>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "design_gen.h"
+
+namespace gen {
+namespace {
+
+std::string ReadFile(const std::string& path) {
+    std::ifstream     f(path, std::ios::binary);
+    std::stringstream ss;
+    ss << f.rdbuf();
+    return ss.str();
+}
+
+// Module name -> modules it instantiates, read back from the written files
+std::map<std::string, std::vector<std::string>> ReadHierarchy(const GeneratedDesign& design) {
+    static const std::regex module(R"(^module (\w+))");
+    static const std::regex instance(R"(^    (\w+) u_\d+ \()");
+
+    std::map<std::string, std::vector<std::string>> hierarchy;
+    std::string                                      current;
+    for (const auto& file : design.files) {
+        std::istringstream in(ReadFile(file));
+        for (std::string line; std::getline(in, line);) {
+            std::smatch match;
+            if (std::regex_search(line, match, module)) {
+                current = match[1];
+                hierarchy[current];
+            } else if (std::regex_search(line, match, instance)) {
+                hierarchy[current].push_back(match[1]);
+            }
+        }
+    }
+    return hierarchy;
+}
+
+uint64_t CountInstances(const std::map<std::string, std::vector<std::string>>& hierarchy, const std::string& module) {
+    uint64_t n = 1;
+    for (const auto& child : hierarchy.at(module)) n += CountInstances(hierarchy, child);
+    return n;
+}
+
+GenOpts SmallOpts() {
+    GenOpts opts;
+    opts.modules          = 13;
+    opts.fanout           = 4;
+    opts.depth            = 3;
+    opts.modules_per_file = 4;
+    opts.filler_lines     = 2;
+    return opts;
+}
+
+TEST(DesignGen, WritesTheDesignItReports) {
+    const GenOpts         opts   = SmallOpts();
+    const GeneratedDesign design = GenerateDesign(opts, testing::TempDir() + "/design_gen");
+    const auto            hierarchy = ReadHierarchy(design);
+
+    EXPECT_EQ(design.top, "l0_m0");
+    EXPECT_EQ(design.modules, opts.modules);
+    EXPECT_EQ(hierarchy.size(), opts.modules);
+    EXPECT_EQ(design.files.size(), (opts.modules + opts.modules_per_file - 1) / opts.modules_per_file);
+    EXPECT_EQ(design.instances, 1u + 4u + 16u + 64u);
+    EXPECT_EQ(CountInstances(hierarchy, design.top), design.instances);
+
+    uint64_t bytes = 0;
+    for (const auto& file : design.files) bytes += ReadFile(file).size();
+    EXPECT_EQ(design.bytes, bytes);
+}
+
+TEST(DesignGen, OnlyTheTopIsNeverInstantiated) {
+    GenOpts opts = SmallOpts();
+    opts.reuse   = 0.9;
+    const auto hierarchy = ReadHierarchy(GenerateDesign(opts, testing::TempDir() + "/design_gen_reuse"));
+
+    std::map<std::string, int> used;
+    for (const auto& [module, children] : hierarchy) {
+        for (const auto& child : children) used[child]++;
+    }
+    for (const auto& [module, children] : hierarchy) EXPECT_EQ(used.count(module) == 0, module == "l0_m0") << module;
+}
+
+TEST(DesignGen, NoMoreModulesOnALevelThanInstances) {
+    GenOpts opts = SmallOpts();
+    opts.modules = 40;
+    const GeneratedDesign design = GenerateDesign(opts, testing::TempDir() + "/design_gen_capped");
+    const auto            hierarchy = ReadHierarchy(design);
+
+    // Level 1 only has 4 instances, the rest is spread over the levels below
+    EXPECT_EQ(design.modules, hierarchy.size());
+    EXPECT_LT(design.modules, opts.modules);
+    EXPECT_EQ(hierarchy.count("l1_m3"), 1u);
+    EXPECT_EQ(hierarchy.count("l1_m4"), 0u);
+    EXPECT_EQ(CountInstances(hierarchy, design.top), design.instances);
+}
+
+TEST(DesignGen, SameSeedSameDesign) {
+    GenOpts opts = SmallOpts();
+    opts.reuse   = 0.5;
+    const GeneratedDesign a = GenerateDesign(opts, testing::TempDir() + "/design_gen_a");
+    const GeneratedDesign b = GenerateDesign(opts, testing::TempDir() + "/design_gen_b");
+    ASSERT_EQ(a.files.size(), b.files.size());
+    for (size_t i = 0; i < a.files.size(); i++) EXPECT_EQ(ReadFile(a.files[i]), ReadFile(b.files[i]));
+}
+
+TEST(DesignGen, OptsForInstancesReachesTheTarget) {
+    for (uint64_t target : {10u, 1000u, 12345u, 1000000u}) {
+        const GenOpts opts = OptsForInstances(target);
+        uint64_t      instances = 0;
+        uint64_t      level     = 1;
+        for (size_t l = 0; l <= opts.depth; l++, level *= opts.fanout) instances += level;
+        EXPECT_GE(instances, target);
+        EXPECT_LT(instances, target * 2 * opts.fanout);
+    }
+}
+
+}
+}
@@ -0,0 +1,189 @@
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "elaborate.h"
+
+namespace elab {
+namespace {
+
+std::optional<int64_t> Eval(std::string_view expr) {
+    return EvalConstExpr(expr, [](std::string_view name) -> std::optional<int64_t> {
+        if (name == "W") return 8;
+        return std::nullopt;
+    });
+}
+
+SV::Parameter Param(const std::string& name, const std::string& value, bool local = false) {
+    SV::Parameter param;
+    param.name          = name;
+    param.default_value = value;
+    param.local         = local;
+    return param;
+}
+
+SV::ModuleInstance Instance(SV::Module* module, SV::Module* parent, std::vector<SV::ParamOverride> overrides = {}) {
+    SV::ModuleInstance instance;
+    instance.module          = module;
+    instance.instance_name   = "u_" + module->name;
+    instance.parent          = parent;
+    instance.param_overrides = std::move(overrides);
+    return instance;
+}
+
+TEST(EvalConstExpr, Operators) {
+    EXPECT_EQ(Eval("1"), 1);
+    EXPECT_EQ(Eval("W*2-1"), 15);
+    EXPECT_EQ(Eval("(W + 1) * 2"), 18);
+    EXPECT_EQ(Eval("1 << 4"), 16);
+    EXPECT_EQ(Eval("2**10"), 1024);
+    EXPECT_EQ(Eval("-3 >>> 1"), -2);
+    EXPECT_EQ(Eval("W>4 ? 3 : 2"), 3);
+    EXPECT_EQ(Eval("W == 8 && 1"), 1);
+    EXPECT_EQ(Eval("$clog2(W)"), 3);
+    EXPECT_EQ(Eval("$clog2(W+1)"), 4);
+}
+
+TEST(EvalConstExpr, Literals) {
+    EXPECT_EQ(Eval("8'hFF"), 255);
+    EXPECT_EQ(Eval("32'd1"), 1);
+    EXPECT_EQ(Eval("4'b1010"), 10);
+    EXPECT_EQ(Eval("8 'h_1F"), 31);
+    EXPECT_EQ(Eval("'0"), 0);
+}
+
+TEST(EvalConstExpr, NotAConstantInteger) {
+    EXPECT_EQ(Eval("4'b1x01"), std::nullopt);
+    EXPECT_EQ(Eval("'1"), std::nullopt);
+    EXPECT_EQ(Eval("\"HELLO\""), std::nullopt);
+    EXPECT_EQ(Eval("1.5"), std::nullopt);
+    EXPECT_EQ(Eval("(W+1)/0"), std::nullopt);
+    EXPECT_EQ(Eval("UNKNOWN + 1"), std::nullopt);
+    EXPECT_EQ(Eval("pkg::X"), std::nullopt);
+    EXPECT_EQ(Eval(""), std::nullopt);
+    EXPECT_EQ(Eval("1 +"), std::nullopt);
+}
+
+TEST(ResolveRange, EvaluatesBothEnds) {
+    SV::Module module;
+    module.parameters = {Param("N", "4")};
+    const std::vector<std::string> values = DefaultValues(&module);
+
+    SV::InstanceRange range;
+    range.first_expr = "N-1";
+    range.last_expr  = "0";
+    int first = 0, last = 0;
+    ASSERT_TRUE(ResolveRange(range, ModuleScope(&module, values), first, last));
+    EXPECT_EQ(first, 3);
+    EXPECT_EQ(last, 0);
+
+    range.last_expr = "M";
+    EXPECT_FALSE(ResolveRange(range, ModuleScope(&module, values), first, last));
+}
+
+// top instantiates mid 100 times, a third of them with N=2. mid instantiates leaf 1000 times, half
+// by name with W=N*8 and half by position with 4+4.
+class ElaborationTest : public testing::Test {
+protected:
+    void SetUp() override {
+        top.name  = "top";
+        mid.name  = "mid";
+        leaf.name = "leaf";
+        leaf.parameters = {Param("W", "4"), Param("D", "W*2"), Param("L", "D+1", true)};
+        mid.parameters  = {Param("N", "1")};
+        for (int i = 0; i < 1000; i++) {
+            if (i % 2) mid.dependencies.push_back(Instance(&leaf, &mid, {{"W", "N*8"}}));
+            else mid.dependencies.push_back(Instance(&leaf, &mid, {{"", "4+4"}}));
+        }
+        for (int i = 0; i < 100; i++) {
+            if (i % 3 == 0) top.dependencies.push_back(Instance(&mid, &top, {{"N", "2"}}));
+            else top.dependencies.push_back(Instance(&mid, &top));
+        }
+        elaboration.Build(&top);
+    }
+
+    SV::Module  top;
+    SV::Module  mid;
+    SV::Module  leaf;
+    Elaboration elaboration;
+};
+
+TEST_F(ElaborationTest, InternsEqualValues) {
+    // W=8 is reached both by name (N=1) and by position, so leaf has two configurations, not three
+    EXPECT_EQ(elaboration.NumSpecializations(), 5u);
+    EXPECT_EQ(elaboration.SpecializationsOf(&mid).size(), 2u);
+    EXPECT_EQ(elaboration.SpecializationsOf(&leaf).size(), 2u);
+    EXPECT_FALSE(elaboration.Truncated());
+
+    // Children of one specialization point at the same interned entries
+    const Specialization& m = elaboration.Get(elaboration.SpecializationsOf(&mid)[0]);
+    ASSERT_EQ(m.children.size(), 1000u);
+    EXPECT_EQ(m.children[0], m.children[2]);
+    EXPECT_EQ(m.children[1], m.children[3]);
+}
+
+TEST_F(ElaborationTest, ResolvesValuesPerSpecialization) {
+    uint64_t leaves = 0;
+    for (uint32_t spec : elaboration.SpecializationsOf(&leaf)) {
+        const std::string* w = elaboration.Value(spec, "W");
+        ASSERT_NE(w, nullptr);
+        // Later parameters use the resolved earlier ones, local ones included
+        EXPECT_EQ(*elaboration.Value(spec, "D"), std::to_string(std::stoi(*w) * 2));
+        EXPECT_EQ(*elaboration.Value(spec, "L"), std::to_string(std::stoi(*w) * 2 + 1));
+        EXPECT_EQ(elaboration.Value(spec, "X"), nullptr);
+        leaves += elaboration.Get(spec).instances;
+    }
+    EXPECT_EQ(leaves, 100u * 1000u);
+    EXPECT_EQ(elaboration.NumInstances(), 1u + 100u + 100u * 1000u);
+
+    // 34 mids with N=2 give 500 leaves each with W=16
+    const std::vector<uint32_t> leaf_specs = elaboration.SpecializationsOf(&leaf);
+    for (uint32_t spec : leaf_specs) {
+        const uint64_t expected = *elaboration.Value(spec, "W") == "16" ? 34u * 500u : 34u * 500u + 66u * 1000u;
+        EXPECT_EQ(elaboration.Get(spec).instances, expected);
+    }
+}
+
+TEST_F(ElaborationTest, DescribeListsOverridableParameters) {
+    for (uint32_t spec : elaboration.SpecializationsOf(&leaf)) {
+        const std::string w = *elaboration.Value(spec, "W");
+        EXPECT_EQ(elaboration.Describe(spec), "leaf #(W=" + w + ", D=" + std::to_string(std::stoi(w) * 2) + ")");
+    }
+    EXPECT_EQ(elaboration.Describe(elaboration.Top()), "top");
+}
+
+TEST(Elaboration, RangesCountElements) {
+    SV::Module top, leaf;
+    top.name  = "top";
+    leaf.name = "leaf";
+    top.parameters = {Param("N", "6")};
+
+    SV::InstanceRange range;
+    range.first_expr = "0";
+    range.last_expr  = "N-1";
+    top.instance_ranges.push_back(range);
+    top.dependencies.push_back(Instance(&leaf, &top));
+    top.dependencies.back().range = 0;
+
+    Elaboration elaboration;
+    elaboration.Build(&top);
+    EXPECT_EQ(elaboration.Get(elaboration.Top()).elements, std::vector<uint32_t>{6});
+    EXPECT_EQ(elaboration.NumInstances(), 7u);
+}
+
+TEST(Elaboration, RecursionStopsAtTheCap) {
+    SV::Module r;
+    r.name       = "r";
+    r.parameters = {Param("N", "3")};
+    r.dependencies.push_back(Instance(&r, &r, {{"N", "N-1"}}));
+
+    Elaboration elaboration;
+    elaboration.Build(&r, 10);
+    EXPECT_EQ(elaboration.NumSpecializations(), 10u);
+    EXPECT_TRUE(elaboration.Truncated());
+}
+
+}
+}
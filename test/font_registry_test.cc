@@ -0,0 +1,51 @@
+#include <thread>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "include/core/SkString.h"
+
+#include "font_registry.h"
+
+namespace graphics {
+namespace {
+
+TEST(FontRegistry, ScansOnce) {
+    FontRegistry& registry = FontRegistry::Get();
+    registry.warmUp();
+    registry.warmUp();
+
+    // Every thread gets the manager of the one scan
+    std::vector<SkFontMgr*> managers(8, nullptr);
+    std::vector<std::thread> threads;
+    for (size_t i = 0; i < managers.size(); i++) {
+        threads.emplace_back([&managers, &registry, i] { managers[i] = registry.manager().get(); });
+    }
+    for (auto& thread : threads) thread.join();
+
+    ASSERT_NE(managers[0], nullptr);
+    for (SkFontMgr* manager : managers) EXPECT_EQ(manager, managers[0]);
+    EXPECT_EQ(&FontRegistry::Get(), &registry);
+}
+
+TEST(FontRegistry, CachesTypefacesAndFonts) {
+    FontRegistry&    registry = FontRegistry::Get();
+    sk_sp<SkFontMgr> manager  = registry.manager();
+    if (manager->countFamilies() == 0) GTEST_SKIP() << "no fonts installed";
+
+    SkString family;
+    manager->getFamilyName(0, &family);
+
+    sk_sp<SkTypeface> typeface = registry.typeface(family.c_str());
+    ASSERT_NE(typeface.get(), nullptr);
+    EXPECT_EQ(registry.typeface(family.c_str()).get(), typeface.get());
+
+    const SkFont font = registry.font(family.c_str(), 13.f);
+    EXPECT_EQ(font.getSize(), 13.f);
+    EXPECT_EQ(font.getTypeface(), typeface.get());
+    EXPECT_EQ(registry.font(family.c_str(), 13.f).getTypeface(), typeface.get());
+    EXPECT_EQ(registry.font(family.c_str(), 20.f).getSize(), 20.f);
+}
+
+}
+}
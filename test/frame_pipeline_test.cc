@@ -0,0 +1,128 @@
+#include <chrono>
+#include <functional>
+#include <initializer_list>
+#include <thread>
+#include <utility>
+
+#include "gtest/gtest.h"
+
+#include "include/core/SkCanvas.h"
+#include "include/core/SkPaint.h"
+#include "include/core/SkPictureRecorder.h"
+
+#include "frame_pipeline.h"
+
+namespace graphics {
+namespace {
+
+constexpr int kWidth  = 128;
+constexpr int kHeight = 96;
+
+// A window texture without a window, read back through a software renderer
+struct Target {
+    SDL_Surface*  surface  = SDL_CreateRGBSurfaceWithFormat(0, kWidth, kHeight, 32, SDL_PIXELFORMAT_ARGB8888);
+    SDL_Renderer* renderer = SDL_CreateSoftwareRenderer(surface);
+    SDL_Texture*  texture  = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_STREAMING, kWidth, kHeight);
+
+    ~Target() {
+        SDL_DestroyTexture(texture);
+        SDL_DestroyRenderer(renderer);
+        SDL_FreeSurface(surface);
+    }
+
+    SkColor pixel(int x, int y) {
+        SDL_RenderCopy(renderer, texture, nullptr, nullptr);
+        return static_cast<const uint32_t*>(surface->pixels)[y * (surface->pitch / 4) + x];
+    }
+};
+
+// A red frame with rects of other colors on top
+sk_sp<SkPicture> Frame(std::initializer_list<std::pair<SkIRect, SkColor>> rects) {
+    SkPictureRecorder recorder;
+    SkCanvas* canvas = recorder.beginRecording(SkRect::MakeWH(kWidth, kHeight));
+    canvas->clear(SK_ColorRED);
+    SkPaint paint;
+    for (const auto& [rect, color] : rects) {
+        paint.setColor(color);
+        canvas->drawRect(SkRect::Make(rect), paint);
+    }
+    return recorder.finishRecordingAsPicture();
+}
+
+DamageTracker Damage(const SkIRect& rect) {
+    DamageTracker damage;
+    damage.reset(kWidth, kHeight);
+    damage.clear();
+    damage.add(rect);
+    return damage;
+}
+
+// Present until done() holds, the render thread gets there eventually
+bool PresentUntil(FramePipeline& pipeline, Target& target, const std::function<bool()>& done) {
+    const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+    while (std::chrono::steady_clock::now() < deadline) {
+        if (pipeline.present(target.texture) && done()) return true;
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    return false;
+}
+
+class FramePipelineTest : public testing::Test {
+protected:
+    void SetUp() override {
+        ASSERT_NE(target.texture, nullptr) << SDL_GetError();
+    }
+
+    Target        target;
+    TiledRenderer tiles{2, 32};
+    FramePipeline pipeline{kWidth, kHeight, &tiles};
+};
+
+TEST_F(FramePipelineTest, PresentsNothingBeforeTheFirstFrame) {
+    EXPECT_FALSE(pipeline.present(target.texture));
+    EXPECT_EQ(pipeline.memoryBytes(), size_t(FramePipeline::kNumBuffers) * kWidth * kHeight * 4);
+}
+
+TEST_F(FramePipelineTest, UploadsOnlyWhatChanged) {
+    DamageTracker full;
+    full.reset(kWidth, kHeight);
+    pipeline.submit(Frame({}), full);
+    ASSERT_TRUE(PresentUntil(pipeline, target, [&] { return target.pixel(0, 0) == SK_ColorRED; }));
+    EXPECT_FALSE(pipeline.present(target.texture));
+
+    // Only the damaged rect is uploaded, so whatever the texture holds around it stays
+    const SkIRect rect = SkIRect::MakeLTRB(10, 10, 20, 20);
+    void* pixels = nullptr;
+    int   pitch  = 0;
+    ASSERT_EQ(SDL_LockTexture(target.texture, nullptr, &pixels, &pitch), 0);
+    for (int y = 0; y < kHeight; y++) {
+        for (int x = 0; x < kWidth; x++) static_cast<uint32_t*>(pixels)[y * (pitch / 4) + x] = SK_ColorBLACK;
+    }
+    SDL_UnlockTexture(target.texture);
+
+    pipeline.submit(Frame({{rect, SK_ColorBLUE}}), Damage(rect));
+    ASSERT_TRUE(PresentUntil(pipeline, target, [&] { return target.pixel(15, 15) == SK_ColorBLUE; }));
+    EXPECT_EQ(target.pixel(0, 0), SK_ColorBLACK);
+    EXPECT_EQ(target.pixel(25, 25), SK_ColorBLACK);
+}
+
+TEST_F(FramePipelineTest, SkippedFramesStillReachTheTexture) {
+    DamageTracker full;
+    full.reset(kWidth, kHeight);
+    pipeline.submit(Frame({}), full);
+    ASSERT_TRUE(PresentUntil(pipeline, target, [&] { return target.pixel(0, 0) == SK_ColorRED; }));
+
+    // Two frames without presenting in between, the damage of the first must not get lost
+    const SkIRect first  = SkIRect::MakeLTRB(0, 0, 10, 10);
+    const SkIRect second = SkIRect::MakeLTRB(50, 50, 60, 60);
+    pipeline.submit(Frame({{first, SK_ColorGREEN}}), Damage(first));
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    pipeline.submit(Frame({{first, SK_ColorGREEN}, {second, SK_ColorYELLOW}}), Damage(second));
+
+    ASSERT_TRUE(PresentUntil(pipeline, target, [&] { return target.pixel(55, 55) == SK_ColorYELLOW; }));
+    EXPECT_EQ(target.pixel(5, 5), SK_ColorGREEN);
+    EXPECT_EQ(target.pixel(30, 30), SK_ColorRED);
+}
+
+}
+}
@@ -0,0 +1,103 @@
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "include/core/SkString.h"
+
+#include "headless.h"
+
+namespace graphics {
+namespace {
+
+std::string ReadFile(const std::string& path) {
+    std::ifstream in(path, std::ios::binary);
+    return std::string(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+}
+
+// top with two instances of leaf
+struct Design {
+    SV::Module top;
+    SV::Module leaf;
+
+    Design() {
+        top.name  = "top";
+        leaf.name = "leaf";
+        for (const char* name : {"u_a", "u_b"}) {
+            SV::ModuleInstance instance;
+            instance.module        = &leaf;
+            instance.instance_name = name;
+            instance.parent        = &top;
+            top.dependencies.push_back(instance);
+        }
+    }
+};
+
+// The default family is not installed everywhere, any family will do
+bool UseInstalledFont(HeadlessOpts& opts) {
+    sk_sp<SkFontMgr> manager = FontRegistry::Get().manager();
+    if (manager->countFamilies() == 0) return false;
+    SkString family;
+    manager->getFamilyName(0, &family);
+    opts.font_family = family.c_str();
+    return true;
+}
+
+ExportView View(SV::Module* module, const std::string& name) {
+    ExportView view;
+    view.module      = module;
+    view.output_path = testing::TempDir() + "/" + name;
+    view.format      = exportFormatFromPath(name);
+    return view;
+}
+
+TEST(Headless, FormatFromExtension) {
+    EXPECT_EQ(exportFormatFromPath("out.svg"), EXPORT_SVG);
+    EXPECT_EQ(exportFormatFromPath("dir/out.pdf"), EXPORT_PDF);
+    EXPECT_EQ(exportFormatFromPath("out.png"), EXPORT_PNG);
+    EXPECT_EQ(exportFormatFromPath("out"), EXPORT_PNG);
+    EXPECT_EQ(exportFormatFromPath("svg"), EXPORT_PNG);
+}
+
+TEST(Headless, RejectsIncompleteViews) {
+    Design     design;
+    ExportView no_module = View(nullptr, "none.png");
+    ExportView no_path   = View(&design.top, "none.png");
+    no_path.output_path.clear();
+
+    EXPECT_FALSE(renderView(no_module));
+    EXPECT_FALSE(renderView(no_path));
+    EXPECT_EQ(renderViews({no_module, no_path}), 0u);
+}
+
+TEST(Headless, WritesEveryFormat) {
+    Design       design;
+    HeadlessOpts opts;
+    if (!UseInstalledFont(opts)) GTEST_SKIP() << "no fonts installed";
+
+    ASSERT_TRUE(renderView(View(&design.top, "top.png"), opts));
+    ASSERT_TRUE(renderView(View(&design.top, "top.svg"), opts));
+    ASSERT_TRUE(renderView(View(&design.top, "top.pdf"), opts));
+
+    EXPECT_EQ(ReadFile(testing::TempDir() + "/top.png").substr(0, 4), "\x89PNG");
+    EXPECT_NE(ReadFile(testing::TempDir() + "/top.svg").find("<svg"), std::string::npos);
+    EXPECT_EQ(ReadFile(testing::TempDir() + "/top.pdf").substr(0, 4), "%PDF");
+}
+
+TEST(Headless, ParallelExportsShareTheRasterBudget) {
+    Design       design;
+    HeadlessOpts opts;
+    if (!UseInstalledFont(opts)) GTEST_SKIP() << "no fonts installed";
+
+    // Every surface is bigger than the whole budget, so they are drawn one at a time, but all of them are
+    opts.threads          = 4;
+    opts.max_raster_bytes = 1;
+    std::vector<ExportView> views;
+    for (int i = 0; i < 8; i++) views.push_back(View(i % 2 ? &design.top : &design.leaf, "view" + std::to_string(i) + ".png"));
+    EXPECT_EQ(renderViews(views, opts), views.size());
+}
+
+}
+}
@@ -0,0 +1,222 @@
+#include <algorithm>
+#include <memory>
+#include <random>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "layout.h"
+
+namespace graphics {
+namespace {
+
+// depth + 1 levels of modules, every one instantiating the next fanout times
+struct Hierarchy {
+    std::vector<std::unique_ptr<SV::Module>> modules;
+
+    Hierarchy(int depth, int fanout) {
+        for (int d = 0; d <= depth; d++) {
+            modules.push_back(std::make_unique<SV::Module>());
+            modules.back()->name = "m" + std::to_string(d);
+        }
+        for (int d = 0; d < depth; d++) {
+            for (int k = 0; k < fanout; k++) {
+                SV::ModuleInstance instance;
+                instance.module        = modules[d + 1].get();
+                instance.instance_name = "u" + std::to_string(k);
+                instance.parent        = modules[d].get();
+                modules[d]->dependencies.push_back(instance);
+            }
+        }
+    }
+
+    SV::Module* root() const { return modules[0].get(); }
+};
+
+LayoutOpts Synchronous(uint32_t expand_depth) {
+    LayoutOpts options;
+    options.background   = false;
+    options.expand_depth = expand_depth;
+    return options;
+}
+
+// Direct children of item i, items are in depth first order
+std::vector<uint32_t> Children(const LayoutSnapshot& snapshot, uint32_t i) {
+    std::vector<uint32_t> children;
+    for (uint32_t c = i + 1; c < snapshot.items[i].subtree_end; c = snapshot.items[c].subtree_end) children.push_back(c);
+    return children;
+}
+
+void ExpectConsistent(const LayoutSnapshot& snapshot) {
+    ASSERT_EQ(snapshot.index.size(), snapshot.items.size());
+    for (uint32_t i = 0; i < snapshot.items.size(); i++) {
+        const GraphItem& item = snapshot.items[i];
+        EXPECT_EQ(snapshot.find(item.node), &item);
+        ASSERT_GT(item.subtree_end, i);
+        ASSERT_LE(item.subtree_end, snapshot.items.size());
+
+        // Children right of their parent, sibling subtrees stacked top to bottom without overlap
+        const std::vector<uint32_t> children = Children(snapshot, i);
+        EXPECT_EQ(!children.empty(), item.expanded && item.has_children);
+        for (size_t k = 0; k < children.size(); k++) {
+            const GraphItem& child = snapshot.items[children[k]];
+            EXPECT_EQ(child.depth, item.depth + 1);
+            EXPECT_GT(child.box.ul.x, item.box.br.x);
+            if (k > 0) {
+                EXPECT_LE(snapshot.items[children[k - 1]].subtree.br.y, child.subtree.ul.y);
+            }
+        }
+    }
+
+    // The spatial index finds exactly the items a scan does
+    std::mt19937 rng(7);
+    const AABB   bounds = snapshot.bounds;
+    for (int q = 0; q < 20; q++) {
+        const vec2 ul(bounds.ul.x + float(rng() % 1000) / 1000.f * bounds.Size().x,
+                      bounds.ul.y + float(rng() % 1000) / 1000.f * bounds.Size().y);
+        const AABB rect(ul, ul + bounds.Size() * 0.2f);
+
+        std::vector<uint32_t> got;
+        snapshot.index.queryRect(rect, got);
+        std::sort(got.begin(), got.end());
+        std::vector<uint32_t> want;
+        for (uint32_t i = 0; i < snapshot.items.size(); i++) {
+            if (snapshot.items[i].box.Intersects(rect)) want.push_back(i);
+        }
+        EXPECT_EQ(got, want);
+    }
+}
+
+TEST(LayoutEngine, ExpandsTheFirstLevels) {
+    Hierarchy    hierarchy(3, 3);
+    LayoutEngine engine(SkFont(), Synchronous(2));
+    engine.setRoot(hierarchy.root());
+
+    const auto snapshot = engine.snapshot();
+    ASSERT_NE(snapshot, nullptr);
+    EXPECT_EQ(snapshot->items.size(), 1u + 3u + 9u);
+    EXPECT_EQ(snapshot->items[0].depth, 0u);
+    EXPECT_TRUE(snapshot->items[0].expanded);
+    ExpectConsistent(*snapshot);
+}
+
+TEST(LayoutEngine, CollapseHidesTheSubtree) {
+    Hierarchy    hierarchy(3, 3);
+    LayoutEngine engine(SkFont(), Synchronous(3));
+    engine.setRoot(hierarchy.root());
+    const auto before = engine.snapshot();
+    ASSERT_EQ(before->items.size(), 1u + 3u + 9u + 27u);
+
+    const GraphItem& first = before->items[1];
+    engine.setExpanded(first.node, false);
+    const auto after = engine.snapshot();
+    EXPECT_EQ(after->items.size(), before->items.size() - (first.subtree_end - 2));
+    EXPECT_GT(after->generation, before->generation);
+    ExpectConsistent(*after);
+}
+
+TEST(LayoutEngine, SubtreeBoundsCoverEverythingBelow) {
+    Hierarchy    hierarchy(3, 4);
+    LayoutEngine engine(SkFont(), Synchronous(3));
+    engine.setRoot(hierarchy.root());
+    const auto snapshot = engine.snapshot();
+
+    // What the zoomed out drawing culls and aggregates by. Positions are summed along different paths,
+    // so allow for rounding
+    for (uint32_t i = 0; i < snapshot->items.size(); i++) {
+        const AABB subtree(snapshot->items[i].subtree.ul - vec2(1e-3f, 1e-3f), snapshot->items[i].subtree.br + vec2(1e-3f, 1e-3f));
+        for (uint32_t j = i; j < snapshot->items[i].subtree_end; j++) {
+            const AABB& box = snapshot->items[j].box;
+            EXPECT_TRUE(subtree.Contains(box.ul) && subtree.Contains(box.br)) << "item " << j << " outside subtree of " << i;
+        }
+    }
+    EXPECT_FLOAT_EQ(snapshot->items[0].subtree.Area(), snapshot->bounds.Area());
+}
+
+TEST(LayoutEngine, TypeColorFollowsTheModule) {
+    Hierarchy    hierarchy(2, 3);
+    LayoutEngine engine(SkFont(), Synchronous(2));
+    engine.setRoot(hierarchy.root());
+    const auto snapshot = engine.snapshot();
+
+    for (const GraphItem& a : snapshot->items) {
+        for (const GraphItem& b : snapshot->items) {
+            EXPECT_EQ(a.module == b.module, a.type_color.rgba() == b.type_color.rgba()) << a.module->name << " " << b.module->name;
+        }
+    }
+}
+
+TEST(LayoutEngine, BigExpansionFillsInOverSeveralPasses) {
+    Hierarchy  hierarchy(2, 200);
+    LayoutOpts options;
+    options.nodes_per_pass = 16;
+    LayoutEngine engine(SkFont(), options);
+    engine.setRoot(hierarchy.root());
+    engine.waitIdle();
+
+    // Every pass published what it had, the last one has all of it
+    auto snapshot = engine.snapshot();
+    ASSERT_NE(snapshot, nullptr);
+    EXPECT_EQ(snapshot->items.size(), 1u + 200u);
+    EXPECT_GT(snapshot->generation, 1u);
+    ExpectConsistent(*snapshot);
+
+    // Expanding one child goes on the same way, without touching the others
+    const uint64_t generation  = snapshot->generation;
+    const size_t   label_bytes = snapshot->label_bytes;
+    EXPECT_GE(label_bytes, 201 * sizeof(NodeLabel));
+    engine.setExpanded(snapshot->items[1].node, true);
+    engine.waitIdle();
+    snapshot = engine.snapshot();
+    EXPECT_EQ(snapshot->items.size(), 1u + 200u + 200u);
+    EXPECT_GT(snapshot->generation, generation + 1);
+    EXPECT_EQ(snapshot->label_bytes, label_bytes + 200 * sizeof(NodeLabel));
+    ExpectConsistent(*snapshot);
+}
+
+TEST(LayoutEngine, SynchronousLayoutMaterializesEverythingAtOnce) {
+    Hierarchy  hierarchy(2, 200);
+    LayoutOpts options = Synchronous(1);
+    options.nodes_per_pass = 16;
+    LayoutEngine engine(SkFont(), options);
+    engine.setRoot(hierarchy.root());
+
+    const auto snapshot = engine.snapshot();
+    ASSERT_NE(snapshot, nullptr);
+    EXPECT_EQ(snapshot->items.size(), 1u + 200u);
+    ExpectConsistent(*snapshot);
+}
+
+TEST(LayoutEngine, ToggleTwiceRestoresTheLayout) {
+    Hierarchy    hierarchy(4, 3);
+    LayoutEngine engine(SkFont(), Synchronous(2));
+    engine.setRoot(hierarchy.root());
+
+    std::mt19937 rng(1);
+    for (int step = 0; step < 100; step++) {
+        const auto before = engine.snapshot();
+        const GraphItem& item = before->items[rng() % before->items.size()];
+        if (!item.has_children) continue;
+
+        engine.toggleExpanded(item.node);
+        ExpectConsistent(*engine.snapshot());
+        engine.toggleExpanded(item.node);
+        const auto after = engine.snapshot();
+        ExpectConsistent(*after);
+
+        // Subtrees copied from the last snapshot land exactly where a full layout puts them
+        ASSERT_EQ(after->items.size(), before->items.size());
+        for (size_t i = 0; i < after->items.size(); i++) {
+            EXPECT_EQ(after->items[i].node, before->items[i].node);
+            EXPECT_EQ(after->items[i].subtree_end, before->items[i].subtree_end);
+            EXPECT_FLOAT_EQ(after->items[i].box.ul.x, before->items[i].box.ul.x);
+            EXPECT_FLOAT_EQ(after->items[i].box.ul.y, before->items[i].box.ul.y);
+        }
+
+        // Leave some of the toggles in place, so the next steps start from a different tree
+        if (step % 3 == 0) engine.toggleExpanded(item.node);
+    }
+}
+
+}
+}
@@ -0,0 +1,95 @@
+#include <algorithm>
+#include <fstream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "line_index.h"
+
+namespace SV {
+namespace {
+
+// Line starts found one byte at a time
+std::vector<size_t> ScalarLineStarts(std::string_view source) {
+    std::vector<size_t> starts = {0};
+    for (size_t i = 0; i < source.size(); i++) {
+        if (source[i] == '\n') starts.push_back(i + 1);
+    }
+    return starts;
+}
+
+void ExpectMatchesScalar(std::string_view source) {
+    const LineIndex           index(source);
+    const std::vector<size_t> starts = ScalarLineStarts(source);
+    ASSERT_EQ(index.LineCount(), starts.size());
+    for (size_t line = 0; line < starts.size(); line++) EXPECT_EQ(index.LineStart(line), starts[line]);
+}
+
+TEST(LineIndex, EmptySourceIsOneLine) {
+    const LineIndex index("");
+    EXPECT_EQ(index.LineCount(), 1u);
+    EXPECT_EQ(index.Locate(0).line, 0u);
+    EXPECT_EQ(index.Locate(0).column, 0u);
+}
+
+TEST(LineIndex, LocatesOffsets) {
+    const LineIndex index("module a;\n\nendmodule\n");
+    EXPECT_EQ(index.LineCount(), 4u);
+
+    const std::vector<std::pair<size_t, LineCol>> cases = {
+        {0, {0, 0}}, {9, {0, 9}}, {10, {1, 0}}, {11, {2, 0}}, {15, {2, 4}}, {21, {3, 0}}, {100, {3, 79}},
+    };
+    for (const auto& [offset, expected] : cases) {
+        const LineCol found = index.Locate(offset);
+        EXPECT_EQ(found.line, expected.line) << "offset " << offset;
+        EXPECT_EQ(found.column, expected.column) << "offset " << offset;
+    }
+}
+
+TEST(LineIndex, NewlinesAroundChunkBoundaries) {
+    // Every length crossing the 16 byte chunks, with a newline at every position in turn
+    for (size_t size = 0; size <= 48; size++) {
+        for (size_t at = 0; at < size; at++) {
+            std::string source(size, 'x');
+            source[at] = '\n';
+            ExpectMatchesScalar(source);
+        }
+        ExpectMatchesScalar(std::string(size, '\n'));
+    }
+}
+
+TEST(LineIndex, MatchesScalarOnRandomText) {
+    std::mt19937 rng(3);
+    for (int round = 0; round < 50; round++) {
+        std::string source(rng() % 4096, ' ');
+        for (char& c : source) c = rng() % 8 == 0 ? '\n' : char('a' + rng() % 26);
+        ExpectMatchesScalar(source);
+
+        // Locate agrees with counting newlines
+        const LineIndex index(source);
+        for (int i = 0; i < 100 && !source.empty(); i++) {
+            const size_t offset = rng() % source.size();
+            const size_t line   = size_t(std::count(source.begin(), source.begin() + offset, '\n'));
+            const size_t start  = source.substr(0, offset).find_last_of('\n') + 1;
+            EXPECT_EQ(index.Locate(offset).line, line);
+            EXPECT_EQ(index.Locate(offset).column, offset - start);
+        }
+    }
+}
+
+TEST(LineIndex, FileIndexIsCached) {
+    const std::string path = testing::TempDir() + "/line_index.sv";
+    std::ofstream(path, std::ios::binary) << "module a;\nendmodule\n";
+
+    const auto index = GetFileLineIndex(path);
+    ASSERT_NE(index, nullptr);
+    EXPECT_EQ(index->LineCount(), 3u);
+    EXPECT_EQ(GetFileLineIndex(path), index);
+
+    EXPECT_EQ(GetFileLineIndex(testing::TempDir() + "/missing.sv"), nullptr);
+}
+
+}
+}
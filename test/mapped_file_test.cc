@@ -0,0 +1,102 @@
+#include <cstdio>
+#include <fstream>
+#include <string>
+
+#include "gtest/gtest.h"
+
+#include "mapped_file.h"
+#include "mem_stats.h"
+
+namespace SV {
+namespace {
+
+std::string WriteFile(const std::string& name, const std::string& contents) {
+    const std::string path = testing::TempDir() + "/" + name;
+    std::ofstream(path, std::ios::binary | std::ios::trunc) << contents;
+    return path;
+}
+
+int64_t MappedSources() {
+    for (const auto& s : mem::GetSourceStats()) {
+        if (s.subsystem == mem::MEM_DOCS && s.name == "mapped sources") return s.current;
+    }
+    return 0;
+}
+
+TEST(MappedFile, ReadsTheFile) {
+    const auto file = MappedFile::Open(WriteFile("read.sv", "module a;\nendmodule\n"));
+    ASSERT_NE(file, nullptr);
+    EXPECT_EQ(file->Text(), "module a;\nendmodule\n");
+    EXPECT_EQ(file->Size(), 20u);
+}
+
+TEST(MappedFile, EmptyAndMissingFiles) {
+    const auto empty = MappedFile::Open(WriteFile("empty.sv", ""));
+    ASSERT_NE(empty, nullptr);
+    EXPECT_TRUE(empty->Text().empty());
+
+    EXPECT_EQ(MappedFile::Open(testing::TempDir() + "/missing.sv"), nullptr);
+    EXPECT_EQ(MappedFile::Open(testing::TempDir()), nullptr);
+}
+
+TEST(MappedFile, WrittenInPlaceIsNoLongerIntact) {
+    const std::string path = WriteFile("in_place.sv", "module a;\nendmodule\n");
+    const auto        file = MappedFile::Open(path);
+    ASSERT_NE(file, nullptr);
+    EXPECT_TRUE(file->Intact());
+
+    // Truncated and written again, like some tools do
+    std::ofstream(path, std::ios::binary | std::ios::trunc) << "x";
+    EXPECT_FALSE(file->Intact());
+}
+
+TEST(MappedFile, RenamedOverOrRemovedStaysIntact) {
+    const std::string path = WriteFile("renamed.sv", "module a;\nendmodule\n");
+    const auto        file = MappedFile::Open(path);
+    ASSERT_NE(file, nullptr);
+
+    const std::string next = WriteFile("renamed.sv.new", "x");
+    ASSERT_EQ(std::rename(next.c_str(), path.c_str()), 0);
+    EXPECT_TRUE(file->Intact());
+    EXPECT_EQ(file->Text(), "module a;\nendmodule\n");
+
+    std::remove(path.c_str());
+    EXPECT_TRUE(file->Intact());
+}
+
+TEST(GetSourceFile, CachesUntilTheFileChanges) {
+    const std::string path  = WriteFile("cached.sv", "module a;\nendmodule\n");
+    const auto        first = GetSourceFile(path);
+    ASSERT_NE(first, nullptr);
+    EXPECT_EQ(GetSourceFile(path), first);
+
+    // Renamed over the old one, which stays valid for whoever holds it
+    const std::string next = WriteFile("cached.sv.new", "module b;\n  wire w;\nendmodule\n");
+    ASSERT_EQ(std::rename(next.c_str(), path.c_str()), 0);
+    const auto second = GetSourceFile(path);
+    ASSERT_NE(second, nullptr);
+    EXPECT_NE(second, first);
+    EXPECT_EQ(second->Text(), "module b;\n  wire w;\nendmodule\n");
+    EXPECT_EQ(first->Text(), "module a;\nendmodule\n");
+
+    std::remove(path.c_str());
+    EXPECT_EQ(GetSourceFile(path), nullptr);
+}
+
+TEST(GetSourceFile, AccountsForEveryCachedFile) {
+    const int64_t     before = MappedSources();
+    const std::string a      = WriteFile("accounted_a.sv", std::string(100, 'a'));
+    const std::string b      = WriteFile("accounted_b.sv", std::string(50, 'b'));
+    ASSERT_NE(GetSourceFile(a), nullptr);
+    ASSERT_NE(GetSourceFile(b), nullptr);
+    EXPECT_EQ(MappedSources(), before + 150);
+
+    // A file that changed replaces its old size
+    const std::string bigger = WriteFile("accounted_a.sv.new", std::string(300, 'a'));
+    ASSERT_EQ(std::rename(bigger.c_str(), a.c_str()), 0);
+    ASSERT_NE(GetSourceFile(a), nullptr);
+    EXPECT_EQ(MappedSources(), before + 350);
+}
+
+}
+}
@@ -0,0 +1,116 @@
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "mem_stats.h"
+
+namespace mem {
+namespace {
+
+// Sources are process wide, every test uses names of its own
+SourceStats Source(Subsystem subsystem, const std::string& name) {
+    for (const auto& s : GetSourceStats()) {
+        if (s.subsystem == subsystem && s.name == name) return s;
+    }
+    return {subsystem, name};
+}
+
+SubsystemStats Totals(Subsystem subsystem) {
+    return GetSubsystemStats().at(subsystem);
+}
+
+TEST(MemStats, AddAndSetKeepCurrentAndPeak) {
+    Add(MEM_RENDER, "add and set", 100);
+    Add(MEM_RENDER, "add and set", 50);
+    Add(MEM_RENDER, "add and set", -120);
+    EXPECT_EQ(Source(MEM_RENDER, "add and set").current, 30);
+    EXPECT_EQ(Source(MEM_RENDER, "add and set").peak, 150);
+
+    Set(MEM_RENDER, "add and set", 80);
+    EXPECT_EQ(Source(MEM_RENDER, "add and set").current, 80);
+    EXPECT_EQ(Source(MEM_RENDER, "add and set").peak, 150);
+    Set(MEM_RENDER, "add and set", 0);
+}
+
+TEST(MemStats, SubsystemsSumTheirSources) {
+    const SubsystemStats before = Totals(MEM_DESIGN);
+    Set(MEM_DESIGN, "sum a", 1000);
+    Set(MEM_DESIGN, "sum b", 500);
+    EXPECT_EQ(Totals(MEM_DESIGN).current, before.current + 1500);
+    EXPECT_GE(Totals(MEM_DESIGN).peak, before.current + 1500);
+
+    // Same name in another subsystem is another source
+    Set(MEM_DOCS, "sum a", 7);
+    EXPECT_EQ(Source(MEM_DESIGN, "sum a").current, 1000);
+    EXPECT_EQ(Source(MEM_DOCS, "sum a").current, 7);
+
+    Set(MEM_DESIGN, "sum a", 0);
+    Set(MEM_DESIGN, "sum b", 0);
+    Set(MEM_DOCS, "sum a", 0);
+    EXPECT_EQ(Totals(MEM_DESIGN).current, before.current);
+}
+
+TEST(MemStats, PhasesAreRecordedInOrder) {
+    const size_t before = GetPhases().size();
+    BeginPhase("phase one");
+    std::vector<char> touched(8 << 20, 1);
+    BeginPhase("phase two");
+    EndPhase();
+    EndPhase();
+
+    const auto phases = GetPhases();
+    ASSERT_EQ(phases.size(), before + 2);
+    EXPECT_EQ(phases[before].name, "phase one");
+    EXPECT_EQ(phases[before + 1].name, "phase two");
+    for (size_t i = before; i < phases.size(); i++) {
+        EXPECT_GE(phases[i].seconds, 0.0);
+        EXPECT_GE(phases[i].rss_peak, phases[i].rss_end);
+    }
+    if (CurrentRSS() > 0) {
+        EXPECT_GE(PeakRSS(), int64_t(touched.size()));
+    }
+}
+
+TEST(MemStats, ReportNamesEverySource) {
+    Set(MEM_CST, "report source", 3 << 20);
+    std::ostringstream out;
+    WriteReport(out);
+    EXPECT_NE(out.str().find("report source"), std::string::npos);
+    EXPECT_NE(out.str().find("3.0 MB"), std::string::npos);
+    for (int i = 0; i < MEM_NUM_SUBSYSTEMS; i++) EXPECT_NE(out.str().find(SubsystemName(Subsystem(i))), std::string::npos);
+    Set(MEM_CST, "report source", 0);
+}
+
+TEST(MemStats, JsonBytesGrowWithTheDocument) {
+    const json small = json::parse(R"({"a": 1})");
+    const json big   = json::parse(R"({"a": 1, "children": [{"tag": "a string longer than fifteen"}, null, [1, 2, 3]]})");
+    EXPECT_GT(JsonBytes(small), int64_t(sizeof(json)));
+    EXPECT_GT(JsonBytes(big), JsonBytes(small));
+    EXPECT_EQ(JsonBytes(json()), int64_t(sizeof(json)));
+}
+
+TEST(MemStats, ModuleBytesCountEveryModule) {
+    SymTable::ModuleSymbolTable table;
+    EXPECT_EQ(ModuleBytes(nullptr), 0);
+    const int64_t empty = ModuleBytes(&table);
+
+    SV::Module a;
+    a.name = "a_module_with_a_long_name";
+    SymTable::symbol_table_insert(&table, &a);
+    const int64_t one = ModuleBytes(&table);
+    EXPECT_GT(one, empty + int64_t(sizeof(SV::Module)));
+
+    a.dependencies.push_back({});
+    a.dependencies.back().instance_name = "an_instance_with_a_long_name";
+    EXPECT_GT(ModuleBytes(&table), one);
+}
+
+TEST(MemStats, StringBytesOnlyCountTheHeap) {
+    EXPECT_EQ(StringBytes("short"), 0);
+    EXPECT_GE(StringBytes(std::string(100, 'x')), 101);
+}
+
+}
+}
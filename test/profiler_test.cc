@@ -0,0 +1,104 @@
+#include <fstream>
+#include <map>
+#include <string>
+#include <thread>
+
+#include <nlohmann/json.hpp>
+
+#include "gtest/gtest.h"
+
+#include "profiler.h"
+
+namespace prof {
+namespace {
+
+nlohmann::json Trace() {
+    const std::string path = testing::TempDir() + "/trace.json";
+    EXPECT_TRUE(WriteChromeTrace(path));
+    std::ifstream in(path);
+    return nlohmann::json::parse(in)["traceEvents"];
+}
+
+std::map<std::string, PhaseStats> Stats() {
+    std::map<std::string, PhaseStats> stats;
+    for (const PhaseStats& s : GetPhaseStats()) stats[s.name] = s;
+    return stats;
+}
+
+class Profiler : public testing::Test {
+protected:
+    void SetUp() override {
+        SetEnabled(true);
+        Reset();
+        SetFrameThread();
+    }
+    void TearDown() override {
+        SetEnabled(false);
+        Reset();
+    }
+};
+
+TEST_F(Profiler, DisabledScopesRecordNothing) {
+    SetEnabled(false);
+    { PROFILE_SCOPE("hidden"); }
+    EXPECT_TRUE(Trace().empty());
+
+    SetEnabled(true);
+    { PROFILE_SCOPE("shown"); }
+    const nlohmann::json events = Trace();
+    ASSERT_EQ(events.size(), 1u);
+    EXPECT_EQ(events[0]["name"], "shown");
+    EXPECT_EQ(events[0]["ph"], "X");
+}
+
+TEST_F(Profiler, FramesSumTheirPhases) {
+    Record("draw", 1000, 2'000'000);
+    Record("draw", 4'000'000, 2'000'000);
+    Record("upload", 7'000'000, 500'000);
+    FrameMark();
+
+    auto stats = Stats();
+    EXPECT_DOUBLE_EQ(stats["draw"].last, 4.0);
+    EXPECT_DOUBLE_EQ(stats["upload"].last, 0.5);
+
+    // A phase that did not run counts as zero, the history keeps the earlier frame
+    Record("draw", 9'000'000, 1'000'000);
+    FrameMark();
+    stats = Stats();
+    EXPECT_DOUBLE_EQ(stats["draw"].last, 1.0);
+    EXPECT_DOUBLE_EQ(stats["draw"].max, 4.0);
+    EXPECT_DOUBLE_EQ(stats["upload"].last, 0.0);
+    EXPECT_EQ(GetFrameTimes().size(), 1u);
+}
+
+TEST_F(Profiler, OtherThreadsOnlyGoIntoTheTrace) {
+    std::thread worker([] { Record("layout", 5'000, 3'000'000); });
+    worker.join();
+    Record("draw", 10'000, 1'000'000);
+    FrameMark();
+
+    const auto stats = Stats();
+    EXPECT_EQ(stats.count("layout"), 0u);
+    EXPECT_DOUBLE_EQ(stats.at("draw").last, 1.0);
+
+    std::map<std::string, int> tids;
+    for (const auto& event : Trace()) tids[event["name"]] = event["tid"];
+    ASSERT_EQ(tids.size(), 2u);
+    EXPECT_NE(tids["layout"], tids["draw"]);
+}
+
+TEST_F(Profiler, TraceIsRelativeToTheFirstEvent) {
+    // Steady clock sized timestamps come out relative to the earliest one, nanoseconds included
+    Record("a", 1'000'000'000'123, 1'500);
+    Record("b", 1'000'000'002'623, 250);
+
+    std::map<std::string, nlohmann::json> events;
+    for (const auto& event : Trace()) events[event["name"]] = event;
+    EXPECT_DOUBLE_EQ(events["a"]["ts"], 0.0);
+    EXPECT_DOUBLE_EQ(events["a"]["dur"], 1.5);
+    EXPECT_DOUBLE_EQ(events["b"]["ts"], 2.5);
+    EXPECT_DOUBLE_EQ(events["b"]["dur"], 0.25);
+}
+
+}
+}
@@ -0,0 +1,97 @@
+#include <chrono>
+#include <memory>
+#include <string>
+#include <thread>
+
+#include "gtest/gtest.h"
+
+#include "project_loader.h"
+
+namespace sv {
+namespace {
+
+using bazel::tools::cpp::runfiles::Runfiles;
+
+// Verible is found through the runfiles, like in the binaries
+std::unique_ptr<Runfiles> TestRunfiles() {
+    std::string error;
+    std::unique_ptr<Runfiles> rf(Runfiles::CreateForTest(BAZEL_CURRENT_REPOSITORY, &error));
+    EXPECT_NE(rf, nullptr) << error;
+    return rf;
+}
+
+bool WaitFinished(const ProjectLoader& loader) {
+    const auto deadline = std::chrono::steady_clock::now() + std::chrono::minutes(2);
+    while (!loader.finished()) {
+        if (std::chrono::steady_clock::now() > deadline) return false;
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    return true;
+}
+
+TEST(LoadProgress, Fraction) {
+    LoadProgress progress;
+    EXPECT_EQ(progress.fraction(), 0.f);
+    progress.files_done  = 1;
+    progress.files_total = 4;
+    EXPECT_EQ(progress.fraction(), 0.25f);
+}
+
+TEST(ProjectLoader, IdleUntilStarted) {
+    ProjectLoader loader;
+    EXPECT_TRUE(loader.finished());
+    EXPECT_EQ(loader.progress().state, LOAD_IDLE);
+    EXPECT_FALSE(loader.takeDoc().has_value());
+    EXPECT_FALSE(loader.takeRoot().has_value());
+    EXPECT_EQ(loader.searchIndex(), nullptr);
+}
+
+TEST(ProjectLoader, LoadsInTheBackground) {
+    auto rf = TestRunfiles();
+    ASSERT_NE(rf, nullptr);
+
+    ProjectLoader loader;
+    loader.start({"test/example.sv", "test/another.sv"}, rf.get());
+    ASSERT_TRUE(WaitFinished(loader));
+
+    const LoadProgress progress = loader.progress();
+    ASSERT_EQ(progress.state, LOAD_DONE) << progress.error;
+    EXPECT_EQ(progress.files_done, 2u);
+    EXPECT_EQ(progress.fraction(), 1.f);
+
+    // The first file is handed over once
+    std::optional<LoadedDoc> doc = loader.takeDoc();
+    ASSERT_TRUE(doc.has_value());
+    EXPECT_NE(doc->file.find("test/example.sv"), std::string::npos);
+    EXPECT_FALSE(doc->doc.empty());
+    EXPECT_FALSE(loader.takeDoc().has_value());
+
+    // And so is the root, the rest stays
+    std::optional<SV::Module*> root = loader.takeRoot();
+    ASSERT_TRUE(root.has_value());
+    ASSERT_NE(*root, nullptr);
+    EXPECT_FALSE(loader.takeRoot().has_value());
+    EXPECT_NE(loader.searchIndex(), nullptr);
+    EXPECT_NE(loader.elaboration(), nullptr);
+    EXPECT_EQ(loader.diff(), nullptr);
+}
+
+TEST(ProjectLoader, CancelEndsTheLoad) {
+    auto rf = TestRunfiles();
+    ASSERT_NE(rf, nullptr);
+
+    ProjectLoader loader;
+    loader.start({"test/example.sv", "test/another.sv"}, rf.get());
+    loader.cancel();
+    ASSERT_TRUE(WaitFinished(loader));
+
+    // Depending on how far it got, but never half done
+    const LoadState state = loader.progress().state;
+    EXPECT_TRUE(state == LOAD_CANCELLED || state == LOAD_DONE) << loader.progress().error;
+    if (state == LOAD_CANCELLED) {
+        EXPECT_FALSE(loader.takeRoot().has_value());
+    }
+}
+
+}
+}
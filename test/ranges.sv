@@ -0,0 +1,29 @@
+// Instance arrays and generate loops, each kept as one ranged instance
+module ranges_top #(
+    parameter N = 8
+) ();
+    leaf u_arr [3:0] ();
+    leaf u_sized [4] ();
+
+    for (genvar i = 0; i < N; i++) begin : g_up
+        leaf u_up ();
+    end
+
+    for (genvar j = 7; j >= 0; j -= 2) begin : g_down
+        leaf u_down ();
+    end
+
+    generate
+        for (genvar k = 0; k < 3; k = k + 1) begin
+            leaf u_anon ();
+        end
+    endgenerate
+
+    // Not counted by a constant step, stays a single instance
+    for (genvar m = 1; m < N; m = m * 2) begin : g_pow
+        leaf u_pow ();
+    end
+endmodule
+
+module leaf;
+endmodule
@@ -0,0 +1,161 @@
+#include <algorithm>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "search_index.h"
+
+namespace search {
+namespace {
+
+// top
+//   u_core (core)
+//     u_alu (alu)
+//     u_regs[7:0] (regfile)
+//       u_cell (cell)
+//   g_lane[0:6].u_alu (alu), every other lane
+//   u_alu (alu)
+struct Design {
+    std::vector<std::unique_ptr<SV::Module>> modules;
+    SymTable::ModuleSymbolTable              table;
+
+    SV::Module* add(const std::string& name) {
+        modules.push_back(std::make_unique<SV::Module>());
+        modules.back()->name = name;
+        table.modules.push_back(modules.back().get());
+        return modules.back().get();
+    }
+
+    static void instantiate(SV::Module* parent, SV::Module* module, const std::string& name, int32_t range = -1) {
+        SV::ModuleInstance instance;
+        instance.module        = module;
+        instance.instance_name = name;
+        instance.parent        = parent;
+        instance.range         = range;
+        parent->dependencies.push_back(instance);
+    }
+
+    static int32_t range(SV::Module* parent, int first, int last, int step = 0, const std::string& scope = "") {
+        SV::InstanceRange r;
+        r.first    = first;
+        r.last     = last;
+        r.step     = step;
+        r.scope    = scope;
+        r.resolved = true;
+        parent->instance_ranges.push_back(r);
+        return int32_t(parent->instance_ranges.size() - 1);
+    }
+
+    SV::Module* top;
+
+    Design() {
+        top                  = add("top");
+        SV::Module* core     = add("core");
+        SV::Module* alu      = add("alu");
+        SV::Module* regfile  = add("regfile");
+        SV::Module* cell     = add("cell");
+        instantiate(top, core, "u_core");
+        instantiate(core, alu, "u_alu");
+        instantiate(core, regfile, "u_regs", range(core, 7, 0));
+        instantiate(regfile, cell, "u_cell");
+        instantiate(top, alu, "u_alu", range(top, 0, 6, 2, "g_lane"));
+        instantiate(top, alu, "u_alu");
+    }
+};
+
+std::vector<std::string> Texts(const SearchIndex& index, const std::vector<Result>& results) {
+    std::vector<std::string> texts;
+    for (const Result& r : results) texts.emplace_back(index.Text(r.entry));
+    return texts;
+}
+
+std::string Found(const SearchIndex& index, std::string_view path) {
+    const uint32_t entry = index.FindPath(path);
+    return entry == kNoEntry ? "" : std::string(index.Text(entry));
+}
+
+class SearchIndexTest : public testing::Test {
+protected:
+    void SetUp() override { index.Build(design.top, &design.table); }
+
+    Design      design;
+    SearchIndex index;
+};
+
+TEST_F(SearchIndexTest, IndexesModulesAndInstances) {
+    // 5 modules, 7 instances, a range is one instance
+    EXPECT_EQ(index.size(), 12u);
+    EXPECT_FALSE(index.truncated());
+
+    const uint32_t regs = index.FindPath("top.u_core.u_regs[7:0]");
+    ASSERT_NE(regs, kNoEntry);
+    EXPECT_EQ(index[regs].kind, ENTRY_INSTANCE);
+    EXPECT_EQ(index[regs].depth, 2u);
+    EXPECT_EQ(index.InstancePath(regs), (std::vector<uint32_t>{0, 1}));
+
+    // Modules point at their first instance
+    for (uint32_t i = 0; i < index.size(); i++) {
+        if (index[i].kind != ENTRY_MODULE || index[i].first_instance == kNoEntry) continue;
+        EXPECT_EQ(index[index[i].first_instance].module, index[i].module);
+    }
+}
+
+TEST_F(SearchIndexTest, FindPathResolvesArrayElements) {
+    EXPECT_EQ(Found(index, "top.u_core.u_alu"), "top.u_core.u_alu");
+    EXPECT_EQ(Found(index, "top.u_core.u_regs[3]"), "top.u_core.u_regs[7:0]");
+    EXPECT_EQ(Found(index, "top.u_core.u_regs[0].u_cell"), "top.u_core.u_regs[7:0].u_cell");
+    EXPECT_EQ(Found(index, "top.g_lane[4].u_alu"), "top.g_lane[0:6].u_alu");
+
+    EXPECT_EQ(Found(index, "top.u_core.u_regs[8]"), "");   // out of range
+    EXPECT_EQ(Found(index, "top.g_lane[3].u_alu"), "");    // not on the step
+    EXPECT_EQ(Found(index, "top.g_lane[4]"), "");          // a scope, not an instance
+    EXPECT_EQ(Found(index, "top.u_core.u_regs[x]"), "");
+    EXPECT_EQ(Found(index, "top.u_core.u_nope"), "");
+    EXPECT_EQ(Found(index, "other.u_core"), "");
+}
+
+TEST_F(SearchIndexTest, RanksExactAndLastSegmentMatchesFirst) {
+    // The module itself before its instances, the shortest instance path before longer ones
+    std::vector<std::string> found = Texts(index, index.Query("alu"));
+    ASSERT_GE(found.size(), 4u);
+    EXPECT_EQ(found[0], "alu");
+    EXPECT_EQ(found[1], "top.u_alu");
+
+    // A query matching the last segment beats one matching further up the path
+    found = Texts(index, index.Query("cell"));
+    ASSERT_FALSE(found.empty());
+    EXPECT_EQ(found[0], "cell");
+    EXPECT_EQ(found[1], "top.u_core.u_regs[7:0].u_cell");
+}
+
+TEST_F(SearchIndexTest, QueriesAreFuzzy) {
+    // Case does not matter, and a subsequence sharing a trigram still matches
+    EXPECT_EQ(Texts(index, index.Query("REGFILE")).at(0), "regfile");
+    const std::vector<std::string> found = Texts(index, index.Query("regfle"));
+    EXPECT_NE(std::find(found.begin(), found.end(), "regfile"), found.end());
+
+    // Too short for a trigram, found by the start of the last segment
+    EXPECT_EQ(Texts(index, index.Query("co")).at(0), "core");
+
+    EXPECT_TRUE(index.Query("").empty());
+    EXPECT_TRUE(index.Query("zzzz").empty());
+    EXPECT_EQ(index.Query("u", 2).size(), 2u);
+}
+
+TEST_F(SearchIndexTest, ExactPathIsAlwaysFound) {
+    const std::vector<std::string> found = Texts(index, index.Query("top.u_core.u_regs[7:0].u_cell"));
+    EXPECT_NE(std::find(found.begin(), found.end(), "top.u_core.u_regs[7:0].u_cell"), found.end());
+}
+
+TEST(SearchIndex, StopsAtMaxInstances) {
+    Design      design;
+    SearchIndex index;
+    index.Build(design.top, &design.table, 3);
+    EXPECT_TRUE(index.truncated());
+    EXPECT_EQ(index.size(), 5u + 3u);
+}
+
+}
+}
@@ -0,0 +1,148 @@
+#include <algorithm>
+#include <random>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "spatial_index.h"
+
+namespace graphics {
+namespace {
+
+std::vector<AABB> RandomBoxes(size_t n, uint32_t seed) {
+    std::mt19937                          rng(seed);
+    std::uniform_real_distribution<float> pos(0.f, 1000.f);
+    std::uniform_real_distribution<float> size(1.f, 40.f);
+    std::vector<AABB> boxes;
+    for (size_t i = 0; i < n; i++) {
+        const vec2 ul(pos(rng), pos(rng));
+        boxes.push_back(AABB(ul, ul + vec2(size(rng), size(rng))));
+    }
+    return boxes;
+}
+
+SpatialIndex Build(const std::vector<AABB>& boxes) {
+    std::vector<SpatialIndex::Item> items;
+    for (uint32_t i = 0; i < boxes.size(); i++) items.push_back({boxes[i], i});
+    SpatialIndex index;
+    index.build(std::move(items));
+    return index;
+}
+
+std::vector<uint32_t> Query(const SpatialIndex& index, const AABB& rect) {
+    std::vector<uint32_t> out;
+    index.queryRect(rect, out);
+    std::sort(out.begin(), out.end());
+    return out;
+}
+
+std::vector<uint32_t> BruteForce(const std::vector<AABB>& boxes, const AABB& rect) {
+    std::vector<uint32_t> out;
+    for (uint32_t i = 0; i < boxes.size(); i++) {
+        if (boxes[i].Intersects(rect)) out.push_back(i);
+    }
+    return out;
+}
+
+TEST(SpatialIndex, QueryRectMatchesBruteForce) {
+    const std::vector<AABB> boxes = RandomBoxes(5000, 1);
+    const SpatialIndex      index = Build(boxes);
+    EXPECT_EQ(index.size(), boxes.size());
+
+    for (const AABB& rect : RandomBoxes(200, 2)) {
+        const AABB view(rect.ul, rect.ul + rect.Size() * 5.f);
+        EXPECT_EQ(Query(index, view), BruteForce(boxes, view));
+    }
+    EXPECT_EQ(Query(index, AABB(-1e6f, -1e6f, 1e6f, 1e6f)).size(), boxes.size());
+    EXPECT_TRUE(Query(index, AABB(2000.f, 2000.f, 3000.f, 3000.f)).empty());
+}
+
+TEST(SpatialIndex, PickFindsTheSmallestBoxUnderThePoint) {
+    const std::vector<AABB> boxes = {
+        AABB(0, 0, 100, 100),
+        AABB(10, 10, 50, 50),
+        AABB(20, 20, 30, 30),
+        AABB(200, 200, 210, 210),
+    };
+    const SpatialIndex index = Build(boxes);
+    EXPECT_EQ(index.pick(vec2(25, 25)), 2);
+    EXPECT_EQ(index.pick(vec2(15, 15)), 1);
+    EXPECT_EQ(index.pick(vec2(90, 90)), 0);
+    EXPECT_EQ(index.pick(vec2(205, 205)), 3);
+    EXPECT_EQ(index.pick(vec2(150, 150)), -1);
+}
+
+TEST(SpatialIndex, RefitFollowsMovedItems) {
+    std::vector<AABB> boxes = RandomBoxes(1000, 3);
+    SpatialIndex      index = Build(boxes);
+
+    for (AABB& box : boxes) {
+        box.ul = box.ul + vec2(500.f, -250.f);
+        box.br = box.br + vec2(500.f, -250.f);
+    }
+    index.refit(boxes);
+    for (const AABB& rect : RandomBoxes(100, 4)) {
+        const AABB view(rect.ul + vec2(400.f, -300.f), rect.br + vec2(500.f, -200.f));
+        EXPECT_EQ(Query(index, view), BruteForce(boxes, view));
+    }
+}
+
+TEST(SpatialIndex, UpdateDropsRemovedAndFindsAddedItems) {
+    const std::vector<AABB> old_boxes = RandomBoxes(2000, 6);
+    SpatialIndex            index     = Build(old_boxes);
+
+    // Every third item goes away, the rest is renumbered, moved a little, and new items come after it
+    std::vector<uint32_t> remap(old_boxes.size(), UINT32_MAX);
+    std::vector<AABB>     boxes;
+    for (uint32_t i = 0; i < old_boxes.size(); i++) {
+        if (i % 3 == 0) continue;
+        remap[i] = uint32_t(boxes.size());
+        boxes.push_back(AABB(old_boxes[i].ul + vec2(3.f, 1.f), old_boxes[i].br + vec2(3.f, 1.f)));
+    }
+    for (const AABB& box : RandomBoxes(100, 7)) boxes.push_back(box);
+
+    index.update(remap, boxes);
+    EXPECT_EQ(index.size(), boxes.size());
+    for (const AABB& rect : RandomBoxes(200, 8)) {
+        const AABB view(rect.ul, rect.ul + rect.Size() * 5.f);
+        EXPECT_EQ(Query(index, view), BruteForce(boxes, view));
+    }
+    EXPECT_EQ(Query(index, AABB(-1e6f, -1e6f, 1e6f, 1e6f)).size(), boxes.size());
+}
+
+TEST(SpatialIndex, RepeatedUpdatesStayExact) {
+    std::vector<AABB> boxes = RandomBoxes(300, 9);
+    SpatialIndex      index = Build(boxes);
+
+    // Enough rounds of removals and additions to go through grafts and rebuilds
+    std::mt19937 rng(10);
+    for (int round = 0; round < 30; round++) {
+        std::vector<uint32_t> remap(boxes.size(), UINT32_MAX);
+        std::vector<AABB>     next;
+        for (uint32_t i = 0; i < boxes.size(); i++) {
+            if (rng() % 5 == 0) continue;
+            remap[i] = uint32_t(next.size());
+            next.push_back(boxes[i]);
+        }
+        for (const AABB& box : RandomBoxes(rng() % 80, rng())) next.push_back(box);
+        boxes = std::move(next);
+
+        index.update(remap, boxes);
+        ASSERT_EQ(index.size(), boxes.size());
+        for (const AABB& rect : RandomBoxes(20, rng())) {
+            const AABB view(rect.ul, rect.ul + rect.Size() * 5.f);
+            ASSERT_EQ(Query(index, view), BruteForce(boxes, view)) << "round " << round;
+        }
+    }
+}
+
+TEST(SpatialIndex, EmptyIndex) {
+    SpatialIndex index = Build(RandomBoxes(10, 5));
+    index.clear();
+    EXPECT_TRUE(index.empty());
+    EXPECT_EQ(index.pick(vec2(0, 0)), -1);
+    EXPECT_TRUE(Query(index, AABB(-1e6f, -1e6f, 1e6f, 1e6f)).empty());
+}
+
+}
+}
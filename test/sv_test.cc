@@ -0,0 +1,99 @@
+#include <string>
+
+#include "gtest/gtest.h"
+
+#include "sv.h"
+
+namespace SV {
+namespace {
+
+// parent with one instance of child over the given range
+struct Ranged {
+    Module         parent;
+    Module         child;
+    ModuleInstance instance;
+
+    explicit Ranged(const InstanceRange& range) {
+        parent.name = "top";
+        child.name  = "leaf";
+        parent.instance_ranges.push_back(range);
+        instance.module        = &child;
+        instance.instance_name = "u_leaf";
+        instance.parent        = &parent;
+        instance.range         = 0;
+    }
+};
+
+InstanceRange Resolved(int first, int last, int step = 0, const std::string& scope = "") {
+    InstanceRange range;
+    range.first_expr = std::to_string(first);
+    range.last_expr  = std::to_string(last);
+    range.first      = first;
+    range.last       = last;
+    range.step       = step;
+    range.scope      = scope;
+    range.resolved   = true;
+    return range;
+}
+
+TEST(InstanceRange, CountAndIndex) {
+    // Arrays count both ends whichever way they go
+    EXPECT_EQ(InstanceRange::Count(7, 0, 0), 8u);
+    EXPECT_EQ(InstanceRange::Count(0, 7, 0), 8u);
+    EXPECT_EQ(InstanceRange::Count(3, 3, 0), 1u);
+    EXPECT_EQ(InstanceRange::Index(7, 0, 0, 2), 5);
+    EXPECT_EQ(InstanceRange::Index(0, 7, 0, 2), 2);
+
+    // Loops stop at the last index the step reaches
+    EXPECT_EQ(InstanceRange::Count(0, 7, 1), 8u);
+    EXPECT_EQ(InstanceRange::Count(0, 7, 2), 4u);
+    EXPECT_EQ(InstanceRange::Count(7, 0, -2), 4u);
+    EXPECT_EQ(InstanceRange::Count(0, -1, 1), 0u);
+    EXPECT_EQ(InstanceRange::Index(7, 0, -2, 3), 1);
+
+    InstanceRange unresolved;
+    unresolved.first_expr = "0";
+    unresolved.last_expr  = "N-1";
+    EXPECT_EQ(unresolved.count(), 1u);
+}
+
+TEST(InstanceLabel, SingleInstance) {
+    ModuleInstance instance;
+    instance.instance_name = "u_core";
+    EXPECT_EQ(InstanceLabel(instance), "u_core");
+    EXPECT_EQ(ElementName(instance, 0), "u_core");
+    EXPECT_EQ(NumElements(instance), 1u);
+}
+
+TEST(InstanceLabel, InstanceArray) {
+    const Ranged r(Resolved(255, 0));
+    EXPECT_EQ(InstanceLabel(r.instance), "u_leaf[255:0]");
+    EXPECT_EQ(ElementName(r.instance, 0), "u_leaf[255]");
+    EXPECT_EQ(ElementName(r.instance, 255), "u_leaf[0]");
+    EXPECT_EQ(NumElements(r.instance), 256u);
+
+    // Fewer elements with other parameters of the parent
+    EXPECT_EQ(InstanceLabel(r.instance, 4), "u_leaf[255:252]");
+}
+
+TEST(InstanceLabel, GenerateLoop) {
+    const Ranged r(Resolved(0, 7, 2, "g_bank"));
+    EXPECT_EQ(InstanceLabel(r.instance), "g_bank[0:6].u_leaf");
+    EXPECT_EQ(ElementName(r.instance, 1), "g_bank[2].u_leaf");
+    EXPECT_EQ(NumElements(r.instance), 4u);
+}
+
+TEST(InstanceLabel, UnresolvedRangeKeepsTheExpressions) {
+    InstanceRange range;
+    range.first_expr = "0";
+    range.last_expr  = "(N)-1";
+    range.step       = 1;
+    range.scope      = "g_lane";
+    const Ranged r(range);
+    EXPECT_EQ(InstanceLabel(r.instance), "g_lane[0:(N)-1].u_leaf");
+    EXPECT_EQ(ElementName(r.instance, 0), "g_lane[0].u_leaf");
+    EXPECT_EQ(NumElements(r.instance), 1u);
+}
+
+}
+}
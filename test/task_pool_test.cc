@@ -0,0 +1,167 @@
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <stdexcept>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "task_pool.h"
+
+namespace task {
+namespace {
+
+using namespace std::chrono_literals;
+
+TEST(TaskPool, RunsSubmittedTasks) {
+    TaskPool         pool(4);
+    std::atomic<int> ran{0};
+    std::vector<TaskHandle> handles;
+    for (int i = 0; i < 100; i++) handles.push_back(pool.submit([&] { ran++; }));
+    for (const auto& h : handles) h.wait();
+    EXPECT_EQ(ran.load(), 100);
+    EXPECT_TRUE(handles.front().done());
+    EXPECT_EQ(pool.numThreads(), 4u);
+    EXPECT_FALSE(pool.onWorker());
+}
+
+TEST(TaskPool, DependenciesRunFirst) {
+    TaskPool         pool(4);
+    std::mutex       mtx;
+    std::vector<int> order;
+    auto push = [&](int i) {
+        std::lock_guard<std::mutex> lock(mtx);
+        order.push_back(i);
+    };
+
+    const TaskHandle a = pool.submit([&] {
+        std::this_thread::sleep_for(20ms);
+        push(1);
+    });
+    const TaskHandle b = pool.then(a, [&] { push(2); });
+    const TaskHandle c = pool.submit([&] { push(3); }, PRIORITY_BACKGROUND, CancelToken(), {a, b});
+    c.wait();
+    EXPECT_EQ(order, (std::vector<int>{1, 2, 3}));
+}
+
+TEST(TaskPool, DependentsRunAfterAFailure) {
+    TaskPool         pool(2);
+    std::atomic<int> ran{0};
+    const TaskHandle failing = pool.submit([] { throw std::runtime_error("first"); });
+    const TaskHandle after   = pool.then(failing, [&] { ran++; });
+    after.wait();
+    EXPECT_EQ(ran.load(), 1);
+    EXPECT_THROW(failing.wait(), std::runtime_error);
+}
+
+TEST(TaskPool, CancelledTasksAreSkipped) {
+    TaskPool         pool(2);
+    CancelToken      token;
+    std::atomic<int> ran{0};
+    token.cancel();
+
+    const TaskHandle skipped = pool.submit([&] { ran++; }, PRIORITY_BACKGROUND, token);
+    skipped.wait();
+    EXPECT_TRUE(skipped.done());
+    EXPECT_EQ(ran.load(), 0);
+
+    // Copies share the flag
+    const CancelToken copy = token;
+    EXPECT_TRUE(copy.cancelled());
+}
+
+TEST(TaskPool, ExceptionsReachTheWaiter) {
+    TaskPool pool(2);
+    try {
+        pool.submit([] { throw std::runtime_error("boom"); }).wait();
+        FAIL() << "no exception";
+    } catch (const std::runtime_error& e) {
+        EXPECT_STREQ(e.what(), "boom");
+    }
+}
+
+TEST(TaskPool, ParallelForCallsEveryIndexOnce) {
+    TaskPool                       pool(4);
+    std::vector<std::atomic<int>> calls(10000);
+    pool.parallelFor(calls.size(), [&](size_t i) { calls[i]++; });
+    for (const auto& c : calls) EXPECT_EQ(c.load(), 1);
+
+    pool.parallelFor(0, [](size_t) { FAIL(); });
+}
+
+TEST(TaskPool, ParallelForRespectsMaxParallel) {
+    TaskPool         pool(4);
+    std::atomic<int> running{0}, most{0};
+    pool.parallelFor(
+        64,
+        [&](size_t) {
+            const int now = ++running;
+            int       seen = most.load();
+            while (now > seen && !most.compare_exchange_weak(seen, now)) {}
+            std::this_thread::sleep_for(1ms);
+            running--;
+        },
+        PRIORITY_INTERACTIVE, CancelToken(), 2);
+    EXPECT_LE(most.load(), 2);
+    EXPECT_GE(most.load(), 1);
+}
+
+TEST(TaskPool, ParallelForThrowsAfterEveryCallFinished) {
+    TaskPool         pool(4);
+    std::atomic<int> finished{0};
+    EXPECT_THROW(pool.parallelFor(100,
+                                  [&](size_t i) {
+                                      if (i == 5) throw std::runtime_error("index 5");
+                                      finished++;
+                                  }),
+                 std::runtime_error);
+    EXPECT_EQ(finished.load(), 99);
+}
+
+TEST(TaskPool, ParallelForStopsOnceCancelled) {
+    TaskPool         pool(4);
+    CancelToken      token;
+    std::atomic<int> calls{0};
+    pool.parallelFor(100000, [&](size_t) {
+        if (++calls == 10) token.cancel();
+    }, PRIORITY_BACKGROUND, token);
+    EXPECT_LT(calls.load(), 100000);
+}
+
+TEST(TaskPool, WaitingInsideTasksDoesNotDeadlock) {
+    // More waiting tasks than threads, each waits for work of its own
+    TaskPool         pool(2);
+    std::atomic<int> sum{0};
+    pool.submit([&] {
+        EXPECT_TRUE(pool.onWorker());
+        std::vector<TaskHandle> handles;
+        for (int i = 0; i < 20; i++) {
+            handles.push_back(pool.submit([&] { pool.parallelFor(100, [&](size_t) { sum++; }); }));
+        }
+        for (const auto& h : handles) h.wait();
+    }).wait();
+    EXPECT_EQ(sum.load(), 2000);
+}
+
+TEST(TaskPool, InteractiveWorkIsNotStuckBehindBackground) {
+    TaskPool                pool(4);
+    CancelToken             background;
+    std::vector<TaskHandle> busy;
+    for (int i = 0; i < 20; i++) {
+        busy.push_back(pool.submit([background] {
+            const auto start = std::chrono::steady_clock::now();
+            while (!background.cancelled() && std::chrono::steady_clock::now() - start < 2s) {}
+        }, PRIORITY_BACKGROUND, background));
+    }
+    std::this_thread::sleep_for(10ms);
+
+    const auto start = std::chrono::steady_clock::now();
+    pool.submit([] {}, PRIORITY_INTERACTIVE).wait();
+    EXPECT_LT(std::chrono::steady_clock::now() - start, 1s);
+
+    background.cancel();
+    for (const auto& h : busy) h.wait();
+}
+
+}
+}
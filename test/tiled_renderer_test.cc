@@ -0,0 +1,83 @@
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "include/core/SkCanvas.h"
+#include "include/core/SkColor.h"
+#include "include/core/SkPaint.h"
+#include "include/core/SkPictureRecorder.h"
+#include "include/core/SkSurface.h"
+
+#include "tiled_renderer.h"
+
+namespace graphics {
+namespace {
+
+constexpr int kWidth  = 640;
+constexpr int kHeight = 480;
+
+// Overlapping opaque rects without anti-aliasing, so every tile rasterizes exactly like one surface
+sk_sp<SkPicture> Scene() {
+    SkPictureRecorder recorder;
+    SkCanvas* canvas = recorder.beginRecording(SkRect::MakeWH(kWidth, kHeight));
+    canvas->clear(SK_ColorBLACK);
+    SkPaint paint;
+    for (int i = 0; i < 40; i++) {
+        paint.setColor(SkColorSetARGB(255, i * 6, 255 - i * 6, (i * 37) & 255));
+        canvas->drawRect(SkRect::MakeXYWH(float(i * 17 % kWidth), float(i * 29 % kHeight), 50.f + i, 30.f + 2 * i), paint);
+    }
+    return recorder.finishRecordingAsPicture();
+}
+
+std::vector<uint8_t> Reference(const SkPicture* picture, const SkIRect& area) {
+    std::vector<uint8_t> pixels(size_t(area.width()) * area.height() * 4);
+    auto info    = SkImageInfo::Make(area.width(), area.height(), kBGRA_8888_SkColorType, kPremul_SkAlphaType);
+    auto surface = SkSurfaces::WrapPixels(info, pixels.data(), size_t(area.width()) * 4);
+    surface->getCanvas()->translate(-area.x(), -area.y());
+    surface->getCanvas()->drawPicture(picture);
+    return pixels;
+}
+
+std::vector<uint8_t> Tiled(const SkPicture* picture, const SkIRect& area, int threads, int tile_size) {
+    std::vector<uint8_t> pixels(size_t(area.width()) * area.height() * 4);
+    TiledRenderer renderer(threads, tile_size);
+    renderer.render(picture, pixels.data(), size_t(area.width()) * 4, area);
+    return pixels;
+}
+
+TEST(TiledRenderer, MatchesSingleSurface) {
+    const sk_sp<SkPicture> picture = Scene();
+    const SkIRect          area    = SkIRect::MakeWH(kWidth, kHeight);
+    const auto             want    = Reference(picture.get(), area);
+
+    // Tile sizes that do and do not divide the area, on one and on several threads
+    for (int threads : {1, 4}) {
+        for (int tile_size : {16, 37, TiledRenderer::kDefaultTileSize, 1024}) {
+            EXPECT_EQ(Tiled(picture.get(), area, threads, tile_size), want) << threads << " threads, tiles of " << tile_size;
+        }
+    }
+}
+
+TEST(TiledRenderer, RendersOnlyTheArea) {
+    const sk_sp<SkPicture> picture = Scene();
+    const SkIRect          area    = SkIRect::MakeLTRB(101, 53, 433, 301);
+    EXPECT_EQ(Tiled(picture.get(), area, 3, 64), Reference(picture.get(), area));
+}
+
+TEST(TiledRenderer, CountsTheCallingThread) {
+    EXPECT_EQ(TiledRenderer(1).threadCount(), 1);
+    EXPECT_EQ(TiledRenderer(3).threadCount(), 3);
+    EXPECT_GE(TiledRenderer(0).threadCount(), 1);
+}
+
+TEST(TiledRenderer, IgnoresEmptyJobs) {
+    const sk_sp<SkPicture> picture = Scene();
+    std::vector<uint8_t>   pixels(16, 0xAB);
+    TiledRenderer          renderer(2, 16);
+    renderer.render(picture.get(), pixels.data(), 16, SkIRect::MakeEmpty());
+    renderer.render(nullptr, pixels.data(), 16, SkIRect::MakeWH(2, 2));
+    EXPECT_EQ(pixels, std::vector<uint8_t>(16, 0xAB));
+}
+
+}
+}
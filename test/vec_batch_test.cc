@@ -0,0 +1,118 @@
+#include <random>
+#include <string>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "vec_batch.h"
+
+namespace simd {
+namespace {
+
+// Sizes around the 4 and 8 wide kernels and their tails
+const size_t kSizes[] = {0, 1, 3, 4, 5, 7, 8, 9, 15, 16, 17, 100, 1003};
+
+std::vector<AABB> RandomBoxes(size_t n, uint32_t seed) {
+    std::mt19937                          rng(seed);
+    std::uniform_real_distribution<float> pos(-1000.f, 1000.f);
+    std::uniform_real_distribution<float> size(0.f, 200.f);
+    std::vector<AABB>                     boxes;
+    for (size_t i = 0; i < n; i++) {
+        const float x = pos(rng), y = pos(rng);
+        boxes.emplace_back(x, y, x + size(rng), y + size(rng));
+    }
+    return boxes;
+}
+
+BoxBuffer Buffer(const std::vector<AABB>& boxes) {
+    BoxBuffer buffer;
+    for (const AABB& box : boxes) buffer.push_back(box);
+    return buffer;
+}
+
+void ExpectSameBox(const AABB& a, const AABB& b) {
+    EXPECT_EQ(a.ul.x, b.ul.x);
+    EXPECT_EQ(a.ul.y, b.ul.y);
+    EXPECT_EQ(a.br.x, b.br.x);
+    EXPECT_EQ(a.br.y, b.br.y);
+}
+
+TEST(VecBatch, KernelIsaIsKnown) {
+    const std::string isa = KernelIsa();
+    EXPECT_TRUE(isa == "avx2" || isa == "sse2" || isa == "scalar") << isa;
+}
+
+TEST(VecBatch, CullMatchesIntersects) {
+    const AABB rect(-100.f, -100.f, 300.f, 200.f);
+    for (size_t n : kSizes) {
+        const std::vector<AABB> boxes  = RandomBoxes(n, uint32_t(n));
+        const BoxBuffer         buffer = Buffer(boxes);
+
+        // Every sub range, so the kernels also start off their alignment
+        for (size_t first : {size_t(0), size_t(1), size_t(3)}) {
+            if (first > n) continue;
+            std::vector<uint32_t> found, expected;
+            CullBoxes(buffer, first, n - first, rect, nullptr, found);
+            for (size_t i = first; i < n; i++) {
+                if (boxes[i].Intersects(rect)) expected.push_back(uint32_t(i));
+            }
+            EXPECT_EQ(found, expected) << "n " << n << " first " << first;
+        }
+    }
+}
+
+TEST(VecBatch, CullAppendsIdsAndTouchingBoxes) {
+    // Boxes sharing an edge or a corner with rect intersect it, like AABB::Intersects says
+    const AABB              rect(0.f, 0.f, 10.f, 10.f);
+    const std::vector<AABB> boxes = {
+        AABB(10.f, 0.f, 20.f, 10.f), AABB(10.1f, 0.f, 20.f, 10.f), AABB(-5.f, -5.f, 0.f, 0.f),
+        AABB(2.f, 2.f, 3.f, 3.f),    AABB(-5.f, 11.f, 50.f, 12.f), AABB(-50.f, -50.f, 50.f, 50.f),
+    };
+    std::vector<uint32_t> expected_ids;
+    for (size_t i = 0; i < boxes.size(); i++) {
+        if (boxes[i].Intersects(rect)) expected_ids.push_back(uint32_t(100 + i));
+    }
+    ASSERT_EQ(expected_ids, (std::vector<uint32_t>{100, 102, 103, 105}));
+
+    const std::vector<uint32_t> ids = {100, 101, 102, 103, 104, 105};
+    std::vector<uint32_t>       found = {7};
+    CullBoxes(Buffer(boxes), 0, boxes.size(), rect, ids.data(), found);
+    expected_ids.insert(expected_ids.begin(), 7);
+    EXPECT_EQ(found, expected_ids);
+}
+
+TEST(VecBatch, BoundsMatchExpand) {
+    for (size_t n : kSizes) {
+        const std::vector<AABB> boxes  = RandomBoxes(n, uint32_t(n + 1));
+        const BoxBuffer         buffer = Buffer(boxes);
+        for (size_t first : {size_t(0), size_t(1), size_t(3)}) {
+            if (first >= n) continue;
+            AABB expected = boxes[first];
+            for (size_t i = first + 1; i < n; i++) expected.Expand(boxes[i]);
+            ExpectSameBox(Bounds(buffer, first, n - first), expected);
+        }
+    }
+    ExpectSameBox(Bounds(BoxBuffer()), AABB());
+}
+
+TEST(VecBatch, TransformMatchesPerCorner) {
+    const vec2  offset(3.f, -4.5f);
+    const float scale = 1.75f;
+    for (size_t n : kSizes) {
+        const std::vector<AABB> boxes = RandomBoxes(n, uint32_t(n + 2));
+        BoxBuffer               out;
+        TransformBoxes(Buffer(boxes), offset, scale, out);
+        ASSERT_EQ(out.size(), n);
+        for (size_t i = 0; i < n; i++) {
+            ExpectSameBox(out.get(i), AABB((boxes[i].ul - offset) * scale, (boxes[i].br - offset) * scale));
+        }
+
+        // In place gives the same
+        BoxBuffer in_place = Buffer(boxes);
+        TransformBoxes(in_place, offset, scale, in_place);
+        for (size_t i = 0; i < n; i++) ExpectSameBox(in_place.get(i), out.get(i));
+    }
+}
+
+}
+}
@@ -0,0 +1,248 @@
+#include <algorithm>
+#include <memory>
+#include <random>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "wire_router.h"
+
+namespace graphics {
+namespace {
+
+constexpr float kLeft  = 100.f; // right edge of the parent
+constexpr float kRight = 140.f; // left edge of the children
+
+// A parent and its children stacked in a column to its right, like the layout places them
+struct Design {
+    SV::Module     parent;
+    SV::Module     child;
+    LayoutSnapshot snapshot;
+
+    Design(const Design&)            = delete;
+    Design& operator=(const Design&) = delete;
+
+    explicit Design(size_t num_children) {
+        parent.name = "p";
+        child.name  = "c";
+        for (size_t i = 0; i < num_children; i++) {
+            SV::ModuleInstance instance;
+            instance.module        = &child;
+            instance.instance_name = "u" + std::to_string(i);
+            instance.parent        = &parent;
+            parent.dependencies.push_back(instance);
+        }
+    }
+
+    void connect(size_t child_index, const std::string& port, const std::string& signal) {
+        parent.dependencies[child_index].port_mapping.push_back({SV::NAMED, port, signal});
+    }
+
+    // Items in depth first order, taken once every connection is made
+    const LayoutSnapshot& layout() {
+        snapshot.generation = 7;
+        snapshot.items.clear();
+        snapshot.items.push_back(Item(AABB(0.f, 40.f, kLeft, 60.f), &parent, nullptr, uint32_t(parent.dependencies.size() + 1)));
+        for (size_t i = 0; i < parent.dependencies.size(); i++) {
+            const float y = float(i) * 25.f;
+            snapshot.items.push_back(Item(AABB(kRight, y, kRight + 60.f, y + 20.f), &child, &parent.dependencies[i], uint32_t(i + 2)));
+        }
+        // One node per item, for routings that start from an earlier one
+        snapshot.item_of_node.clear();
+        for (uint32_t i = 0; i < snapshot.items.size(); i++) {
+            snapshot.items[i].node = i;
+            snapshot.item_of_node.push_back(i);
+        }
+        return snapshot;
+    }
+
+    static GraphItem Item(const AABB& box, SV::Module* module, const SV::ModuleInstance* instance, uint32_t subtree_end) {
+        GraphItem item{};
+        item.box         = box;
+        item.module      = module;
+        item.instance    = instance;
+        item.subtree_end = subtree_end;
+        item.expanded    = true;
+        return item;
+    }
+};
+
+// x of the vertical trunk of a net
+float TrunkX(const WireLayout& wires, const WireNet& net) {
+    const WireSegment& s = wires.segments[net.first_segment];
+    if (s.from.x == s.to.x) return s.from.x;
+    return s.from.x == kLeft ? s.to.x : s.from.x;
+}
+
+// Most nets that are on one height at once, the tracks a channel needs at least
+size_t MaxOverlap(const WireLayout& wires) {
+    size_t most = 0;
+    for (const WireNet& a : wires.nets) {
+        size_t overlap = 0;
+        for (const WireNet& b : wires.nets) overlap += b.bounds.ul.y <= a.bounds.ul.y && a.bounds.ul.y <= b.bounds.br.y;
+        most = std::max(most, overlap);
+    }
+    return most;
+}
+
+// Four children in a chain: clk to every child, d from the parent port, w_i from one child to the next
+void Chain(Design& design) {
+    design.parent.ports.resize(2);
+    design.parent.ports[0].name      = "d";
+    design.parent.ports[1].name      = "q";
+    design.parent.ports[1].port_type = SV::OUTPUT;
+    for (size_t i = 0; i < 4; i++) {
+        design.connect(i, "clk", "clk");
+        design.connect(i, "d", i == 0 ? "d" : "w_" + std::to_string(i - 1));
+        design.connect(i, "q", "w_" + std::to_string(i));
+    }
+}
+
+TEST(RouteWires, OneNetPerConnectedSignal) {
+    Design design(4);
+    Chain(design);
+    const auto wires = routeWires(design.layout());
+    ASSERT_NE(wires, nullptr);
+    EXPECT_EQ(wires->generation, 7u);
+
+    // clk, d, w_0, w_1 and w_2, w_3 only has one end
+    ASSERT_EQ(wires->nets.size(), 5u);
+    EXPECT_EQ(wires->channel_width, kRight - kLeft);
+
+    size_t ports = 0;
+    for (const WireNet& net : wires->nets) {
+        ports += net.style == WIRE_PORT;
+        EXPECT_NE(net.style, WIRE_BUS);
+
+        // Stubs reach from the trunk to the edges, inside the bounds of the net
+        for (uint32_t s = net.first_segment; s < net.first_segment + net.num_segments; s++) {
+            const WireSegment& seg = wires->segments[s];
+            EXPECT_TRUE(seg.from.x == seg.to.x || seg.from.y == seg.to.y);
+            EXPECT_TRUE(seg.to.x == kRight || seg.from.x == kLeft || seg.from.x == seg.to.x);
+            EXPECT_GE(std::min(seg.from.y, seg.to.y), net.bounds.ul.y);
+            EXPECT_LE(std::max(seg.from.y, seg.to.y), net.bounds.br.y);
+        }
+    }
+    EXPECT_EQ(ports, 1u);
+}
+
+TEST(RouteWires, OverlappingNetsGetTracksOfTheirOwn) {
+    std::mt19937 rng(5);
+    for (int round = 0; round < 20; round++) {
+        Design design(12);
+        for (size_t i = 0; i < 12; i++) {
+            for (size_t k = 0; k < 3; k++) design.connect(i, "p" + std::to_string(k), "s" + std::to_string(rng() % 10));
+        }
+        const auto wires = routeWires(design.layout());
+        ASSERT_NE(wires, nullptr);
+
+        std::set<float> tracks;
+        for (size_t a = 0; a < wires->nets.size(); a++) {
+            const float x = TrunkX(*wires, wires->nets[a]);
+            EXPECT_GT(x, kLeft);
+            EXPECT_LT(x, kRight);
+            tracks.insert(x);
+            for (size_t b = a + 1; b < wires->nets.size(); b++) {
+                const AABB& ba = wires->nets[a].bounds;
+                const AABB& bb = wires->nets[b].bounds;
+                if (ba.ul.y <= bb.br.y && bb.ul.y <= ba.br.y) {
+                    EXPECT_NE(x, TrunkX(*wires, wires->nets[b]));
+                }
+            }
+        }
+        // Left edge first needs no more tracks than nets overlap
+        EXPECT_EQ(tracks.size(), MaxOverlap(*wires));
+    }
+}
+
+TEST(RouteWires, ParametersAndRanges) {
+    Design design(4);
+    Chain(design);
+    design.parent.parameters.resize(1);
+    design.parent.parameters[0].name = "WIDTH";
+    design.connect(0, "W", "WIDTH");
+    design.connect(1, "W", "WIDTH");
+    design.layout();
+    design.snapshot.items[2].is_range = true;
+
+    const auto wires = routeWires(design.snapshot);
+    ASSERT_NE(wires, nullptr);
+    // WIDTH is handed down, not a wire, and the nets touching the range are buses
+    EXPECT_EQ(wires->nets.size(), 5u);
+    size_t buses = 0;
+    for (const WireNet& net : wires->nets) buses += net.style == WIRE_BUS;
+    EXPECT_EQ(buses, 3u); // clk, w_0 and w_1
+}
+
+TEST(RouteWires, CollapsedAndCancelled) {
+    Design design(4);
+    Chain(design);
+    design.layout();
+    design.snapshot.items[0].expanded = false;
+    EXPECT_TRUE(routeWires(design.snapshot)->nets.empty());
+
+    task::CancelToken token;
+    token.cancel();
+    design.snapshot.items[0].expanded = true;
+    EXPECT_EQ(routeWires(design.snapshot, token), nullptr);
+}
+
+TEST(RouteWires, TakesOverParentsThatOnlyMoved) {
+    Design design(4);
+    Chain(design);
+    const LayoutSnapshot before = design.layout();
+    const auto           routed = routeWires(before);
+    ASSERT_NE(routed, nullptr);
+    ASSERT_EQ(routed->parents.size(), 1u);
+    EXPECT_EQ(routed->parents[0].num_nets, 5u);
+
+    // Marked, so a net that is taken over can be told from one routed again
+    WireLayout prev = *routed;
+    prev.nets[0].style = WIRE_BUS;
+
+    // Everything moved together
+    LayoutSnapshot moved = before;
+    const vec2     delta(10.f, 30.f);
+    for (GraphItem& item : moved.items) item.box = AABB(item.box.ul + delta, item.box.br + delta);
+    const auto wires = routeWires(moved, task::CancelToken(), &before, &prev);
+    ASSERT_NE(wires, nullptr);
+    ASSERT_EQ(wires->nets.size(), routed->nets.size());
+    ASSERT_EQ(wires->segments.size(), routed->segments.size());
+    EXPECT_EQ(wires->nets[0].style, WIRE_BUS);
+    EXPECT_EQ(wires->channel_width, routed->channel_width);
+    for (size_t s = 0; s < wires->segments.size(); s++) {
+        EXPECT_EQ(wires->segments[s].from, routed->segments[s].from + delta);
+        EXPECT_EQ(wires->segments[s].to, routed->segments[s].to + delta);
+    }
+
+    // A child that moved on its own has its ports somewhere else
+    LayoutSnapshot changed = before;
+    changed.items[2].box = AABB(changed.items[2].box.ul + vec2(0.f, 2.f), changed.items[2].box.br + vec2(0.f, 2.f));
+    const auto again = routeWires(changed, task::CancelToken(), &before, &prev);
+    ASSERT_NE(again, nullptr);
+    EXPECT_NE(again->nets[0].style, WIRE_BUS);
+    EXPECT_EQ(again->segments.size(), routeWires(changed)->segments.size());
+}
+
+TEST(WireRouter, KeepsTheLatestRouting) {
+    Design design(4);
+    Chain(design);
+    const auto snapshot = std::make_shared<LayoutSnapshot>(design.layout());
+
+    WireRouter router;
+    EXPECT_EQ(router.wires(), nullptr);
+    router.route(snapshot);
+    router.route(snapshot);
+    router.waitIdle();
+    ASSERT_NE(router.wires(), nullptr);
+    EXPECT_EQ(router.wires()->nets.size(), 5u);
+
+    router.route(nullptr);
+    router.waitIdle();
+    EXPECT_EQ(router.wires(), nullptr);
+}
+
+}
+}